@@ -0,0 +1,63 @@
+//
+//  airflow.h
+//  3D Object Drawing
+//
+//  The air the ceiling fans move, shared by everything the fans blow around.
+//  Each fan adds a downdraft under its hub, a swirl in the direction of its
+//  blades and an outflow along the floor, all scaled by how fast it spins. The
+//  falloffs are rational rather than exponential so block-wise evaluations (see
+//  particles.h) vectorize.
+//
+
+#ifndef AIRFLOW_H
+#define AIRFLOW_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+const float AIRFLOW_PUSH = 7.0f;            // downdraft speed under the hub per unit of blade tip speed
+const float AIRFLOW_SWIRL = 0.5f;           // swirl speed at the blade tips per unit of downdraft
+const float AIRFLOW_FLOOR_LAYER = 0.6f;     // height of the outflow along the floor
+const int AIRFLOW_MAX_FANS = 8;             // fans a simulation follows at once
+
+// a fan as the airflow sees it
+struct Airflow
+{
+    glm::vec3 Hub;              // center of the blades
+    float Radius;               // blade length
+    float Spin;                 // radians per second about +z, 0 when off
+};
+
+// downdraft speed under the hub; the on-screen fans spin slowly, so the push is exaggerated
+inline float AirflowPush(const Airflow& fan)
+{
+    return AIRFLOW_PUSH * std::fabs(fan.Spin) * fan.Radius;
+}
+
+// velocity of one fan's air at the offset (dx, dy) from its axis, below the hub's height
+// and height above the floor
+inline glm::vec3 AirflowVelocity(const Airflow& fan, float dx, float dy, float below, float height)
+{
+    float r2 = fan.Radius * fan.Radius;
+    float push = AirflowPush(fan);
+    float spread = r2 / (r2 + dx * dx + dy * dy);   // 1 on the axis, 1/2 at the blade tips
+    float core = spread * spread;
+    float under = std::min(std::max(below * 4.0f, 0.0f), 1.0f);
+    float floorLayer = std::max(1.0f - height * (1.0f / AIRFLOW_FLOOR_LAYER), 0.0f);
+    float swirl = std::copysign(AIRFLOW_SWIRL * push / fan.Radius, fan.Spin) * core;
+    float outflow = push * floorLayer * spread / fan.Radius;
+    return glm::vec3(-dy * swirl + dx * outflow, dx * swirl + dy * outflow, -push * core * under);
+}
+
+// velocity of the air at p in a room whose floor is at floorZ
+inline glm::vec3 AirVelocity(const Airflow* fans, int fanCount, const glm::vec3& p, float floorZ)
+{
+    glm::vec3 velocity(0.0f);
+    for (int f = 0; f < fanCount; f++)
+        velocity += AirflowVelocity(fans[f], p.x - fans[f].Hub.x, p.y - fans[f].Hub.y, fans[f].Hub.z - p.z, p.z - floorZ);
+    return velocity;
+}
+
+#endif
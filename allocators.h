@@ -0,0 +1,239 @@
+//
+//  allocators.h
+//  3D Object Drawing
+//
+//  Allocation helpers for the render loop: a linear arena for data that only
+//  lives for one frame, a fixed-size block pool for container nodes that come
+//  and go, and the counter behind the global operator new hook (defined once in
+//  main.cpp). Scene nodes, streamed chunks and edited furniture live in flat
+//  arrays whose slots are reused, so they need no allocator of their own.
+//
+
+#ifndef ALLOCATORS_H
+#define ALLOCATORS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// incremented by the global operator new replacement, per thread: the render loop's count
+// leaves out the telemetry server and the thread pool's workers
+extern thread_local unsigned long long heapAllocationCount;
+
+// heap allocations the calling thread made so far
+inline unsigned long long HeapAllocationCount()
+{
+    return heapAllocationCount;
+}
+
+// Linear allocator reset once per frame. Overflow falls back to the heap for the rest
+// of the frame and the arena grows to the high-water mark on the next Reset(), so
+// steady-state frames never touch the heap.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t capacity = 1 << 20)
+        : buffer(nullptr), capacity(0), offset(0), highWater(0), overflowBytes(0)
+    {
+        grow(capacity);
+        overflow.reserve(16);
+    }
+
+    ~FrameArena()
+    {
+        releaseOverflow();
+        ::operator delete(buffer);
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+        if (aligned + size <= capacity)
+        {
+            offset = aligned + size;
+            highWater = std::max(highWater, offset);
+            return buffer + aligned;
+        }
+        overflowBytes += size + alignment;
+        highWater = std::max(highWater, offset + overflowBytes);
+        void* block = ::operator new(size + alignment);
+        overflow.push_back(block);
+        uintptr_t address = (reinterpret_cast<uintptr_t>(block) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        return reinterpret_cast<void*>(address);
+    }
+
+    // uninitialized storage for count objects; only for trivially destructible types
+    template<typename T>
+    T* Allocate(size_t count)
+    {
+        return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void Reset()
+    {
+        if (!overflow.empty())
+        {
+            releaseOverflow();
+            grow(highWater + highWater / 2);
+        }
+        offset = 0;
+    }
+
+    size_t Capacity() const { return capacity; }
+    size_t Used() const { return offset; }
+    size_t HighWater() const { return highWater; }
+
+private:
+    unsigned char* buffer;
+    size_t capacity;
+    size_t offset;
+    size_t highWater;
+    size_t overflowBytes;
+    std::vector<void*> overflow;
+
+    void grow(size_t newCapacity)
+    {
+        ::operator delete(buffer);
+        buffer = static_cast<unsigned char*>(::operator new(newCapacity));
+        capacity = newCapacity;
+    }
+
+    void releaseOverflow()
+    {
+        for (void* block : overflow)
+            ::operator delete(block);
+        overflow.clear();
+        overflowBytes = 0;
+    }
+};
+
+// Fixed-size block pool. Blocks live in chunks that are never returned to the heap until
+// the pool goes away, freed blocks are reused through an intrusive free list.
+class PoolAllocator
+{
+public:
+    explicit PoolAllocator(size_t blockSize, size_t chunkBlocks = 256)
+        : blockSize(std::max((blockSize + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t), sizeof(Slot))),
+          chunkBlocks(chunkBlocks), freeList(nullptr), live(0)
+    {
+    }
+
+    ~PoolAllocator()
+    {
+        for (void* chunk : chunks)
+            ::operator delete(chunk);
+    }
+
+    PoolAllocator(const PoolAllocator&) = delete;
+    PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+    void* Allocate()
+    {
+        if (freeList == nullptr)
+            addChunk();
+        Slot* slot = freeList;
+        freeList = slot->Next;
+        live++;
+        return slot;
+    }
+
+    void Free(void* block)
+    {
+        Slot* slot = static_cast<Slot*>(block);
+        slot->Next = freeList;
+        freeList = slot;
+        live--;
+    }
+
+    // makes sure count more blocks can be allocated without touching the heap
+    void Reserve(size_t count)
+    {
+        size_t available = chunks.size() * chunkBlocks - live;
+        while (available < count)
+        {
+            addChunk();
+            available += chunkBlocks;
+        }
+    }
+
+    size_t BlockSize() const { return blockSize; }
+    size_t Live() const { return live; }
+
+private:
+    struct Slot
+    {
+        Slot* Next;
+    };
+
+    size_t blockSize;
+    size_t chunkBlocks;
+    std::vector<void*> chunks;
+    Slot* freeList;
+    size_t live;
+
+    void addChunk()
+    {
+        unsigned char* chunk = static_cast<unsigned char*>(::operator new(blockSize * chunkBlocks));
+        for (size_t i = chunkBlocks; i-- > 0;)
+        {
+            Slot* slot = reinterpret_cast<Slot*>(chunk + i * blockSize);
+            slot->Next = freeList;
+            freeList = slot;
+        }
+        chunks.push_back(chunk);
+    }
+};
+
+// Standard allocator that takes the single nodes of node based containers (std::map,
+// std::list) from a PoolAllocator, so an insert after an erase reuses the erased node
+// instead of going to the heap. Anything larger than the pool's blocks, and arrays, still
+// come from the heap. The pool must outlive the containers using it.
+template<typename T>
+class PoolNodeAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit PoolNodeAllocator(PoolAllocator& pool) : pool(&pool) {}
+
+    template<typename U>
+    PoolNodeAllocator(const PoolNodeAllocator<U>& other) : pool(other.pool) {}
+
+    T* allocate(size_t count)
+    {
+        if (fromPool(count))
+            return static_cast<T*>(pool->Allocate());
+        return static_cast<T*>(::operator new(count * sizeof(T)));
+    }
+
+    void deallocate(T* block, size_t count)
+    {
+        if (fromPool(count))
+            pool->Free(block);
+        else
+            ::operator delete(block);
+    }
+
+    template<typename U>
+    bool operator==(const PoolNodeAllocator<U>& other) const { return pool == other.pool; }
+    template<typename U>
+    bool operator!=(const PoolNodeAllocator<U>& other) const { return pool != other.pool; }
+
+private:
+    template<typename U>
+    friend class PoolNodeAllocator;
+
+    PoolAllocator* pool;
+
+    bool fromPool(size_t count) const
+    {
+        return count == 1 && sizeof(T) <= pool->BlockSize() && alignof(T) <= alignof(std::max_align_t);
+    }
+};
+
+#endif
@@ -0,0 +1,153 @@
+//
+//  animation.h
+//  3D Object Drawing
+//
+//  Batched animation of scene nodes. Procedural rotators and keyframe tracks are
+//  stored as flat per-field arrays and evaluated in one pass per kind; the pass is
+//  split across the thread pool once there are enough animations to pay for it.
+//  Results are then scattered onto the scene, marking only the touched nodes dirty.
+//
+
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "scene.h"
+#include "thread_pool.h"
+
+#include <cmath>
+#include <vector>
+
+// animations per chunk below which splitting across threads costs more than it saves
+const size_t ANIMATION_PARALLEL_CHUNK = 4096;
+
+class AnimationSystem
+{
+public:
+    // procedural rotators: angle += speed * dt while active
+    std::vector<unsigned int> RotatorNode;
+    std::vector<float> RotatorSpeed;        // degrees per second
+    std::vector<float> RotatorPhase;        // degrees added on top of the accumulated angle
+    std::vector<float> RotatorAngle;        // accumulated angle in [0, 360)
+    std::vector<float> RotatorActive;       // 1 or 0, multiplied in so the update has no branches
+
+    // keyframe tracks: piecewise linear, looping, keys packed in KeyTime/KeyValue
+    std::vector<unsigned int> TrackNode;
+    std::vector<int> TrackChannel;
+    std::vector<unsigned int> TrackFirstKey;
+    std::vector<unsigned int> TrackKeyCount;
+    std::vector<float> TrackSpeed;          // playback rate
+    std::vector<float> TrackPhase;          // seconds added to the local time
+    std::vector<float> TrackTime;           // local time in [0, duration)
+    std::vector<float> TrackActive;
+    std::vector<float> TrackValue;          // result of the last evaluation
+    std::vector<float> KeyTime;
+    std::vector<float> KeyValue;
+
+    unsigned int AddRotator(unsigned int node, float speed, float phase = 0.0f, bool active = true)
+    {
+        RotatorNode.push_back(node);
+        RotatorSpeed.push_back(speed);
+        RotatorPhase.push_back(phase);
+        RotatorAngle.push_back(0.0f);
+        RotatorActive.push_back(active ? 1.0f : 0.0f);
+        return static_cast<unsigned int>(RotatorNode.size() - 1);
+    }
+
+    // times must be increasing and start at 0; the last key time is the loop length
+    unsigned int AddTrack(unsigned int node, int channel, const float* times, const float* values, unsigned int keyCount,
+                          float speed = 1.0f, float phase = 0.0f, bool active = true)
+    {
+        TrackNode.push_back(node);
+        TrackChannel.push_back(channel);
+        TrackFirstKey.push_back(static_cast<unsigned int>(KeyTime.size()));
+        TrackKeyCount.push_back(keyCount);
+        TrackSpeed.push_back(speed);
+        TrackPhase.push_back(phase);
+        TrackTime.push_back(0.0f);
+        TrackActive.push_back(active ? 1.0f : 0.0f);
+        TrackValue.push_back(keyCount > 0 ? values[0] : 0.0f);
+        KeyTime.insert(KeyTime.end(), times, times + keyCount);
+        KeyValue.insert(KeyValue.end(), values, values + keyCount);
+        return static_cast<unsigned int>(TrackNode.size() - 1);
+    }
+
+    void SetRotatorActive(unsigned int rotator, bool active) { RotatorActive[rotator] = active ? 1.0f : 0.0f; }
+    void SetTrackActive(unsigned int track, bool active) { TrackActive[track] = active ? 1.0f : 0.0f; }
+
+    // advances every animation by deltaTime and writes the results into the scene
+    void Update(float deltaTime, Scene& scene, ThreadPool* pool = nullptr)
+    {
+        size_t rotatorCount = RotatorNode.size();
+        size_t trackCount = TrackNode.size();
+
+        if (pool != nullptr)
+        {
+            pool->ParallelFor(rotatorCount, ANIMATION_PARALLEL_CHUNK, [this, deltaTime](size_t begin, size_t end) { updateRotators(begin, end, deltaTime); });
+            pool->ParallelFor(trackCount, ANIMATION_PARALLEL_CHUNK, [this, deltaTime](size_t begin, size_t end) { updateTracks(begin, end, deltaTime); });
+        }
+        else
+        {
+            updateRotators(0, rotatorCount, deltaTime);
+            updateTracks(0, trackCount, deltaTime);
+        }
+
+        // scatter serially: several animations may drive the same node
+        for (size_t i = 0; i < rotatorCount; i++)
+        {
+            if (RotatorActive[i] != 0.0f && RotatorSpeed[i] != 0.0f)
+                scene.SetChannel(RotatorNode[i], CHANNEL_ANGLE, RotatorAngle[i] + RotatorPhase[i]);
+        }
+        for (size_t i = 0; i < trackCount; i++)
+        {
+            if (TrackActive[i] != 0.0f)
+                scene.SetChannel(TrackNode[i], TrackChannel[i], TrackValue[i]);
+        }
+    }
+
+private:
+    void updateRotators(size_t begin, size_t end, float deltaTime)
+    {
+        float* angle = RotatorAngle.data();
+        const float* speed = RotatorSpeed.data();
+        const float* active = RotatorActive.data();
+        for (size_t i = begin; i < end; i++)
+        {
+            float a = angle[i] + speed[i] * active[i] * deltaTime;
+            angle[i] = a - 360.0f * std::floor(a * (1.0f / 360.0f));
+        }
+    }
+
+    void updateTracks(size_t begin, size_t end, float deltaTime)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            unsigned int keyCount = TrackKeyCount[i];
+            if (keyCount == 0)
+                continue;
+            const float* times = &KeyTime[TrackFirstKey[i]];
+            const float* values = &KeyValue[TrackFirstKey[i]];
+            float duration = times[keyCount - 1];
+            if (keyCount == 1 || duration <= 0.0f)
+            {
+                TrackValue[i] = values[0];
+                continue;
+            }
+
+            float t = TrackTime[i] + TrackSpeed[i] * TrackActive[i] * deltaTime;
+            t -= duration * std::floor(t / duration);
+            TrackTime[i] = t;
+
+            float local = TrackTime[i] + TrackPhase[i];
+            local -= duration * std::floor(local / duration);
+
+            unsigned int key = 1;
+            while (key < keyCount - 1 && times[key] < local)
+                key++;
+            float span = times[key] - times[key - 1];
+            float f = span > 0.0f ? (local - times[key - 1]) / span : 0.0f;
+            TrackValue[i] = values[key - 1] + (values[key] - values[key - 1]) * f;
+        }
+    }
+};
+
+#endif
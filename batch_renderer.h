@@ -0,0 +1,347 @@
+//
+//  batch_renderer.h
+//  3D Object Drawing
+//
+//  Renders lists of camera poses of one or more room layouts offscreen, for
+//  generating image datasets without the interactive window. Every worker thread
+//  owns an independent GL context (a hidden GLFW window) with its own renderer,
+//  material table and framebuffer, and takes the next camera from a shared
+//  counter, so the workers never wait on each other. Images are read back through
+//  a pair of pixel buffers: the readback of one image overlaps the drawing of the
+//  next, and the finished pixels are handed to the sink on the worker's thread.
+//
+
+#ifndef BATCH_RENDERER_H
+#define BATCH_RENDERER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bounds.h"
+#include "bvh.h"
+#include "gpu_memory.h"
+#include "materials.h"
+#include "scene.h"
+#include "scene_renderer.h"
+#include "transparency.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// pixel buffers per context; two let a readback overlap the next image's draw
+const int BATCH_READBACK_BUFFERS = 2;
+
+// GPU memory of one context: the cube and the instances of one camera's visible parts
+const size_t BATCH_VERTEX_ARENA_BYTES = 64 << 10;
+const size_t BATCH_INDEX_ARENA_BYTES = 16 << 10;
+const size_t BATCH_INSTANCE_ARENA_BYTES = 1 << 20;
+
+struct BatchCamera
+{
+    unsigned int Layout;        // from BatchRenderer::AddLayout()
+    glm::vec3 Position;
+    glm::vec3 Target;
+    float Fov;                  // vertical, in degrees
+};
+
+// a finished image; Pixels are RGBA rows from bottom to top and only valid during the sink call
+struct BatchImage
+{
+    unsigned int Index;         // position of the camera in the Render() call
+    unsigned int Layout;
+    int Width, Height;
+    const unsigned char* Pixels;
+};
+
+typedef void (*BatchMaterialBuilder)(MaterialTable& materials);
+
+// called from every worker thread at once, in completion order
+typedef std::function<void(const BatchImage& image)> BatchSink;
+
+class BatchRenderer
+{
+public:
+    int Width, Height;
+    glm::vec3 Up;
+    float Near, Far;
+    glm::vec4 ClearColor;
+
+    // statistics of the last Render()
+    unsigned long long Images;
+    double Seconds;
+
+    // creates contextCount hidden windows with their GL resources; call on the main thread
+    // after glfwInit(). The cube is the 6-float (position, color) mesh the room is built from.
+    BatchRenderer(int width, int height, unsigned int contextCount, BatchMaterialBuilder buildMaterials,
+                  const float* cubeVertices, size_t vertexBytes, const unsigned int* cubeIndices, size_t indexBytes)
+        : Width(width), Height(height), Up(0.0f, 0.0f, 1.0f), Near(0.1f), Far(100.0f), ClearColor(0.2f, 0.3f, 0.3f, 1.0f),
+          Images(0), Seconds(0.0)
+    {
+        glfwDefaultWindowHints();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+        for (unsigned int i = 0; i < std::max(contextCount, 1u); i++)
+        {
+            GLFWwindow* window = glfwCreateWindow(1, 1, "batch", NULL, NULL);
+            if (window == NULL)
+                break;
+            glfwMakeContextCurrent(window);
+            if (contexts.empty() && !gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+            {
+                std::cout << "ERROR::BATCH::GLAD_FAILED" << std::endl;
+                glfwDestroyWindow(window);
+                break;
+            }
+            Context* context = new Context;
+            context->Window = window;
+            createResources(*context, buildMaterials, cubeVertices, vertexBytes, cubeIndices, indexBytes);
+            contexts.push_back(context);
+        }
+        glfwMakeContextCurrent(NULL);
+        if (contexts.empty())
+            std::cout << "ERROR::BATCH::NO_CONTEXT" << std::endl;
+    }
+
+    ~BatchRenderer()
+    {
+        Release();
+    }
+
+    BatchRenderer(const BatchRenderer&) = delete;
+    BatchRenderer& operator=(const BatchRenderer&) = delete;
+
+    bool Ok() const { return !contexts.empty(); }
+    unsigned int ContextCount() const { return static_cast<unsigned int>(contexts.size()); }
+
+    // registers a layout to render; the scene must stay alive and unchanged while rendering
+    unsigned int AddLayout(const Scene& scene)
+    {
+        Layout* layout = new Layout;
+        layout->Source = &scene;
+        layout->Bvh.Build(scene.PartBounds.data(), scene.PartCount());
+        layouts.push_back(layout);
+        return static_cast<unsigned int>(layouts.size() - 1);
+    }
+
+    // renders every camera and returns when all images went through the sink
+    void Render(const BatchCamera* cameras, unsigned int count, const BatchSink& sink)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::atomic<unsigned int> next(0);
+        std::vector<std::thread> workers;
+        for (Context* context : contexts)
+            workers.emplace_back([this, context, cameras, count, &next, &sink]() { work(*context, cameras, count, next, sink); });
+        for (std::thread& worker : workers)
+            worker.join();
+        Images = count;
+        Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void PrintStats() const
+    {
+        std::cout << "batch: " << Images << " images of " << Width << "x" << Height << " on " << contexts.size() << " contexts in "
+                  << Seconds << " s, " << (Seconds > 0.0 ? Images / Seconds : 0.0) << " images/s" << std::endl;
+    }
+
+    // destroys the contexts with everything created in them; main thread only
+    void Release()
+    {
+        for (Context* context : contexts)
+        {
+            glfwMakeContextCurrent(context->Window);
+            context->Renderer->Release();
+            delete context->Renderer;
+            context->Transparency->Release();
+            delete context->Transparency;
+            context->Materials.Release();
+            glDeleteVertexArrays(1, &context->VAO);
+            context->Vertices.Reset();
+            context->Indices.Reset();
+            context->Memory->Release();
+            delete context->Memory;
+            glDeleteFramebuffers(1, &context->Framebuffer);
+            glDeleteRenderbuffers(1, &context->ColorBuffer);
+            glDeleteRenderbuffers(1, &context->DepthBuffer);
+            glDeleteBuffers(BATCH_READBACK_BUFFERS, context->PixelBuffers);
+            glfwMakeContextCurrent(NULL);
+            glfwDestroyWindow(context->Window);
+            delete context;
+        }
+        contexts.clear();
+        for (Layout* layout : layouts)
+            delete layout;
+        layouts.clear();
+    }
+
+private:
+    struct Layout
+    {
+        const Scene* Source;
+        BVH Bvh;
+    };
+
+    struct Context
+    {
+        GLFWwindow* Window;
+        SceneRenderer* Renderer;
+        TransparencyTarget* Transparency;
+        MaterialTable Materials;
+        GpuMemory* Memory;
+        GpuBlock Vertices, Indices;
+        unsigned int VAO;
+        unsigned int Framebuffer, ColorBuffer, DepthBuffer;
+        unsigned int PixelBuffers[BATCH_READBACK_BUFFERS];
+        unsigned int PendingCamera[BATCH_READBACK_BUFFERS];     // camera read into each buffer, or count when idle
+        std::vector<unsigned int> Visible;
+    };
+
+    std::vector<Context*> contexts;
+    std::vector<Layout*> layouts;
+
+    void createResources(Context& context, BatchMaterialBuilder buildMaterials,
+                         const float* cubeVertices, size_t vertexBytes, const unsigned int* cubeIndices, size_t indexBytes)
+    {
+        // GL objects are not shared between the contexts, so each has its own arenas
+        context.Memory = new GpuMemory(BATCH_VERTEX_ARENA_BYTES, BATCH_INDEX_ARENA_BYTES, BATCH_INSTANCE_ARENA_BYTES);
+        context.Vertices = context.Memory->Allocate(GPU_MEMORY_VERTEX, vertexBytes, "batch cube vertices", false);
+        context.Indices = context.Memory->Allocate(GPU_MEMORY_INDEX, indexBytes, "batch cube indices", false);
+        context.Vertices.Upload(cubeVertices, vertexBytes);
+        context.Indices.Upload(cubeIndices, indexBytes);
+
+        glGenVertexArrays(1, &context.VAO);
+        glBindVertexArray(context.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, context.Vertices.Buffer());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, context.Indices.Buffer());
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)context.Vertices.Offset());
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(context.Vertices.Offset() + 12));
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(0);
+
+        context.Renderer = new SceneRenderer(context.Memory->Arena(GPU_MEMORY_INSTANCE));
+        context.Renderer->AttachInstances(context.VAO);
+        context.Renderer->IndexOffset = context.Indices.Offset();
+        buildMaterials(context.Materials);
+        context.Materials.Upload();
+
+        glGenRenderbuffers(1, &context.ColorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, context.ColorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, Width, Height);
+        glGenRenderbuffers(1, &context.DepthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, context.DepthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, Width, Height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glGenFramebuffers(1, &context.Framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, context.Framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, context.ColorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, context.DepthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::BATCH::FRAMEBUFFER_INCOMPLETE" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        context.Transparency = new TransparencyTarget();
+        context.Transparency->Attach(context.DepthBuffer);
+        context.Renderer->UseTransparency(context.Transparency);
+
+        glGenBuffers(BATCH_READBACK_BUFFERS, context.PixelBuffers);
+        for (int i = 0; i < BATCH_READBACK_BUFFERS; i++)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, context.PixelBuffers[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<size_t>(Width) * Height * 4, NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    // worker thread: draws cameras until none are left, one readback in flight
+    void work(Context& context, const BatchCamera* cameras, unsigned int count, std::atomic<unsigned int>& next, const BatchSink& sink)
+    {
+        glfwMakeContextCurrent(context.Window);
+        glBindFramebuffer(GL_FRAMEBUFFER, context.Framebuffer);
+        glViewport(0, 0, Width, Height);
+        glEnable(GL_DEPTH_TEST);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        for (int i = 0; i < BATCH_READBACK_BUFFERS; i++)
+            context.PendingCamera[i] = count;
+
+        int buffer = 0;
+        for (;;)
+        {
+            unsigned int index = next.fetch_add(1, std::memory_order_relaxed);
+            if (index >= count)
+                break;
+            draw(context, cameras[index]);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, context.PixelBuffers[buffer]);
+            glReadPixels(0, 0, Width, Height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+            context.PendingCamera[buffer] = index;
+
+            // the previous image had a whole draw to finish its transfer
+            buffer = (buffer + 1) % BATCH_READBACK_BUFFERS;
+            deliver(context, buffer, cameras, count, sink);
+        }
+        for (int i = 0; i < BATCH_READBACK_BUFFERS; i++)
+        {
+            buffer = (buffer + 1) % BATCH_READBACK_BUFFERS;
+            deliver(context, buffer, cameras, count, sink);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glfwMakeContextCurrent(NULL);
+    }
+
+    void draw(Context& context, const BatchCamera& camera)
+    {
+        const Layout& layout = *layouts[camera.Layout];
+        const Scene& scene = *layout.Source;
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Fov), static_cast<float>(Width) / Height, Near, Far);
+        glm::mat4 viewProjection = projection * glm::lookAt(camera.Position, camera.Target, Up);
+        glm::vec4 tile(1.0f, 1.0f, 0.0f, 0.0f);
+
+        glClearColor(ClearColor.x, ClearColor.y, ClearColor.z, ClearColor.w);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        context.Visible.resize(scene.PartCount());
+        unsigned int visibleCount = layout.Bvh.QueryFrustum(Frustum(viewProjection), context.Visible.data(), scene.PartCount());
+        context.Renderer->Begin();
+        context.Renderer->AddVisible(scene, context.Visible.data(), visibleCount);
+        context.Renderer->Draw(context.VAO, context.Materials, 1, &viewProjection, &tile, &camera.Position);
+        context.Renderer->DrawTransparent(context.VAO, context.Materials, 1, &viewProjection, &tile, &camera.Position);
+    }
+
+    // hands a finished readback to the sink straight from the mapped buffer
+    void deliver(Context& context, int buffer, const BatchCamera* cameras, unsigned int count, const BatchSink& sink)
+    {
+        unsigned int index = context.PendingCamera[buffer];
+        if (index >= count)
+            return;
+        context.PendingCamera[buffer] = count;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, context.PixelBuffers[buffer]);
+        void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<size_t>(Width) * Height * 4, GL_MAP_READ_BIT);
+        if (pixels == NULL)
+        {
+            std::cout << "ERROR::BATCH::MAP_FAILED image " << index << std::endl;
+            return;
+        }
+        BatchImage image;
+        image.Index = index;
+        image.Layout = cameras[index].Layout;
+        image.Width = Width;
+        image.Height = Height;
+        image.Pixels = static_cast<const unsigned char*>(pixels);
+        sink(image);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+};
+
+#endif
@@ -0,0 +1,307 @@
+//
+//  benchmarks.h
+//  3D Object Drawing
+//
+//  Command line benchmarks for the CPU-side subsystems, run with
+//  "<program> --bench-<name> [count]" and printed to stdout. They need no window.
+//
+
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include "bvh.h"
+#include "cloth.h"
+#include "layout_editor.h"
+#include "particles.h"
+#include "thread_pool.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+inline double benchmarkSeconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// furniture sized boxes scattered over a building floor plan
+inline void RunBVHBenchmark(unsigned int objectCount)
+{
+    std::mt19937 rng(4208);
+    float side = std::sqrt(static_cast<float>(objectCount)) * 2.0f;
+    std::uniform_real_distribution<float> position(0.0f, side);
+    std::uniform_real_distribution<float> height(0.0f, 5.0f);
+    std::uniform_real_distribution<float> size(0.05f, 1.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::vector<AABB> bounds(objectCount);
+    for (AABB& b : bounds)
+    {
+        glm::vec3 c(position(rng), position(rng), height(rng));
+        glm::vec3 h(size(rng), size(rng), size(rng));
+        b = AABB(c - h, c + h);
+    }
+
+    std::cout << "BVH benchmark: " << objectCount << " objects" << std::endl;
+
+    BVH bvh;
+    auto start = std::chrono::steady_clock::now();
+    bvh.Build(bounds.data(), objectCount);
+    std::cout << "  build            " << benchmarkSeconds(start) * 1e3 << " ms (" << bvh.Nodes.size() << " nodes)" << std::endl;
+
+    // move 10% of the objects a little and refit
+    unsigned int moved = objectCount / 10;
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < moved; i++)
+    {
+        unsigned int object = (i * 7919u) % objectCount;
+        glm::vec3 d(unit(rng) * 0.1f, unit(rng) * 0.1f, 0.0f);
+        bvh.Update(object, AABB(bounds[object].Min + d, bounds[object].Max + d));
+    }
+    bvh.Refit();
+    std::cout << "  refit " << moved << " moved " << benchmarkSeconds(start) * 1e3 << " ms" << std::endl;
+
+    const int queryCount = 100000;
+    std::vector<glm::vec3> points(queryCount), directions(queryCount);
+    for (int i = 0; i < queryCount; i++)
+    {
+        points[i] = glm::vec3(position(rng), position(rng), height(rng));
+        directions[i] = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng) * 0.2f + 1e-3f));
+    }
+
+    unsigned int hits = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < queryCount; i++)
+    {
+        RayHit hit;
+        hits += bvh.RayCast(points[i], directions[i], 50.0f, hit) ? 1 : 0;
+    }
+    std::cout << "  ray cast         " << benchmarkSeconds(start) * 1e6 / queryCount << " us/query (" << hits << " hits)" << std::endl;
+
+    std::vector<unsigned int> results;
+    results.reserve(1024);
+    size_t found = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < queryCount; i++)
+    {
+        results.clear();
+        found += bvh.QuerySphere(points[i], 0.3f, results);
+    }
+    std::cout << "  sphere overlap   " << benchmarkSeconds(start) * 1e6 / queryCount << " us/query (" << found << " found)" << std::endl;
+
+    found = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < queryCount; i++)
+    {
+        results.clear();
+        found += bvh.QueryAABB(AABB(points[i] - glm::vec3(1.0f), points[i] + glm::vec3(1.0f)), results);
+    }
+    std::cout << "  box overlap      " << benchmarkSeconds(start) * 1e6 / queryCount << " us/query (" << found << " found)" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < queryCount; i++)
+    {
+        unsigned int object;
+        float distance;
+        bvh.Nearest(points[i], 10.0f, object, distance);
+    }
+    std::cout << "  nearest          " << benchmarkSeconds(start) * 1e6 / queryCount << " us/query" << std::endl;
+}
+
+// dust in the room with both fans on, packed for drawing every frame like the app does
+inline void RunParticleBenchmark(unsigned int particleCount)
+{
+    ParticleSystem particles;
+    particles.Spawn(particleCount, glm::vec3(-4.95f, -3.45f, 0.02f), glm::vec3(4.95f, 3.45f, 4.95f));
+    const float spin = -12.0f * 3.14159265f / 180.0f;      // the room's fan speed
+    Airflow fans[2] = { { glm::vec3(2.5f, 1.5f, 4.5f), 1.0f, spin }, { glm::vec3(-2.5f, 1.5f, 4.5f), 1.0f, spin } };
+    particles.SetFans(fans, 2);
+    std::vector<glm::vec4> packed(particles.Count());
+
+    std::cout << "Particle benchmark: " << particles.Count() << " particles, 2 fans" << std::endl;
+
+    const int frameCount = 100;
+    const float deltaTime = 1.0f / 60.0f;
+    ThreadPool pool;
+    const unsigned int threadCounts[2] = { 1, pool.Size() };
+    for (unsigned int run = 0; run < (pool.Size() > 1 ? 2u : 1u); run++)
+    {
+        unsigned int threads = threadCounts[run];
+        ThreadPool* updatePool = threads > 1 ? &pool : nullptr;
+        particles.Update(deltaTime, packed.data(), updatePool);
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frameCount; frame++)
+            particles.Update(deltaTime, packed.data(), updatePool);
+        double seconds = benchmarkSeconds(start);
+        std::cout << "  update, " << threads << (threads > 1 ? " threads " : " thread  ") << seconds * 1e3 / frameCount << " ms/frame ("
+                  << particles.Count() * static_cast<double>(frameCount) / seconds * 1e-6 << " M particles/s)" << std::endl;
+    }
+
+    // where the dust went: the downdraft should have thinned it out under the hubs
+    unsigned int underHubs = 0;
+    for (const glm::vec4& p : packed)
+        underHubs += glm::length(glm::vec2(std::fabs(p.x) - 2.5f, p.y - 1.5f)) < 1.0f ? 1 : 0;
+    std::cout << "  under the hubs   " << 100.0 * underHubs / particles.Count() << " % of the particles" << std::endl;
+}
+
+// square curtains of resolution x resolution vertices hung in a row of rooms, each pair of
+// curtains in front of a wall box and under a fan; 0 sweeps the count or the resolution
+inline void RunClothBenchmark(unsigned int clothCount, unsigned int resolution)
+{
+    const unsigned int clothCounts[3] = { 4, 64, 256 };
+    const unsigned int resolutions[2] = { 16, 32 };
+    const float spin = -12.0f * 3.14159265f / 180.0f;      // the room's fan speed
+    const int tickCount = 60;
+    ThreadPool pool;
+    std::cout << "Cloth benchmark: " << CLOTH_ITERATIONS << " iterations per tick" << std::endl;
+    for (unsigned int countIndex = 0; countIndex < 3; countIndex++)
+    {
+        unsigned int count = clothCount > 0 ? clothCount : clothCounts[countIndex];
+        for (unsigned int resolutionIndex = 0; resolutionIndex < 2; resolutionIndex++)
+        {
+            unsigned int size = std::max(resolution > 0 ? resolution : resolutions[resolutionIndex], 2u);
+            ClothSystem cloth;
+            Airflow fans[AIRFLOW_MAX_FANS];
+            int fanCount = 0;
+            for (unsigned int i = 0; i < count; i++)
+            {
+                float room = static_cast<float>(i / 2) * 3.0f;
+                AABB wall(glm::vec3(room - 1.5f, 3.4875f, 0.0f), glm::vec3(room + 1.5f, 3.5125f, 5.0f));
+                cloth.AddCloth(glm::vec3(room - 1.2f + 1.3f * (i % 2), 3.38f, 3.7f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -2.4f),
+                               size, size, 0, &wall, 1);
+                if (i % 2 == 0 && fanCount < AIRFLOW_MAX_FANS)
+                    fans[fanCount++] = { glm::vec3(room, 1.5f, 4.5f), 1.0f, spin };
+            }
+            cloth.SetFans(fans, fanCount);
+
+            const unsigned int threadCounts[2] = { 1, pool.Size() };
+            for (unsigned int run = 0; run < (pool.Size() > 1 ? 2u : 1u); run++)
+            {
+                unsigned int threads = threadCounts[run];
+                ThreadPool* updatePool = threads > 1 ? &pool : nullptr;
+                unsigned long long firstTick = cloth.Ticks;
+                auto start = std::chrono::steady_clock::now();
+                for (int tick = 0; tick < tickCount; tick++)
+                    cloth.Update(CLOTH_TICK, updatePool);
+                double seconds = benchmarkSeconds(start);
+                double ticks = static_cast<double>(cloth.Ticks - firstTick);
+                std::cout << "  " << count << " x " << size << "x" << size << ", " << cloth.Groups.size() << " groups, " << threads
+                          << (threads > 1 ? " threads " : " thread  ") << seconds * 1e3 / ticks << " ms/tick ("
+                          << cloth.ConstraintCount() * CLOTH_ITERATIONS * ticks / seconds * 1e-6 << " M constraints/s)" << std::endl;
+            }
+            if (resolution > 0)
+                break;
+        }
+        if (clothCount > 0)
+            break;
+    }
+}
+
+// a building floor of furniture, edited the way the app applies edits: the edit, then the
+// frame's transform update, BVH refit of the dirty parts; compared with a full rebuild
+inline void RunLayoutBenchmark(unsigned int furnitureCount)
+{
+    Scene scene;
+    BVH bvh;
+    LayoutEditor layout(scene, bvh);
+    glm::mat4 identityMatrix = glm::mat4(1.0f);
+    unsigned int side = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<float>(furnitureCount))));
+    std::vector<unsigned int> nodes;
+    for (unsigned int i = 0; i < furnitureCount; i++)
+    {
+        glm::vec3 position(static_cast<float>(i % side) * 3.0f, static_cast<float>(i / side) * 3.0f, 0.0f);
+        nodes.push_back(layout.Build(static_cast<Furniture_Kind>(i % FURNITURE_KIND_COUNT), glm::translate(identityMatrix, position)));
+    }
+    bvh.Build(scene.PartBounds.data(), scene.PartCount());
+    std::cout << "Layout benchmark: " << furnitureCount << " pieces of furniture, " << scene.PartCount() << " parts" << std::endl;
+
+    auto frame = [&scene, &bvh]() {
+        scene.UpdateTransforms();
+        for (unsigned int part : scene.DirtyParts)
+            bvh.Update(part, scene.PartBounds[part]);
+        bvh.Refit();
+    };
+
+    std::mt19937 rng(4208);
+    std::uniform_int_distribution<unsigned int> pick(0, furnitureCount - 1);
+    const int editCount = 10000;
+    auto start = std::chrono::steady_clock::now();
+    for (int edit = 0; edit < editCount; edit++)
+    {
+        unsigned int node = nodes[pick(rng)];
+        layout.Move(node, glm::vec3(0.01f, -0.01f, 0.0f));
+        layout.Rotate(node, 1.0f);
+        frame();
+    }
+    std::cout << "  move and turn    " << benchmarkSeconds(start) * 1e6 / editCount << " us/edit" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    for (int edit = 0; edit < editCount; edit++)
+    {
+        unsigned int node = nodes[pick(rng)];
+        if (!layout.Editable(static_cast<int>(node)))
+            continue;
+        Furniture_Kind kind = static_cast<Furniture_Kind>(edit % FURNITURE_KIND_COUNT);
+        glm::mat4 placement = scene.NodeBase[node];
+        layout.Remove(node);
+        frame();
+        unsigned int added = layout.Add(kind, placement);
+        frame();
+        std::replace(nodes.begin(), nodes.end(), node, added);
+    }
+    std::cout << "  delete and add   " << benchmarkSeconds(start) * 1e6 / editCount << " us/edit ("
+              << scene.NodeCount() << " nodes after reuse)" << std::endl;
+
+    // moves far enough that the parts leave their BVH leaves and are reinserted
+    float extent = static_cast<float>(side) * 3.0f;
+    std::uniform_real_distribution<float> across(0.0f, extent);
+    const int relocateCount = editCount / 10;
+    start = std::chrono::steady_clock::now();
+    for (int edit = 0; edit < relocateCount; edit++)
+    {
+        unsigned int node = nodes[pick(rng)];
+        glm::vec3 from(scene.NodeBase[node][3]);
+        glm::vec3 to(across(rng), across(rng), 0.0f);
+        if (glm::length(to - from) <= LAYOUT_REINSERT_DISTANCE)
+            to.x = from.x + LAYOUT_REINSERT_DISTANCE * 2.0f;
+        layout.Move(node, to - from);
+        frame();
+    }
+    std::cout << "  relocate         " << benchmarkSeconds(start) * 1e6 / relocateCount << " us/edit" << std::endl;
+
+    // the incremental BVH must still answer like a fresh one, for rays in every direction
+    unsigned int mismatches = 0;
+    BVH fresh;
+    fresh.Build(scene.PartBounds.data(), scene.PartCount());
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    const int queryCount = 10000;
+    for (int query = 0; query < queryCount; query++)
+    {
+        glm::vec3 origin(across(rng), across(rng), unit(rng) + 1.0f);
+        glm::vec3 direction(unit(rng), unit(rng), unit(rng));
+        // every eighth ray runs along an axis, the case the slab test has to guard
+        if (query % 8 == 0)
+        {
+            direction = glm::vec3(0.0f);
+            direction[query / 8 % 3] = query % 16 == 0 ? 1.0f : -1.0f;
+        }
+        if (glm::length(direction) < 0.01f)
+            continue;
+        direction = glm::normalize(direction);
+        RayHit a, b;
+        bool hitA = bvh.RayCast(origin, direction, 1000.0f, a);
+        bool hitB = fresh.RayCast(origin, direction, 1000.0f, b);
+        mismatches += hitA != hitB || (hitA && a.Distance != b.Distance) ? 1 : 0;
+    }
+    std::cout << "  ray mismatches   " << mismatches << " of " << queryCount << std::endl;
+
+    // what every edit cost before: rebuilding the BVH over the whole floor
+    const int rebuildCount = 20;
+    start = std::chrono::steady_clock::now();
+    for (int rebuild = 0; rebuild < rebuildCount; rebuild++)
+        fresh.Build(scene.PartBounds.data(), scene.PartCount());
+    std::cout << "  full rebuild     " << benchmarkSeconds(start) * 1e6 / rebuildCount << " us" << std::endl;
+}
+
+#endif
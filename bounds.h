@@ -0,0 +1,143 @@
+//
+//  bounds.h
+//  3D Object Drawing
+//
+//  Axis aligned bounding boxes and the few geometric tests the spatial
+//  queries need.
+//
+
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// half extent of the unit cube in cube_vertices
+const float CUBE_HALF_EXTENT = 0.25f;
+
+struct AABB
+{
+    glm::vec3 Min;
+    glm::vec3 Max;
+
+    AABB() : Min(FLT_MAX), Max(-FLT_MAX) {}
+    AABB(const glm::vec3& min, const glm::vec3& max) : Min(min), Max(max) {}
+
+    bool Empty() const { return Min.x > Max.x; }
+    glm::vec3 Center() const { return (Min + Max) * 0.5f; }
+    glm::vec3 Extent() const { return Max - Min; }
+
+    void Expand(const glm::vec3& p)
+    {
+        Min = glm::min(Min, p);
+        Max = glm::max(Max, p);
+    }
+
+    void Expand(const AABB& b)
+    {
+        Min = glm::min(Min, b.Min);
+        Max = glm::max(Max, b.Max);
+    }
+
+    float SurfaceArea() const
+    {
+        if (Empty())
+            return 0.0f;
+        glm::vec3 e = Max - Min;
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+
+    bool Overlaps(const AABB& b) const
+    {
+        return Min.x <= b.Max.x && Max.x >= b.Min.x &&
+               Min.y <= b.Max.y && Max.y >= b.Min.y &&
+               Min.z <= b.Max.z && Max.z >= b.Min.z;
+    }
+
+    // squared distance from p to the box, 0 when p is inside
+    float DistanceSquared(const glm::vec3& p) const
+    {
+        glm::vec3 d = glm::max(glm::max(Min - p, p - Max), glm::vec3(0.0f));
+        return glm::dot(d, d);
+    }
+
+    bool OverlapsSphere(const glm::vec3& center, float radius) const
+    {
+        return DistanceSquared(center) <= radius * radius;
+    }
+
+    // slab test; invDir is 1/direction per axis. On a hit tNear is the entry distance (0 when starting inside)
+    // invDir from RayInverse()
+    bool IntersectRay(const glm::vec3& origin, const glm::vec3& invDir, float tMax, float& tNear) const
+    {
+        float tx1 = (Min.x - origin.x) * invDir.x, tx2 = (Max.x - origin.x) * invDir.x;
+        float ty1 = (Min.y - origin.y) * invDir.y, ty2 = (Max.y - origin.y) * invDir.y;
+        float tz1 = (Min.z - origin.z) * invDir.z, tz2 = (Max.z - origin.z) * invDir.z;
+        float t0 = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), 0.0f));
+        float t1 = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), tMax));
+        tNear = t0;
+        return t0 <= t1;
+    }
+};
+
+// per component 1 / direction for AABB::IntersectRay. A zero component becomes a large finite
+// value of the same sign instead of infinity, so a slab the ray starts on gives 0 rather than
+// 0 * inf = NaN, which would fail the test for axis aligned rays
+inline glm::vec3 RayInverse(const glm::vec3& direction)
+{
+    glm::vec3 inv;
+    for (int i = 0; i < 3; i++)
+        inv[i] = std::fabs(direction[i]) > 1e-20f ? 1.0f / direction[i] : std::copysign(1e30f, direction[i]);
+    return inv;
+}
+
+// view frustum as six inward facing planes (xyz normal, w offset) extracted from projection * view
+struct Frustum
+{
+    glm::vec4 Planes[6];
+
+    Frustum() {}
+
+    explicit Frustum(const glm::mat4& viewProjection)
+    {
+        const glm::mat4& m = viewProjection;
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+        Planes[0] = row3 + row0;    // left
+        Planes[1] = row3 - row0;    // right
+        Planes[2] = row3 + row1;    // bottom
+        Planes[3] = row3 - row1;    // top
+        Planes[4] = row3 + row2;    // near
+        Planes[5] = row3 - row2;    // far
+    }
+
+    // conservative: may accept boxes just outside a frustum corner
+    bool Intersects(const AABB& box) const
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            const glm::vec4& p = Planes[i];
+            glm::vec3 positive(p.x >= 0.0f ? box.Max.x : box.Min.x,
+                               p.y >= 0.0f ? box.Max.y : box.Min.y,
+                               p.z >= 0.0f ? box.Max.z : box.Min.z);
+            if (p.x * positive.x + p.y * positive.y + p.z * positive.z + p.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+
+// world bounds of the unit cube drawn with the given model matrix
+inline AABB TransformedCubeBounds(const glm::mat4& model)
+{
+    glm::vec3 center = glm::vec3(model[3]);
+    glm::vec3 half = (glm::abs(glm::vec3(model[0])) + glm::abs(glm::vec3(model[1])) + glm::abs(glm::vec3(model[2]))) * CUBE_HALF_EXTENT;
+    return AABB(center - half, center + half);
+}
+
+#endif
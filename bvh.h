@@ -0,0 +1,596 @@
+//
+//  bvh.h
+//  3D Object Drawing
+//
+//  Bounding volume hierarchy over object bounds (scene parts), built with a
+//  binned surface area heuristic. Moving objects are handled by refitting only
+//  the paths above their leaves; added objects get a leaf next to the one they
+//  grow least, and removed ones stay with empty bounds.
+//  Supports ray casts, box and sphere overlap queries and nearest object queries.
+//
+
+#ifndef BVH_H
+#define BVH_H
+
+#include "bounds.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+const unsigned int BVH_MAX_LEAF_SIZE = 4;
+const int BVH_BIN_COUNT = 12;
+const int BVH_MAX_DEPTH = 48;           // Build() stops splitting and attach() refuses to go deeper
+const int BVH_STACK_SIZE = 64;
+
+// a depth first walk holds at most one pending sibling per level plus the two children just pushed
+static_assert(BVH_STACK_SIZE >= BVH_MAX_DEPTH + 1, "BVH traversal stacks must cover the deepest leaf");
+const unsigned int BVH_INVALID = 0xFFFFFFFFu;
+
+struct RayHit
+{
+    unsigned int Object;
+    float Distance;
+};
+
+class BVH
+{
+public:
+    // 32 bytes; Count > 0 marks a leaf whose objects are Items[First .. First + Count),
+    // otherwise First is the left child and the right child follows it
+    struct Node
+    {
+        glm::vec3 Min;
+        unsigned int First;
+        glm::vec3 Max;
+        unsigned int Count;
+    };
+
+    std::vector<Node> Nodes;
+    std::vector<unsigned int> Items;        // object ids in leaf order
+    std::vector<AABB> Bounds;               // per object
+
+    unsigned int ObjectCount() const { return static_cast<unsigned int>(Bounds.size()); }
+
+    void Build(const AABB* bounds, unsigned int count)
+    {
+        Bounds.assign(bounds, bounds + count);
+        Items.resize(count);
+        centroids.resize(count);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            Items[i] = i;
+            centroids[i] = Bounds[i].Center();
+        }
+
+        Nodes.clear();
+        Nodes.reserve(count > 0 ? 2 * count : 1);
+        parents.clear();
+        parents.reserve(count > 0 ? 2 * count : 1);
+        Nodes.push_back(Node());
+        parents.push_back(BVH_INVALID);
+        Nodes[0].First = 0;
+        Nodes[0].Count = count;
+        subdivide(0, 0);
+
+        objectLeaf.assign(count, 0);
+        for (unsigned int n = 0; n < Nodes.size(); n++)
+        {
+            for (unsigned int i = 0; i < Nodes[n].Count; i++)
+                objectLeaf[Items[Nodes[n].First + i]] = n;
+        }
+        nodeDirty.assign(Nodes.size(), 0);
+        dirtyLeaves.clear();
+        deadEntries = 0;
+    }
+
+    // records new bounds for a moving object; call Refit() once after a batch of updates
+    void Update(unsigned int object, const AABB& bounds)
+    {
+        Bounds[object] = bounds;
+        unsigned int leaf = objectLeaf[object];
+        if (!nodeDirty[leaf])
+        {
+            nodeDirty[leaf] = 1;
+            dirtyLeaves.push_back(leaf);
+        }
+    }
+
+    // adds an object without a rebuild and returns its id (the next one). It gets a leaf of its
+    // own next to the leaf whose bounds grow least; call Refit() before querying
+    unsigned int Insert(const AABB& bounds)
+    {
+        unsigned int object = ObjectCount();
+        Bounds.push_back(bounds);
+        centroids.push_back(bounds.Center());
+        objectLeaf.push_back(0);
+        if (object == 0 || !attach(object))
+            rebuild();
+        return object;
+    }
+
+    // moves an object that travelled far into a leaf near its new bounds; refitting alone would
+    // stretch its old leaf's ancestors across the distance. Call Refit() before querying.
+    void Reinsert(unsigned int object, const AABB& bounds)
+    {
+        Bounds[object] = bounds;
+        centroids[object] = bounds.Center();
+        if (!detach(object) || !attach(object) || deadEntries > ObjectCount())
+            rebuild();
+    }
+
+    // refits the dirty leaves and walks up their parents, stopping where the bounds no longer change
+    void Refit()
+    {
+        for (unsigned int leaf : dirtyLeaves)
+        {
+            nodeDirty[leaf] = 0;
+            AABB box = leafBounds(Nodes[leaf]);
+            unsigned int node = leaf;
+            for (;;)
+            {
+                if (Nodes[node].Min == box.Min && Nodes[node].Max == box.Max && node != leaf)
+                    break;
+                Nodes[node].Min = box.Min;
+                Nodes[node].Max = box.Max;
+                node = parents[node];
+                if (node == BVH_INVALID)
+                    break;
+                const Node& left = Nodes[Nodes[node].First];
+                const Node& right = Nodes[Nodes[node].First + 1];
+                box = AABB(glm::min(left.Min, right.Min), glm::max(left.Max, right.Max));
+            }
+        }
+        dirtyLeaves.clear();
+    }
+
+    // closest object whose bounds the ray enters within maxDistance
+    bool RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& hit) const
+    {
+        hit.Object = BVH_INVALID;
+        hit.Distance = maxDistance;
+        if (Bounds.empty())
+            return false;
+
+        glm::vec3 invDir = RayInverse(direction);
+        unsigned int stack[BVH_STACK_SIZE];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const Node& node = Nodes[stack[--top]];
+            float tNode;
+            if (!AABB(node.Min, node.Max).IntersectRay(origin, invDir, hit.Distance, tNode))
+                continue;
+
+            if (node.Count > 0)
+            {
+                for (unsigned int i = node.First; i < node.First + node.Count; i++)
+                {
+                    float t;
+                    if (Bounds[Items[i]].IntersectRay(origin, invDir, hit.Distance, t) && t < hit.Distance)
+                    {
+                        hit.Distance = t;
+                        hit.Object = Items[i];
+                    }
+                }
+                continue;
+            }
+
+            // visit the nearer child first
+            unsigned int nearChild = node.First, farChild = node.First + 1;
+            float tNear, tFar;
+            bool hitNear = AABB(Nodes[nearChild].Min, Nodes[nearChild].Max).IntersectRay(origin, invDir, hit.Distance, tNear);
+            bool hitFar = AABB(Nodes[farChild].Min, Nodes[farChild].Max).IntersectRay(origin, invDir, hit.Distance, tFar);
+            if (hitNear && hitFar && tFar < tNear)
+                std::swap(nearChild, farChild);
+            if (hitNear && hitFar)
+            {
+                stack[top++] = farChild;
+                stack[top++] = nearChild;
+            }
+            else if (hitNear)
+                stack[top++] = nearChild;
+            else if (hitFar)
+                stack[top++] = farChild;
+        }
+        return hit.Object != BVH_INVALID;
+    }
+
+    // true when anything blocks the segment between a and b
+    bool LineOfSightBlocked(const glm::vec3& a, const glm::vec3& b) const
+    {
+        glm::vec3 d = b - a;
+        float length = glm::length(d);
+        RayHit hit;
+        return length > 0.0f && RayCast(a, d / length, length, hit);
+    }
+
+    // appends every object whose bounds overlap the box; returns how many were added
+    unsigned int QueryAABB(const AABB& box, std::vector<unsigned int>& results) const
+    {
+        size_t before = results.size();
+        traverse([&box](const glm::vec3& min, const glm::vec3& max) { return box.Overlaps(AABB(min, max)); },
+                 [&results](unsigned int object) { results.push_back(object); });
+        return static_cast<unsigned int>(results.size() - before);
+    }
+
+    unsigned int QuerySphere(const glm::vec3& center, float radius, std::vector<unsigned int>& results) const
+    {
+        size_t before = results.size();
+        traverse([&center, radius](const glm::vec3& min, const glm::vec3& max) { return AABB(min, max).OverlapsSphere(center, radius); },
+                 [&results](unsigned int object) { results.push_back(object); });
+        return static_cast<unsigned int>(results.size() - before);
+    }
+
+    // writes up to capacity objects that may be visible into results; returns how many were written
+    unsigned int QueryFrustum(const Frustum& frustum, unsigned int* results, unsigned int capacity) const
+    {
+        unsigned int count = 0;
+        traverse([&frustum](const glm::vec3& min, const glm::vec3& max) { return frustum.Intersects(AABB(min, max)); },
+                 [results, capacity, &count](unsigned int object) { if (count < capacity) results[count++] = object; });
+        return count;
+    }
+
+    // culls against up to 32 frustums in one walk. Writes the objects visible in any of them
+    // with a bitmask of the frustums they touch; subtrees are only tested against the
+    // frustums their parent touched
+    unsigned int QueryFrustums(const Frustum* frustums, unsigned int frustumCount, unsigned int* results, unsigned int* masks, unsigned int capacity) const
+    {
+        unsigned int count = 0;
+        if (Bounds.empty() || frustumCount == 0)
+            return 0;
+
+        unsigned int stack[BVH_STACK_SIZE];
+        unsigned int stackMasks[BVH_STACK_SIZE];
+        int top = 0;
+        stack[top] = 0;
+        stackMasks[top++] = frustumCount >= 32 ? ~0u : (1u << frustumCount) - 1u;
+        while (top > 0)
+        {
+            --top;
+            const Node& node = Nodes[stack[top]];
+            unsigned int mask = frustumMask(frustums, stackMasks[top], AABB(node.Min, node.Max));
+            if (mask == 0)
+                continue;
+            if (node.Count > 0)
+            {
+                for (unsigned int i = node.First; i < node.First + node.Count; i++)
+                {
+                    unsigned int objectMask = frustumMask(frustums, mask, Bounds[Items[i]]);
+                    if (objectMask != 0 && count < capacity)
+                    {
+                        results[count] = Items[i];
+                        masks[count++] = objectMask;
+                    }
+                }
+                continue;
+            }
+            stack[top] = node.First + 1;
+            stackMasks[top++] = mask;
+            stack[top] = node.First;
+            stackMasks[top++] = mask;
+        }
+        return count;
+    }
+
+    // object whose bounds are closest to point, searched up to maxDistance
+    bool Nearest(const glm::vec3& point, float maxDistance, unsigned int& object, float& distance) const
+    {
+        object = BVH_INVALID;
+        distance = maxDistance;
+        float best = maxDistance * maxDistance;
+        if (Bounds.empty())
+            return false;
+
+        unsigned int stack[BVH_STACK_SIZE];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const Node& node = Nodes[stack[--top]];
+            if (AABB(node.Min, node.Max).DistanceSquared(point) > best)
+                continue;
+
+            if (node.Count > 0)
+            {
+                for (unsigned int i = node.First; i < node.First + node.Count; i++)
+                {
+                    float d = Bounds[Items[i]].DistanceSquared(point);
+                    if (d <= best)
+                    {
+                        best = d;
+                        object = Items[i];
+                    }
+                }
+                continue;
+            }
+
+            unsigned int nearChild = node.First, farChild = node.First + 1;
+            float dNear = AABB(Nodes[nearChild].Min, Nodes[nearChild].Max).DistanceSquared(point);
+            float dFar = AABB(Nodes[farChild].Min, Nodes[farChild].Max).DistanceSquared(point);
+            if (dFar < dNear)
+            {
+                std::swap(nearChild, farChild);
+                std::swap(dNear, dFar);
+            }
+            if (dFar <= best)
+                stack[top++] = farChild;
+            if (dNear <= best)
+                stack[top++] = nearChild;
+        }
+        distance = std::sqrt(best);
+        return object != BVH_INVALID;
+    }
+
+private:
+    std::vector<glm::vec3> centroids;
+    std::vector<unsigned int> parents;
+    std::vector<unsigned int> objectLeaf;
+    std::vector<unsigned char> nodeDirty;
+    std::vector<unsigned int> dirtyLeaves;
+    unsigned int deadEntries = 0;           // nodes and items detach() left unreferenced
+
+    // gives object a new leaf next to the one its bounds grow least; false, with nothing
+    // changed, when that leaf is too deep for the traversal stacks
+    bool attach(unsigned int object)
+    {
+        const AABB& bounds = Bounds[object];
+        unsigned int node = 0;
+        int depth = 0;
+        while (Nodes[node].Count == 0)
+        {
+            unsigned int left = Nodes[node].First;
+            float leftGrowth = grownArea(Nodes[left], bounds) - AABB(Nodes[left].Min, Nodes[left].Max).SurfaceArea();
+            float rightGrowth = grownArea(Nodes[left + 1], bounds) - AABB(Nodes[left + 1].Min, Nodes[left + 1].Max).SurfaceArea();
+            node = leftGrowth <= rightGrowth ? left : left + 1;
+            depth++;
+        }
+        if (depth + 1 >= BVH_MAX_DEPTH)
+            return false;
+
+        // the leaf moves down into the first of two new children, the object goes into the second
+        unsigned int sibling = static_cast<unsigned int>(Nodes.size());
+        Nodes.push_back(Nodes[node]);
+        Nodes.push_back(Node());
+        parents.push_back(node);
+        parents.push_back(node);
+        nodeDirty.push_back(0);
+        nodeDirty.push_back(0);
+        for (unsigned int i = Nodes[sibling].First; i < Nodes[sibling].First + Nodes[sibling].Count; i++)
+            objectLeaf[Items[i]] = sibling;
+        if (nodeDirty[node])
+        {
+            nodeDirty[node] = 0;
+            std::replace(dirtyLeaves.begin(), dirtyLeaves.end(), node, sibling);
+            nodeDirty[sibling] = 1;
+        }
+        Nodes[sibling + 1].First = static_cast<unsigned int>(Items.size());
+        Nodes[sibling + 1].Count = 1;
+        Nodes[sibling + 1].Min = Nodes[sibling + 1].Max = glm::vec3(0.0f);
+        Items.push_back(object);
+        objectLeaf[object] = sibling + 1;
+        Nodes[node].First = sibling;
+        Nodes[node].Count = 0;
+        nodeDirty[sibling + 1] = 1;
+        dirtyLeaves.push_back(sibling + 1);
+        return true;
+    }
+
+    // takes object out of its leaf. A leaf left empty is dropped and its sibling moves up into
+    // their parent; the unreferenced entries count as dead until the next rebuild
+    bool detach(unsigned int object)
+    {
+        unsigned int leaf = objectLeaf[object];
+        Node& node = Nodes[leaf];
+        if (node.Count > 1)
+        {
+            unsigned int last = node.First + node.Count - 1;
+            std::swap(*std::find(Items.begin() + node.First, Items.begin() + last + 1, object), Items[last]);
+            node.Count--;
+            markDirty(leaf);
+            deadEntries++;
+            return true;
+        }
+
+        unsigned int parent = parents[leaf];
+        if (parent == BVH_INVALID)
+            return false;
+        if (nodeDirty[leaf])
+        {
+            nodeDirty[leaf] = 0;
+            dirtyLeaves.erase(std::find(dirtyLeaves.begin(), dirtyLeaves.end(), leaf));
+        }
+        unsigned int sibling = leaf == Nodes[parent].First ? leaf + 1 : leaf - 1;
+        Nodes[parent] = Nodes[sibling];
+        if (Nodes[parent].Count > 0)
+        {
+            for (unsigned int i = Nodes[parent].First; i < Nodes[parent].First + Nodes[parent].Count; i++)
+                objectLeaf[Items[i]] = parent;
+            if (nodeDirty[sibling])
+            {
+                nodeDirty[sibling] = 0;
+                dirtyLeaves.erase(std::find(dirtyLeaves.begin(), dirtyLeaves.end(), sibling));
+            }
+            markDirty(parent);
+        }
+        else
+        {
+            parents[Nodes[parent].First] = parent;
+            parents[Nodes[parent].First + 1] = parent;
+        }
+        deadEntries += 3;
+        return true;
+    }
+
+    void markDirty(unsigned int leaf)
+    {
+        if (!nodeDirty[leaf])
+        {
+            nodeDirty[leaf] = 1;
+            dirtyLeaves.push_back(leaf);
+        }
+    }
+
+    void rebuild()
+    {
+        std::vector<AABB> all(Bounds);
+        Build(all.data(), static_cast<unsigned int>(all.size()));
+    }
+
+    static float grownArea(const Node& node, const AABB& bounds)
+    {
+        AABB box(node.Min, node.Max);
+        box.Expand(bounds);
+        return box.SurfaceArea();
+    }
+
+    AABB leafBounds(const Node& node) const
+    {
+        AABB box;
+        for (unsigned int i = node.First; i < node.First + node.Count; i++)
+            box.Expand(Bounds[Items[i]]);
+        return box;
+    }
+
+    // subset of the frustums in mask that the box touches
+    static unsigned int frustumMask(const Frustum* frustums, unsigned int mask, const AABB& box)
+    {
+        unsigned int result = 0;
+        for (unsigned int i = 0; i < 32 && (mask >> i) != 0; i++)
+        {
+            if (((mask >> i) & 1u) && frustums[i].Intersects(box))
+                result |= 1u << i;
+        }
+        return result;
+    }
+
+    // depth first walk calling emit(object) for every object whose bounds pass test
+    template<typename Test, typename Emit>
+    void traverse(Test test, Emit emit) const
+    {
+        if (Bounds.empty())
+            return;
+
+        unsigned int stack[BVH_STACK_SIZE];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const Node& node = Nodes[stack[--top]];
+            if (!test(node.Min, node.Max))
+                continue;
+            if (node.Count > 0)
+            {
+                for (unsigned int i = node.First; i < node.First + node.Count; i++)
+                {
+                    if (test(Bounds[Items[i]].Min, Bounds[Items[i]].Max))
+                        emit(Items[i]);
+                }
+                continue;
+            }
+            stack[top++] = node.First + 1;
+            stack[top++] = node.First;
+        }
+    }
+
+    void subdivide(unsigned int nodeIndex, int depth)
+    {
+        unsigned int first = Nodes[nodeIndex].First;
+        unsigned int count = Nodes[nodeIndex].Count;
+
+        AABB box, centroidBox;
+        for (unsigned int i = first; i < first + count; i++)
+        {
+            box.Expand(Bounds[Items[i]]);
+            centroidBox.Expand(centroids[Items[i]]);
+        }
+        Nodes[nodeIndex].Min = box.Empty() ? glm::vec3(0.0f) : box.Min;
+        Nodes[nodeIndex].Max = box.Empty() ? glm::vec3(0.0f) : box.Max;
+        // leaves at the depth cap keep all their objects so the traversal stacks cannot overflow
+        if (count <= BVH_MAX_LEAF_SIZE || depth >= BVH_MAX_DEPTH)
+            return;
+
+        // binned SAH over all three axes
+        int bestAxis = -1, bestSplit = 0;
+        float bestCost = FLT_MAX;
+        glm::vec3 extent = centroidBox.Extent();
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (extent[axis] <= 0.0f)
+                continue;
+            AABB bins[BVH_BIN_COUNT];
+            unsigned int binCounts[BVH_BIN_COUNT] = { 0 };
+            float scale = BVH_BIN_COUNT / extent[axis];
+            for (unsigned int i = first; i < first + count; i++)
+            {
+                int bin = std::min(BVH_BIN_COUNT - 1, static_cast<int>((centroids[Items[i]][axis] - centroidBox.Min[axis]) * scale));
+                bins[bin].Expand(Bounds[Items[i]]);
+                binCounts[bin]++;
+            }
+
+            float leftArea[BVH_BIN_COUNT - 1];
+            unsigned int leftCount[BVH_BIN_COUNT - 1];
+            AABB accum;
+            unsigned int sum = 0;
+            for (int b = 0; b < BVH_BIN_COUNT - 1; b++)
+            {
+                accum.Expand(bins[b]);
+                sum += binCounts[b];
+                leftArea[b] = accum.SurfaceArea();
+                leftCount[b] = sum;
+            }
+            accum = AABB();
+            sum = 0;
+            for (int b = BVH_BIN_COUNT - 1; b > 0; b--)
+            {
+                accum.Expand(bins[b]);
+                sum += binCounts[b];
+                float cost = leftCount[b - 1] * leftArea[b - 1] + sum * accum.SurfaceArea();
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        unsigned int middle = first;
+        if (bestAxis >= 0)
+        {
+            float scale = BVH_BIN_COUNT / extent[bestAxis];
+            float splitPos = centroidBox.Min[bestAxis] + bestSplit / scale;
+            unsigned int* begin = &Items[first];
+            unsigned int* end = begin + count;
+            const std::vector<glm::vec3>& c = centroids;
+            int axis = bestAxis;
+            middle = first + static_cast<unsigned int>(std::partition(begin, end, [&c, axis, splitPos](unsigned int item) { return c[item][axis] < splitPos; }) - begin);
+        }
+        // coincident centroids or a one sided split: median along the widest axis
+        if (middle == first || middle == first + count)
+        {
+            int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z ? 1 : 2);
+            const std::vector<glm::vec3>& c = centroids;
+            middle = first + count / 2;
+            std::nth_element(Items.begin() + first, Items.begin() + middle, Items.begin() + first + count,
+                             [&c, axis](unsigned int a, unsigned int b) { return c[a][axis] < c[b][axis]; });
+        }
+
+        unsigned int left = static_cast<unsigned int>(Nodes.size());
+        Nodes.push_back(Node());
+        Nodes.push_back(Node());
+        parents.push_back(nodeIndex);
+        parents.push_back(nodeIndex);
+        Nodes[left].First = first;
+        Nodes[left].Count = middle - first;
+        Nodes[left + 1].First = middle;
+        Nodes[left + 1].Count = first + count - middle;
+        Nodes[nodeIndex].First = left;
+        Nodes[nodeIndex].Count = 0;
+        subdivide(left, depth + 1);
+        subdivide(left + 1, depth + 1);
+    }
+};
+
+#endif
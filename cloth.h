@@ -0,0 +1,558 @@
+//
+//  cloth.h
+//  3D Object Drawing
+//
+//  Curtains and other hanging cloth. ClothSystem simulates any number of
+//  rectangular cloths with position based dynamics on Verlet integration, at a
+//  fixed tick: each tick integrates gravity and the push of the fans' air on the
+//  cloth, relaxes the distance constraints (grid edges and both diagonals) for a
+//  few iterations and pushes the vertices out of the cloth's collider boxes.
+//
+//  The constraints are split into color groups as cloths are added: no two
+//  constraints of a group share a vertex, so a group is solved in parallel on
+//  the thread pool without locks, in blocks of CLOTH_LANES gathered into local
+//  lane arrays that compilers turn into SIMD code. All cloths share the groups,
+//  so a hundred rooms of curtains take as many parallel passes as one.
+//
+//  Each tick also recomputes the normals and packs position and normal per
+//  vertex into Vertices(); ClothRenderer streams them into a buffer it orphans
+//  and refills, and draws every cloth once for all views.
+//
+
+#ifndef CLOTH_H
+#define CLOTH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "airflow.h"
+#include "bounds.h"
+#include "gpu_memory.h"
+#include "materials.h"
+#include "shader.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// constraints per block of the solver
+const unsigned int CLOTH_LANES = 8;
+// work per chunk below which splitting across threads costs more than it saves
+const size_t CLOTH_PARALLEL_CONSTRAINTS = 4096;
+const size_t CLOTH_PARALLEL_VERTICES = 4096;
+
+// solver
+const float CLOTH_TICK = 1.0f / 60.0f;          // seconds per tick
+const int CLOTH_MAX_TICKS = 4;                  // per Update, so a slow frame does not snowball
+const int CLOTH_ITERATIONS = 8;
+const float CLOTH_DAMPING = 0.99f;              // share of the velocity kept per tick
+const float CLOTH_AIR_DRAG = 20.0f;             // per second, how fast the cloth follows air across it
+const float CLOTH_THICKNESS = 0.01f;            // distance kept from the colliders
+const float CLOTH_REST_SPEED = 0.002f;          // a cloth whose vertices are all slower counts as still
+const int CLOTH_MAX_FANS = AIRFLOW_MAX_FANS;
+const int CLOTH_MAX_GROUPS = 32;
+const glm::vec3 CLOTH_GRAVITY = glm::vec3(0.0f, 0.0f, -9.81f);
+
+// per vertex: position, normal
+const unsigned int CLOTH_VERTEX_FLOATS = 6;
+
+class ClothSystem
+{
+public:
+    // vertices of all cloths
+    std::vector<float> PositionX, PositionY, PositionZ;
+    std::vector<float> PreviousX, PreviousY, PreviousZ;     // position one tick ago
+    std::vector<float> NormalX, NormalY, NormalZ;
+    std::vector<float> InverseMass;                         // 0 pins the vertex, 1 otherwise
+
+    // distance constraints; no two of a group share a vertex
+    struct ConstraintGroup
+    {
+        std::vector<unsigned int> A, B;
+        std::vector<float> Rest;
+    };
+    std::vector<ConstraintGroup> Groups;
+
+    // cloths
+    std::vector<unsigned int> ClothFirstVertex;
+    std::vector<unsigned int> ClothColumns, ClothRows;      // vertices across and down
+    std::vector<unsigned int> ClothMaterial;
+    std::vector<unsigned int> ClothFirstCollider, ClothColliderCount;
+    std::vector<AABB> ClothBounds;                          // after the last tick
+    std::vector<AABB> ClothSwept;                           // covered during the last Update
+    std::vector<unsigned char> ClothMoving;                 // moved during the last Update
+    std::vector<AABB> Colliders;
+
+    Airflow Fans[CLOTH_MAX_FANS];
+    int FanCount;
+    float FloorZ;                   // for the fans' outflow along the floor
+
+    // statistics
+    unsigned long long Ticks;
+
+    ClothSystem()
+        : FanCount(0), FloorZ(0.0f), Ticks(0), timeBank(0.0f)
+    {
+    }
+
+    unsigned int VertexCount() const { return static_cast<unsigned int>(PositionX.size()); }
+    unsigned int ClothCount() const { return static_cast<unsigned int>(ClothFirstVertex.size()); }
+    unsigned int ConstraintCount() const
+    {
+        size_t count = 0;
+        for (const ConstraintGroup& group : Groups)
+            count += group.Rest.size();
+        return static_cast<unsigned int>(count);
+    }
+
+    // adds a cloth of columns x rows vertices hanging from its top edge, which runs from top
+    // along across; down spans its length. Colliders it can reach are kept for it. Returns the
+    // cloth, or -1 when its constraints need more than CLOTH_MAX_GROUPS colors.
+    int AddCloth(const glm::vec3& top, const glm::vec3& across, const glm::vec3& down, unsigned int columns, unsigned int rows,
+                 unsigned int material, const AABB* colliders = nullptr, unsigned int colliderCount = 0)
+    {
+        columns = std::max(columns, 2u);
+        rows = std::max(rows, 2u);
+        unsigned int first = VertexCount();
+        AABB reach;
+        for (unsigned int r = 0; r < rows; r++)
+        {
+            for (unsigned int c = 0; c < columns; c++)
+            {
+                glm::vec3 p = top + across * (static_cast<float>(c) / (columns - 1)) + down * (static_cast<float>(r) / (rows - 1));
+                PositionX.push_back(p.x);
+                PositionY.push_back(p.y);
+                PositionZ.push_back(p.z);
+                PreviousX.push_back(p.x);
+                PreviousY.push_back(p.y);
+                PreviousZ.push_back(p.z);
+                NormalX.push_back(0.0f);
+                NormalY.push_back(0.0f);
+                NormalZ.push_back(0.0f);
+                InverseMass.push_back(r == 0 ? 0.0f : 1.0f);
+                reach.Expand(p);
+            }
+        }
+
+        // grid edges and both diagonals of every cell, colored greedily
+        std::vector<uint32_t> vertexGroups(columns * rows, 0);
+        auto vertex = [columns](unsigned int c, unsigned int r) { return r * columns + c; };
+        bool colored = true;
+        auto link = [&](unsigned int a, unsigned int b) {
+            uint32_t used = vertexGroups[a] | vertexGroups[b];
+            int group = 0;
+            while (group < CLOTH_MAX_GROUPS && (used & (1u << group)) != 0)
+                group++;
+            if (group == CLOTH_MAX_GROUPS)
+            {
+                colored = false;
+                return;
+            }
+            vertexGroups[a] |= 1u << group;
+            vertexGroups[b] |= 1u << group;
+            if (static_cast<int>(Groups.size()) <= group)
+                Groups.resize(group + 1);
+            Groups[group].A.push_back(first + a);
+            Groups[group].B.push_back(first + b);
+            Groups[group].Rest.push_back(glm::length(position(first + b) - position(first + a)));
+        };
+        for (unsigned int r = 0; r < rows; r++)
+            for (unsigned int c = 0; c + 1 < columns; c++)
+                link(vertex(c, r), vertex(c + 1, r));
+        for (unsigned int r = 0; r + 1 < rows; r++)
+            for (unsigned int c = 0; c < columns; c++)
+                link(vertex(c, r), vertex(c, r + 1));
+        for (unsigned int r = 0; r + 1 < rows; r++)
+        {
+            for (unsigned int c = 0; c + 1 < columns; c++)
+            {
+                link(vertex(c, r), vertex(c + 1, r + 1));
+                link(vertex(c + 1, r), vertex(c, r + 1));
+            }
+        }
+        if (!colored)
+        {
+            std::cout << "ERROR::CLOTH::TOO_MANY_CONSTRAINT_GROUPS" << std::endl;
+            return -1;
+        }
+
+        // the cloth can swing about as far as it is long
+        float length = glm::length(down);
+        AABB swing(reach.Min - glm::vec3(length), reach.Max + glm::vec3(length));
+        ClothFirstCollider.push_back(static_cast<unsigned int>(Colliders.size()));
+        for (unsigned int i = 0; i < colliderCount; i++)
+            if (colliders[i].Overlaps(swing))
+                Colliders.push_back(colliders[i]);
+        ClothColliderCount.push_back(static_cast<unsigned int>(Colliders.size()) - ClothFirstCollider.back());
+
+        ClothFirstVertex.push_back(first);
+        ClothColumns.push_back(columns);
+        ClothRows.push_back(rows);
+        ClothMaterial.push_back(material);
+        ClothBounds.push_back(reach);
+        ClothSwept.push_back(reach);
+        ClothMoving.push_back(1);
+        vertices.resize(static_cast<size_t>(VertexCount()) * CLOTH_VERTEX_FLOATS);
+        finish(ClothCount() - 1);
+        return static_cast<int>(ClothCount() - 1);
+    }
+
+    // replaces the fans; extra ones beyond CLOTH_MAX_FANS are ignored
+    void SetFans(const Airflow* fans, int count)
+    {
+        FanCount = std::min(count, CLOTH_MAX_FANS);
+        std::copy(fans, fans + FanCount, Fans);
+    }
+
+    // runs the whole ticks deltaTime adds up to; returns how many ran
+    int Update(float deltaTime, ThreadPool* pool = nullptr)
+    {
+        timeBank = std::min(timeBank + deltaTime, CLOTH_TICK * CLOTH_MAX_TICKS);
+        int ticks = 0;
+        for (unsigned int cloth = 0; cloth < ClothCount(); cloth++)
+        {
+            ClothSwept[cloth] = ClothBounds[cloth];
+            ClothMoving[cloth] = 0;
+        }
+        while (timeBank >= CLOTH_TICK)
+        {
+            tick(pool);
+            timeBank -= CLOTH_TICK;
+            ticks++;
+        }
+        return ticks;
+    }
+
+    // position and normal of every vertex after the last tick
+    const float* Vertices() const { return vertices.data(); }
+
+    // two triangles per cell of every cloth, offset by indexBase; firstIndex receives
+    // each cloth's first index
+    void Indices(std::vector<unsigned int>& indices, std::vector<unsigned int>& firstIndex, unsigned int indexBase = 0) const
+    {
+        indices.clear();
+        firstIndex.clear();
+        for (unsigned int cloth = 0; cloth < ClothCount(); cloth++)
+        {
+            firstIndex.push_back(static_cast<unsigned int>(indices.size()));
+            unsigned int columns = ClothColumns[cloth];
+            unsigned int base = indexBase + ClothFirstVertex[cloth];
+            for (unsigned int r = 0; r + 1 < ClothRows[cloth]; r++)
+            {
+                for (unsigned int c = 0; c + 1 < columns; c++)
+                {
+                    unsigned int v = base + r * columns + c;
+                    unsigned int quad[6] = { v, v + columns, v + 1, v + 1, v + columns, v + columns + 1 };
+                    indices.insert(indices.end(), quad, quad + 6);
+                }
+            }
+        }
+    }
+
+    // indices of one cloth
+    static unsigned int IndexCount(unsigned int columns, unsigned int rows) { return (columns - 1) * (rows - 1) * 6; }
+
+private:
+    float timeBank;                 // simulated time not yet ticked
+    std::vector<float> vertices;
+
+    glm::vec3 position(unsigned int v) const { return glm::vec3(PositionX[v], PositionY[v], PositionZ[v]); }
+
+    void tick(ThreadPool* pool)
+    {
+        Ticks++;
+        parallelFor(pool, VertexCount(), CLOTH_PARALLEL_VERTICES, [this](size_t begin, size_t end) { integrate(begin, end); });
+        for (int iteration = 0; iteration < CLOTH_ITERATIONS; iteration++)
+        {
+            for (const ConstraintGroup& group : Groups)
+            {
+                const ConstraintGroup* g = &group;
+                parallelFor(pool, group.Rest.size(), CLOTH_PARALLEL_CONSTRAINTS, [this, g](size_t begin, size_t end) { solve(*g, begin, end); });
+            }
+        }
+        parallelFor(pool, ClothCount(), 1, [this](size_t begin, size_t end) {
+            for (size_t cloth = begin; cloth < end; cloth++)
+            {
+                collide(static_cast<unsigned int>(cloth));
+                finish(static_cast<unsigned int>(cloth));
+            }
+        });
+    }
+
+    template<typename Func>
+    static void parallelFor(ThreadPool* pool, size_t count, size_t minChunk, Func&& func)
+    {
+        if (pool != nullptr)
+            pool->ParallelFor(count, minChunk, func);
+        else
+            func(size_t(0), count);
+    }
+
+    // Verlet step under gravity and the air pushing across the cloth
+    void integrate(size_t begin, size_t end)
+    {
+        for (size_t v = begin; v < end; v++)
+        {
+            glm::vec3 p(PositionX[v], PositionY[v], PositionZ[v]);
+            glm::vec3 step = (p - glm::vec3(PreviousX[v], PreviousY[v], PreviousZ[v])) * CLOTH_DAMPING;
+            glm::vec3 normal(NormalX[v], NormalY[v], NormalZ[v]);
+            glm::vec3 relative = AirVelocity(Fans, FanCount, p, FloorZ) - step * (1.0f / CLOTH_TICK);
+            glm::vec3 acceleration = CLOTH_GRAVITY + normal * (glm::dot(normal, relative) * CLOTH_AIR_DRAG);
+            glm::vec3 next = p + (step + acceleration * (CLOTH_TICK * CLOTH_TICK)) * InverseMass[v];
+            PreviousX[v] = p.x;
+            PreviousY[v] = p.y;
+            PreviousZ[v] = p.z;
+            PositionX[v] = next.x;
+            PositionY[v] = next.y;
+            PositionZ[v] = next.z;
+        }
+    }
+
+    // relaxes constraints [begin, end) of a group: whole blocks through the lanes, the rest one by one
+    void solve(const ConstraintGroup& group, size_t begin, size_t end)
+    {
+        size_t i = begin;
+        for (; i + CLOTH_LANES <= end; i += CLOTH_LANES)
+            solveLanes<CLOTH_LANES>(group, i);
+        for (; i < end; i++)
+            solveLanes<1>(group, i);
+    }
+
+    template<unsigned int Lanes>
+    void solveLanes(const ConstraintGroup& group, size_t first)
+    {
+        float* px = PositionX.data();
+        float* py = PositionY.data();
+        float* pz = PositionZ.data();
+        const float* inverseMass = InverseMass.data();
+        const unsigned int* a = group.A.data() + first;
+        const unsigned int* b = group.B.data() + first;
+        const float* rest = group.Rest.data() + first;
+
+        float ax[Lanes], ay[Lanes], az[Lanes], aw[Lanes];
+        float bx[Lanes], by[Lanes], bz[Lanes], bw[Lanes];
+        for (unsigned int l = 0; l < Lanes; l++)
+        {
+            ax[l] = px[a[l]];
+            ay[l] = py[a[l]];
+            az[l] = pz[a[l]];
+            aw[l] = inverseMass[a[l]];
+            bx[l] = px[b[l]];
+            by[l] = py[b[l]];
+            bz[l] = pz[b[l]];
+            bw[l] = inverseMass[b[l]];
+        }
+        for (unsigned int l = 0; l < Lanes; l++)
+        {
+            float dx = bx[l] - ax[l], dy = by[l] - ay[l], dz = bz[l] - az[l];
+            float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+            // pinned pairs and coincident ends are left alone without a branch
+            float scale = (length - rest[l]) / (std::max(length, 1e-6f) * std::max(aw[l] + bw[l], 1e-6f));
+            ax[l] += dx * scale * aw[l];
+            ay[l] += dy * scale * aw[l];
+            az[l] += dz * scale * aw[l];
+            bx[l] -= dx * scale * bw[l];
+            by[l] -= dy * scale * bw[l];
+            bz[l] -= dz * scale * bw[l];
+        }
+        for (unsigned int l = 0; l < Lanes; l++)
+        {
+            px[a[l]] = ax[l];
+            py[a[l]] = ay[l];
+            pz[a[l]] = az[l];
+            px[b[l]] = bx[l];
+            py[b[l]] = by[l];
+            pz[b[l]] = bz[l];
+        }
+    }
+
+    // pushes the cloth's vertices out of its colliders along the shallowest axis; the motion
+    // into the collider is dropped
+    void collide(unsigned int cloth)
+    {
+        unsigned int firstVertex = ClothFirstVertex[cloth];
+        unsigned int endVertex = firstVertex + ClothColumns[cloth] * ClothRows[cloth];
+        unsigned int firstCollider = ClothFirstCollider[cloth];
+        unsigned int endCollider = firstCollider + ClothColliderCount[cloth];
+        for (unsigned int c = firstCollider; c < endCollider; c++)
+        {
+            glm::vec3 lower = Colliders[c].Min - glm::vec3(CLOTH_THICKNESS);
+            glm::vec3 upper = Colliders[c].Max + glm::vec3(CLOTH_THICKNESS);
+            for (unsigned int v = firstVertex; v < endVertex; v++)
+            {
+                float* p[3] = { &PositionX[v], &PositionY[v], &PositionZ[v] };
+                float* previous[3] = { &PreviousX[v], &PreviousY[v], &PreviousZ[v] };
+                if (*p[0] <= lower.x || *p[0] >= upper.x || *p[1] <= lower.y || *p[1] >= upper.y || *p[2] <= lower.z || *p[2] >= upper.z)
+                    continue;
+                int axis = 0;
+                float best = FLT_MAX, target = 0.0f;
+                for (int k = 0; k < 3; k++)
+                {
+                    if (*p[k] - lower[k] < best)
+                    {
+                        best = *p[k] - lower[k];
+                        axis = k;
+                        target = lower[k];
+                    }
+                    if (upper[k] - *p[k] < best)
+                    {
+                        best = upper[k] - *p[k];
+                        axis = k;
+                        target = upper[k];
+                    }
+                }
+                *p[axis] = target;
+                *previous[axis] = target;
+            }
+        }
+    }
+
+    // normals, bounds, motion and the packed vertices of a cloth
+    void finish(unsigned int cloth)
+    {
+        unsigned int first = ClothFirstVertex[cloth];
+        unsigned int columns = ClothColumns[cloth], rows = ClothRows[cloth];
+        AABB bounds;
+        float fastest = 0.0f;
+        for (unsigned int r = 0; r < rows; r++)
+        {
+            for (unsigned int c = 0; c < columns; c++)
+            {
+                unsigned int v = first + r * columns + c;
+                glm::vec3 p = position(v);
+                glm::vec3 across = position(first + r * columns + std::min(c + 1, columns - 1)) - position(first + r * columns + (c > 0 ? c - 1 : 0));
+                glm::vec3 down = position(first + std::min(r + 1, rows - 1) * columns + c) - position(first + (r > 0 ? r - 1 : 0) * columns + c);
+                glm::vec3 normal = glm::cross(across, down);
+                float length = glm::length(normal);
+                normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+                NormalX[v] = normal.x;
+                NormalY[v] = normal.y;
+                NormalZ[v] = normal.z;
+                bounds.Expand(p);
+                fastest = std::max(fastest, glm::length(p - glm::vec3(PreviousX[v], PreviousY[v], PreviousZ[v])));
+
+                float* out = &vertices[static_cast<size_t>(v) * CLOTH_VERTEX_FLOATS];
+                out[0] = p.x;
+                out[1] = p.y;
+                out[2] = p.z;
+                out[3] = normal.x;
+                out[4] = normal.y;
+                out[5] = normal.z;
+            }
+        }
+        ClothBounds[cloth] = bounds;
+        ClothSwept[cloth].Expand(bounds);
+        if (fastest > CLOTH_REST_SPEED * CLOTH_TICK)
+            ClothMoving[cloth] = 1;
+    }
+};
+
+// texture units used by the cloth shader, as in the scene shader
+const int CLOTH_MATERIAL_TABLE_UNIT = 0;
+const int CLOTH_MATERIAL_LAYER_UNIT = 1;
+
+class ClothRenderer
+{
+public:
+    unsigned int DrawCalls;
+
+    ClothRenderer()
+        : DrawCalls(0), vertexBuffer(0), vertexArray(0), vertexCount(0), shader("clothShader.vs", "clothShader.fs")
+    {
+        shader.use();
+        shader.setInt("materials", CLOTH_MATERIAL_TABLE_UNIT);
+        shader.setInt("materialLayers", CLOTH_MATERIAL_LAYER_UNIT);
+    }
+
+    // the indices go to the index arena once, the vertices to a stream buffer of this renderer
+    void Create(const ClothSystem& cloth, GpuMemory& memory)
+    {
+        std::vector<unsigned int> indices;
+        cloth.Indices(indices, firstIndex);
+        for (unsigned int i = 0; i < cloth.ClothCount(); i++)
+            indexCount.push_back(ClothSystem::IndexCount(cloth.ClothColumns[i], cloth.ClothRows[i]));
+        // Draw() reads the offset each time, so the block may move; the vertex array only keeps the arena's buffer
+        indexBlock = memory.Allocate(GPU_MEMORY_INDEX, indices.size() * sizeof(unsigned int), "cloth indices");
+        indexBlock.Upload(indices.data(), indices.size() * sizeof(unsigned int));
+
+        vertexCount = cloth.VertexCount();
+        glGenBuffers(1, &vertexBuffer);
+        glGenVertexArrays(1, &vertexArray);
+        glBindVertexArray(vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, streamBytes(), cloth.Vertices(), GL_STREAM_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, CLOTH_VERTEX_FLOATS * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, CLOTH_VERTEX_FLOATS * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBlock.Buffer());
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // streams the vertices of the last tick; the old storage is orphaned so the GPU can
+    // finish drawing from it
+    void Upload(const ClothSystem& cloth)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, streamBytes(), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, streamBytes(), cloth.Vertices());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // one instanced draw per cloth, an instance per view (see MultiView)
+    void Draw(const ClothSystem& cloth, const MaterialTable& materials, int viewCount, const glm::mat4* viewProjections,
+              const glm::vec4* viewTiles, const glm::vec3* eyes, const glm::vec3& lightDirection)
+    {
+        DrawCalls = 0;
+        if (vertexArray == 0)
+            return;
+        shader.use();
+        glUniformMatrix4fv(glGetUniformLocation(shader.ID, "viewProjection"), viewCount, GL_FALSE, glm::value_ptr(viewProjections[0]));
+        glUniform4fv(glGetUniformLocation(shader.ID, "viewTile"), viewCount, glm::value_ptr(viewTiles[0]));
+        glUniform3fv(glGetUniformLocation(shader.ID, "viewPosition"), viewCount, glm::value_ptr(eyes[0]));
+        shader.setVec3("lightDirection", lightDirection);
+        materials.Bind(CLOTH_MATERIAL_TABLE_UNIT, CLOTH_MATERIAL_LAYER_UNIT);
+
+        // curtains are seen from both sides
+        for (int plane = 0; plane < 4; plane++)
+            glEnable(GL_CLIP_DISTANCE0 + plane);
+        glBindVertexArray(vertexArray);
+        for (unsigned int i = 0; i < cloth.ClothCount(); i++)
+        {
+            glUniform1ui(glGetUniformLocation(shader.ID, "materialId"), cloth.ClothMaterial[i]);
+            glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(indexCount[i]), GL_UNSIGNED_INT,
+                                    (void*)(indexBlock.Offset() + firstIndex[i] * sizeof(unsigned int)), viewCount);
+            DrawCalls++;
+        }
+        glBindVertexArray(0);
+        for (int plane = 0; plane < 4; plane++)
+            glDisable(GL_CLIP_DISTANCE0 + plane);
+    }
+
+    void Release()
+    {
+        glDeleteVertexArrays(1, &vertexArray);
+        glDeleteBuffers(1, &vertexBuffer);
+        vertexArray = vertexBuffer = 0;
+        indexBlock.Reset();
+        indexCount.clear();
+        firstIndex.clear();
+    }
+
+private:
+    unsigned int vertexBuffer, vertexArray;
+    unsigned int vertexCount;
+    GpuBlock indexBlock;
+    std::vector<unsigned int> firstIndex, indexCount;
+    Shader shader;
+
+    GLsizeiptr streamBytes() const { return static_cast<GLsizeiptr>(vertexCount) * CLOTH_VERTEX_FLOATS * sizeof(float); }
+};
+
+#endif
@@ -0,0 +1,43 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 worldPosition;
+in vec3 worldNormal;
+flat in int viewIndex;
+
+const int MAX_VIEWS = 4;
+const float TEXTURE_SCALE = 0.5;                // texture repeats per world unit, as sceneShader.fs
+
+uniform samplerBuffer materials;                // two texels per material: color, (roughness, layer)
+uniform sampler2DArray materialLayers;
+uniform uint materialId;
+uniform vec3 viewPosition[MAX_VIEWS];
+uniform vec3 lightDirection;
+
+void main()
+{
+    vec4 color = texelFetch(materials, int(materialId) * 2);
+    vec4 params = texelFetch(materials, int(materialId) * 2 + 1);
+    float roughness = params.x;
+    float layer = params.y;
+
+    // cloth is seen from both sides; light the side facing the viewer
+    vec3 normal = normalize(worldNormal);
+    vec3 viewDirection = normalize(viewPosition[viewIndex] - worldPosition);
+    if (dot(normal, viewDirection) < 0.0)
+        normal = -normal;
+
+    if (layer >= 0.0)
+    {
+        // box projection onto the dominant plane, so the weave lines up with the scene's
+        vec3 n = abs(normal);
+        vec2 uv = n.x > n.y && n.x > n.z ? worldPosition.yz : (n.y > n.z ? worldPosition.xz : worldPosition.xy);
+        color.rgb *= texture(materialLayers, vec3(uv * TEXTURE_SCALE, layer)).rgb;
+    }
+
+    vec3 toLight = -lightDirection;
+    float diffuse = max(dot(normal, toLight), 0.0);
+    float shininess = mix(96.0, 4.0, roughness);
+    float specular = pow(max(dot(normal, normalize(toLight + viewDirection)), 0.0), shininess) * (1.0 - roughness) * 0.5;
+    FragColor = vec4(color.rgb * (0.35 + 0.65 * diffuse) + vec3(specular), 1.0);
+}
@@ -0,0 +1,32 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+
+// must match SCENE_MAX_VIEWS in scene_renderer.h
+const int MAX_VIEWS = 4;
+
+uniform mat4 viewProjection[MAX_VIEWS];
+uniform vec4 viewTile[MAX_VIEWS];               // xy: scale, zw: offset of the view's tile in NDC
+
+out vec3 worldPosition;
+out vec3 worldNormal;
+flat out int viewIndex;
+out float gl_ClipDistance[4];
+
+// one instance per view
+void main()
+{
+    int view = gl_InstanceID;
+    worldPosition = aPos;
+    worldNormal = aNormal;
+    viewIndex = view;
+
+    // squeeze the view into its tile and clip it against the tile edges, as sceneShader.vs
+    vec4 clip = viewProjection[view] * vec4(aPos, 1.0);
+    gl_ClipDistance[0] = clip.w + clip.x;
+    gl_ClipDistance[1] = clip.w - clip.x;
+    gl_ClipDistance[2] = clip.w + clip.y;
+    gl_ClipDistance[3] = clip.w - clip.y;
+    clip.xy = clip.xy * viewTile[view].xy + viewTile[view].zw * clip.w;
+    gl_Position = clip;
+}
@@ -0,0 +1,89 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+// must match GPUCULL_MAX_VIEWS in gpu_culling.h
+const int MAX_VIEWS = 4;
+
+struct Object
+{
+    mat4 model;
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uvec4 ids;                  // x: material, y: lightmap slot, z: skip (drawn by the transparent pass)
+};
+
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Objects
+{
+    Object objects[];
+};
+
+// SceneInstance records: 16 floats of model matrix, material, view, lightmap slot, padding
+layout (std430, binding = 1) writeonly buffer Instances
+{
+    uint instanceData[];
+};
+
+layout (std430, binding = 2) buffer Commands
+{
+    uint drawCount;
+    uint padding[3];
+    DrawCommand commands[];
+};
+
+uniform uint objectCount;
+uniform uint indexCount;
+uniform uint firstIndex;
+uniform int viewCount;
+uniform vec4 frustumPlanes[MAX_VIEWS * 6];
+
+bool intersects(int view, vec3 boundsMin, vec3 boundsMax)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        vec4 plane = frustumPlanes[view * 6 + i];
+        vec3 positive = mix(boundsMin, boundsMax, greaterThanEqual(plane.xyz, vec3(0.0)));
+        if (dot(plane.xyz, positive) + plane.w < 0.0)
+            return false;
+    }
+    return true;
+}
+
+void main()
+{
+    uint object = gl_GlobalInvocationID.x;
+    if (object >= objectCount || objects[object].ids.z != 0u)
+        return;
+
+    vec3 boundsMin = objects[object].boundsMin.xyz;
+    vec3 boundsMax = objects[object].boundsMax.xyz;
+    for (int view = 0; view < viewCount; view++)
+    {
+        if (!intersects(view, boundsMin, boundsMax))
+            continue;
+
+        // visible instances are packed at the front; the commands behind them stay zero
+        uint slot = atomicAdd(drawCount, 1u);
+        uint base = slot * 20u;
+        mat4 model = objects[object].model;
+        for (int column = 0; column < 4; column++)
+        {
+            for (int row = 0; row < 4; row++)
+                instanceData[base + uint(column * 4 + row)] = floatBitsToUint(model[column][row]);
+        }
+        instanceData[base + 16u] = objects[object].ids.x;
+        instanceData[base + 17u] = uint(view);
+        instanceData[base + 18u] = objects[object].ids.y;
+        instanceData[base + 19u] = 0u;
+
+        commands[slot] = DrawCommand(indexCount, 1u, firstIndex, 0, slot);
+    }
+}
@@ -0,0 +1,6 @@
+#version 330 core
+
+// depth-only pre-pass: the color writes are masked off, nothing is shaded
+void main()
+{
+}
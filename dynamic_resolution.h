@@ -0,0 +1,193 @@
+//
+//  dynamic_resolution.h
+//  3D Object Drawing
+//
+//  Offscreen color/depth target whose render resolution follows the measured GPU
+//  frame time, upscaled to the window framebuffer at the end of every frame.
+//
+
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// number of timer queries in flight; results are read a few frames late so the
+// CPU never waits on the GPU to find out how long a frame took
+const int DYNRES_QUERY_COUNT = 4;
+
+class DynamicResolution
+{
+public:
+    // controller settings
+    float TargetFrameMs;
+    float MinScale;
+    float MaxScale;
+    float ScaleStep;
+
+    // current state
+    float Scale;
+    float GpuFrameMs;
+    int OutputWidth, OutputHeight;   // real framebuffer size
+    int Width, Height;               // resolution the scene is rendered at this frame
+
+    // offscreen target, allocated once at MaxScale and rendered into a sub-rectangle
+    unsigned int FBO, ColorTexture, DepthRBO;
+
+    DynamicResolution(int outputWidth, int outputHeight, float targetFrameMs = 16.6f, float minScale = 0.5f, float maxScale = 1.0f)
+        : TargetFrameMs(targetFrameMs), MinScale(minScale), MaxScale(maxScale), ScaleStep(0.05f),
+          Scale(maxScale), GpuFrameMs(0.0f), OutputWidth(0), OutputHeight(0), Width(0), Height(0),
+          FBO(0), ColorTexture(0), DepthRBO(0),
+          allocWidth(0), allocHeight(0), queryIndex(0), framesIssued(0), smoothedMs(0.0f), cooldown(0)
+    {
+        glGenQueries(DYNRES_QUERY_COUNT, queries);
+        Resize(outputWidth, outputHeight);
+    }
+
+    // reallocates the offscreen target when the window framebuffer changes size
+    void Resize(int outputWidth, int outputHeight)
+    {
+        if (outputWidth == OutputWidth && outputHeight == OutputHeight)
+            return;
+        OutputWidth = std::max(outputWidth, 1);
+        OutputHeight = std::max(outputHeight, 1);
+        allocateTarget();
+        updateSize();
+    }
+
+    // binds the offscreen target at the current scale and starts timing the frame
+    void BeginFrame()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(0, 0, Width, Height);
+        glBeginQuery(GL_TIME_ELAPSED, queries[queryIndex]);
+    }
+
+    // stops timing, upscales the rendered region to the default framebuffer and
+    // feeds the oldest finished timing into the scale controller
+    void EndFrame()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        Present();
+
+        queryIndex = (queryIndex + 1) % DYNRES_QUERY_COUNT;
+        framesIssued++;
+
+        // the query we are about to overwrite next frame is the oldest one in flight
+        if (framesIssued >= DYNRES_QUERY_COUNT)
+        {
+            GLint available = 0;
+            glGetQueryObjectiv(queries[queryIndex], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint64 elapsedNs = 0;
+                glGetQueryObjectui64v(queries[queryIndex], GL_QUERY_RESULT, &elapsedNs);
+                GpuFrameMs = static_cast<float>(elapsedNs) / 1.0e6f;
+                adjustScale(GpuFrameMs);
+            }
+        }
+    }
+
+    // upscales the last rendered frame to the default framebuffer; also used on its own
+    // to show that frame again without rendering it
+    void Present()
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, Width, Height, 0, 0, OutputWidth, OutputHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, OutputWidth, OutputHeight);
+    }
+
+    void Release()
+    {
+        glDeleteQueries(DYNRES_QUERY_COUNT, queries);
+        releaseTarget();
+    }
+
+private:
+    int allocWidth, allocHeight;
+    unsigned int queries[DYNRES_QUERY_COUNT];
+    int queryIndex;
+    int framesIssued;
+    float smoothedMs;
+    int cooldown;
+
+    void allocateTarget()
+    {
+        releaseTarget();
+        allocWidth = std::max(1, static_cast<int>(std::ceil(OutputWidth * MaxScale)));
+        allocHeight = std::max(1, static_cast<int>(std::ceil(OutputHeight * MaxScale)));
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+        glGenTextures(1, &ColorTexture);
+        glBindTexture(GL_TEXTURE_2D, ColorTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, allocWidth, allocHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ColorTexture, 0);
+
+        glGenRenderbuffers(1, &DepthRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, DepthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, allocWidth, allocHeight);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, DepthRBO);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::DYNAMIC_RESOLUTION::FRAMEBUFFER_INCOMPLETE" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void releaseTarget()
+    {
+        if (FBO == 0)
+            return;
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteTextures(1, &ColorTexture);
+        glDeleteRenderbuffers(1, &DepthRBO);
+        FBO = ColorTexture = DepthRBO = 0;
+    }
+
+    void updateSize()
+    {
+        Width = std::min(allocWidth, std::max(1, static_cast<int>(OutputWidth * Scale)));
+        Height = std::min(allocHeight, std::max(1, static_cast<int>(OutputHeight * Scale)));
+    }
+
+    // pixel cost is proportional to Scale^2, so the ideal scale for the target is
+    // Scale * sqrt(target / measured); moves are quantized and rate limited so the
+    // resolution does not oscillate around the budget
+    void adjustScale(float gpuMs)
+    {
+        // timings still in flight when the scale changed belong to the old resolution
+        if (cooldown > 0)
+        {
+            cooldown--;
+            return;
+        }
+        smoothedMs = (smoothedMs == 0.0f) ? gpuMs : smoothedMs * 0.8f + gpuMs * 0.2f;
+
+        float newScale = Scale;
+        if (smoothedMs > TargetFrameMs)
+            newScale = std::min(Scale - ScaleStep, std::floor(Scale * std::sqrt(TargetFrameMs / smoothedMs) / ScaleStep) * ScaleStep);
+        else if (smoothedMs < TargetFrameMs * 0.8f)
+            newScale = Scale + ScaleStep;
+
+        newScale = std::min(MaxScale, std::max(MinScale, newScale));
+        if (std::fabs(newScale - Scale) > ScaleStep * 0.5f)
+        {
+            Scale = newScale;
+            updateSize();
+            smoothedMs = 0.0f;
+            cooldown = DYNRES_QUERY_COUNT;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,344 @@
+//
+//  frame_export.h
+//  3D Object Drawing
+//
+//  Exports the presented frames without stalling the renderer. Every frame is
+//  read into the next pixel buffer object of a small ring and fenced; the CPU only
+//  maps a buffer once its fence has signalled (a few frames later), copies the
+//  pixels into a free frame of a fixed pool and hands it to the thread pool. The
+//  workers flip and encode the frame and write it out: a Y4M (4:2:0) or raw RGBA
+//  video stream in frame order to a file, a named pipe or stdout ("-"), or one PPM
+//  image per frame when the path contains a printf pattern such as "shot_%05d.ppm".
+//
+
+#ifndef FRAME_EXPORT_H
+#define FRAME_EXPORT_H
+
+#include <glad/glad.h>
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum Export_Format {
+    EXPORT_Y4M,
+    EXPORT_RAW_RGBA,
+    EXPORT_PPM_SEQUENCE
+};
+
+// readbacks in flight; a frame is mapped EXPORT_RING_SIZE - 1 frames after it was read
+const int EXPORT_RING_SIZE = 3;
+
+class FrameExporter
+{
+public:
+    Export_Format Format;
+    int Width, Height;
+    int FramesPerSecond;
+
+    // statistics
+    unsigned long long FramesCaptured, FramesWritten;
+    unsigned long long ReadbackStalls;     // the oldest readback was not done when its buffer was needed
+    unsigned long long EncoderStalls;      // every frame of the pool was still being encoded
+
+    FrameExporter(ThreadPool& pool, const char* path, int width, int height, int framesPerSecond)
+        : Width(width & ~1), Height(height & ~1), FramesPerSecond(framesPerSecond),
+          FramesCaptured(0), FramesWritten(0), ReadbackStalls(0), EncoderStalls(0),
+          pool(pool), pattern(path), file(NULL), ringHead(0), ringPending(0), nextWrite(0), failed(false)
+    {
+        std::string name(path);
+        if (name.find('%') != std::string::npos)
+            Format = EXPORT_PPM_SEQUENCE;
+        else if (name.size() > 4 && name.compare(name.size() - 4, 4, ".y4m") == 0)
+            Format = EXPORT_Y4M;
+        else if (name == "-")
+            Format = EXPORT_Y4M;
+        else
+            Format = EXPORT_RAW_RGBA;
+
+        if (Format != EXPORT_PPM_SEQUENCE)
+        {
+            file = name == "-" ? stdout : fopen(path, "wb");
+            if (file == NULL)
+            {
+                std::cout << "ERROR::FRAME_EXPORT::CANNOT_OPEN " << path << std::endl;
+                failed = true;
+                return;
+            }
+            if (Format == EXPORT_Y4M)
+                fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", Width, Height, FramesPerSecond);
+        }
+
+        size_t frameBytes = static_cast<size_t>(Width) * Height * 4;
+        glGenBuffers(EXPORT_RING_SIZE, ring);
+        for (int i = 0; i < EXPORT_RING_SIZE; i++)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, ring[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+            fences[i] = 0;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        // enough frames that every worker can encode one while another waits to be written
+        frames.resize(pool.Size() + 2);
+        for (ExportFrame& frame : frames)
+        {
+            frame.Pixels.resize(frameBytes);
+            frame.Encoded.reserve(Format == EXPORT_Y4M ? frameBytes * 3 / 8 + 16 : frameBytes + 32);
+            frame.Busy = false;
+        }
+    }
+
+    ~FrameExporter()
+    {
+        Finish();
+    }
+
+    FrameExporter(const FrameExporter&) = delete;
+    FrameExporter& operator=(const FrameExporter&) = delete;
+
+    bool Ok() const { return !failed; }
+
+    // queues a readback of the lower left Width x Height pixels of the default framebuffer's
+    // back buffer; call after the frame has been presented into it and before swapping
+    void Capture()
+    {
+        if (failed)
+            return;
+
+        // the ring is full: the oldest readback has to be retired first
+        if (ringPending == EXPORT_RING_SIZE)
+            retire(true);
+
+        int slot = ringHead;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glReadBuffer(GL_BACK);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, ring[slot]);
+        glReadPixels(0, 0, Width, Height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        ringHead = (ringHead + 1) % EXPORT_RING_SIZE;
+        ringPending++;
+        FramesCaptured++;
+
+        // hand over whatever has already arrived without waiting
+        while (ringPending > 0 && retire(false))
+            ;
+    }
+
+    // retires every readback, waits for the encoders and closes the output
+    void Finish()
+    {
+        if (frames.empty())
+            return;
+        while (ringPending > 0)
+            retire(true);
+        pool.Wait();
+        if (file != NULL && file != stdout)
+            fclose(file);
+        else if (file == stdout)
+            fflush(stdout);
+        file = NULL;
+        glDeleteBuffers(EXPORT_RING_SIZE, ring);
+        frames.clear();
+    }
+
+    void PrintStats() const
+    {
+        std::cerr << "export: " << FramesWritten << " of " << FramesCaptured << " frames written at " << Width << "x" << Height
+                  << ", readback stalls " << ReadbackStalls << ", encoder stalls " << EncoderStalls << std::endl;
+    }
+
+private:
+    struct ExportFrame
+    {
+        std::vector<unsigned char> Pixels;      // RGBA, bottom row first as read
+        std::vector<unsigned char> Encoded;
+        unsigned long long Index;
+        bool Busy;
+    };
+
+    ThreadPool& pool;
+    std::string pattern;
+    FILE* file;
+    unsigned int ring[EXPORT_RING_SIZE];
+    GLsync fences[EXPORT_RING_SIZE];
+    int ringHead, ringPending;
+    std::vector<ExportFrame> frames;
+    std::mutex mutex;
+    std::condition_variable frameFreed, writeTurn;
+    unsigned long long nextWrite;
+    bool failed;
+
+    // moves the oldest readback into a pool frame and queues its encoding; without wait
+    // it gives up when the GPU has not finished the readback yet
+    bool retire(bool wait)
+    {
+        int slot = (ringHead - ringPending + EXPORT_RING_SIZE) % EXPORT_RING_SIZE;
+        GLenum status = glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            if (!wait)
+                return false;
+            ReadbackStalls++;
+            while (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull) == GL_TIMEOUT_EXPIRED)
+                ;
+        }
+        glDeleteSync(fences[slot]);
+        fences[slot] = 0;
+        ringPending--;
+
+        ExportFrame* frame = acquireFrame();
+        frame->Index = FramesCaptured - 1 - ringPending;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, ring[slot]);
+        const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame->Pixels.size(), GL_MAP_READ_BIT);
+        if (pixels != NULL)
+            memcpy(frame->Pixels.data(), pixels, frame->Pixels.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        pool.Submit([this, frame]() { encode(*frame); });
+        return true;
+    }
+
+    ExportFrame* acquireFrame()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            for (ExportFrame& frame : frames)
+            {
+                if (!frame.Busy)
+                {
+                    frame.Busy = true;
+                    return &frame;
+                }
+            }
+            EncoderStalls++;
+            frameFreed.wait(lock);
+        }
+    }
+
+    // worker side: encode in parallel, then write streams strictly in frame order
+    void encode(ExportFrame& frame)
+    {
+        frame.Encoded.clear();
+        if (Format == EXPORT_Y4M)
+            encodeY4M(frame);
+        else if (Format == EXPORT_RAW_RGBA)
+            encodeRaw(frame);
+        else
+            encodePPM(frame);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (Format == EXPORT_PPM_SEQUENCE)
+        {
+            // independent files, no ordering needed
+            lock.unlock();
+            writeImage(frame);
+            lock.lock();
+        }
+        else
+        {
+            writeTurn.wait(lock, [this, &frame] { return nextWrite == frame.Index; });
+            fwrite(frame.Encoded.data(), 1, frame.Encoded.size(), file);
+            nextWrite++;
+            writeTurn.notify_all();
+        }
+        FramesWritten++;
+        frame.Busy = false;
+        frameFreed.notify_one();
+    }
+
+    const unsigned char* row(const ExportFrame& frame, int y) const
+    {
+        // GL rows are stored bottom up
+        return &frame.Pixels[static_cast<size_t>(Height - 1 - y) * Width * 4];
+    }
+
+    void encodeRaw(ExportFrame& frame)
+    {
+        for (int y = 0; y < Height; y++)
+            frame.Encoded.insert(frame.Encoded.end(), row(frame, y), row(frame, y) + Width * 4);
+    }
+
+    void encodePPM(ExportFrame& frame)
+    {
+        char header[32];
+        int length = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", Width, Height);
+        frame.Encoded.resize(length + static_cast<size_t>(Width) * Height * 3);
+        memcpy(frame.Encoded.data(), header, length);
+        unsigned char* out = frame.Encoded.data() + length;
+        for (int y = 0; y < Height; y++)
+        {
+            const unsigned char* p = row(frame, y);
+            for (int x = 0; x < Width; x++, p += 4, out += 3)
+            {
+                out[0] = p[0];
+                out[1] = p[1];
+                out[2] = p[2];
+            }
+        }
+    }
+
+    // full range BT.709, chroma averaged over 2x2 blocks
+    void encodeY4M(ExportFrame& frame)
+    {
+        static const char marker[] = "FRAME\n";
+        size_t lumaSize = static_cast<size_t>(Width) * Height;
+        size_t chromaSize = lumaSize / 4;
+        frame.Encoded.resize(sizeof(marker) - 1 + lumaSize + chromaSize * 2);
+        memcpy(frame.Encoded.data(), marker, sizeof(marker) - 1);
+        unsigned char* luma = frame.Encoded.data() + sizeof(marker) - 1;
+        unsigned char* u = luma + lumaSize;
+        unsigned char* v = u + chromaSize;
+
+        for (int y = 0; y < Height; y++)
+        {
+            const unsigned char* p = row(frame, y);
+            unsigned char* out = luma + static_cast<size_t>(y) * Width;
+            for (int x = 0; x < Width; x++, p += 4)
+                out[x] = static_cast<unsigned char>((54 * p[0] + 183 * p[1] + 19 * p[2] + 128) >> 8);
+        }
+        for (int y = 0; y < Height; y += 2)
+        {
+            const unsigned char* top = row(frame, y);
+            const unsigned char* bottom = row(frame, y + 1);
+            size_t offset = static_cast<size_t>(y / 2) * (Width / 2);
+            for (int x = 0; x < Width; x += 2)
+            {
+                int r = top[x * 4] + top[x * 4 + 4] + bottom[x * 4] + bottom[x * 4 + 4];
+                int g = top[x * 4 + 1] + top[x * 4 + 5] + bottom[x * 4 + 1] + bottom[x * 4 + 5];
+                int b = top[x * 4 + 2] + top[x * 4 + 6] + bottom[x * 4 + 2] + bottom[x * 4 + 6];
+                // sums of four pixels: scale the BT.709 weights by 1/4 as well
+                u[offset + x / 2] = static_cast<unsigned char>(std::min(255, std::max(0, 128 + ((-29 * r - 99 * g + 128 * b + 512) >> 10))));
+                v[offset + x / 2] = static_cast<unsigned char>(std::min(255, std::max(0, 128 + ((128 * r - 116 * g - 12 * b + 512) >> 10))));
+            }
+        }
+    }
+
+    void writeImage(const ExportFrame& frame)
+    {
+        char path[512];
+        snprintf(path, sizeof(path), pattern.c_str(), static_cast<int>(frame.Index));
+        FILE* image = fopen(path, "wb");
+        if (image == NULL)
+        {
+            std::cerr << "ERROR::FRAME_EXPORT::CANNOT_OPEN " << path << std::endl;
+            return;
+        }
+        fwrite(frame.Encoded.data(), 1, frame.Encoded.size(), image);
+        fclose(image);
+    }
+};
+
+#endif
@@ -0,0 +1,96 @@
+//
+//  frame_pacing.h
+//  3D Object Drawing
+//
+//  With vsync on, a frame that starts right after the previous swap spends most of
+//  the refresh interval blocked in its own swap, so what it shows was read from the
+//  input almost a full interval before the vblank. FramePacer holds the next frame
+//  back instead: it starts it as late as the recent render times allow while still
+//  finishing before the vblank after the one just presented, and the caller handles
+//  input while it waits.
+//
+//  A swap that blocks returns close to the vblank it waited for, which is taken as
+//  the schedule's phase. The render time planned for is a high percentile of the
+//  last PACING_HISTORY frames, measured from the frame's start to its swap plus its
+//  GPU time, which overestimates when the two overlap and errs towards starting
+//  early rather than missing the vblank.
+//
+
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+#include <algorithm>
+#include <iostream>
+
+const int PACING_HISTORY = 32;              // frames whose render time the schedule looks at
+const float PACING_PERCENTILE = 0.95f;
+const double PACING_MARGIN_MS = 1.5;        // slack for the wake up and the driver
+
+class FramePacer
+{
+public:
+    bool Enabled;
+    double RefreshMs;           // vblank interval
+    double MarginMs;
+    double RenderMs;            // render time the schedule plans for
+
+    // statistics
+    unsigned long long PacedFrames, MissedFrames;
+
+    explicit FramePacer(double refreshMs)
+        : Enabled(false), RefreshMs(refreshMs), MarginMs(PACING_MARGIN_MS), RenderMs(refreshMs), PacedFrames(0), MissedFrames(0),
+          lastVblank(0.0), historyCount(0), cursor(0)
+    {
+    }
+
+    // the frame's swap returned at presentTime (seconds) after renderMs of work
+    void FramePresented(double presentTime, double renderMs)
+    {
+        if (!Enabled)
+            return;
+        // later than half an interval after the vblank it was scheduled for: it waited a whole extra one
+        if (lastVblank > 0.0 && (presentTime - lastVblank) * 1000.0 > RefreshMs * 1.5)
+            MissedFrames++;
+        PacedFrames++;
+        lastVblank = presentTime;
+
+        history[cursor] = renderMs;
+        cursor = (cursor + 1) % PACING_HISTORY;
+        historyCount = std::min(historyCount + 1, PACING_HISTORY);
+        double sorted[PACING_HISTORY];
+        std::copy(history, history + historyCount, sorted);
+        int rank = std::min(static_cast<int>(historyCount * PACING_PERCENTILE), historyCount - 1);
+        std::nth_element(sorted, sorted + rank, sorted + historyCount);
+        RenderMs = sorted[rank];
+    }
+
+    // nothing was presented; the next frame starts a new schedule
+    void Idle()
+    {
+        lastVblank = 0.0;
+    }
+
+    // seconds to hold the next frame back at time now, 0 to start it at once
+    double Delay(double now) const
+    {
+        if (!Enabled || lastVblank == 0.0)
+            return 0.0;
+        double start = lastVblank + (RefreshMs - RenderMs - MarginMs) / 1000.0;
+        return std::max(start - now, 0.0);
+    }
+
+    void PrintStats() const
+    {
+        if (!Enabled || PacedFrames == 0)
+            return;
+        std::cout << "frame pacing: " << PacedFrames << " frames at " << RefreshMs << " ms, planned render time " << RenderMs
+                  << " ms, " << MissedFrames << " missed vblanks" << std::endl;
+    }
+
+private:
+    double lastVblank;          // seconds, 0 before the first paced frame
+    double history[PACING_HISTORY];
+    int historyCount, cursor;
+};
+
+#endif
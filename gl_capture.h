@@ -0,0 +1,1247 @@
+//
+//  gl_capture.h
+//  3D Object Drawing
+//
+//  GL command capture and replay. GLCapture swaps glad's function pointers for
+//  recording hooks, so every GL call the renderer makes (including the ones in
+//  shader.h) is serialized with its arguments and any buffer/texture/uniform data.
+//
+//  Calls are grouped in three categories:
+//    resource - object creation, deletion and data uploads; always recorded
+//    state    - bindings and fixed-function state; outside the captured frames
+//               only the last value per binding point is kept and written out
+//               before the next resource call or the first captured frame
+//    frame    - draws, clears, blits, dispatches and queries; only recorded
+//               inside the captured frames
+//  so the file holds exactly what is needed to rebuild the renderer's objects,
+//  followed by the captured frames. GLReplay runs the setup once and can then
+//  re-execute the frames any number of times.
+//
+//  Object names, shader/program names and uniform locations are remapped on
+//  replay. Writes made through mapped buffer pointers are not seen by the hooks.
+//
+
+#ifndef GL_CAPTURE_H
+#define GL_CAPTURE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum GLCapture_Category {
+    GLCAPTURE_RESOURCE,
+    GLCAPTURE_STATE,
+    GLCAPTURE_FRAME
+};
+
+// object namespaces that get remapped on replay
+enum GLCapture_NameKind {
+    NAME_NONE,
+    NAME_BUFFER,
+    NAME_VERTEX_ARRAY,
+    NAME_TEXTURE,
+    NAME_FRAMEBUFFER,
+    NAME_RENDERBUFFER,
+    NAME_QUERY,
+    NAME_PROGRAM,           // shaders and programs share one namespace
+    NAME_KIND_COUNT
+};
+
+#define GLCAPTURE_UNPAREN(...) __VA_ARGS__
+
+// entry points whose arguments are all plain values (pointers are buffer offsets):
+// X(name, category, coalescing key, parameters, arguments, name kind per argument)
+#define GLCAPTURE_GENERIC_FUNCTIONS(X) \
+    X(BindVertexArray, GLCAPTURE_STATE, GLCAPTURE_KEY(BindVertexArray, 0), (GLuint array), (array), (NAME_VERTEX_ARRAY)) \
+    X(BindRenderbuffer, GLCAPTURE_STATE, GLCAPTURE_KEY(BindRenderbuffer, 0), (GLenum target, GLuint renderbuffer), (target, renderbuffer), (NAME_NONE, NAME_RENDERBUFFER)) \
+    X(BindBufferBase, GLCAPTURE_STATE, GLCAPTURE_KEY(BindBufferBase, (uint64_t(target) << 16) | index), (GLenum target, GLuint index, GLuint buffer), (target, index, buffer), (NAME_NONE, NAME_NONE, NAME_BUFFER)) \
+    X(BindBufferRange, GLCAPTURE_STATE, GLCAPTURE_KEY(BindBufferBase, (uint64_t(target) << 16) | index), (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size), (target, index, buffer, offset, size), (NAME_NONE, NAME_NONE, NAME_BUFFER, NAME_NONE, NAME_NONE)) \
+    X(Viewport, GLCAPTURE_STATE, GLCAPTURE_KEY(Viewport, 0), (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(Scissor, GLCAPTURE_STATE, GLCAPTURE_KEY(Scissor, 0), (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(Enable, GLCAPTURE_STATE, GLCAPTURE_KEY(Enable, cap), (GLenum cap), (cap), (NAME_NONE)) \
+    X(Disable, GLCAPTURE_STATE, GLCAPTURE_KEY(Enable, cap), (GLenum cap), (cap), (NAME_NONE)) \
+    X(ClearColor, GLCAPTURE_STATE, GLCAPTURE_KEY(ClearColor, 0), (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha), (red, green, blue, alpha), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(ClearDepth, GLCAPTURE_STATE, GLCAPTURE_KEY(ClearDepth, 0), (GLdouble depth), (depth), (NAME_NONE)) \
+    X(DepthMask, GLCAPTURE_STATE, GLCAPTURE_KEY(DepthMask, 0), (GLboolean flag), (flag), (NAME_NONE)) \
+    X(DepthFunc, GLCAPTURE_STATE, GLCAPTURE_KEY(DepthFunc, 0), (GLenum func), (func), (NAME_NONE)) \
+    X(ColorMask, GLCAPTURE_STATE, GLCAPTURE_KEY(ColorMask, 0), (GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha), (red, green, blue, alpha), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(BlendFunc, GLCAPTURE_STATE, GLCAPTURE_KEY(BlendFunc, 0), (GLenum sfactor, GLenum dfactor), (sfactor, dfactor), (NAME_NONE, NAME_NONE)) \
+    X(BlendFunci, GLCAPTURE_STATE, GLCAPTURE_KEY(BlendFunci, buf), (GLuint buf, GLenum src, GLenum dst), (buf, src, dst), (NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(BlendEquation, GLCAPTURE_STATE, GLCAPTURE_KEY(BlendEquation, 0), (GLenum mode), (mode), (NAME_NONE)) \
+    X(CullFace, GLCAPTURE_STATE, GLCAPTURE_KEY(CullFace, 0), (GLenum mode), (mode), (NAME_NONE)) \
+    X(FrontFace, GLCAPTURE_STATE, GLCAPTURE_KEY(FrontFace, 0), (GLenum mode), (mode), (NAME_NONE)) \
+    X(PolygonMode, GLCAPTURE_STATE, GLCAPTURE_KEY(PolygonMode, face), (GLenum face, GLenum mode), (face, mode), (NAME_NONE, NAME_NONE)) \
+    X(CompileShader, GLCAPTURE_RESOURCE, 0, (GLuint shader), (shader), (NAME_PROGRAM)) \
+    X(AttachShader, GLCAPTURE_RESOURCE, 0, (GLuint program, GLuint shader), (program, shader), (NAME_PROGRAM, NAME_PROGRAM)) \
+    X(DetachShader, GLCAPTURE_RESOURCE, 0, (GLuint program, GLuint shader), (program, shader), (NAME_PROGRAM, NAME_PROGRAM)) \
+    X(LinkProgram, GLCAPTURE_RESOURCE, 0, (GLuint program), (program), (NAME_PROGRAM)) \
+    X(DeleteShader, GLCAPTURE_RESOURCE, 0, (GLuint shader), (shader), (NAME_PROGRAM)) \
+    X(DeleteProgram, GLCAPTURE_RESOURCE, 0, (GLuint program), (program), (NAME_PROGRAM)) \
+    X(UniformBlockBinding, GLCAPTURE_RESOURCE, 0, (GLuint program, GLuint index, GLuint binding), (program, index, binding), (NAME_PROGRAM, NAME_NONE, NAME_NONE)) \
+    X(VertexAttribPointer, GLCAPTURE_RESOURCE, 0, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer), (index, size, type, normalized, stride, pointer), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(VertexAttribIPointer, GLCAPTURE_RESOURCE, 0, (GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer), (index, size, type, stride, pointer), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(EnableVertexAttribArray, GLCAPTURE_RESOURCE, 0, (GLuint index), (index), (NAME_NONE)) \
+    X(DisableVertexAttribArray, GLCAPTURE_RESOURCE, 0, (GLuint index), (index), (NAME_NONE)) \
+    X(VertexAttribDivisor, GLCAPTURE_RESOURCE, 0, (GLuint index, GLuint divisor), (index, divisor), (NAME_NONE, NAME_NONE)) \
+    X(TexParameteri, GLCAPTURE_RESOURCE, 0, (GLenum target, GLenum pname, GLint param), (target, pname, param), (NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(TexParameterf, GLCAPTURE_RESOURCE, 0, (GLenum target, GLenum pname, GLfloat param), (target, pname, param), (NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(TexBuffer, GLCAPTURE_RESOURCE, 0, (GLenum target, GLenum internalformat, GLuint buffer), (target, internalformat, buffer), (NAME_NONE, NAME_NONE, NAME_BUFFER)) \
+    X(GenerateMipmap, GLCAPTURE_RESOURCE, 0, (GLenum target), (target), (NAME_NONE)) \
+    X(TexStorage2D, GLCAPTURE_RESOURCE, 0, (GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height), (target, levels, internalformat, width, height), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(TexStorage3D, GLCAPTURE_RESOURCE, 0, (GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth), (target, levels, internalformat, width, height, depth), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(RenderbufferStorage, GLCAPTURE_RESOURCE, 0, (GLenum target, GLenum internalformat, GLsizei width, GLsizei height), (target, internalformat, width, height), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(FramebufferTexture2D, GLCAPTURE_RESOURCE, 0, (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level), (target, attachment, textarget, texture, level), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_TEXTURE, NAME_NONE)) \
+    X(FramebufferTexture, GLCAPTURE_RESOURCE, 0, (GLenum target, GLenum attachment, GLuint texture, GLint level), (target, attachment, texture, level), (NAME_NONE, NAME_NONE, NAME_TEXTURE, NAME_NONE)) \
+    X(FramebufferTextureLayer, GLCAPTURE_RESOURCE, 0, (GLenum target, GLenum attachment, GLuint texture, GLint level, GLint layer), (target, attachment, texture, level, layer), (NAME_NONE, NAME_NONE, NAME_TEXTURE, NAME_NONE, NAME_NONE)) \
+    X(FramebufferRenderbuffer, GLCAPTURE_RESOURCE, 0, (GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer), (target, attachment, renderbuffertarget, renderbuffer), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_RENDERBUFFER)) \
+    X(DrawBuffer, GLCAPTURE_RESOURCE, 0, (GLenum buf), (buf), (NAME_NONE)) \
+    X(ReadBuffer, GLCAPTURE_RESOURCE, 0, (GLenum src), (src), (NAME_NONE)) \
+    X(Clear, GLCAPTURE_FRAME, 0, (GLbitfield mask), (mask), (NAME_NONE)) \
+    X(DrawArrays, GLCAPTURE_FRAME, 0, (GLenum mode, GLint first, GLsizei count), (mode, first, count), (NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(DrawElements, GLCAPTURE_FRAME, 0, (GLenum mode, GLsizei count, GLenum type, const void* indices), (mode, count, type, indices), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(DrawArraysInstanced, GLCAPTURE_FRAME, 0, (GLenum mode, GLint first, GLsizei count, GLsizei instancecount), (mode, first, count, instancecount), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(DrawElementsInstanced, GLCAPTURE_FRAME, 0, (GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount), (mode, count, type, indices, instancecount), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(DrawElementsInstancedBaseInstance, GLCAPTURE_FRAME, 0, (GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount, GLuint baseinstance), (mode, count, type, indices, instancecount, baseinstance), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(MultiDrawElementsIndirect, GLCAPTURE_FRAME, 0, (GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride), (mode, type, indirect, drawcount, stride), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(CopyBufferSubData, GLCAPTURE_RESOURCE, 0, (GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size), (readTarget, writeTarget, readOffset, writeOffset, size), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(ClearBufferData, GLCAPTURE_FRAME, 0, (GLenum target, GLenum internalformat, GLenum format, GLenum type, const void* data), (target, internalformat, format, type, data), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(DispatchCompute, GLCAPTURE_FRAME, 0, (GLuint x, GLuint y, GLuint z), (x, y, z), (NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(MemoryBarrier, GLCAPTURE_FRAME, 0, (GLbitfield barriers), (barriers), (NAME_NONE)) \
+    X(BlitFramebuffer, GLCAPTURE_FRAME, 0, (GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter), (srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter), (NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE, NAME_NONE)) \
+    X(BeginQuery, GLCAPTURE_FRAME, 0, (GLenum target, GLuint id), (target, id), (NAME_NONE, NAME_QUERY)) \
+    X(EndQuery, GLCAPTURE_FRAME, 0, (GLenum target), (target), (NAME_NONE)) \
+    X(QueryCounter, GLCAPTURE_FRAME, 0, (GLuint id, GLenum target), (id, target), (NAME_QUERY, NAME_NONE)) \
+    X(Flush, GLCAPTURE_FRAME, 0, (), (), ()) \
+    X(Finish, GLCAPTURE_FRAME, 0, (), (), ())
+
+// object types created with glGen* and destroyed with glDelete*
+#define GLCAPTURE_NAMED_OBJECTS(X) \
+    X(Buffers, NAME_BUFFER) \
+    X(VertexArrays, NAME_VERTEX_ARRAY) \
+    X(Textures, NAME_TEXTURE) \
+    X(Framebuffers, NAME_FRAMEBUFFER) \
+    X(Renderbuffers, NAME_RENDERBUFFER) \
+    X(Queries, NAME_QUERY)
+
+// entry points with hand written hooks (data pointers, return values or shadowed state)
+#define GLCAPTURE_SPECIAL_FUNCTIONS(X) \
+    X(CreateShader) X(CreateProgram) X(ShaderSource) X(GetUniformLocation) \
+    X(BufferData) X(BufferSubData) X(BufferStorage) \
+    X(TexImage2D) X(TexImage3D) X(TexSubImage2D) X(TexSubImage3D) X(TexParameterfv) X(PixelStorei) \
+    X(CompressedTexImage3D) X(CompressedTexSubImage3D) \
+    X(DrawBuffers) X(ClearBufferfv) \
+    X(BindBuffer) X(BindFramebuffer) X(BindTexture) X(ActiveTexture) X(UseProgram) \
+    X(GetQueryObjectiv) X(GetQueryObjectui64v) X(ReadPixels) \
+    X(Uniform1i) X(Uniform1ui) X(Uniform1f) X(Uniform2f) X(Uniform3f) X(Uniform4f) \
+    X(Uniform1iv) X(Uniform1fv) X(Uniform2fv) X(Uniform3fv) X(Uniform4fv) \
+    X(UniformMatrix3fv) X(UniformMatrix4fv)
+
+enum GLCapture_Op {
+    GLCAPTURE_OP_CaptureBegin,
+    GLCAPTURE_OP_FrameEnd,
+    GLCAPTURE_OP_Uniform,
+#define GLCAPTURE_GENERIC_OP(name, ...) GLCAPTURE_OP_##name,
+    GLCAPTURE_GENERIC_FUNCTIONS(GLCAPTURE_GENERIC_OP)
+#undef GLCAPTURE_GENERIC_OP
+#define GLCAPTURE_OBJECT_OPS(objects, kind) GLCAPTURE_OP_Gen##objects, GLCAPTURE_OP_Delete##objects,
+    GLCAPTURE_NAMED_OBJECTS(GLCAPTURE_OBJECT_OPS)
+#undef GLCAPTURE_OBJECT_OPS
+#define GLCAPTURE_SPECIAL_OP(name) GLCAPTURE_OP_##name,
+    GLCAPTURE_SPECIAL_FUNCTIONS(GLCAPTURE_SPECIAL_OP)
+#undef GLCAPTURE_SPECIAL_OP
+    GLCAPTURE_OP_COUNT
+};
+
+// state calls that overwrite each other share a key
+#define GLCAPTURE_KEY(group, value) ((uint64_t(GLCAPTURE_OP_##group) << 48) | uint64_t(value))
+
+// value layout of the GLCAPTURE_OP_Uniform record
+enum GLCapture_UniformType {
+    UNIFORM_1I, UNIFORM_1UI, UNIFORM_1F, UNIFORM_2F, UNIFORM_3F, UNIFORM_4F,
+    UNIFORM_1IV, UNIFORM_1FV, UNIFORM_2FV, UNIFORM_3FV, UNIFORM_4FV,
+    UNIFORM_MATRIX3FV, UNIFORM_MATRIX4FV
+};
+
+const char GLCAPTURE_MAGIC[8] = { 'G', 'L', 'C', 'A', 'P', 'T', 'R', '3' };
+
+struct GLCaptureHeader
+{
+    char Magic[8];
+    uint32_t FirstFrame;
+    uint32_t LastFrame;
+    uint32_t ContextMajor;
+    uint32_t ContextMinor;
+    uint32_t Width;
+    uint32_t Height;
+};
+
+// bytes per pixel of client side texture data, 0 when unknown
+inline size_t glCapturePixelSize(GLenum format, GLenum type)
+{
+    size_t components = 4;
+    switch (format)
+    {
+    case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: components = 1; break;
+    case GL_RG: case GL_RG_INTEGER: components = 2; break;
+    case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: components = 3; break;
+    case GL_RGBA: case GL_BGRA: case GL_RGBA_INTEGER: components = 4; break;
+    case GL_DEPTH_STENCIL: return 4;
+    default: return 0;
+    }
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE: case GL_BYTE: return components;
+    case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: return components * 2;
+    case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: return components * 4;
+    case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_8_8_8_8_REV: case GL_UNSIGNED_INT_2_10_10_10_REV: return 4;
+    default: return 0;
+    }
+}
+
+inline size_t glCaptureImageSize(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, GLint alignment)
+{
+    size_t row = static_cast<size_t>(width) * glCapturePixelSize(format, type);
+    row = (row + alignment - 1) / alignment * alignment;
+    return row * height * depth;
+}
+
+// ---------------------------------------------------------------------------------------
+// recording
+// ---------------------------------------------------------------------------------------
+
+struct GLCaptureRealFunctions
+{
+#define GLCAPTURE_REAL_GENERIC(name, ...) decltype(glad_gl##name) name;
+    GLCAPTURE_GENERIC_FUNCTIONS(GLCAPTURE_REAL_GENERIC)
+#undef GLCAPTURE_REAL_GENERIC
+#define GLCAPTURE_REAL_OBJECTS(objects, kind) decltype(glad_glGen##objects) Gen##objects; decltype(glad_glDelete##objects) Delete##objects;
+    GLCAPTURE_NAMED_OBJECTS(GLCAPTURE_REAL_OBJECTS)
+#undef GLCAPTURE_REAL_OBJECTS
+#define GLCAPTURE_REAL_SPECIAL(name) decltype(glad_gl##name) name;
+    GLCAPTURE_SPECIAL_FUNCTIONS(GLCAPTURE_REAL_SPECIAL)
+#undef GLCAPTURE_REAL_SPECIAL
+};
+
+class GLCapture
+{
+public:
+    GLCaptureRealFunctions Real;
+
+    // shadowed state the hooks need to interpret their arguments
+    GLuint CurrentProgram;
+    GLuint ActiveUnit;
+    GLuint UnpackBuffer;
+    GLint UnpackAlignment;
+
+    static GLCapture& Instance()
+    {
+        static GLCapture capture;
+        return capture;
+    }
+
+    // hooks every wrapped GL entry point; frames firstFrame..lastFrame (as numbered by
+    // BeginFrame) are captured and the file is written when lastFrame ends
+    void Install(int firstFrame, int lastFrame, const std::string& outputPath, int width, int height);
+
+    void BeginFrame(int frame)
+    {
+        if (!installed || frame != firstFrame)
+            return;
+        flushPending();
+        Begin(GLCAPTURE_OP_CaptureBegin, GLCAPTURE_RESOURCE, 0);
+        End();
+        inRange = true;
+        currentFrame = frame;
+    }
+
+    void EndFrame()
+    {
+        if (!inRange)
+            return;
+        Begin(GLCAPTURE_OP_FrameEnd, GLCAPTURE_FRAME, 0);
+        End();
+        if (currentFrame++ == lastFrame)
+            finish();
+    }
+
+    bool Recording(int category) const
+    {
+        return installed && (inRange || category != GLCAPTURE_FRAME);
+    }
+
+    void Begin(int op, int category, uint64_t key)
+    {
+        record.clear();
+        recordCategory = category;
+        recordKey = key;
+        uint16_t code = static_cast<uint16_t>(op);
+        uint32_t size = 0;
+        WriteBytes(&code, sizeof(code));
+        WriteBytes(&size, sizeof(size));
+    }
+
+    template<typename T>
+    void Write(T value)
+    {
+        if constexpr (std::is_pointer<T>::value)
+        {
+            uint64_t offset = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value));
+            WriteBytes(&offset, sizeof(offset));
+        }
+        else
+            WriteBytes(&value, sizeof(value));
+    }
+
+    template<typename... Args>
+    void WriteArgs(Args... args)
+    {
+        (Write(args), ...);
+    }
+
+    void WriteBytes(const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        record.insert(record.end(), bytes, bytes + size);
+    }
+
+    // optional data block: a flag, then either the bytes or an offset into a bound buffer
+    void WriteData(const void* data, size_t size, bool bufferBound)
+    {
+        uint8_t kind = data == nullptr ? 0 : (bufferBound ? 2 : 1);
+        Write(kind);
+        if (kind == 1)
+        {
+            Write(static_cast<uint64_t>(size));
+            WriteBytes(data, size);
+        }
+        else if (kind == 2)
+            Write(data);
+    }
+
+    void WriteString(const char* text)
+    {
+        uint32_t length = static_cast<uint32_t>(strlen(text));
+        Write(length);
+        WriteBytes(text, length);
+    }
+
+    void End()
+    {
+        uint32_t size = static_cast<uint32_t>(record.size() - 6);
+        memcpy(&record[2], &size, sizeof(size));
+
+        if (inRange)
+            stream.insert(stream.end(), record.begin(), record.end());
+        else if (recordCategory == GLCAPTURE_STATE)
+        {
+            auto found = pendingIndex.find(recordKey);
+            if (found == pendingIndex.end())
+            {
+                pendingIndex[recordKey] = pending.size();
+                pending.push_back(record);
+            }
+            else
+                pending[found->second] = record;
+        }
+        else if (recordCategory == GLCAPTURE_RESOURCE)
+        {
+            flushPending();
+            stream.insert(stream.end(), record.begin(), record.end());
+        }
+    }
+
+private:
+    bool installed = false;
+    bool inRange = false;
+    int firstFrame = 0, lastFrame = 0, currentFrame = 0;
+    std::string path;
+    GLCaptureHeader header;
+    std::vector<unsigned char> stream;
+    std::vector<unsigned char> record;
+    int recordCategory = GLCAPTURE_RESOURCE;
+    uint64_t recordKey = 0;
+    std::vector<std::vector<unsigned char>> pending;
+    std::unordered_map<uint64_t, size_t> pendingIndex;
+
+    GLCapture() : CurrentProgram(0), ActiveUnit(0), UnpackBuffer(0), UnpackAlignment(4) {}
+
+    void flushPending()
+    {
+        for (const std::vector<unsigned char>& entry : pending)
+            stream.insert(stream.end(), entry.begin(), entry.end());
+        pending.clear();
+        pendingIndex.clear();
+    }
+
+    void uninstall();
+
+    void finish()
+    {
+        inRange = false;
+        uninstall();
+
+        FILE* file = fopen(path.c_str(), "wb");
+        if (file == NULL)
+        {
+            std::cout << "ERROR::GL_CAPTURE::CANNOT_WRITE " << path << std::endl;
+            return;
+        }
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(stream.data(), 1, stream.size(), file);
+        fclose(file);
+        std::cout << "GL capture: frames " << firstFrame << "-" << lastFrame << " written to " << path
+                  << " (" << stream.size() / 1024 << " KiB)" << std::endl;
+        std::vector<unsigned char>().swap(stream);
+    }
+};
+
+// generic hooks
+#define GLCAPTURE_GENERIC_HOOK(name, category, key, params, args, kinds) \
+    inline void APIENTRY captureGl##name params \
+    { \
+        GLCapture& capture = GLCapture::Instance(); \
+        if (capture.Recording(category)) \
+        { \
+            capture.Begin(GLCAPTURE_OP_##name, category, key); \
+            capture.WriteArgs args; \
+            capture.End(); \
+        } \
+        capture.Real.name args; \
+    }
+GLCAPTURE_GENERIC_FUNCTIONS(GLCAPTURE_GENERIC_HOOK)
+#undef GLCAPTURE_GENERIC_HOOK
+
+#define GLCAPTURE_OBJECT_HOOKS(objects, kind) \
+    inline void APIENTRY captureGlGen##objects(GLsizei n, GLuint* names) \
+    { \
+        GLCapture& capture = GLCapture::Instance(); \
+        capture.Real.Gen##objects(n, names); \
+        capture.Begin(GLCAPTURE_OP_Gen##objects, GLCAPTURE_RESOURCE, 0); \
+        capture.Write(n); \
+        capture.WriteBytes(names, sizeof(GLuint) * n); \
+        capture.End(); \
+    } \
+    inline void APIENTRY captureGlDelete##objects(GLsizei n, const GLuint* names) \
+    { \
+        GLCapture& capture = GLCapture::Instance(); \
+        capture.Begin(GLCAPTURE_OP_Delete##objects, GLCAPTURE_RESOURCE, 0); \
+        capture.Write(n); \
+        capture.WriteBytes(names, sizeof(GLuint) * n); \
+        capture.End(); \
+        capture.Real.Delete##objects(n, names); \
+    }
+GLCAPTURE_NAMED_OBJECTS(GLCAPTURE_OBJECT_HOOKS)
+#undef GLCAPTURE_OBJECT_HOOKS
+
+// special hooks
+inline GLuint APIENTRY captureGlCreateShader(GLenum type)
+{
+    GLCapture& capture = GLCapture::Instance();
+    GLuint shader = capture.Real.CreateShader(type);
+    capture.Begin(GLCAPTURE_OP_CreateShader, GLCAPTURE_RESOURCE, 0);
+    capture.WriteArgs(type, shader);
+    capture.End();
+    return shader;
+}
+
+inline GLuint APIENTRY captureGlCreateProgram()
+{
+    GLCapture& capture = GLCapture::Instance();
+    GLuint program = capture.Real.CreateProgram();
+    capture.Begin(GLCAPTURE_OP_CreateProgram, GLCAPTURE_RESOURCE, 0);
+    capture.Write(program);
+    capture.End();
+    return program;
+}
+
+inline void APIENTRY captureGlShaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length)
+{
+    GLCapture& capture = GLCapture::Instance();
+    std::string source;
+    for (GLsizei i = 0; i < count; i++)
+        source.append(string[i], (length != NULL && length[i] >= 0) ? static_cast<size_t>(length[i]) : strlen(string[i]));
+    capture.Begin(GLCAPTURE_OP_ShaderSource, GLCAPTURE_RESOURCE, 0);
+    capture.Write(shader);
+    capture.WriteString(source.c_str());
+    capture.End();
+    capture.Real.ShaderSource(shader, count, string, length);
+}
+
+inline GLint APIENTRY captureGlGetUniformLocation(GLuint program, const GLchar* name)
+{
+    GLCapture& capture = GLCapture::Instance();
+    GLint location = capture.Real.GetUniformLocation(program, name);
+    capture.Begin(GLCAPTURE_OP_GetUniformLocation, GLCAPTURE_RESOURCE, 0);
+    capture.WriteArgs(program, location);
+    capture.WriteString(name);
+    capture.End();
+    return location;
+}
+
+inline void APIENTRY captureGlBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+    GLCapture& capture = GLCapture::Instance();
+    capture.Begin(GLCAPTURE_OP_BufferData, GLCAPTURE_RESOURCE, 0);
+    capture.WriteArgs(target, size, usage);
+    capture.WriteData(data, static_cast<size_t>(size), false);
+    capture.End();
+    capture.Real.BufferData(target, size, data, usage);
+}
+
+inline void APIENTRY captureGlBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+    GLCapture& capture = GLCapture::Instance();
+    capture.Begin(GLCAPTURE_OP_BufferSubData, GLCAPTURE_RESOURCE, 0);
+    capture.WriteArgs(target, offset, size);
+    capture.WriteData(data, static_cast<size_t>(size), false);
+    capture.End();
+    capture.Real.BufferSubData(target, offset, size, data);
+}
+
+inline void APIENTRY captureGlBufferStorage(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags)
+{
+    GLCapture& capture = GLCapture::Instance();
+    capture.Begin(GLCAPTURE_OP_BufferStorage, GLCAPTURE_RESOURCE, 0);
+    capture.WriteArgs(target, size, flags);
+    capture.WriteData(data, static_cast<size_t>(size), false);
+    capture.End();
+    capture.Real.BufferStorage(target, size, data, flags);
+}
+
+inline void APIENTRY captureGlTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels)
+{
+    GLCapture& capture = GLCapture::Instance();
+    capture.Begin(GLCAPTURE_OP_TexImage2D, GLCAPTURE_RESOURCE, 0);
+    capture.WriteArgs(target, level, internalformat, width, height, border, format, type);
+    capture.WriteData(pixels, glCaptureImageSize(width, height, 1, format, type, capture.UnpackAlignment), capture.UnpackBuffer != 0);
+    capture.End();
+    capture.Real.TexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+}
+
+inline void APIENTRY captureGlTexImage3D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels)
+{
+    GLCapture& capture = GLCapture::Instance();
+    capture.Begin(GLCAPTURE_OP_TexImage3D, GLCAPTURE_RESOURCE, 0);
+    capture.WriteArgs(target, level, internalformat, width, height, depth, border, format, type);
+    capture.WriteData(pixels, glCaptureImageSize(width, height, depth, format, type, capture.UnpackAlignment), capture.UnpackBuffer != 0);
+    capture.End();
+    capture.Real.TexImage3D(target, level, internalformat, width, height, depth, border, format, type, pixels);
+}
+
+inline void APIENTRY captureGlTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels)
+{
+    GLCapture& capture = GLCapture::Instance();
+    capture.Begin(GLCAPTURE_OP_TexSubImage2D, GLCAPTURE_RESOURCE, 0);
+    capture.WriteArgs(target, level, xoffset, yoffset, width, height, format, type);
+    capture.WriteData(pixels, glCaptureImageSize(width, height, 1, format, type, capture.UnpackAlignment), capture.UnpackBuffer != 0);
+    capture.End();
+    capture.Real.TexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+
+inline void APIENTRY captureGlTexSubImage3D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)
+{
+    GLCapture& capture = GLCapture::Instance();
+    capture.Begin(GLCAPTURE_OP_TexSubImage3D, GLCAPTURE_RESOURCE, 0);
+    capture.WriteArgs(target, level, xoffset, yoffset, zoffset, width, height, depth, format, type);
+    capture.WriteData(pixels, glCaptureImageSize(width, height, depth, format, type, capture.UnpackAlignment), capture.UnpackBuffer != 0);
+    capture.End();
+    capture.Real.TexSubImage3D(target, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels);
+}
+
+// compressed images carry their own byte count
+inline void APIENTRY captureGlCompressedTexImage3D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLsizei imageSize, const void* data)
+{
+    GLCapture& capture = GLCapture::Instance();
+    capture.Begin(GLCAPTURE_OP_CompressedTexImage3D, GLCAPTURE_RESOURCE, 0);
+    capture.WriteArgs(target, level, internalformat, width, height, depth, border, imageSize);
+    capture.WriteData(data, static_cast<size_t>(imageSize), capture.UnpackBuffer != 0);
+    capture.End();
+    capture.Real.CompressedTexImage3D(target, level, internalformat, width, height, depth, border, imageSize, data);
+}
+
+inline void APIENTRY captureGlCompressedTexSubImage3D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLsizei imageSize, const void* data)
+{
+    GLCapture& capture = GLCapture::Instance();
+    capture.Begin(GLCAPTURE_OP_CompressedTexSubImage3D, GLCAPTURE_RESOURCE, 0);
+    capture.WriteArgs(target, level, xoffset, yoffset, zoffset, width, height, depth, format, imageSize);
+    capture.WriteData(data, static_cast<size_t>(imageSize), capture.UnpackBuffer != 0);
+    capture.End();
+    capture.Real.CompressedTexSubImage3D(target, level, xoffset, yoffset, zoffset, width, height, depth, format, imageSize, data);
+}
+
+inline void APIENTRY captureGlTexParameterfv(GLenum target, GLenum pname, const GLfloat* params)
+{
+    GLCapture& capture = GLCapture::Instance();
+    capture.Begin(GLCAPTURE_OP_TexParameterfv, GLCAPTURE_RESOURCE, 0);
+    capture.WriteArgs(target, pname);
+    capture.WriteBytes(params, sizeof(GLfloat) * (pname == GL_TEXTURE_BORDER_COLOR ? 4 : 1));
+    capture.End();
+    capture.Real.TexParameterfv(target, pname, params);
+}
+
+inline void APIENTRY captureGlPixelStorei(GLenum pname, GLint param)
+{
+    GLCapture& capture = GLCapture::Instance();
+    if (pname == GL_UNPACK_ALIGNMENT)
+        capture.UnpackAlignment = param;
+    capture.Begin(GLCAPTURE_OP_PixelStorei, GLCAPTURE_STATE, GLCAPTURE_KEY(PixelStorei, pname));
+    capture.WriteArgs(pname, param);
+    capture.End();
+    capture.Real.PixelStorei(pname, param);
+}
+
+inline void APIENTRY captureGlDrawBuffers(GLsizei n, const GLenum* bufs)
+{
+    GLCapture& capture = GLCapture::Instance();
+    capture.Begin(GLCAPTURE_OP_DrawBuffers, GLCAPTURE_RESOURCE, 0);
+    capture.Write(n);
+    capture.WriteBytes(bufs, sizeof(GLenum) * n);
+    capture.End();
+    capture.Real.DrawBuffers(n, bufs);
+}
+
+inline void APIENTRY captureGlClearBufferfv(GLenum buffer, GLint drawbuffer, const GLfloat* value)
+{
+    GLCapture& capture = GLCapture::Instance();
+    if (capture.Recording(GLCAPTURE_FRAME))
+    {
+        capture.Begin(GLCAPTURE_OP_ClearBufferfv, GLCAPTURE_FRAME, 0);
+        capture.WriteArgs(buffer, drawbuffer);
+        capture.WriteBytes(value, sizeof(GLfloat) * (buffer == GL_COLOR ? 4 : 1));
+        capture.End();
+    }
+    capture.Real.ClearBufferfv(buffer, drawbuffer, value);
+}
+
+inline void APIENTRY captureGlBindBuffer(GLenum target, GLuint buffer)
+{
+    GLCapture& capture = GLCapture::Instance();
+    if (target == GL_PIXEL_UNPACK_BUFFER)
+        capture.UnpackBuffer = buffer;
+    // the element array binding is part of the vertex array object, so it is never coalesced
+    if (target == GL_ELEMENT_ARRAY_BUFFER)
+        capture.Begin(GLCAPTURE_OP_BindBuffer, GLCAPTURE_RESOURCE, 0);
+    else
+        capture.Begin(GLCAPTURE_OP_BindBuffer, GLCAPTURE_STATE, GLCAPTURE_KEY(BindBuffer, target));
+    capture.WriteArgs(target, buffer);
+    capture.End();
+    capture.Real.BindBuffer(target, buffer);
+}
+
+inline void APIENTRY captureGlBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    GLCapture& capture = GLCapture::Instance();
+    // GL_FRAMEBUFFER sets both bindings; keep them as separate coalescing slots
+    if (target == GL_FRAMEBUFFER)
+    {
+        capture.Begin(GLCAPTURE_OP_BindFramebuffer, GLCAPTURE_STATE, GLCAPTURE_KEY(BindFramebuffer, GL_DRAW_FRAMEBUFFER));
+        capture.WriteArgs(static_cast<GLenum>(GL_DRAW_FRAMEBUFFER), framebuffer);
+        capture.End();
+        capture.Begin(GLCAPTURE_OP_BindFramebuffer, GLCAPTURE_STATE, GLCAPTURE_KEY(BindFramebuffer, GL_READ_FRAMEBUFFER));
+        capture.WriteArgs(static_cast<GLenum>(GL_READ_FRAMEBUFFER), framebuffer);
+        capture.End();
+    }
+    else
+    {
+        capture.Begin(GLCAPTURE_OP_BindFramebuffer, GLCAPTURE_STATE, GLCAPTURE_KEY(BindFramebuffer, target));
+        capture.WriteArgs(target, framebuffer);
+        capture.End();
+    }
+    capture.Real.BindFramebuffer(target, framebuffer);
+}
+
+inline void APIENTRY captureGlBindTexture(GLenum target, GLuint texture)
+{
+    GLCapture& capture = GLCapture::Instance();
+    capture.Begin(GLCAPTURE_OP_BindTexture, GLCAPTURE_STATE, GLCAPTURE_KEY(BindTexture, (uint64_t(capture.ActiveUnit) << 32) | target));
+    capture.WriteArgs(capture.ActiveUnit, target, texture);
+    capture.End();
+    capture.Real.BindTexture(target, texture);
+}
+
+inline void APIENTRY captureGlActiveTexture(GLenum texture)
+{
+    GLCapture& capture = GLCapture::Instance();
+    capture.ActiveUnit = texture - GL_TEXTURE0;
+    capture.Begin(GLCAPTURE_OP_ActiveTexture, GLCAPTURE_STATE, GLCAPTURE_KEY(ActiveTexture, 0));
+    capture.Write(texture);
+    capture.End();
+    capture.Real.ActiveTexture(texture);
+}
+
+inline void APIENTRY captureGlUseProgram(GLuint program)
+{
+    GLCapture& capture = GLCapture::Instance();
+    capture.CurrentProgram = program;
+    capture.Begin(GLCAPTURE_OP_UseProgram, GLCAPTURE_STATE, GLCAPTURE_KEY(UseProgram, 0));
+    capture.Write(program);
+    capture.End();
+    capture.Real.UseProgram(program);
+}
+
+inline void APIENTRY captureGlGetQueryObjectiv(GLuint id, GLenum pname, GLint* params)
+{
+    GLCapture& capture = GLCapture::Instance();
+    if (capture.Recording(GLCAPTURE_FRAME))
+    {
+        capture.Begin(GLCAPTURE_OP_GetQueryObjectiv, GLCAPTURE_FRAME, 0);
+        capture.WriteArgs(id, pname);
+        capture.End();
+    }
+    capture.Real.GetQueryObjectiv(id, pname, params);
+}
+
+inline void APIENTRY captureGlGetQueryObjectui64v(GLuint id, GLenum pname, GLuint64* params)
+{
+    GLCapture& capture = GLCapture::Instance();
+    if (capture.Recording(GLCAPTURE_FRAME))
+    {
+        capture.Begin(GLCAPTURE_OP_GetQueryObjectui64v, GLCAPTURE_FRAME, 0);
+        capture.WriteArgs(id, pname);
+        capture.End();
+    }
+    capture.Real.GetQueryObjectui64v(id, pname, params);
+}
+
+inline void APIENTRY captureGlReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels)
+{
+    GLCapture& capture = GLCapture::Instance();
+    if (capture.Recording(GLCAPTURE_FRAME))
+    {
+        capture.Begin(GLCAPTURE_OP_ReadPixels, GLCAPTURE_FRAME, 0);
+        capture.WriteArgs(x, y, width, height, format, type, static_cast<const void*>(pixels));
+        capture.End();
+    }
+    capture.Real.ReadPixels(x, y, width, height, format, type, pixels);
+}
+
+inline void glCaptureUniform(int type, GLint location, GLsizei count, GLboolean transpose, const void* values, size_t size)
+{
+    GLCapture& capture = GLCapture::Instance();
+    capture.Begin(GLCAPTURE_OP_Uniform, GLCAPTURE_STATE, GLCAPTURE_KEY(Uniform, (uint64_t(capture.CurrentProgram) << 32) | static_cast<uint32_t>(location)));
+    capture.WriteArgs(capture.CurrentProgram, location, static_cast<uint8_t>(type), count, transpose);
+    capture.Write(static_cast<uint32_t>(size));
+    capture.WriteBytes(values, size);
+    capture.End();
+}
+
+inline void APIENTRY captureGlUniform1i(GLint location, GLint v0) { glCaptureUniform(UNIFORM_1I, location, 1, GL_FALSE, &v0, sizeof(v0)); GLCapture::Instance().Real.Uniform1i(location, v0); }
+inline void APIENTRY captureGlUniform1ui(GLint location, GLuint v0) { glCaptureUniform(UNIFORM_1UI, location, 1, GL_FALSE, &v0, sizeof(v0)); GLCapture::Instance().Real.Uniform1ui(location, v0); }
+inline void APIENTRY captureGlUniform1f(GLint location, GLfloat v0) { glCaptureUniform(UNIFORM_1F, location, 1, GL_FALSE, &v0, sizeof(v0)); GLCapture::Instance().Real.Uniform1f(location, v0); }
+inline void APIENTRY captureGlUniform2f(GLint location, GLfloat v0, GLfloat v1) { GLfloat v[2] = { v0, v1 }; glCaptureUniform(UNIFORM_2F, location, 1, GL_FALSE, v, sizeof(v)); GLCapture::Instance().Real.Uniform2f(location, v0, v1); }
+inline void APIENTRY captureGlUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) { GLfloat v[3] = { v0, v1, v2 }; glCaptureUniform(UNIFORM_3F, location, 1, GL_FALSE, v, sizeof(v)); GLCapture::Instance().Real.Uniform3f(location, v0, v1, v2); }
+inline void APIENTRY captureGlUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) { GLfloat v[4] = { v0, v1, v2, v3 }; glCaptureUniform(UNIFORM_4F, location, 1, GL_FALSE, v, sizeof(v)); GLCapture::Instance().Real.Uniform4f(location, v0, v1, v2, v3); }
+inline void APIENTRY captureGlUniform1iv(GLint location, GLsizei count, const GLint* value) { glCaptureUniform(UNIFORM_1IV, location, count, GL_FALSE, value, sizeof(GLint) * count); GLCapture::Instance().Real.Uniform1iv(location, count, value); }
+inline void APIENTRY captureGlUniform1fv(GLint location, GLsizei count, const GLfloat* value) { glCaptureUniform(UNIFORM_1FV, location, count, GL_FALSE, value, sizeof(GLfloat) * count); GLCapture::Instance().Real.Uniform1fv(location, count, value); }
+inline void APIENTRY captureGlUniform2fv(GLint location, GLsizei count, const GLfloat* value) { glCaptureUniform(UNIFORM_2FV, location, count, GL_FALSE, value, sizeof(GLfloat) * 2 * count); GLCapture::Instance().Real.Uniform2fv(location, count, value); }
+inline void APIENTRY captureGlUniform3fv(GLint location, GLsizei count, const GLfloat* value) { glCaptureUniform(UNIFORM_3FV, location, count, GL_FALSE, value, sizeof(GLfloat) * 3 * count); GLCapture::Instance().Real.Uniform3fv(location, count, value); }
+inline void APIENTRY captureGlUniform4fv(GLint location, GLsizei count, const GLfloat* value) { glCaptureUniform(UNIFORM_4FV, location, count, GL_FALSE, value, sizeof(GLfloat) * 4 * count); GLCapture::Instance().Real.Uniform4fv(location, count, value); }
+inline void APIENTRY captureGlUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { glCaptureUniform(UNIFORM_MATRIX3FV, location, count, transpose, value, sizeof(GLfloat) * 9 * count); GLCapture::Instance().Real.UniformMatrix3fv(location, count, transpose, value); }
+inline void APIENTRY captureGlUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) { glCaptureUniform(UNIFORM_MATRIX4FV, location, count, transpose, value, sizeof(GLfloat) * 16 * count); GLCapture::Instance().Real.UniformMatrix4fv(location, count, transpose, value); }
+
+inline void GLCapture::Install(int first, int last, const std::string& outputPath, int width, int height)
+{
+    firstFrame = first;
+    lastFrame = last;
+    path = outputPath;
+    memcpy(header.Magic, GLCAPTURE_MAGIC, sizeof(header.Magic));
+    header.FirstFrame = static_cast<uint32_t>(first);
+    header.LastFrame = static_cast<uint32_t>(last);
+    GLint major = 3, minor = 3;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    header.ContextMajor = static_cast<uint32_t>(major);
+    header.ContextMinor = static_cast<uint32_t>(minor);
+    header.Width = static_cast<uint32_t>(width);
+    header.Height = static_cast<uint32_t>(height);
+
+    // entry points the driver does not provide stay unhooked
+#define GLCAPTURE_INSTALL(name) Real.name = glad_gl##name; if (Real.name != NULL) glad_gl##name = captureGl##name;
+#define GLCAPTURE_INSTALL_GENERIC(name, ...) GLCAPTURE_INSTALL(name)
+#define GLCAPTURE_INSTALL_OBJECTS(objects, kind) GLCAPTURE_INSTALL(Gen##objects) GLCAPTURE_INSTALL(Delete##objects)
+    GLCAPTURE_GENERIC_FUNCTIONS(GLCAPTURE_INSTALL_GENERIC)
+    GLCAPTURE_NAMED_OBJECTS(GLCAPTURE_INSTALL_OBJECTS)
+    GLCAPTURE_SPECIAL_FUNCTIONS(GLCAPTURE_INSTALL)
+#undef GLCAPTURE_INSTALL_OBJECTS
+#undef GLCAPTURE_INSTALL_GENERIC
+#undef GLCAPTURE_INSTALL
+    installed = true;
+}
+
+inline void GLCapture::uninstall()
+{
+#define GLCAPTURE_UNINSTALL(name) if (Real.name != NULL) glad_gl##name = Real.name;
+#define GLCAPTURE_UNINSTALL_GENERIC(name, ...) GLCAPTURE_UNINSTALL(name)
+#define GLCAPTURE_UNINSTALL_OBJECTS(objects, kind) GLCAPTURE_UNINSTALL(Gen##objects) GLCAPTURE_UNINSTALL(Delete##objects)
+    GLCAPTURE_GENERIC_FUNCTIONS(GLCAPTURE_UNINSTALL_GENERIC)
+    GLCAPTURE_NAMED_OBJECTS(GLCAPTURE_UNINSTALL_OBJECTS)
+    GLCAPTURE_SPECIAL_FUNCTIONS(GLCAPTURE_UNINSTALL)
+#undef GLCAPTURE_UNINSTALL_OBJECTS
+#undef GLCAPTURE_UNINSTALL_GENERIC
+#undef GLCAPTURE_UNINSTALL
+    installed = false;
+}
+
+// ---------------------------------------------------------------------------------------
+// replay
+// ---------------------------------------------------------------------------------------
+
+class GLReplay
+{
+public:
+    GLCaptureHeader Header;
+
+    bool Load(const char* path)
+    {
+        FILE* file = fopen(path, "rb");
+        if (file == NULL)
+            return false;
+        bool ok = fread(&Header, sizeof(Header), 1, file) == 1 && memcmp(Header.Magic, GLCAPTURE_MAGIC, sizeof(Header.Magic)) == 0;
+        if (ok)
+        {
+            fseek(file, 0, SEEK_END);
+            long size = ftell(file) - static_cast<long>(sizeof(Header));
+            fseek(file, sizeof(Header), SEEK_SET);
+            stream.resize(size > 0 ? static_cast<size_t>(size) : 0);
+            ok = fread(stream.data(), 1, stream.size(), file) == stream.size();
+        }
+        fclose(file);
+        if (!ok)
+            return false;
+
+        // everything before the capture marker rebuilds the renderer's objects
+        framesBegin = stream.size();
+        for (size_t offset = 0; offset + 6 <= stream.size();)
+        {
+            uint16_t op;
+            uint32_t size;
+            memcpy(&op, &stream[offset], sizeof(op));
+            memcpy(&size, &stream[offset + 2], sizeof(size));
+            if (op == GLCAPTURE_OP_CaptureBegin)
+            {
+                framesBegin = offset + 6 + size;
+                break;
+            }
+            offset += 6 + size;
+        }
+        return true;
+    }
+
+    void RunSetup()
+    {
+        currentProgram = 0;
+        activeUnit = 0;
+        execute(0, framesBegin);
+    }
+
+    // re-executes the captured frames once; returns how many frames were replayed
+    int RunFrames()
+    {
+        return execute(framesBegin, stream.size());
+    }
+
+private:
+    std::vector<unsigned char> stream;
+    size_t framesBegin = 0;
+    const unsigned char* cursor = nullptr;
+    std::unordered_map<GLuint, GLuint> names[NAME_KIND_COUNT];
+    std::unordered_map<uint64_t, GLint> locations;
+    GLuint currentProgram = 0;
+    GLuint activeUnit = 0;
+    std::vector<unsigned char> scratch;
+
+    template<typename T>
+    T read()
+    {
+        if constexpr (std::is_pointer<T>::value)
+        {
+            uint64_t offset;
+            memcpy(&offset, cursor, sizeof(offset));
+            cursor += sizeof(offset);
+            return reinterpret_cast<T>(static_cast<uintptr_t>(offset));
+        }
+        else
+        {
+            T value;
+            memcpy(&value, cursor, sizeof(value));
+            cursor += sizeof(value);
+            return value;
+        }
+    }
+
+    std::string readString()
+    {
+        uint32_t length = read<uint32_t>();
+        std::string text(reinterpret_cast<const char*>(cursor), length);
+        cursor += length;
+        return text;
+    }
+
+    // returns client memory, a buffer offset or NULL as written by GLCapture::WriteData
+    const void* readData()
+    {
+        uint8_t kind = read<uint8_t>();
+        if (kind == 1)
+        {
+            uint64_t size = read<uint64_t>();
+            const void* data = cursor;
+            cursor += size;
+            return data;
+        }
+        if (kind == 2)
+            return read<const void*>();
+        return NULL;
+    }
+
+    GLuint mapName(int kind, GLuint recorded)
+    {
+        if (kind == NAME_NONE || recorded == 0)
+            return recorded;
+        auto found = names[kind].find(recorded);
+        return found != names[kind].end() ? found->second : recorded;
+    }
+
+    template<typename T>
+    void mapArgument(T&, int) {}
+
+    void mapArgument(GLuint& value, int kind) { value = mapName(kind, value); }
+
+    // reads the arguments of a plain entry point in declaration order, remaps names and calls it
+    template<typename Function, typename... Args, size_t... I>
+    void replayGeneric(Function function, const int* kinds, std::index_sequence<I...>, Args*...)
+    {
+        std::tuple<Args...> args{ read<Args>()... };
+        (mapArgument(std::get<I>(args), kinds[I + 1]), ...);
+        function(std::get<I>(args)...);
+    }
+
+    template<typename R, typename... Args>
+    void replayGeneric(R (APIENTRY *function)(Args...), const int* kinds)
+    {
+        replayGeneric(function, kinds, std::index_sequence_for<Args...>(), static_cast<typename std::decay<Args>::type*>(nullptr)...);
+    }
+
+    void replayUniform()
+    {
+        GLuint program = mapName(NAME_PROGRAM, read<GLuint>());
+        GLint recordedLocation = read<GLint>();
+        uint8_t type = read<uint8_t>();
+        GLsizei count = read<GLsizei>();
+        GLboolean transpose = read<GLboolean>();
+        uint32_t size = read<uint32_t>();
+        const unsigned char* values = cursor;
+        cursor += size;
+
+        auto found = locations.find((uint64_t(program) << 32) | static_cast<uint32_t>(recordedLocation));
+        GLint location = found != locations.end() ? found->second : recordedLocation;
+        if (program != currentProgram)
+            glUseProgram(program);
+
+        const GLint* iv = reinterpret_cast<const GLint*>(values);
+        const GLuint* uiv = reinterpret_cast<const GLuint*>(values);
+        const GLfloat* fv = reinterpret_cast<const GLfloat*>(values);
+        switch (type)
+        {
+        case UNIFORM_1I: glUniform1i(location, iv[0]); break;
+        case UNIFORM_1UI: glUniform1ui(location, uiv[0]); break;
+        case UNIFORM_1F: glUniform1f(location, fv[0]); break;
+        case UNIFORM_2F: glUniform2f(location, fv[0], fv[1]); break;
+        case UNIFORM_3F: glUniform3f(location, fv[0], fv[1], fv[2]); break;
+        case UNIFORM_4F: glUniform4f(location, fv[0], fv[1], fv[2], fv[3]); break;
+        case UNIFORM_1IV: glUniform1iv(location, count, iv); break;
+        case UNIFORM_1FV: glUniform1fv(location, count, fv); break;
+        case UNIFORM_2FV: glUniform2fv(location, count, fv); break;
+        case UNIFORM_3FV: glUniform3fv(location, count, fv); break;
+        case UNIFORM_4FV: glUniform4fv(location, count, fv); break;
+        case UNIFORM_MATRIX3FV: glUniformMatrix3fv(location, count, transpose, fv); break;
+        case UNIFORM_MATRIX4FV: glUniformMatrix4fv(location, count, transpose, fv); break;
+        }
+
+        if (program != currentProgram)
+            glUseProgram(currentProgram);
+    }
+
+    int execute(size_t begin, size_t end)
+    {
+        int frames = 0;
+        size_t offset = begin;
+        while (offset + 6 <= end)
+        {
+            uint16_t op;
+            uint32_t size;
+            memcpy(&op, &stream[offset], sizeof(op));
+            memcpy(&size, &stream[offset + 2], sizeof(size));
+            cursor = &stream[offset + 6];
+            offset += 6 + size;
+
+            switch (op)
+            {
+            case GLCAPTURE_OP_CaptureBegin:
+                break;
+            case GLCAPTURE_OP_FrameEnd:
+                glFlush();
+                frames++;
+                break;
+            case GLCAPTURE_OP_Uniform:
+                replayUniform();
+                break;
+
+#define GLCAPTURE_REPLAY_GENERIC(name, category, key, params, args, kinds) \
+            case GLCAPTURE_OP_##name: \
+            { \
+                static const int argumentKinds[] = { NAME_NONE, GLCAPTURE_UNPAREN kinds }; \
+                replayGeneric(gl##name, argumentKinds); \
+                break; \
+            }
+            GLCAPTURE_GENERIC_FUNCTIONS(GLCAPTURE_REPLAY_GENERIC)
+#undef GLCAPTURE_REPLAY_GENERIC
+
+#define GLCAPTURE_REPLAY_OBJECTS(objects, kind) \
+            case GLCAPTURE_OP_Gen##objects: \
+            { \
+                GLsizei n = read<GLsizei>(); \
+                scratch.resize(sizeof(GLuint) * n); \
+                GLuint* created = reinterpret_cast<GLuint*>(scratch.data()); \
+                glGen##objects(n, created); \
+                for (GLsizei i = 0; i < n; i++) \
+                    names[kind][read<GLuint>()] = created[i]; \
+                break; \
+            } \
+            case GLCAPTURE_OP_Delete##objects: \
+            { \
+                GLsizei n = read<GLsizei>(); \
+                scratch.resize(sizeof(GLuint) * n); \
+                GLuint* deleted = reinterpret_cast<GLuint*>(scratch.data()); \
+                for (GLsizei i = 0; i < n; i++) \
+                { \
+                    GLuint recorded = read<GLuint>(); \
+                    deleted[i] = mapName(kind, recorded); \
+                    names[kind].erase(recorded); \
+                } \
+                glDelete##objects(n, deleted); \
+                break; \
+            }
+            GLCAPTURE_NAMED_OBJECTS(GLCAPTURE_REPLAY_OBJECTS)
+#undef GLCAPTURE_REPLAY_OBJECTS
+
+            case GLCAPTURE_OP_CreateShader:
+            {
+                GLenum type = read<GLenum>();
+                GLuint recorded = read<GLuint>();
+                names[NAME_PROGRAM][recorded] = glCreateShader(type);
+                break;
+            }
+            case GLCAPTURE_OP_CreateProgram:
+                names[NAME_PROGRAM][read<GLuint>()] = glCreateProgram();
+                break;
+            case GLCAPTURE_OP_ShaderSource:
+            {
+                GLuint shader = mapName(NAME_PROGRAM, read<GLuint>());
+                std::string source = readString();
+                const GLchar* text = source.c_str();
+                glShaderSource(shader, 1, &text, NULL);
+                break;
+            }
+            case GLCAPTURE_OP_GetUniformLocation:
+            {
+                GLuint program = mapName(NAME_PROGRAM, read<GLuint>());
+                GLint recorded = read<GLint>();
+                std::string name = readString();
+                locations[(uint64_t(program) << 32) | static_cast<uint32_t>(recorded)] = glGetUniformLocation(program, name.c_str());
+                break;
+            }
+            case GLCAPTURE_OP_BufferData:
+            {
+                GLenum target = read<GLenum>();
+                GLsizeiptr size = read<GLsizeiptr>();
+                GLenum usage = read<GLenum>();
+                glBufferData(target, size, readData(), usage);
+                break;
+            }
+            case GLCAPTURE_OP_BufferSubData:
+            {
+                GLenum target = read<GLenum>();
+                GLintptr bufferOffset = read<GLintptr>();
+                GLsizeiptr size = read<GLsizeiptr>();
+                glBufferSubData(target, bufferOffset, size, readData());
+                break;
+            }
+            case GLCAPTURE_OP_BufferStorage:
+            {
+                GLenum target = read<GLenum>();
+                GLsizeiptr size = read<GLsizeiptr>();
+                GLbitfield flags = read<GLbitfield>();
+                glBufferStorage(target, size, readData(), flags);
+                break;
+            }
+            case GLCAPTURE_OP_TexImage2D:
+            {
+                GLenum target = read<GLenum>();
+                GLint level = read<GLint>(), internalformat = read<GLint>();
+                GLsizei width = read<GLsizei>(), height = read<GLsizei>();
+                GLint border = read<GLint>();
+                GLenum format = read<GLenum>(), type = read<GLenum>();
+                glTexImage2D(target, level, internalformat, width, height, border, format, type, readData());
+                break;
+            }
+            case GLCAPTURE_OP_TexImage3D:
+            {
+                GLenum target = read<GLenum>();
+                GLint level = read<GLint>(), internalformat = read<GLint>();
+                GLsizei width = read<GLsizei>(), height = read<GLsizei>(), depth = read<GLsizei>();
+                GLint border = read<GLint>();
+                GLenum format = read<GLenum>(), type = read<GLenum>();
+                glTexImage3D(target, level, internalformat, width, height, depth, border, format, type, readData());
+                break;
+            }
+            case GLCAPTURE_OP_TexSubImage2D:
+            {
+                GLenum target = read<GLenum>();
+                GLint level = read<GLint>(), xoffset = read<GLint>(), yoffset = read<GLint>();
+                GLsizei width = read<GLsizei>(), height = read<GLsizei>();
+                GLenum format = read<GLenum>(), type = read<GLenum>();
+                glTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, readData());
+                break;
+            }
+            case GLCAPTURE_OP_TexSubImage3D:
+            {
+                GLenum target = read<GLenum>();
+                GLint level = read<GLint>(), xoffset = read<GLint>(), yoffset = read<GLint>(), zoffset = read<GLint>();
+                GLsizei width = read<GLsizei>(), height = read<GLsizei>(), depth = read<GLsizei>();
+                GLenum format = read<GLenum>(), type = read<GLenum>();
+                glTexSubImage3D(target, level, xoffset, yoffset, zoffset, width, height, depth, format, type, readData());
+                break;
+            }
+            case GLCAPTURE_OP_CompressedTexImage3D:
+            {
+                GLenum target = read<GLenum>();
+                GLint level = read<GLint>();
+                GLenum internalformat = read<GLenum>();
+                GLsizei width = read<GLsizei>(), height = read<GLsizei>(), depth = read<GLsizei>();
+                GLint border = read<GLint>();
+                GLsizei imageSize = read<GLsizei>();
+                glCompressedTexImage3D(target, level, internalformat, width, height, depth, border, imageSize, readData());
+                break;
+            }
+            case GLCAPTURE_OP_CompressedTexSubImage3D:
+            {
+                GLenum target = read<GLenum>();
+                GLint level = read<GLint>(), xoffset = read<GLint>(), yoffset = read<GLint>(), zoffset = read<GLint>();
+                GLsizei width = read<GLsizei>(), height = read<GLsizei>(), depth = read<GLsizei>();
+                GLenum format = read<GLenum>();
+                GLsizei imageSize = read<GLsizei>();
+                glCompressedTexSubImage3D(target, level, xoffset, yoffset, zoffset, width, height, depth, format, imageSize, readData());
+                break;
+            }
+            case GLCAPTURE_OP_TexParameterfv:
+            {
+                GLenum target = read<GLenum>();
+                GLenum pname = read<GLenum>();
+                glTexParameterfv(target, pname, reinterpret_cast<const GLfloat*>(cursor));
+                break;
+            }
+            case GLCAPTURE_OP_PixelStorei:
+            {
+                GLenum pname = read<GLenum>();
+                glPixelStorei(pname, read<GLint>());
+                break;
+            }
+            case GLCAPTURE_OP_DrawBuffers:
+            {
+                GLsizei n = read<GLsizei>();
+                glDrawBuffers(n, reinterpret_cast<const GLenum*>(cursor));
+                break;
+            }
+            case GLCAPTURE_OP_ClearBufferfv:
+            {
+                GLenum buffer = read<GLenum>();
+                GLint drawbuffer = read<GLint>();
+                glClearBufferfv(buffer, drawbuffer, reinterpret_cast<const GLfloat*>(cursor));
+                break;
+            }
+            case GLCAPTURE_OP_BindBuffer:
+            {
+                GLenum target = read<GLenum>();
+                glBindBuffer(target, mapName(NAME_BUFFER, read<GLuint>()));
+                break;
+            }
+            case GLCAPTURE_OP_BindFramebuffer:
+            {
+                GLenum target = read<GLenum>();
+                glBindFramebuffer(target, mapName(NAME_FRAMEBUFFER, read<GLuint>()));
+                break;
+            }
+            case GLCAPTURE_OP_BindTexture:
+            {
+                GLuint unit = read<GLuint>();
+                GLenum target = read<GLenum>();
+                GLuint texture = mapName(NAME_TEXTURE, read<GLuint>());
+                if (unit != activeUnit)
+                    glActiveTexture(GL_TEXTURE0 + unit);
+                glBindTexture(target, texture);
+                if (unit != activeUnit)
+                    glActiveTexture(GL_TEXTURE0 + activeUnit);
+                break;
+            }
+            case GLCAPTURE_OP_ActiveTexture:
+            {
+                GLenum texture = read<GLenum>();
+                activeUnit = texture - GL_TEXTURE0;
+                glActiveTexture(texture);
+                break;
+            }
+            case GLCAPTURE_OP_UseProgram:
+                currentProgram = mapName(NAME_PROGRAM, read<GLuint>());
+                glUseProgram(currentProgram);
+                break;
+            case GLCAPTURE_OP_GetQueryObjectiv:
+            {
+                GLuint id = mapName(NAME_QUERY, read<GLuint>());
+                GLenum pname = read<GLenum>();
+                GLint value;
+                glGetQueryObjectiv(id, pname, &value);
+                break;
+            }
+            case GLCAPTURE_OP_GetQueryObjectui64v:
+            {
+                GLuint id = mapName(NAME_QUERY, read<GLuint>());
+                GLenum pname = read<GLenum>();
+                GLuint64 value;
+                glGetQueryObjectui64v(id, pname, &value);
+                break;
+            }
+            case GLCAPTURE_OP_ReadPixels:
+            {
+                GLint x = read<GLint>(), y = read<GLint>();
+                GLsizei width = read<GLsizei>(), height = read<GLsizei>();
+                GLenum format = read<GLenum>(), type = read<GLenum>();
+                void* pixels = read<void*>();
+                GLint packBuffer = 0;
+                glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &packBuffer);
+                if (packBuffer == 0)
+                {
+                    scratch.resize(glCaptureImageSize(width, height, 1, format, type, 8));
+                    pixels = scratch.data();
+                }
+                glReadPixels(x, y, width, height, format, type, pixels);
+                break;
+            }
+            default:
+                std::cout << "ERROR::GL_REPLAY::UNKNOWN_OP " << op << std::endl;
+                break;
+            }
+        }
+        return frames;
+    }
+};
+
+#endif
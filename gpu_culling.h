@@ -0,0 +1,260 @@
+//
+//  gpu_culling.h
+//  3D Object Drawing
+//
+//  GPU-driven culling. The bounds, model matrix and material of every part live in a
+//  storage buffer that is uploaded once and patched for moved and added parts only. Each frame
+//  a compute shader tests every part against the view frustums and appends a
+//  SceneInstance and a DrawElementsIndirectCommand per visible part and view, so
+//  SceneRenderer::DrawIndirect submits the whole room with one
+//  glMultiDrawElementsIndirect without the CPU looking at a single part.
+//  Parts of transparent materials are left out: the caller adds them to the
+//  SceneRenderer for its transparent pass. Needs GL 4.3 (compute shaders, storage
+//  buffers, multi-draw indirect).
+//
+
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "bounds.h"
+#include "materials.h"
+#include "scene.h"
+#include "scene_renderer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// must match MAX_VIEWS in cullShader.cs
+const int GPUCULL_MAX_VIEWS = SCENE_MAX_VIEWS;
+const unsigned int GPUCULL_GROUP_SIZE = 64;
+
+// storage buffer bindings used by cullShader.cs
+const int GPUCULL_OBJECT_BINDING = 0;
+const int GPUCULL_INSTANCE_BINDING = 1;
+const int GPUCULL_COMMAND_BINDING = 2;
+
+// the command buffer starts with the visible count (padded to 16 bytes), then the commands
+const size_t GPUCULL_COMMAND_OFFSET = 16;
+
+// std430 layout of Object in cullShader.cs
+struct GpuCullObject
+{
+    glm::mat4 Model;
+    glm::vec4 Min;
+    glm::vec4 Max;
+    unsigned int Material;
+    unsigned int Lightmap;
+    unsigned int Skip;          // non-zero for parts the shader leaves out
+    unsigned int Padding;
+};
+
+struct DrawElementsIndirectCommand
+{
+    unsigned int Count;
+    unsigned int InstanceCount;
+    unsigned int FirstIndex;
+    int BaseVertex;
+    unsigned int BaseInstance;
+};
+
+class GpuCulling
+{
+public:
+    unsigned int ObjectBuffer, InstanceBuffer, CommandBuffer;
+    unsigned int ObjectCount;
+    unsigned int Capacity;          // commands and instances: one per part and view
+
+    GpuCulling() : ObjectBuffer(0), InstanceBuffer(0), CommandBuffer(0), ObjectCount(0), Capacity(0), program(0), objectCapacity(0), views(1)
+    {
+        program = compile("cullShader.cs");
+        objectCountLocation = glGetUniformLocation(program, "objectCount");
+        indexCountLocation = glGetUniformLocation(program, "indexCount");
+        firstIndexLocation = glGetUniformLocation(program, "firstIndex");
+        viewCountLocation = glGetUniformLocation(program, "viewCount");
+        planesLocation = glGetUniformLocation(program, "frustumPlanes");
+        glGenBuffers(1, &ObjectBuffer);
+        glGenBuffers(1, &InstanceBuffer);
+        glGenBuffers(1, &CommandBuffer);
+    }
+
+    // uploads every part once; the instance and command buffers are sized for viewCount views
+    void Upload(const Scene& scene, const MaterialTable& materials, int viewCount)
+    {
+        views = static_cast<unsigned int>(std::min(std::max(viewCount, 1), GPUCULL_MAX_VIEWS));
+        allocate(scene, materials, scene.PartCount());
+    }
+
+    // patches the parts UpdateTransforms() moved, one upload per run of consecutive parts (a
+    // node's parts are consecutive). Parts added since the last call are patched in as well;
+    // once they outgrow the buffers everything is uploaded again with room to spare.
+    void Update(const Scene& scene, const MaterialTable& materials)
+    {
+        if (scene.PartCount() > objectCapacity)
+        {
+            allocate(scene, materials, std::max(scene.PartCount(), objectCapacity * 2));
+            return;
+        }
+        for (unsigned int part = ObjectCount; part < scene.PartCount(); part++)
+            skip.push_back(materials.Transparent(scene.PartMaterial[part]) ? 1u : 0u);
+        ObjectCount = scene.PartCount();
+        if (scene.DirtyParts.empty())
+            return;
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ObjectBuffer);
+        size_t i = 0;
+        while (i < scene.DirtyParts.size())
+        {
+            unsigned int first = scene.DirtyParts[i];
+            patch.clear();
+            while (i < scene.DirtyParts.size() && scene.DirtyParts[i] == first + patch.size())
+                patch.push_back(object(scene, scene.DirtyParts[i++]));
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(GpuCullObject) * first, sizeof(GpuCullObject) * patch.size(), patch.data());
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // fills the instance and command buffers for the given frustums; every command draws
+    // indexCount indices from firstIndex on
+    void Cull(const Frustum* frustums, int viewCount, unsigned int indexCount, unsigned int firstIndex = 0)
+    {
+        viewCount = std::min(viewCount, GPUCULL_MAX_VIEWS);
+        glm::vec4 planes[GPUCULL_MAX_VIEWS * 6];
+        for (int view = 0; view < viewCount; view++)
+            for (int i = 0; i < 6; i++)
+                planes[view * 6 + i] = frustums[view].Planes[i];
+
+        // zero count and commands; slots the shader does not fill draw nothing
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, CommandBuffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        glUseProgram(program);
+        glUniform1ui(objectCountLocation, ObjectCount);
+        glUniform1ui(indexCountLocation, indexCount);
+        glUniform1ui(firstIndexLocation, firstIndex);
+        glUniform1i(viewCountLocation, viewCount);
+        glUniform4fv(planesLocation, viewCount * 6, glm::value_ptr(planes[0]));
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPUCULL_OBJECT_BINDING, ObjectBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPUCULL_INSTANCE_BINDING, InstanceBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPUCULL_COMMAND_BINDING, CommandBuffer);
+        glDispatchCompute((ObjectCount + GPUCULL_GROUP_SIZE - 1) / GPUCULL_GROUP_SIZE, 1, 1);
+
+        // the draw reads the commands and the instances as vertex attributes
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+
+    // visible part count of the last Cull(); stalls until the GPU has finished it, debugging only
+    unsigned int ReadVisibleCount() const
+    {
+        unsigned int count = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, CommandBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(count), &count);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        return count;
+    }
+
+    void Release()
+    {
+        glDeleteProgram(program);
+        glDeleteBuffers(1, &ObjectBuffer);
+        glDeleteBuffers(1, &InstanceBuffer);
+        glDeleteBuffers(1, &CommandBuffer);
+        ObjectBuffer = InstanceBuffer = CommandBuffer = 0;
+        program = 0;
+    }
+
+private:
+    unsigned int program;
+    GLint objectCountLocation, indexCountLocation, firstIndexLocation, viewCountLocation, planesLocation;
+    std::vector<unsigned int> skip;
+    unsigned int objectCapacity;    // parts the buffers have room for
+    unsigned int views;
+    std::vector<GpuCullObject> patch;
+
+    // (re)creates the buffers for objects parts and uploads the scene's
+    void allocate(const Scene& scene, const MaterialTable& materials, unsigned int objects)
+    {
+        ObjectCount = scene.PartCount();
+        objectCapacity = objects;
+        Capacity = objectCapacity * views;
+        skip.resize(ObjectCount);
+        for (unsigned int part = 0; part < ObjectCount; part++)
+            skip[part] = materials.Transparent(scene.PartMaterial[part]) ? 1u : 0u;
+
+        std::vector<GpuCullObject> uploaded(ObjectCount);
+        for (unsigned int part = 0; part < ObjectCount; part++)
+            uploaded[part] = object(scene, part);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ObjectBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GpuCullObject) * objectCapacity, NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GpuCullObject) * uploaded.size(), uploaded.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, InstanceBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(SceneInstance) * Capacity, NULL, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, CommandBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, GPUCULL_COMMAND_OFFSET + sizeof(DrawElementsIndirectCommand) * Capacity, NULL, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    GpuCullObject object(const Scene& scene, unsigned int part) const
+    {
+        GpuCullObject result;
+        result.Model = scene.PartModel[part];
+        result.Min = glm::vec4(scene.PartBounds[part].Min, 0.0f);
+        result.Max = glm::vec4(scene.PartBounds[part].Max, 0.0f);
+        result.Material = scene.PartMaterial[part];
+        result.Lightmap = scene.PartLightmap[part];
+        result.Skip = skip[part] | scene.NodeRemoved[scene.PartNode[part]];
+        result.Padding = 0;
+        return result;
+    }
+
+    static unsigned int compile(const char* computePath)
+    {
+        std::string code;
+        std::ifstream file(computePath);
+        if (file)
+        {
+            std::stringstream stream;
+            stream << file.rdbuf();
+            code = stream.str();
+        }
+        else
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << computePath << std::endl;
+        }
+
+        const char* source = code.c_str();
+        unsigned int shader = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        GLint success;
+        GLchar infoLog[1024];
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+            std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: COMPUTE\n" << infoLog << std::endl;
+        }
+
+        unsigned int id = glCreateProgram();
+        glAttachShader(id, shader);
+        glLinkProgram(id);
+        glGetProgramiv(id, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glGetProgramInfoLog(id, 1024, NULL, infoLog);
+            std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: PROGRAM\n" << infoLog << std::endl;
+        }
+        glDeleteShader(shader);
+        return id;
+    }
+};
+
+#endif
@@ -0,0 +1,465 @@
+//
+//  gpu_memory.h
+//  3D Object Drawing
+//
+//  Suballocates vertex, index and instance data from a few large GL buffers
+//  instead of one buffer per mesh. Each GpuArena owns one buffer of fixed
+//  capacity, so GPU memory stays bounded, and hands out aligned ranges with an
+//  offset allocator: the free ranges are kept sorted by offset, allocation takes
+//  the smallest range that fits and freeing merges a range with its free
+//  neighbours. A GpuBlock owns its range and gives it back when it is destroyed
+//  or reset; it is move-only, so every range has exactly one owner, and ranges
+//  still owned when the arena is released are reported as leaks with the name
+//  their owner gave them.
+//
+//  Freed ranges leave holes. Defragment() closes them a few bytes per frame: it
+//  slides the block above the lowest hole down into it with glCopyBufferSubData
+//  (through a scratch buffer when the two places overlap), so the holes bubble up
+//  and merge into the free tail. The GPU orders the copies after the draws that
+//  still read the old place, so the CPU never waits. Owners must therefore read
+//  Offset() at draw time; ranges whose offset is baked into a vertex array are
+//  allocated pinned and never move. The free and live range maps take their nodes
+//  from a pool, so allocating, freeing and moving ranges every frame stays off the
+//  heap once the pool has grown.
+//
+
+#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+
+#include "allocators.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <utility>
+#include <vector>
+
+enum Gpu_Memory_Category {
+    GPU_MEMORY_VERTEX,
+    GPU_MEMORY_INDEX,
+    GPU_MEMORY_INSTANCE,
+    GPU_MEMORY_CATEGORY_COUNT
+};
+
+const char* const GPU_MEMORY_CATEGORY_NAMES[GPU_MEMORY_CATEGORY_COUNT] = { "vertex", "index", "instance" };
+
+// offsets and sizes are multiples of this; enough for any attribute or index type
+const size_t GPU_MEMORY_ALIGNMENT = 64;
+// pool block for a range map node: the tree links plus an offset and a size
+const size_t GPU_MEMORY_MAP_NODE_BYTES = 64;
+
+class GpuArena;
+
+// owner of one range of an arena
+class GpuBlock
+{
+public:
+    GpuBlock() : arena(NULL), id(0) {}
+    ~GpuBlock() { Reset(); }
+
+    GpuBlock(GpuBlock&& other) : arena(other.arena), id(other.id)
+    {
+        other.arena = NULL;
+    }
+
+    GpuBlock& operator=(GpuBlock&& other)
+    {
+        if (this != &other)
+        {
+            Reset();
+            arena = other.arena;
+            id = other.id;
+            other.arena = NULL;
+        }
+        return *this;
+    }
+
+    GpuBlock(const GpuBlock&) = delete;
+    GpuBlock& operator=(const GpuBlock&) = delete;
+
+    bool Valid() const { return arena != NULL; }
+    size_t Offset() const;
+    size_t Size() const;
+    unsigned int Buffer() const;
+
+    // writes bytes at the given position of the range
+    void Upload(const void* data, size_t bytes, size_t at = 0) const;
+
+    // gives the range back to its arena
+    void Reset();
+
+private:
+    friend class GpuArena;
+
+    GpuArena* arena;
+    unsigned int id;
+
+    GpuBlock(GpuArena* arena, unsigned int id) : arena(arena), id(id) {}
+};
+
+class GpuArena
+{
+public:
+    unsigned int Buffer;
+    size_t Capacity;
+
+    // statistics
+    size_t Used, Peak;
+    unsigned int BlockCount;
+    unsigned long long Allocations, Failures, Moves, MovedBytes;
+
+    GpuArena()
+        : Buffer(0), Capacity(0), Used(0), Peak(0), BlockCount(0), Allocations(0), Failures(0), Moves(0), MovedBytes(0),
+          name(""), nodePool(GPU_MEMORY_MAP_NODE_BYTES), freeRanges(std::less<size_t>(), RangeAllocator(nodePool)),
+          liveBlocks(std::less<size_t>(), BlockAllocator(nodePool)), scratch(0), scratchSize(0)
+    {
+    }
+
+    ~GpuArena()
+    {
+        Release();
+    }
+
+    GpuArena(const GpuArena&) = delete;
+    GpuArena& operator=(const GpuArena&) = delete;
+
+    // allocates the arena's buffer once; usage as for glBufferData
+    void Create(const char* arenaName, size_t capacity, GLenum usage)
+    {
+        name = arenaName;
+        Capacity = alignUp(capacity);
+        glGenBuffers(1, &Buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, Buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, Capacity, NULL, usage);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        freeRanges.clear();
+        freeRanges[0] = Capacity;
+    }
+
+    // a range of at least bytes for owner; invalid when the arena has no hole large enough
+    GpuBlock Allocate(size_t bytes, const char* owner, bool movable = true)
+    {
+        size_t size = alignUp(std::max<size_t>(bytes, 1));
+        RangeMap::iterator best = freeRanges.end();
+        for (RangeMap::iterator range = freeRanges.begin(); range != freeRanges.end(); ++range)
+        {
+            if (range->second >= size && (best == freeRanges.end() || range->second < best->second))
+                best = range;
+        }
+        if (best == freeRanges.end())
+        {
+            Failures++;
+            std::cout << "ERROR::GPU_MEMORY::OUT_OF_MEMORY " << name << " arena: " << owner << " needs " << size
+                      << " bytes, largest hole " << LargestFree() << std::endl;
+            return GpuBlock();
+        }
+
+        Block block;
+        block.Offset = take(best, size);
+        block.Size = size;
+        block.Owner = owner;
+        block.Movable = movable;
+        block.Live = true;
+        unsigned int id;
+        if (!freeIds.empty())
+        {
+            id = freeIds.back();
+            freeIds.pop_back();
+            blocks[id] = block;
+        }
+        else
+        {
+            id = static_cast<unsigned int>(blocks.size());
+            blocks.push_back(block);
+        }
+
+        liveBlocks[block.Offset] = id;
+        Used += size;
+        Peak = std::max(Peak, Used);
+        BlockCount++;
+        Allocations++;
+        return GpuBlock(this, id);
+    }
+
+    size_t LargestFree() const
+    {
+        size_t largest = 0;
+        for (const std::pair<const size_t, size_t>& range : freeRanges)
+            largest = std::max(largest, range.second);
+        return largest;
+    }
+
+    // share of the free bytes outside the largest hole; 0 when everything free is in one piece
+    float Fragmentation() const
+    {
+        size_t free = Capacity - Used;
+        return free > 0 ? 1.0f - static_cast<float>(LargestFree()) / free : 0.0f;
+    }
+
+    // slides movable blocks down into the holes below them, at most byteBudget bytes;
+    // returns the bytes moved
+    size_t Defragment(size_t byteBudget)
+    {
+        size_t moved = 0;
+        RangeMap::iterator hole = freeRanges.begin();
+        while (hole != freeRanges.end() && Buffer != 0)
+        {
+            // the block right above the hole; the free tail has none
+            BlockMap::iterator above = liveBlocks.find(hole->first + hole->second);
+            if (above == liveBlocks.end())
+                break;
+            Block& block = blocks[above->second];
+            if (!block.Movable)
+            {
+                // a pinned block stays; try the next hole
+                ++hole;
+                continue;
+            }
+            if (moved + block.Size > byteBudget)
+                break;
+
+            size_t to = hole->first;
+            size_t gap = hole->second;
+            unsigned int id = above->second;
+            copy(block.Offset, to, block.Size);
+            liveBlocks.erase(above);
+            liveBlocks[to] = id;
+            block.Offset = to;
+            // the hole moves up past the block and merges with whatever is free there
+            freeRanges.erase(hole);
+            give(to + block.Size, gap);
+            hole = freeRanges.lower_bound(to + block.Size);
+            moved += block.Size;
+            Moves++;
+            MovedBytes += block.Size;
+        }
+        return moved;
+    }
+
+    void PrintStats() const
+    {
+        std::cout << "  " << name << ": " << Used / 1024 << " of " << Capacity / 1024 << " KB in " << BlockCount << " blocks, peak "
+                  << Peak / 1024 << " KB, " << freeRanges.size() << " holes (largest " << LargestFree() / 1024 << " KB), "
+                  << Allocations << " allocations, " << Failures << " failed, " << Moves << " moves ("
+                  << MovedBytes / 1024 << " KB)" << std::endl;
+    }
+
+    // deletes the buffer; blocks still owned at this point are leaks
+    void Release()
+    {
+        for (const Block& block : blocks)
+        {
+            if (block.Live)
+                std::cout << "ERROR::GPU_MEMORY::LEAK " << name << " arena: " << block.Owner << " still holds "
+                          << block.Size << " bytes" << std::endl;
+        }
+        if (Buffer != 0)
+            glDeleteBuffers(1, &Buffer);
+        if (scratch != 0)
+            glDeleteBuffers(1, &scratch);
+        Buffer = scratch = 0;
+        scratchSize = 0;
+        Capacity = Used = 0;
+        BlockCount = 0;
+        blocks.clear();
+        freeIds.clear();
+        freeRanges.clear();
+        liveBlocks.clear();
+    }
+
+private:
+    friend class GpuBlock;
+
+    struct Block
+    {
+        size_t Offset;
+        size_t Size;
+        const char* Owner;
+        bool Movable;
+        bool Live;
+    };
+
+    typedef PoolNodeAllocator<std::pair<const size_t, size_t>> RangeAllocator;
+    typedef PoolNodeAllocator<std::pair<const size_t, unsigned int>> BlockAllocator;
+    typedef std::map<size_t, size_t, std::less<size_t>, RangeAllocator> RangeMap;
+    typedef std::map<size_t, unsigned int, std::less<size_t>, BlockAllocator> BlockMap;
+
+    const char* name;
+    std::vector<Block> blocks;
+    std::vector<unsigned int> freeIds;
+    PoolAllocator nodePool;                     // declared before the maps that use it
+    RangeMap freeRanges;                        // offset -> size
+    BlockMap liveBlocks;                        // offset -> block id
+    unsigned int scratch;                       // staging for moves onto overlapping places
+    size_t scratchSize;
+
+    static size_t alignUp(size_t bytes)
+    {
+        return (bytes + GPU_MEMORY_ALIGNMENT - 1) / GPU_MEMORY_ALIGNMENT * GPU_MEMORY_ALIGNMENT;
+    }
+
+    // carves size bytes off the front of a free range
+    size_t take(RangeMap::iterator range, size_t size)
+    {
+        size_t offset = range->first;
+        size_t rest = range->second - size;
+        freeRanges.erase(range);
+        if (rest > 0)
+            freeRanges[offset + size] = rest;
+        return offset;
+    }
+
+    // returns a range, merged with the free ranges it touches
+    void give(size_t offset, size_t size)
+    {
+        RangeMap::iterator next = freeRanges.lower_bound(offset);
+        if (next != freeRanges.end() && offset + size == next->first)
+        {
+            size += next->second;
+            next = freeRanges.erase(next);
+        }
+        if (next != freeRanges.begin())
+        {
+            RangeMap::iterator previous = std::prev(next);
+            if (previous->first + previous->second == offset)
+            {
+                previous->second += size;
+                return;
+            }
+        }
+        freeRanges[offset] = size;
+    }
+
+    // GPU side copy within the buffer; GL forbids overlapping source and destination
+    void copy(size_t from, size_t to, size_t size)
+    {
+        bool overlap = from < to + size && to < from + size;
+        if (overlap && scratchSize < size)
+        {
+            if (scratch == 0)
+                glGenBuffers(1, &scratch);
+            scratchSize = size;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+            glBufferData(GL_COPY_WRITE_BUFFER, scratchSize, NULL, GL_STREAM_COPY);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, Buffer);
+        if (overlap)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(from), 0, static_cast<GLsizeiptr>(size));
+            glBindBuffer(GL_COPY_READ_BUFFER, scratch);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, Buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, static_cast<GLintptr>(to), static_cast<GLsizeiptr>(size));
+        }
+        else
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, Buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(from), static_cast<GLintptr>(to), static_cast<GLsizeiptr>(size));
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    void free(unsigned int id)
+    {
+        // the arena was released before its blocks; Release() reported them
+        if (id >= blocks.size() || !blocks[id].Live)
+            return;
+        Block& block = blocks[id];
+        block.Live = false;
+        liveBlocks.erase(block.Offset);
+        give(block.Offset, block.Size);
+        Used -= block.Size;
+        BlockCount--;
+        freeIds.push_back(id);
+    }
+};
+
+inline size_t GpuBlock::Offset() const
+{
+    return arena->blocks[id].Offset;
+}
+
+inline size_t GpuBlock::Size() const
+{
+    return arena->blocks[id].Size;
+}
+
+inline unsigned int GpuBlock::Buffer() const
+{
+    return arena->Buffer;
+}
+
+inline void GpuBlock::Upload(const void* data, size_t bytes, size_t at) const
+{
+    // the copy target leaves the bound vertex array's element buffer alone
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena->Buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(Offset() + at), static_cast<GLsizeiptr>(bytes), data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+inline void GpuBlock::Reset()
+{
+    if (arena != NULL)
+        arena->free(id);
+    arena = NULL;
+}
+
+// one arena per category
+class GpuMemory
+{
+public:
+    GpuMemory(size_t vertexBytes, size_t indexBytes, size_t instanceBytes)
+    {
+        arenas[GPU_MEMORY_VERTEX].Create(GPU_MEMORY_CATEGORY_NAMES[GPU_MEMORY_VERTEX], vertexBytes, GL_STATIC_DRAW);
+        arenas[GPU_MEMORY_INDEX].Create(GPU_MEMORY_CATEGORY_NAMES[GPU_MEMORY_INDEX], indexBytes, GL_STATIC_DRAW);
+        arenas[GPU_MEMORY_INSTANCE].Create(GPU_MEMORY_CATEGORY_NAMES[GPU_MEMORY_INSTANCE], instanceBytes, GL_STREAM_DRAW);
+    }
+
+    GpuArena& Arena(Gpu_Memory_Category category) { return arenas[category]; }
+
+    GpuBlock Allocate(Gpu_Memory_Category category, size_t bytes, const char* owner, bool movable = true)
+    {
+        return arenas[category].Allocate(bytes, owner, movable);
+    }
+
+    // background compaction, a byte budget shared by the arenas; call once per frame
+    size_t Defragment(size_t byteBudget)
+    {
+        size_t moved = 0;
+        for (int category = 0; category < GPU_MEMORY_CATEGORY_COUNT && moved < byteBudget; category++)
+            moved += arenas[category].Defragment(byteBudget - moved);
+        return moved;
+    }
+
+    size_t Used() const
+    {
+        size_t used = 0;
+        for (int category = 0; category < GPU_MEMORY_CATEGORY_COUNT; category++)
+            used += arenas[category].Used;
+        return used;
+    }
+
+    void PrintStats() const
+    {
+        std::cout << "GPU memory:" << std::endl;
+        for (int category = 0; category < GPU_MEMORY_CATEGORY_COUNT; category++)
+            arenas[category].PrintStats();
+    }
+
+    void Release()
+    {
+        for (int category = 0; category < GPU_MEMORY_CATEGORY_COUNT; category++)
+            arenas[category].Release();
+    }
+
+private:
+    GpuArena arenas[GPU_MEMORY_CATEGORY_COUNT];
+};
+
+#endif
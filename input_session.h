@@ -0,0 +1,257 @@
+//
+//  input_session.h
+//  3D Object Drawing
+//
+//  Records everything that drives the simulation (the frame clock, the keys
+//  processInput polls and the mouse/scroll/button/resize callbacks) to a file, and
+//  feeds a recording back with the recorded clock so a session replays the same
+//  frames on every run. Replays also collect CPU frame times for comparing builds.
+//
+
+#ifndef INPUT_SESSION_H
+#define INPUT_SESSION_H
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+enum Input_Mode {
+    INPUT_LIVE,
+    INPUT_RECORD,
+    INPUT_REPLAY
+};
+
+enum Input_EventType {
+    INPUT_CURSOR,
+    INPUT_SCROLL,
+    INPUT_MOUSE_BUTTON,
+    INPUT_RESIZE
+};
+
+// at most this many keys can be tracked (one bit each in the per-frame key mask)
+const int INPUT_MAX_KEYS = 32;
+
+const char INPUT_SESSION_MAGIC[8] = { 'I', 'N', 'P', 'U', 'T', 'R', 'E', 'C' };
+
+struct InputEvent
+{
+    uint32_t Type;
+    float Time;              // seconds since the session started
+    double X, Y;             // cursor position, scroll offset or new framebuffer size
+    int32_t Button, Action, Mods;
+};
+
+class InputSession
+{
+public:
+    Input_Mode Mode;
+    int RecordedWidth, RecordedHeight;   // framebuffer size of the recorded session
+
+    InputSession() : Mode(INPUT_LIVE), RecordedWidth(0), RecordedHeight(0), file(NULL), keyCount(0), frameKeys(0), frameDelta(0.0f),
+                     sessionTime(0.0f), dispatching(false), finished(false), replayCursor(0)
+    {
+        events.reserve(64);
+        frameEvents.reserve(64);
+    }
+
+    ~InputSession()
+    {
+        if (file != NULL)
+            fclose(file);
+    }
+
+    // keys processInput polls; must be set up identically for recording and replay
+    void TrackKeys(const int* keys, int count)
+    {
+        keyCount = std::min(count, INPUT_MAX_KEYS);
+        std::copy(keys, keys + keyCount, trackedKeys);
+    }
+
+    bool StartRecording(const char* path, int framebufferWidth, int framebufferHeight)
+    {
+        file = fopen(path, "wb");
+        if (file == NULL)
+            return false;
+        uint32_t header[3] = { static_cast<uint32_t>(keyCount), static_cast<uint32_t>(framebufferWidth), static_cast<uint32_t>(framebufferHeight) };
+        fwrite(INPUT_SESSION_MAGIC, sizeof(INPUT_SESSION_MAGIC), 1, file);
+        fwrite(header, sizeof(header), 1, file);
+        fwrite(trackedKeys, sizeof(int), keyCount, file);
+        Mode = INPUT_RECORD;
+        return true;
+    }
+
+    bool StartReplay(const char* path)
+    {
+        FILE* input = fopen(path, "rb");
+        if (input == NULL)
+            return false;
+        fseek(input, 0, SEEK_END);
+        replayData.resize(static_cast<size_t>(ftell(input)));
+        fseek(input, 0, SEEK_SET);
+        bool ok = fread(replayData.data(), 1, replayData.size(), input) == replayData.size();
+        fclose(input);
+
+        uint32_t header[3];
+        if (!ok || replayData.size() < sizeof(INPUT_SESSION_MAGIC) + sizeof(header) ||
+            memcmp(replayData.data(), INPUT_SESSION_MAGIC, sizeof(INPUT_SESSION_MAGIC)) != 0)
+            return false;
+        replayCursor = sizeof(INPUT_SESSION_MAGIC);
+        read(header, sizeof(header));
+        int recordedKeys[INPUT_MAX_KEYS];
+        int count = std::min(static_cast<int>(header[0]), INPUT_MAX_KEYS);
+        read(recordedKeys, sizeof(int) * count);
+        if (count != keyCount || !std::equal(recordedKeys, recordedKeys + count, trackedKeys))
+            std::cout << "WARNING::INPUT_SESSION::TRACKED_KEYS_DIFFER" << std::endl;
+        RecordedWidth = static_cast<int>(header[1]);
+        RecordedHeight = static_cast<int>(header[2]);
+        frameTimes.reserve(4096);
+        Mode = INPUT_REPLAY;
+        return true;
+    }
+
+    // called at the top of every frame with the wall clock delta; returns the delta the
+    // simulation must use. During replay this also dispatches the frame's recorded events
+    // through the callbacks.
+    template<typename Dispatch>
+    float BeginFrame(float realDelta, Dispatch&& dispatch)
+    {
+        frameStart = std::chrono::steady_clock::now();
+        if (Mode == INPUT_RECORD)
+        {
+            frameDelta = realDelta;
+            sessionTime += realDelta;
+            frameKeys = 0;
+            // events polled since the last frame are the ones this frame consumes
+            frameEvents.swap(events);
+            events.clear();
+            return realDelta;
+        }
+        if (Mode != INPUT_REPLAY)
+            return realDelta;
+
+        if (replayCursor + sizeof(float) + sizeof(uint32_t) * 2 > replayData.size())
+        {
+            finished = true;
+            return 0.0f;
+        }
+        uint32_t eventCount;
+        read(&frameDelta, sizeof(frameDelta));
+        read(&frameKeys, sizeof(frameKeys));
+        read(&eventCount, sizeof(eventCount));
+        sessionTime += frameDelta;
+
+        dispatching = true;
+        for (uint32_t i = 0; i < eventCount; i++)
+        {
+            InputEvent event;
+            read(&event, sizeof(event));
+            dispatch(event);
+        }
+        dispatching = false;
+        return frameDelta;
+    }
+
+    // every callback asks first; live and recorded input is accepted (and logged when
+    // recording), real input arriving during a replay is ignored
+    bool Accept(Input_EventType type, double x, double y, int button = 0, int action = 0, int mods = 0)
+    {
+        if (Mode == INPUT_REPLAY)
+            return dispatching;
+        if (Mode == INPUT_RECORD)
+        {
+            InputEvent event;
+            memset(&event, 0, sizeof(event));
+            event.Type = type;
+            event.Time = sessionTime;
+            event.X = x;
+            event.Y = y;
+            event.Button = button;
+            event.Action = action;
+            event.Mods = mods;
+            events.push_back(event);
+        }
+        return true;
+    }
+
+    // replacement for glfwGetKey in processInput
+    int GetKey(GLFWwindow* window, int key)
+    {
+        int bit = keyBit(key);
+        if (Mode == INPUT_REPLAY && bit >= 0)
+            return (frameKeys >> bit) & 1u ? GLFW_PRESS : GLFW_RELEASE;
+        int state = glfwGetKey(window, key);
+        if (Mode == INPUT_RECORD && bit >= 0 && state == GLFW_PRESS)
+            frameKeys |= 1u << bit;
+        return state;
+    }
+
+    // called at the very end of the frame; writes the frame's record
+    void EndFrame()
+    {
+        if (Mode == INPUT_REPLAY)
+            frameTimes.push_back(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+        if (Mode != INPUT_RECORD)
+            return;
+        uint32_t eventCount = static_cast<uint32_t>(frameEvents.size());
+        fwrite(&frameDelta, sizeof(frameDelta), 1, file);
+        fwrite(&frameKeys, sizeof(frameKeys), 1, file);
+        fwrite(&eventCount, sizeof(eventCount), 1, file);
+        fwrite(frameEvents.data(), sizeof(InputEvent), frameEvents.size(), file);
+    }
+
+    bool Finished() const { return finished; }
+
+    void PrintReplayTimings()
+    {
+        if (frameTimes.empty())
+            return;
+        std::vector<float> sorted(frameTimes);
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (float t : sorted)
+            total += t;
+        std::cout << "input replay: " << sorted.size() << " frames, cpu ms/frame mean " << total / sorted.size()
+                  << "  median " << sorted[sorted.size() / 2]
+                  << "  p99 " << sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)]
+                  << "  max " << sorted.back() << std::endl;
+    }
+
+private:
+    FILE* file;
+    int trackedKeys[INPUT_MAX_KEYS];
+    int keyCount;
+    uint32_t frameKeys;
+    float frameDelta;
+    float sessionTime;
+    std::vector<InputEvent> events;         // recorded since the current frame started
+    std::vector<InputEvent> frameEvents;    // consumed by the current frame
+    bool dispatching;
+    bool finished;
+    std::vector<unsigned char> replayData;
+    size_t replayCursor;
+    std::chrono::steady_clock::time_point frameStart;
+    std::vector<float> frameTimes;
+
+    int keyBit(int key) const
+    {
+        for (int i = 0; i < keyCount; i++)
+            if (trackedKeys[i] == key)
+                return i;
+        return -1;
+    }
+
+    void read(void* destination, size_t size)
+    {
+        size = std::min(size, replayData.size() - replayCursor);
+        memcpy(destination, replayData.data() + replayCursor, size);
+        replayCursor += size;
+    }
+};
+
+#endif
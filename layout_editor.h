@@ -0,0 +1,222 @@
+//
+//  layout_editor.h
+//  3D Object Drawing
+//
+//  Runtime editing of the room's furniture: select, move, rotate, add and delete
+//  prefab placements while the app runs. Every edit is incremental. A placement is
+//  one scene node, so an edit only dirties that node's parts, and the frame's usual
+//  path picks them up: UpdateTransforms, the BVH refit of the dirty leaves, the
+//  GpuCulling patch of their range and the redraw of their screen rectangle.
+//  Added furniture reuses the node of deleted furniture of the same kind or appends
+//  a node and inserts its parts into the BVH; deleted furniture keeps its node with
+//  empty bounds, so no part index shifts and nothing is rebuilt. Furniture that ends
+//  up far from where its parts entered the BVH is reinserted rather than refitted,
+//  which would stretch its old leaves' ancestors across the room.
+//
+//  Baked lighting near an edit no longer matches the room: parts whose bounds come
+//  within LAYOUT_LIGHT_REACH of the edited furniture drop their lightmap slot and
+//  are lit live until the next --bake-lightmap.
+//
+
+#ifndef LAYOUT_EDITOR_H
+#define LAYOUT_EDITOR_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bounds.h"
+#include "bvh.h"
+#include "prefabs.h"
+#include "scene.h"
+
+#include <vector>
+
+// furniture the editor can place
+enum Furniture_Kind {
+    FURNITURE_CHAIR,
+    FURNITURE_TABLE,
+    FURNITURE_BED,
+    FURNITURE_KIND_COUNT
+};
+
+const char* const FURNITURE_NAMES[FURNITURE_KIND_COUNT] = { "chair", "table", "bed" };
+
+// nodeKind of nodes the editor does not touch (walls, windows, fans)
+const unsigned int FURNITURE_NONE = 0xFFFFFFFFu;
+
+// how far an edit can change the baked light around it (contact shadows, bounce)
+const float LAYOUT_LIGHT_REACH = 0.5f;
+
+// furniture moved further than this from where its parts entered the BVH is reinserted
+const float LAYOUT_REINSERT_DISTANCE = 2.0f;
+
+class LayoutEditor
+{
+public:
+    int Selected;                   // node, -1 when nothing is selected
+    unsigned long long Edits;
+    unsigned int ForgottenBakes;    // parts whose baked lighting edits dropped
+
+    LayoutEditor(Scene& scene, BVH& bvh)
+        : Selected(-1), Edits(0), ForgottenBakes(0), scene(scene), bvh(bvh)
+    {
+    }
+
+    static PrefabView Furniture(Furniture_Kind kind)
+    {
+        switch (kind)
+        {
+            case FURNITURE_TABLE:
+                return ViewPrefab(TABLE);
+            case FURNITURE_BED:
+                return ViewPrefab(BED);
+            default:
+                return ViewPrefab(CHAIR);
+        }
+    }
+
+    // places furniture while the room is built, before the BVH is; returns the node
+    unsigned int Build(Furniture_Kind kind, const glm::mat4& placement)
+    {
+        unsigned int node = AddPrefab(scene, Furniture(kind), placement);
+        track(node, kind);
+        return node;
+    }
+
+    bool Editable(int node) const
+    {
+        return node >= 0 && node < static_cast<int>(nodeKind.size()) && nodeKind[node] != FURNITURE_NONE && !scene.NodeRemoved[node];
+    }
+
+    // selects the furniture a part belongs to; false, with nothing selected, for the room's fixed parts
+    bool Select(int part)
+    {
+        Selected = part >= 0 && Editable(static_cast<int>(scene.PartNode[part])) ? static_cast<int>(scene.PartNode[part]) : -1;
+        return Selected >= 0;
+    }
+
+    const char* SelectedName() const
+    {
+        return Selected >= 0 ? FURNITURE_NAMES[nodeKind[Selected]] : "nothing";
+    }
+
+    // slides furniture along the floor
+    void Move(unsigned int node, const glm::vec3& delta)
+    {
+        glm::mat4 identityMatrix = glm::mat4(1.0f);
+        place(node, glm::translate(identityMatrix, glm::vec3(delta.x, delta.y, 0.0f)) * scene.NodeBase[node]);
+    }
+
+    // turns furniture about the vertical through its origin
+    void Rotate(unsigned int node, float degrees)
+    {
+        glm::mat4 identityMatrix = glm::mat4(1.0f);
+        place(node, scene.NodeBase[node] * glm::rotate(identityMatrix, glm::radians(degrees), glm::vec3(0.0f, 0.0f, 1.0f)));
+    }
+
+    // adds furniture at placement and selects it; returns its node
+    unsigned int Add(Furniture_Kind kind, const glm::mat4& placement)
+    {
+        unsigned int node;
+        if (!freeNodes[kind].empty())
+        {
+            node = freeNodes[kind].back();
+            freeNodes[kind].pop_back();
+            place(node, placement);
+        }
+        else
+        {
+            node = AddPrefab(scene, Furniture(kind), placement);
+            track(node, kind);
+            unsigned int end = scene.NodeFirstPart[node] + scene.NodePartCount[node];
+            for (unsigned int part = scene.NodeFirstPart[node]; part < end; part++)
+                bvh.Insert(scene.PartBounds[part]);
+            forgetLight(nodeBounds(node, scene.NodeWorld[node]));
+            // downstream caches learn about the parts from the dirty list
+            scene.MarkNodeDirty(node);
+            Edits++;
+        }
+        Selected = static_cast<int>(node);
+        return node;
+    }
+
+    // takes furniture out of the room; its node waits for the next Add of its kind
+    void Remove(unsigned int node)
+    {
+        if (!Editable(static_cast<int>(node)))
+            return;
+        forgetLight(nodeBounds(node, scene.NodeWorld[node]));
+        scene.RemoveNode(node);
+        freeNodes[nodeKind[node]].push_back(node);
+        if (Selected == static_cast<int>(node))
+            Selected = -1;
+        Edits++;
+    }
+
+private:
+    Scene& scene;
+    BVH& bvh;
+    std::vector<unsigned int> nodeKind;     // per scene node: Furniture_Kind or FURNITURE_NONE
+    std::vector<glm::vec3> nodeAnchor;      // per scene node: origin when its parts entered the BVH
+    std::vector<unsigned int> freeNodes[FURNITURE_KIND_COUNT];
+    std::vector<unsigned int> nearby;
+
+    void track(unsigned int node, Furniture_Kind kind)
+    {
+        if (nodeKind.size() < scene.NodeCount())
+        {
+            nodeKind.resize(scene.NodeCount(), FURNITURE_NONE);
+            nodeAnchor.resize(scene.NodeCount());
+        }
+        nodeKind[node] = kind;
+        nodeAnchor[node] = glm::vec3(scene.NodeBase[node][3]);
+    }
+
+    // world bounds the node's parts have under the world matrix
+    AABB nodeBounds(unsigned int node, const glm::mat4& world) const
+    {
+        AABB bounds;
+        unsigned int end = scene.NodeFirstPart[node] + scene.NodePartCount[node];
+        for (unsigned int part = scene.NodeFirstPart[node]; part < end; part++)
+            bounds.Expand(TransformedCubeBounds(world * scene.PartLocal[part]));
+        return bounds;
+    }
+
+    void place(unsigned int node, const glm::mat4& base)
+    {
+        bool removed = scene.NodeRemoved[node] != 0;
+        AABB touched = removed ? AABB() : nodeBounds(node, scene.NodeWorld[node]);
+        scene.PlaceNode(node, base);
+        glm::mat4 world = scene.NodeTransform(node);
+        touched.Expand(nodeBounds(node, world));
+        forgetLight(touched);
+        if (removed || glm::length(glm::vec3(base[3]) - nodeAnchor[node]) > LAYOUT_REINSERT_DISTANCE)
+        {
+            unsigned int end = scene.NodeFirstPart[node] + scene.NodePartCount[node];
+            for (unsigned int part = scene.NodeFirstPart[node]; part < end; part++)
+                bvh.Reinsert(part, TransformedCubeBounds(world * scene.PartLocal[part]));
+            nodeAnchor[node] = glm::vec3(base[3]);
+        }
+        Edits++;
+    }
+
+    // parts around region lose their bake; their nodes are marked dirty so the patched
+    // instance data carries the change
+    void forgetLight(const AABB& region)
+    {
+        if (region.Empty())
+            return;
+        nearby.clear();
+        bvh.QueryAABB(AABB(region.Min - glm::vec3(LAYOUT_LIGHT_REACH), region.Max + glm::vec3(LAYOUT_LIGHT_REACH)), nearby);
+        for (unsigned int part : nearby)
+        {
+            if (scene.PartLightmap[part] == LIGHTMAP_NONE)
+                continue;
+            scene.PartLightmap[part] = LIGHTMAP_NONE;
+            scene.MarkNodeDirty(scene.PartNode[part]);
+            ForgottenBakes++;
+        }
+    }
+};
+
+#endif
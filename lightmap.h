@@ -0,0 +1,464 @@
+//
+//  lightmap.h
+//  3D Object Drawing
+//
+//  Baked lighting for the static part of the room. LightmapBaker gives every face
+//  of every static part a rectangle of texels in one atlas and path traces the
+//  irradiance arriving at each texel: sun and sky come in through the window
+//  openings and bounce off the walls and furniture, with rays traced against a BVH
+//  of the static parts' boxes. Texels are independent, so a refinement pass is a
+//  ParallelFor over all of them and scales with the cores; every pass adds samples
+//  to running sums, and the current estimate can be saved after any pass.
+//
+//  Lightmap loads a saved bake, uploads the atlas and a texture buffer with each
+//  face's rectangle, and tags the baked parts in the Scene; the scene shader then
+//  replaces their lighting with a single atlas fetch.
+//
+
+#ifndef LIGHTMAP_H
+#define LIGHTMAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "bvh.h"
+#include "materials.h"
+#include "scene.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// texel density of the atlas and the largest rectangle side a face may get
+const float LIGHTMAP_TEXELS_PER_UNIT = 10.0f;
+const int LIGHTMAP_MAX_FACE_TEXELS = 128;
+const int LIGHTMAP_ATLAS_WIDTH = 1024;
+const int LIGHTMAP_PADDING = 1;         // texels between rectangles
+
+// path length limit; paths longer than LIGHTMAP_ROULETTE_BOUNCE continue with the surface's albedo as probability
+const int LIGHTMAP_MAX_BOUNCES = 5;
+const int LIGHTMAP_ROULETTE_BOUNCE = 2;
+
+// keeps rays from hitting the surface they start on
+const float LIGHTMAP_RAY_OFFSET = 1.0e-3f;
+
+const char LIGHTMAP_FILE_MAGIC[4] = { 'L', 'M', 'A', 'P' };
+const unsigned int LIGHTMAP_FILE_VERSION = 1;
+
+// texel rectangle of one cube face in the atlas. Faces are numbered axis * 2 + (positive ? 1 : 0);
+// the rectangle's x runs along local axis (axis + 1) % 3, its y along (axis + 2) % 3
+struct LightmapRect
+{
+    int X, Y, Width, Height;
+};
+
+class LightmapBaker
+{
+public:
+    glm::vec3 SkyColor;         // radiance of rays leaving through a window above the horizon
+    glm::vec3 GroundColor;      // and below it
+    glm::vec3 SunDirection;     // direction the sunlight travels
+    glm::vec3 SunColor;         // irradiance / pi on a surface facing the sun
+
+    int AtlasWidth, AtlasHeight;
+    unsigned int Passes, SamplesPerTexel;
+    std::vector<unsigned int> PartSlot;     // per scene part: slot of its six rectangles, LIGHTMAP_NONE if not baked
+    std::vector<LightmapRect> Rects;        // six per slot
+
+    // bakes the parts whose partStatic entry is non-zero; they alone occlude and bounce light
+    LightmapBaker(const Scene& scene, const std::vector<unsigned char>& partStatic, const MaterialTable& materials)
+        : SkyColor(0.75f, 0.85f, 1.1f), GroundColor(0.3f, 0.28f, 0.22f),
+          SunDirection(glm::normalize(glm::vec3(0.35f, -0.75f, -0.55f))), SunColor(4.0f, 3.7f, 3.2f),
+          AtlasWidth(LIGHTMAP_ATLAS_WIDTH), AtlasHeight(0), Passes(0), SamplesPerTexel(0)
+    {
+        PartSlot.assign(scene.PartCount(), LIGHTMAP_NONE);
+        std::vector<AABB> bounds;
+        for (unsigned int part = 0; part < scene.PartCount(); part++)
+        {
+            if (!partStatic[part])
+                continue;
+            PartSlot[part] = static_cast<unsigned int>(bounds.size());
+            bounds.push_back(scene.PartBounds[part]);
+            glm::vec4 color = materials.Materials[scene.PartMaterial[part]].Color;
+            albedo.push_back(glm::vec3(color));
+        }
+        bvh.Build(bounds.data(), static_cast<unsigned int>(bounds.size()));
+
+        layout(scene);
+        sum.assign(texels.size(), glm::vec3(0.0f));
+        count.assign(texels.size(), 0);
+    }
+
+    size_t TexelCount() const { return texels.size(); }
+
+    // adds samples paths per texel
+    void Refine(ThreadPool& pool, unsigned int samples)
+    {
+        unsigned int pass = Passes;
+        pool.ParallelFor(texels.size(), 64, [this, samples, pass](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+            {
+                unsigned int state = hash(static_cast<unsigned int>(i) * 9781u + pass * 6271u + 1u);
+                for (unsigned int s = 0; s < samples; s++)
+                {
+                    glm::vec3 irradiance;
+                    if (sample(texels[i], state, irradiance))
+                    {
+                        sum[i] += irradiance;
+                        count[i]++;
+                    }
+                }
+            }
+        });
+        Passes++;
+        SamplesPerTexel += samples;
+    }
+
+    // writes the current estimate; texels buried inside other parts take their neighbours' light
+    bool Save(const char* path) const
+    {
+        std::vector<float> atlas(static_cast<size_t>(AtlasWidth) * AtlasHeight * 3, 0.0f);
+        std::vector<unsigned char> valid(static_cast<size_t>(AtlasWidth) * AtlasHeight, 0);
+        for (size_t i = 0; i < texels.size(); i++)
+        {
+            if (count[i] == 0)
+                continue;
+            glm::vec3 value = sum[i] / static_cast<float>(count[i]);
+            memcpy(&atlas[texels[i].Atlas * 3], &value[0], sizeof(float) * 3);
+            valid[texels[i].Atlas] = 1;
+        }
+        dilate(atlas, valid);
+
+        FILE* file = fopen(path, "wb");
+        if (file == NULL)
+            return false;
+        unsigned int partCount = static_cast<unsigned int>(PartSlot.size());
+        unsigned int rectCount = static_cast<unsigned int>(Rects.size());
+        fwrite(LIGHTMAP_FILE_MAGIC, 1, 4, file);
+        fwrite(&LIGHTMAP_FILE_VERSION, sizeof(unsigned int), 1, file);
+        fwrite(&partCount, sizeof(unsigned int), 1, file);
+        fwrite(&rectCount, sizeof(unsigned int), 1, file);
+        fwrite(&AtlasWidth, sizeof(int), 1, file);
+        fwrite(&AtlasHeight, sizeof(int), 1, file);
+        fwrite(PartSlot.data(), sizeof(unsigned int), partCount, file);
+        fwrite(Rects.data(), sizeof(LightmapRect), rectCount, file);
+        fwrite(atlas.data(), sizeof(float), atlas.size(), file);
+        bool ok = ferror(file) == 0;
+        fclose(file);
+        return ok;
+    }
+
+private:
+    struct Texel
+    {
+        glm::vec3 Position;
+        glm::vec3 Normal;
+        size_t Atlas;           // y * AtlasWidth + x
+    };
+
+    BVH bvh;                            // objects are slots
+    std::vector<glm::vec3> albedo;      // per slot
+    std::vector<Texel> texels;
+    std::vector<glm::vec3> sum;
+    std::vector<unsigned int> count;    // samples that started outside every other part
+
+    // gives every face of every slot a rectangle (shelf packed, tallest first) and creates its texels
+    void layout(const Scene& scene)
+    {
+        std::vector<unsigned int> slotPart(albedo.size());
+        for (unsigned int part = 0; part < PartSlot.size(); part++)
+            if (PartSlot[part] != LIGHTMAP_NONE)
+                slotPart[PartSlot[part]] = part;
+
+        Rects.resize(albedo.size() * 6);
+        std::vector<unsigned int> order(Rects.size());
+        for (unsigned int rect = 0; rect < Rects.size(); rect++)
+        {
+            const glm::mat4& model = scene.PartModel[slotPart[rect / 6]];
+            int axis = (rect % 6) / 2;
+            Rects[rect].Width = texelsAlong(model, (axis + 1) % 3);
+            Rects[rect].Height = texelsAlong(model, (axis + 2) % 3);
+            order[rect] = rect;
+        }
+        std::sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b) { return Rects[a].Height > Rects[b].Height; });
+
+        int x = 0, y = 0, shelfHeight = 0;
+        for (unsigned int rect : order)
+        {
+            LightmapRect& r = Rects[rect];
+            if (x + r.Width + LIGHTMAP_PADDING > AtlasWidth)
+            {
+                x = 0;
+                y += shelfHeight + LIGHTMAP_PADDING;
+                shelfHeight = 0;
+            }
+            r.X = x;
+            r.Y = y;
+            x += r.Width + LIGHTMAP_PADDING;
+            shelfHeight = std::max(shelfHeight, r.Height);
+        }
+        AtlasHeight = (y + shelfHeight + 3) & ~3;
+
+        for (unsigned int rect = 0; rect < Rects.size(); rect++)
+        {
+            const glm::mat4& model = scene.PartModel[slotPart[rect / 6]];
+            int axis = (rect % 6) / 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+            float side = rect % 2 ? 1.0f : -1.0f;
+            glm::vec3 localNormal(0.0f);
+            localNormal[axis] = side;
+            glm::vec3 normal = glm::normalize(glm::transpose(glm::inverse(glm::mat3(model))) * localNormal);
+
+            const LightmapRect& r = Rects[rect];
+            for (int j = 0; j < r.Height; j++)
+            {
+                for (int i = 0; i < r.Width; i++)
+                {
+                    // texel centers on the unit cube's face (half extent 0.25)
+                    glm::vec3 local(0.0f);
+                    local[axis] = 0.25f * side;
+                    local[u] = ((i + 0.5f) / r.Width - 0.5f) * 0.5f;
+                    local[v] = ((j + 0.5f) / r.Height - 0.5f) * 0.5f;
+                    Texel texel;
+                    texel.Position = glm::vec3(model * glm::vec4(local, 1.0f));
+                    texel.Normal = normal;
+                    texel.Atlas = static_cast<size_t>(r.Y + j) * AtlasWidth + r.X + i;
+                    texels.push_back(texel);
+                }
+            }
+        }
+    }
+
+    static int texelsAlong(const glm::mat4& model, int axis)
+    {
+        float length = 0.5f * glm::length(glm::vec3(model[axis]));
+        return std::min(std::max(static_cast<int>(std::ceil(length * LIGHTMAP_TEXELS_PER_UNIT)), 1), LIGHTMAP_MAX_FACE_TEXELS);
+    }
+
+    // one path from the texel; false when the texel point is buried inside another part
+    bool sample(const Texel& texel, unsigned int& state, glm::vec3& irradiance) const
+    {
+        glm::vec3 position = texel.Position + texel.Normal * LIGHTMAP_RAY_OFFSET;
+        glm::vec3 normal = texel.Normal;
+        glm::vec3 throughput(1.0f);
+        irradiance = glm::vec3(0.0f);
+
+        for (int bounce = 0; bounce < LIGHTMAP_MAX_BOUNCES; bounce++)
+        {
+            // the sun is a point on the sky: sample it directly at every vertex
+            float sunCosine = glm::dot(normal, -SunDirection);
+            if (sunCosine > 0.0f && !occluded(position, -SunDirection))
+                irradiance += throughput * SunColor * sunCosine;
+
+            glm::vec3 direction = cosineDirection(normal, random(state), random(state));
+            RayHit hit;
+            if (!bvh.RayCast(position, direction, 1.0e4f, hit))
+            {
+                irradiance += throughput * (direction.z >= 0.0f ? SkyColor : GroundColor);
+                break;
+            }
+            if (hit.Distance <= 0.0f)
+                return bounce > 0;
+
+            glm::vec3 surfaceAlbedo = albedo[hit.Object];
+            glm::vec3 point = position + direction * hit.Distance;
+            normal = boxNormal(bvh.Bounds[hit.Object], point);
+            position = point + normal * LIGHTMAP_RAY_OFFSET;
+            throughput *= surfaceAlbedo;
+            if (bounce >= LIGHTMAP_ROULETTE_BOUNCE)
+            {
+                float keep = std::max(surfaceAlbedo.x, std::max(surfaceAlbedo.y, surfaceAlbedo.z));
+                if (random(state) >= keep)
+                    break;
+                throughput /= keep;
+            }
+        }
+        return true;
+    }
+
+    bool occluded(const glm::vec3& origin, const glm::vec3& direction) const
+    {
+        RayHit hit;
+        return bvh.RayCast(origin, direction, 1.0e4f, hit);
+    }
+
+    // outward normal of the box face closest to a point on its surface
+    static glm::vec3 boxNormal(const AABB& box, const glm::vec3& point)
+    {
+        glm::vec3 normal(0.0f);
+        float best = 1.0e30f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float toMin = std::fabs(point[axis] - box.Min[axis]), toMax = std::fabs(point[axis] - box.Max[axis]);
+            if (toMin < best)
+            {
+                best = toMin;
+                normal = glm::vec3(0.0f);
+                normal[axis] = -1.0f;
+            }
+            if (toMax < best)
+            {
+                best = toMax;
+                normal = glm::vec3(0.0f);
+                normal[axis] = 1.0f;
+            }
+        }
+        return normal;
+    }
+
+    static glm::vec3 cosineDirection(const glm::vec3& normal, float u1, float u2)
+    {
+        float radius = std::sqrt(u1), angle = 6.2831853f * u2;
+        glm::vec3 tangent = std::fabs(normal.x) > 0.5f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        tangent = glm::normalize(glm::cross(tangent, normal));
+        glm::vec3 bitangent = glm::cross(normal, tangent);
+        return tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle)) + normal * std::sqrt(std::max(0.0f, 1.0f - u1));
+    }
+
+    static unsigned int hash(unsigned int x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    static float random(unsigned int& state)
+    {
+        state = state * 747796405u + 2891336453u;
+        unsigned int word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return static_cast<float>((word >> 22u) ^ word) * (1.0f / 4294967296.0f);
+    }
+
+    // fills invalid texels from valid neighbours, a few rings deep
+    void dilate(std::vector<float>& atlas, std::vector<unsigned char>& valid) const
+    {
+        for (int ring = 0; ring < 4; ring++)
+        {
+            std::vector<unsigned char> filled = valid;
+            for (const LightmapRect& r : Rects)
+            {
+                for (int y = r.Y; y < r.Y + r.Height; y++)
+                {
+                    for (int x = r.X; x < r.X + r.Width; x++)
+                    {
+                        size_t at = static_cast<size_t>(y) * AtlasWidth + x;
+                        if (valid[at])
+                            continue;
+                        glm::vec3 total(0.0f);
+                        int neighbours = 0;
+                        const int dx[4] = { -1, 1, 0, 0 }, dy[4] = { 0, 0, -1, 1 };
+                        for (int n = 0; n < 4; n++)
+                        {
+                            int nx = x + dx[n], ny = y + dy[n];
+                            if (nx < r.X || ny < r.Y || nx >= r.X + r.Width || ny >= r.Y + r.Height)
+                                continue;
+                            size_t other = static_cast<size_t>(ny) * AtlasWidth + nx;
+                            if (!valid[other])
+                                continue;
+                            total += glm::vec3(atlas[other * 3], atlas[other * 3 + 1], atlas[other * 3 + 2]);
+                            neighbours++;
+                        }
+                        if (neighbours == 0)
+                            continue;
+                        total /= static_cast<float>(neighbours);
+                        memcpy(&atlas[at * 3], &total[0], sizeof(float) * 3);
+                        filled[at] = 1;
+                    }
+                }
+            }
+            valid.swap(filled);
+        }
+    }
+};
+
+class Lightmap
+{
+public:
+    unsigned int AtlasTexture, RectBuffer, RectTexture;
+    int AtlasWidth, AtlasHeight;
+
+    Lightmap() : AtlasTexture(0), RectBuffer(0), RectTexture(0), AtlasWidth(0), AtlasHeight(0) {}
+
+    // loads a bake made for this scene and tags its parts; false (and nothing changed) when the
+    // file is missing or was baked for another room
+    bool Load(const char* path, Scene& scene)
+    {
+        FILE* file = fopen(path, "rb");
+        if (file == NULL)
+            return false;
+        char magic[4];
+        unsigned int version = 0, partCount = 0, rectCount = 0;
+        bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, LIGHTMAP_FILE_MAGIC, 4) == 0 &&
+                  fread(&version, sizeof(unsigned int), 1, file) == 1 && version == LIGHTMAP_FILE_VERSION &&
+                  fread(&partCount, sizeof(unsigned int), 1, file) == 1 && partCount == scene.PartCount() &&
+                  fread(&rectCount, sizeof(unsigned int), 1, file) == 1 &&
+                  fread(&AtlasWidth, sizeof(int), 1, file) == 1 && fread(&AtlasHeight, sizeof(int), 1, file) == 1 &&
+                  AtlasWidth > 0 && AtlasHeight > 0;
+        std::vector<unsigned int> partSlot(ok ? partCount : 0);
+        std::vector<LightmapRect> rects(ok ? rectCount : 0);
+        std::vector<float> atlas(ok ? static_cast<size_t>(AtlasWidth) * AtlasHeight * 3 : 0);
+        ok = ok && fread(partSlot.data(), sizeof(unsigned int), partCount, file) == partCount &&
+             fread(rects.data(), sizeof(LightmapRect), rectCount, file) == rectCount &&
+             fread(atlas.data(), sizeof(float), atlas.size(), file) == atlas.size();
+        fclose(file);
+        if (!ok)
+        {
+            std::cout << "ERROR::LIGHTMAP::INVALID_FILE " << path << std::endl;
+            return false;
+        }
+
+        // rectangles as (x, y, width, height) in texels for the shader
+        std::vector<glm::vec4> rectTexels(rects.size());
+        for (size_t i = 0; i < rects.size(); i++)
+            rectTexels[i] = glm::vec4(rects[i].X, rects[i].Y, rects[i].Width, rects[i].Height);
+
+        glGenTextures(1, &AtlasTexture);
+        glBindTexture(GL_TEXTURE_2D, AtlasTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, AtlasWidth, AtlasHeight, 0, GL_RGB, GL_FLOAT, atlas.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenBuffers(1, &RectBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, RectBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * std::max<size_t>(rectTexels.size(), 1), rectTexels.data(), GL_STATIC_DRAW);
+        glGenTextures(1, &RectTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, RectTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, RectBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        for (unsigned int part = 0; part < partCount; part++)
+            scene.PartLightmap[part] = partSlot[part];
+        return true;
+    }
+
+    bool Loaded() const { return AtlasTexture != 0; }
+
+    void Bind(int atlasUnit, int rectUnit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + atlasUnit);
+        glBindTexture(GL_TEXTURE_2D, AtlasTexture);
+        glActiveTexture(GL_TEXTURE0 + rectUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, RectTexture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void Release()
+    {
+        glDeleteTextures(1, &AtlasTexture);
+        glDeleteTextures(1, &RectTexture);
+        glDeleteBuffers(1, &RectBuffer);
+        AtlasTexture = RectTexture = RectBuffer = 0;
+    }
+};
+
+#endif
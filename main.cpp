@@ -15,19 +15,70 @@
 #include "shader.h"
 #include "camera.h"
 #include "basic_camera.h"
-
+#include "dynamic_resolution.h"
+#include "thread_pool.h"
+#include "scene.h"
+#include "animation.h"
+#include "bvh.h"
+#include "benchmarks.h"
+#include "allocators.h"
+#include "gl_capture.h"
+#include "input_session.h"
+#include "materials.h"
+#include "scene_renderer.h"
+#include "multi_view.h"
+#include "redraw_tracker.h"
+#include "gpu_culling.h"
+#include "world_streaming.h"
+#include "frame_export.h"
+#include "overdraw_meter.h"
+#include "lightmap.h"
+#include "reflection_probes.h"
+#include "texture_streaming.h"
+#include "prefabs.h"
+#include "telemetry.h"
+#include "batch_renderer.h"
+#include "gpu_memory.h"
+#include "particles.h"
+#include "cloth.h"
+#include "layout_editor.h"
+#include "frame_pacing.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <vector>
 
 using namespace std;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void window_refresh_callback(GLFWwindow* window);
 void processInput(GLFWwindow* window);
+void dispatchInputEvent(GLFWwindow* window, const InputEvent& event);
+void buildRoom(Scene& scene, AnimationSystem& animation, std::vector<unsigned int>& fanRotators, LayoutEditor* layout = NULL);
+void editLayout(GLFWwindow* window, LayoutEditor& layout, const BVH& bvh);
+void collideCamera(const BVH& bvh, const glm::vec3& previousPosition);
+void pickObject(const BVH& bvh, const Scene& scene);
+void setMonitorViews(MultiView& multiView, const AABB& room);
+void createRoomMaterials(MaterialTable& materials);
+void buildChunk(const glm::ivec2& chunk, const glm::vec2& origin, ChunkData& data);
+unsigned int createCubeVertexArray(const GpuBlock& vertices, const GpuBlock& indices);
+int bakeRoomLightmap(unsigned int samplesPerTexel);
+int renderImageBatch(const char* cameraPath, const char* outputPattern, int width, int height, unsigned int contextCount);
 
 // settings
 const unsigned int SCR_WIDTH = 1200;
 const unsigned int SCR_HEIGHT = 800;
+const float TARGET_FRAME_MS = 16.6f;     // GPU time budget the dynamic resolution aims for
+
+// actual framebuffer size (differs from SCR_WIDTH/SCR_HEIGHT after resizing or on retina displays)
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
 
 // modelling transform
 float rotateAngle_X = 0.0;
@@ -43,7 +94,7 @@ float scale_X = 1.0;
 float scale_Y = 1.0;
 float scale_Z = 1.0;
 bool fan_on = false;
-float fan_rotateAngle_Y = 0.0;
+const float FAN_SPEED = -12.0f;     // degrees per second
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -51,23 +102,307 @@ float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
+// collision and picking
+bool camera_collision = true;
+const float CAMERA_RADIUS = 0.2f;
+bool pickRequested = false;
+int pickedPart = -1;
+std::vector<unsigned int> queryResults;
+
+// layout editing: clicking furniture selects it, the arrow keys slide it along the floor relative
+// to the view, Q/E turn it, Delete removes it and 1/2/3 add a chair/table/bed where the view hits
+const float EDIT_MOVE_SPEED = 1.5f;         // units per second
+const float EDIT_TURN_SPEED = 90.0f;        // degrees per second
+const float EDIT_PLACE_DISTANCE = 3.0f;     // furthest floor point new furniture goes to
+const int EDIT_ADD_KEYS[FURNITURE_KIND_COUNT] = { GLFW_KEY_1, GLFW_KEY_2, GLFW_KEY_3 };
+bool editKeysHeld[FURNITURE_KIND_COUNT + 1] = { false };   // add keys and Delete act once per press
+
 float eyeX = 0.0, eyeY = 1.0, eyeZ = 3.0;
 float lookAtX = 0.0, lookAtY = 0.0, lookAtZ = 0.0;
 glm::vec3 V = glm::vec3(0.0f, 1.0f, 0.0f);
 //BasicCamera basic_camera(eyeX, eyeY, eyeZ, lookAtX, lookAtY, lookAtZ, V);
 
+// the unit cube (half extent 0.25, position and color) every part of the room is drawn from
+const float cube_vertices[] = {
+    0.25f, 0.25f, -0.25f, 0.3f, 0.8f, 0.5f,
+    -0.25f, 0.25f, -0.25f, 0.5f, 0.4f, 0.3f,
+    -0.25f, -0.25f, -0.25f, 0.2f, 0.7f, 0.3f,
+    0.25f, -0.25f, -0.25f, 0.6f, 0.2f, 0.8f,
+    0.25f, 0.25f, 0.25f, 0.8f, 0.3f, 0.6f,
+    -0.25f, 0.25f, 0.25f, 0.4f, 0.4f, 0.8f,
+    -0.25f, -0.25f, 0.25f, 0.2f, 0.3f, 0.6f,
+    0.25f, -0.25f, 0.25f, 0.7f, 0.5f, 0.4f
+};
+const unsigned int cube_indices[] = {
+    0, 3, 2,
+    2, 1, 0,
+
+    1, 2, 6,
+    6, 5, 1,
+
+    5, 6, 7,
+    7 ,4, 5,
+
+    4, 7, 3,
+    3, 0, 4,
+
+    6, 2, 3,
+    3, 7, 6,
+
+    1, 5, 4,
+    4, 0, 1
+};
+
+// multi-view: --views <n> splits the window between the player camera and up to three
+// fixed monitoring cameras in the room's upper corners
+int viewCount = 1;
+const float MONITOR_FOV = 70.0f;
+
+// on-demand rendering: frames without changes are not rendered and the loop sleeps until
+// input arrives; --continuous renders every frame like before
+bool continuousRendering = false;
+bool windowDamaged = false;     // the window system lost the presented image
+
+// latency: with vsync, frames start as late as their render time allows before the vblank
+// (FramePacer), so the input they read is that much newer; --unpaced starts every frame right
+// after the previous swap
+bool unpaced = false;
+const double DEFAULT_REFRESH_MS = 1000.0 / 60.0;     // when the monitor does not report its rate
+
+// GPU-driven culling: --gpu-culling asks for a GL 4.5 context and lets a compute shader
+// cull the room and write the draw commands (falls back to CPU culling below GL 4.3)
+bool gpuCullingRequested = false;
+
+// world streaming: --stream-building [budget MB] surrounds the room with an endless building
+// of generated rooms, streamed in around the camera within the memory budget
+float streamBudgetMB = 0.0f;
+const glm::vec2 BUILDING_CELL = glm::vec2(10.0f, 7.0f);    // footprint of one room (and chunk)
+const float STREAM_LOAD_RADIUS = 45.0f;
+
+// frame export: --export <path> [fps] [width height] renders every frame with a fixed time
+// step of 1/fps and writes it out (.y4m or "-" for Y4M video, a %d pattern for PPM images,
+// anything else raw RGBA); width and height set the window size, e.g. 3840 2160
+const char* exportPath = NULL;
+int exportFramesPerSecond = 60;
+int exportWidth = 0;
+int exportHeight = 0;
+
+// overdraw: the room is drawn front to back; --depth-prepass lays the large occluders into
+// depth before shading, --overdraw [unsorted|sorted|prepass] shows a heat map of the shaded
+// fragments per pixel with that ordering and reports the average overdraw on exit
+bool depthPrepass = false;
+bool frontToBack = true;
+bool overdrawView = false;
+
+// batch rendering: --render-batch <cameras> <output pattern> [width height] [contexts] renders
+// the room from every camera in the file (lines of "x y z  target x y z  [fov]") offscreen on
+// one GL context per core and writes PPM images named by the pattern, e.g. frames/%06d.ppm
+const float BATCH_DEFAULT_FOV = 45.0f;
+
+// baked lighting: --bake-lightmap [samples per texel] path traces the static room's lighting
+// into LIGHTMAP_PATH without opening a window; later runs load it when it matches the room
+const char* LIGHTMAP_PATH = "room.lightmap";
+const unsigned int LIGHTMAP_PASS_SAMPLES = 16;
+
+// reflections: the room's probe is captured from ROOM_PROBE_POSITION over the room's volume
+// at load; afterwards faces that see something change are re-rendered, a few per frame
+const glm::vec3 ROOM_PROBE_POSITION = glm::vec3(0.0f, 0.0f, 1.5f);
+const glm::vec3 ROOM_PROBE_MIN = glm::vec3(-5.0f, -3.5f, 0.0f);
+const glm::vec3 ROOM_PROBE_MAX = glm::vec3(5.0f, 3.5f, 5.0f);
+const unsigned int REFLECTION_FACES_PER_FRAME = 2;
+
+// texture streaming: --build-textures writes the material layers' full mip chains at
+// TEXSTREAM_TOP_SIZE into TEXTURE_PACK_PATH without opening a window; later runs stream
+// them from it within textureBudgetMB of video memory (--texture-budget <MB>)
+const char* TEXTURE_PACK_PATH = "room.textures";
+float textureBudgetMB = 8.0f;
+
+// telemetry: the live counters are always published in the TELEMETRY_SHARED_NAME shared
+// memory block; --telemetry <port> also serves them as Prometheus text on 127.0.0.1, and
+// --read-telemetry prints the block of a running instance
+int telemetryPort = 0;
+const double TELEMETRY_GPU_MEMORY_INTERVAL = 1.0;     // seconds between video memory queries
+double inputEventTime = 0.0;    // arrival of the first input event not yet shown, 0 if none
+
+// dust: --particles [count] fills the room with dust the fans blow around, bright where the
+// sunlight falls through the windows; --bench-particles [count] times the update alone
+unsigned int particleCount = 0;
+const unsigned int PARTICLE_DEFAULT_COUNT = 1000000;
+const glm::vec3 PARTICLE_ROOM_MIN = glm::vec3(-4.95f, -3.45f, 0.02f);
+const glm::vec3 PARTICLE_ROOM_MAX = glm::vec3(4.95f, 3.45f, 4.95f);
+// the window openings of the front wall y = 3.5 (center x, z, half width, half height)
+const glm::vec4 SUNLIT_WINDOWS[] = { glm::vec4(2.75f, 2.5f, 1.75f, 1.0f), glm::vec4(-2.75f, 2.5f, 1.75f, 1.0f) };
+const float SUNLIT_WALL_Y = 3.5f;
+
+// curtains either side of both windows, hung just in front of the wall and blown by the fans;
+// --bench-cloth [count] [resolution] times the solver alone
+const unsigned int CURTAIN_COLUMNS = 16;
+const unsigned int CURTAIN_ROWS = 24;
+const float CURTAIN_LEFT_EDGES[] = { 0.85f, 3.65f, -1.85f, -4.65f };
+const float CURTAIN_WIDTH = 1.0f;
+const float CURTAIN_DROP = 2.4f;
+const float CURTAIN_TOP = 3.7f;
+const float CURTAIN_Y = 3.38f;
+
 // timing
 float deltaTime = 0.0f;    // time between current frame and last frame
 float lastFrame = 0.0f;
 
-int main()
+// allocation tracking: with --check-allocations the app renders a fixed number of
+// frames after warm-up and fails if the render thread allocated from the C++ heap in any
+// of them; other threads (telemetry server, thread pool jobs) are not counted
+const int ALLOCATION_WARMUP_FRAMES = 120;
+int allocationCheckFrames = 0;
+const size_t FRAME_ARENA_SIZE = 1 << 20;
+
+// GPU memory: meshes and instance streams are suballocated from one buffer per category;
+// freed ranges are compacted a bounded number of bytes per frame
+const size_t GPU_VERTEX_ARENA_BYTES = 1 << 20;
+const size_t GPU_INDEX_ARENA_BYTES = 256 << 10;
+const size_t GPU_INSTANCE_ARENA_BYTES = 4 << 20;
+const size_t GPU_DEFRAG_BYTES_PER_FRAME = 64 << 10;
+
+// GL capture: with --capture <first> <last> <file> the GL calls of frames first..last
+// (plus whatever is needed to recreate the objects they use) are written for replay
+int captureFirstFrame = -1;
+int captureLastFrame = -1;
+const char* capturePath = NULL;
+
+// input sessions: --record-input <file> logs the clock and all input, --replay-input <file>
+// plays it back with the recorded clock (and a fixed render resolution) for repeatable runs
+InputSession inputSession;
+const int INPUT_KEYS[] = { GLFW_KEY_ESCAPE, GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_F, GLFW_KEY_R,
+                           GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_LEFT, GLFW_KEY_RIGHT, GLFW_KEY_Q, GLFW_KEY_E,
+                           GLFW_KEY_1, GLFW_KEY_2, GLFW_KEY_3, GLFW_KEY_DELETE };
+const char* inputRecordPath = NULL;
+const char* inputReplayPath = NULL;
+
+// global allocation hook: counts every C++ heap allocation, per thread
+thread_local unsigned long long heapAllocationCount = 0;
+
+void* operator new(std::size_t size)
+{
+    heapAllocationCount++;
+    if (void* block = std::malloc(size ? size : 1))
+        return block;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept
+{
+    std::free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept
+{
+    std::free(block);
+}
+
+int main(int argc, char** argv)
 {
+    // command line: flags combine in any order, and each consumes the plain arguments that
+    // follow it up to the next flag; benchmarks and tools run without a window and exit
+    // -------------------------------------------------------------------------------------
+    for (int i = 1; i < argc; i++)
+    {
+        const char* flag = argv[i];
+        char** value = argv + i + 1;
+        int values = 0;
+        while (i + 1 + values < argc && strncmp(value[values], "--", 2) != 0)
+            values++;
+        i += values;
+
+        if (strcmp(flag, "--bench-bvh") == 0)
+        {
+            RunBVHBenchmark(values > 0 ? static_cast<unsigned int>(atoi(value[0])) : 100000u);
+            return 0;
+        }
+        else if (strcmp(flag, "--bench-particles") == 0)
+        {
+            RunParticleBenchmark(values > 0 ? static_cast<unsigned int>(atoi(value[0])) : PARTICLE_DEFAULT_COUNT);
+            return 0;
+        }
+        else if (strcmp(flag, "--bench-layout") == 0)
+        {
+            RunLayoutBenchmark(values > 0 ? static_cast<unsigned int>(atoi(value[0])) : 10000u);
+            return 0;
+        }
+        else if (strcmp(flag, "--bench-cloth") == 0)
+        {
+            RunClothBenchmark(values > 0 ? static_cast<unsigned int>(atoi(value[0])) : 0u, values > 1 ? static_cast<unsigned int>(atoi(value[1])) : 0u);
+            return 0;
+        }
+        else if (strcmp(flag, "--bake-lightmap") == 0)
+            return bakeRoomLightmap(values > 0 ? static_cast<unsigned int>(atoi(value[0])) : 256u);
+        else if (strcmp(flag, "--build-textures") == 0)
+            return TextureStreamer::Write(TEXTURE_PACK_PATH, MATERIAL_LAYER_COUNT) ? 0 : 1;
+        else if (strcmp(flag, "--render-batch") == 0 && values >= 2)
+            return renderImageBatch(value[0], value[1], values >= 4 ? atoi(value[2]) : 640, values >= 4 ? atoi(value[3]) : 480,
+                                    values >= 5 ? static_cast<unsigned int>(atoi(value[4])) : std::max(std::thread::hardware_concurrency(), 1u));
+        else if (strcmp(flag, "--read-telemetry") == 0)
+            return Telemetry::Dump(TELEMETRY_SHARED_NAME);
+        else if (strcmp(flag, "--telemetry") == 0 && values >= 1)
+            telemetryPort = atoi(value[0]);
+        else if (strcmp(flag, "--check-allocations") == 0)
+            allocationCheckFrames = values > 0 ? atoi(value[0]) : 600;
+        else if (strcmp(flag, "--capture") == 0 && values >= 3)
+        {
+            captureFirstFrame = atoi(value[0]);
+            captureLastFrame = atoi(value[1]);
+            capturePath = value[2];
+        }
+        else if (strcmp(flag, "--record-input") == 0 && values >= 1)
+            inputRecordPath = value[0];
+        else if (strcmp(flag, "--replay-input") == 0 && values >= 1)
+            inputReplayPath = value[0];
+        else if (strcmp(flag, "--views") == 0 && values >= 1)
+            viewCount = std::min(std::max(atoi(value[0]), 1), MULTIVIEW_MAX_VIEWS);
+        else if (strcmp(flag, "--continuous") == 0)
+            continuousRendering = true;
+        else if (strcmp(flag, "--unpaced") == 0)
+            unpaced = true;
+        else if (strcmp(flag, "--gpu-culling") == 0)
+            gpuCullingRequested = true;
+        else if (strcmp(flag, "--stream-building") == 0)
+            streamBudgetMB = values > 0 ? static_cast<float>(atof(value[0])) : 4.0f;
+        else if (strcmp(flag, "--texture-budget") == 0 && values >= 1)
+            textureBudgetMB = static_cast<float>(atof(value[0]));
+        else if (strcmp(flag, "--particles") == 0)
+            particleCount = values > 0 ? static_cast<unsigned int>(atoi(value[0])) : PARTICLE_DEFAULT_COUNT;
+        else if (strcmp(flag, "--depth-prepass") == 0)
+            depthPrepass = true;
+        else if (strcmp(flag, "--overdraw") == 0)
+        {
+            overdrawView = true;
+            frontToBack = !(values > 0 && strcmp(value[0], "unsorted") == 0);
+            depthPrepass = depthPrepass || (values > 0 && strcmp(value[0], "prepass") == 0);
+        }
+        else if (strcmp(flag, "--export") == 0 && values >= 1)
+        {
+            exportPath = value[0];
+            if (values >= 2)
+                exportFramesPerSecond = std::max(atoi(value[1]), 1);
+            if (values >= 4)
+            {
+                exportWidth = atoi(value[2]);
+                exportHeight = atoi(value[3]);
+            }
+        }
+        else
+        {
+            std::cout << "Ignoring unknown or incomplete option " << flag << std::endl;
+        }
+    }
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, gpuCullingRequested ? 4 : 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, gpuCullingRequested ? 5 : 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // an export keeps the size it started with
+    if (exportPath != NULL)
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -75,7 +410,16 @@ int main()
 
     // glfw window creation
     // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "CSE 4208: Computer Graphics Laboratory", NULL, NULL);
+    int windowWidth = exportWidth > 0 && exportHeight > 0 ? exportWidth : SCR_WIDTH;
+    int windowHeight = exportWidth > 0 && exportHeight > 0 ? exportHeight : SCR_HEIGHT;
+    GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, "CSE 4208: Computer Graphics Laboratory", NULL, NULL);
+    if (window == NULL && gpuCullingRequested)
+    {
+        std::cout << "No OpenGL 4.5 context, GPU culling disabled" << std::endl;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(windowWidth, windowHeight, "CSE 4208: Computer Graphics Laboratory", NULL, NULL);
+    }
     if (window == NULL)
     {
         std::cout << "Failed to create GLFW window" << std::endl;
@@ -83,13 +427,34 @@ int main()
         return -1;
     }
     glfwMakeContextCurrent(window);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
 
     // tell GLFW to capture our mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
+    inputSession.TrackKeys(INPUT_KEYS, sizeof(INPUT_KEYS) / sizeof(INPUT_KEYS[0]));
+    if (inputRecordPath != NULL && !inputSession.StartRecording(inputRecordPath, framebufferWidth, framebufferHeight))
+        std::cout << "Failed to open input recording " << inputRecordPath << std::endl;
+    if (inputReplayPath != NULL)
+    {
+        if (!inputSession.StartReplay(inputReplayPath))
+        {
+            std::cout << "Failed to load input recording " << inputReplayPath << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        // replays run unthrottled at the recorded framebuffer size
+        framebufferWidth = inputSession.RecordedWidth;
+        framebufferHeight = inputSession.RecordedHeight;
+        glfwSwapInterval(0);
+    }
+
     // glad: load all OpenGL function pointers
     // ---------------------------------------
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
@@ -98,26 +463,25 @@ int main()
         return -1;
     }
 
+    // hook GL before any object is created so the capture can rebuild them
+    if (capturePath != NULL && captureFirstFrame >= 0 && captureLastFrame >= captureFirstFrame)
+        GLCapture::Instance().Install(captureFirstFrame, captureLastFrame, capturePath, framebufferWidth, framebufferHeight);
+
     // configure global opengl state
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
 
+    // the scene is rendered into an offscreen target whose resolution follows the GPU frame time
+    DynamicResolution dynamicResolution(framebufferWidth, framebufferHeight, TARGET_FRAME_MS);
+    if (inputSession.Mode == INPUT_REPLAY || exportPath != NULL)
+        dynamicResolution.MinScale = dynamicResolution.MaxScale;
+
     // build and compile our shader zprogram
     // ------------------------------------
     Shader ourShader("vertexShader.vs", "fragmentShader.fs");
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
-    float cube_vertices[] = {
-        0.25f, 0.25f, -0.25f, 0.3f, 0.8f, 0.5f,
-        -0.25f, 0.25f, -0.25f, 0.5f, 0.4f, 0.3f,
-        -0.25f, -0.25f, -0.25f, 0.2f, 0.7f, 0.3f,
-        0.25f, -0.25f, -0.25f, 0.6f, 0.2f, 0.8f,
-        0.25f, 0.25f, 0.25f, 0.8f, 0.3f, 0.6f,
-        -0.25f, 0.25f, 0.25f, 0.4f, 0.4f, 0.8f,
-        -0.25f, -0.25f, 0.25f, 0.2f, 0.3f, 0.6f,
-        0.25f, -0.25f, 0.25f, 0.7f, 0.5f, 0.4f
-    };
     /*float cube_vertices[] = {
         0.0f, 0.0f, 0.0f,
         0.5f, 0.0f, 0.0f,
@@ -178,25 +542,6 @@ int main()
         20, 21, 22,
         22, 23, 20
     };*/
-    unsigned int cube_indices[] = {
-        0, 3, 2,
-        2, 1, 0,
-
-        1, 2, 6,
-        6, 5, 1,
-
-        5, 6, 7,
-        7 ,4, 5,
-
-        4, 7, 3,
-        3, 0, 4,
-
-        6, 2, 3,
-        3, 7, 6,
-
-        1, 5, 4,
-        4, 0, 1
-    };
     
     // world space positions of our cubes
     /*glm::vec3 cubePositions[] = {
@@ -229,49 +574,191 @@ int main()
     };
 
 
-    //axis line VBO,VAO
-    unsigned int axisVAO, axisVBO;
+    // vertex, index and instance data live in a few large buffers; blocks are freed by their owners
+    GpuMemory gpuMemory(GPU_VERTEX_ARENA_BYTES, GPU_INDEX_ARENA_BYTES, GPU_INSTANCE_ARENA_BYTES);
+
+    //axis line VBO,VAO; its offset is baked into the vertex array, so the block is pinned
+    GpuBlock axisVertexBlock = gpuMemory.Allocate(GPU_MEMORY_VERTEX, sizeof(axisVertices), "axis lines", false);
+    axisVertexBlock.Upload(axisVertices, sizeof(axisVertices));
+    unsigned int axisVAO;
     glGenVertexArrays(1, &axisVAO);
-    glGenBuffers(1, &axisVBO);
 
     // Bind the axis VAO and VBO
     glBindVertexArray(axisVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, axisVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(axisVertices), axisVertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, axisVertexBlock.Buffer());
 
     // Set up vertex attribute pointers
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)axisVertexBlock.Offset());
     glEnableVertexAttribArray(0);
     
 
     // Main
-    unsigned int VBO, VAO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+    GpuBlock cubeVertexBlock = gpuMemory.Allocate(GPU_MEMORY_VERTEX, sizeof(cube_vertices), "cube vertices", false);
+    GpuBlock cubeIndexBlock = gpuMemory.Allocate(GPU_MEMORY_INDEX, sizeof(cube_indices), "cube indices", false);
+    cubeVertexBlock.Upload(cube_vertices, sizeof(cube_vertices));
+    cubeIndexBlock.Upload(cube_indices, sizeof(cube_indices));
+    unsigned int VAO = createCubeVertexArray(cubeVertexBlock, cubeIndexBlock);
 
-    glBindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_STATIC_DRAW);
+    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
 
-    // position attribute
-   // glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    //glEnableVertexAttribArray(0);
+    // room parts are drawn instanced with per-instance materials
+    SceneRenderer sceneRenderer(gpuMemory.Arena(GPU_MEMORY_INSTANCE));
+    sceneRenderer.AttachInstances(VAO);
+    sceneRenderer.IndexOffset = cubeIndexBlock.Offset();
+    sceneRenderer.FrontToBack = frontToBack;
+    sceneRenderer.DepthPrepass = depthPrepass;
+    sceneRenderer.Overdraw = overdrawView;
+    OverdrawMeter overdrawMeter;
+    MaterialTable materials;
+    createRoomMaterials(materials);
+    materials.Upload();
+
+    // window glass and other transparent parts are blended order independently over the opaque target
+    TransparencyTarget transparency;
+    transparency.Attach(dynamicResolution.DepthRBO);
+    sceneRenderer.UseTransparency(&transparency);
+
+    // scene and animation
+    // -------------------
+    ThreadPool threadPool;
+    Scene scene;
+    AnimationSystem animation;
+    std::vector<unsigned int> fanRotators;
+    // spatial index over every part for camera collision, picking and layout edits; built below
+    BVH sceneBVH;
+    LayoutEditor layout(scene, sceneBVH);
+    buildRoom(scene, animation, fanRotators, &layout);
+    std::vector<unsigned int> transparentParts;
+    for (unsigned int part = 0; part < scene.PartCount(); part++)
+        if (materials.Transparent(scene.PartMaterial[part]))
+            transparentParts.push_back(part);
+
+    // static parts with a bake take their lighting from the lightmap
+    Lightmap lightmap;
+    if (lightmap.Load(LIGHTMAP_PATH, scene))
+        sceneRenderer.UseLightmap(&lightmap);
+
+    sceneBVH.Build(scene.PartBounds.data(), scene.PartCount());
+
+    // the material layers stream in at up to TEXSTREAM_TOP_SIZE once their pack is built
+    TextureStreamer textureStreamer(threadPool, static_cast<size_t>(textureBudgetMB * 1024.0f * 1024.0f));
+    if (textureStreamer.Open(TEXTURE_PACK_PATH))
+        sceneRenderer.UseTextureStreaming(&textureStreamer);
+
+    // glossy surfaces reflect the room's probe; the heat map leaves it out
+    ReflectionProbes reflectionProbes;
+    if (!overdrawView)
+    {
+        reflectionProbes.Add(ROOM_PROBE_POSITION, AABB(ROOM_PROBE_MIN, ROOM_PROBE_MAX));
+        reflectionProbes.Background = glm::vec4(0.2f, 0.3f, 0.3f, 1.0f);
+        reflectionProbes.Create(scene);
+        sceneRenderer.CaptureReflections(reflectionProbes, VAO, scene, sceneBVH, materials, reflectionProbes.FaceCount());
+        sceneRenderer.UseReflections(&reflectionProbes);
+    }
 
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    // GPU-driven path: its own cube vertex array reads the instances the culling shader writes
+    GpuCulling* gpuCulling = NULL;
+    unsigned int gpuVAO = 0;
+    if (gpuCullingRequested && GLAD_GL_VERSION_4_3)
+    {
+        gpuCulling = new GpuCulling();
+        gpuCulling->Upload(scene, materials, viewCount);
+        gpuVAO = createCubeVertexArray(cubeVertexBlock, cubeIndexBlock);
+        sceneRenderer.AttachInstances(gpuVAO, gpuCulling->InstanceBuffer);
+    }
+    else if (gpuCullingRequested)
+    {
+        std::cout << "GPU culling needs OpenGL 4.3, using CPU culling" << std::endl;
+    }
 
-    //color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-    glEnableVertexAttribArray(1);
+    // streamed building around the room; chunks are generated on the thread pool
+    WorldStreamer* streamer = NULL;
+    unsigned int streamVAO = 0;
+    if (streamBudgetMB > 0.0f)
+    {
+        streamer = new WorldStreamer(threadPool, buildChunk, BUILDING_CELL, static_cast<size_t>(streamBudgetMB * 1024.0f * 1024.0f), STREAM_LOAD_RADIUS);
+        streamVAO = createCubeVertexArray(cubeVertexBlock, cubeIndexBlock);
+        sceneRenderer.AttachInstances(streamVAO, streamer->InstanceBuffer());
+    }
 
+    // dust in the fans' airflow, simulated on the thread pool and drawn from a mapped buffer
+    ParticleSystem* particles = NULL;
+    ParticleRenderer* particleRenderer = NULL;
+    const float fanRadius = 0.5f * (FAN_BLADES.Bounds.Max[0] - FAN_BLADES.Bounds.Min[0]);
+    if (particleCount > 0)
+    {
+        particles = new ParticleSystem();
+        particles->Spawn(particleCount, PARTICLE_ROOM_MIN, PARTICLE_ROOM_MAX);
+        particleRenderer = new ParticleRenderer();
+        // GL captures only see the data of glBufferSubData
+        particleRenderer->Create(particles->Count(), capturePath == NULL);
+        particleRenderer->SetWindows(SUNLIT_WINDOWS, sizeof(SUNLIT_WINDOWS) / sizeof(SUNLIT_WINDOWS[0]), SUNLIT_WALL_Y);
+    }
 
-    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    // curtains collide with the window frames and the wall around them; vertices are streamed every tick
+    ClothSystem cloth;
+    cloth.FloorZ = 0.0f;
+    std::vector<AABB> curtainColliders;
+    for (unsigned int part = 0; part < scene.PartCount(); part++)
+    {
+        unsigned int material = scene.PartMaterial[part];
+        if (material == MATERIAL_WINDOW_FRAME || material == MATERIAL_GLASS || material == MATERIAL_WALL)
+            curtainColliders.push_back(scene.PartBounds[part]);
+    }
+    for (float left : CURTAIN_LEFT_EDGES)
+        cloth.AddCloth(glm::vec3(left, CURTAIN_Y, CURTAIN_TOP), glm::vec3(CURTAIN_WIDTH, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -CURTAIN_DROP),
+                       CURTAIN_COLUMNS, CURTAIN_ROWS, MATERIAL_CURTAIN, curtainColliders.data(), static_cast<unsigned int>(curtainColliders.size()));
+    ClothRenderer clothRenderer;
+    clothRenderer.Create(cloth, gpuMemory);
+
+    // additional views share the scene update and culling
+    MultiView* multiView = viewCount > 1 ? new MultiView(viewCount) : NULL;
+
+    // presented frames are read back asynchronously and encoded on the thread pool
+    FrameExporter* frameExporter = NULL;
+    if (exportPath != NULL)
+    {
+        frameExporter = new FrameExporter(threadPool, exportPath, framebufferWidth, framebufferHeight, exportFramesPerSecond);
+        if (!frameExporter->Ok())
+        {
+            delete frameExporter;
+            frameExporter = NULL;
+        }
+    }
+
+    // live counters for monitoring; the render loop only ever writes them
+    Telemetry telemetry;
+    telemetry.Open(TELEMETRY_SHARED_NAME);
+    if (telemetryPort > 0)
+        telemetry.Serve(telemetryPort);
+    unsigned long long telemetryFrames = 0;
+    double lastGpuMemoryQuery = -TELEMETRY_GPU_MEMORY_INTERVAL;
+
+    // damage tracking; replays, captures, exports, overdraw counts and allocation checks need every frame rendered
+    RedrawTracker redraw;
+    redraw.Enabled = !continuousRendering && inputSession.Mode != INPUT_REPLAY && capturePath == NULL && frameExporter == NULL &&
+                     !overdrawView && allocationCheckFrames == 0;
+    redraw.TrackParts(scene);
+    glm::mat4 drawnAxisModel(0.0f);
+
+    // frame pacing; recordings, replays and captures keep the plain frame timing
+    FramePacer framePacer(DEFAULT_REFRESH_MS);
+    framePacer.Enabled = !unpaced && inputSession.Mode != INPUT_REPLAY && capturePath == NULL && frameExporter == NULL && allocationCheckFrames == 0;
+    if (framePacer.Enabled)
+    {
+        const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+        if (videoMode != NULL && videoMode->refreshRate > 0)
+            framePacer.RefreshMs = 1000.0 / videoMode->refreshRate;
+        // the schedule follows the vblanks the swap waits for
+        glfwSwapInterval(1);
+    }
+
+    // per-frame scratch memory (visible sets, draw lists, temporary matrices)
+    FrameArena frameArena(FRAME_ARENA_SIZE);
+    int frameNumber = 0;
+    int allocatingFrames = 0;
 
 
     //ourShader.use();
@@ -282,842 +769,618 @@ int main()
         {
             // per-frame time logic
             // --------------------
+            unsigned long long frameAllocationStart = HeapAllocationCount();
+            frameArena.Reset();
+            GLCapture::Instance().BeginFrame(frameNumber);
+            double frameStartTime = glfwGetTime();
+
             float currentFrame = static_cast<float>(glfwGetTime());
-            deltaTime = currentFrame - lastFrame;
+            deltaTime = inputSession.BeginFrame(currentFrame - lastFrame, [window](const InputEvent& event) { dispatchInputEvent(window, event); });
             lastFrame = currentFrame;
+            if (inputSession.Finished())
+                break;
+            // exported video advances by whole frames however long rendering takes
+            if (frameExporter != NULL)
+                deltaTime = 1.0f / exportFramesPerSecond;
 
             // input
             // -----
+            glm::vec3 previousCameraPosition = camera.Position;
             processInput(window);
+            editLayout(window, layout, sceneBVH);
+
+            // animation
+            // ---------
+            for (unsigned int fan : fanRotators)
+                animation.SetRotatorActive(fan, fan_on);
+            animation.Update(deltaTime, scene, &threadPool);
+            scene.UpdateTransforms();
+
+            // moved and edited parts only refit the paths above their leaves
+            for (unsigned int part : scene.DirtyParts)
+                sceneBVH.Update(part, scene.PartBounds[part]);
+            sceneBVH.Refit();
+            if (gpuCulling != NULL)
+                gpuCulling->Update(scene, materials);
+            reflectionProbes.Invalidate(scene);
+            gpuMemory.Defragment(GPU_DEFRAG_BYTES_PER_FRAME);
+
+            // the air follows the fans as animated this frame
+            Airflow airflow[AIRFLOW_MAX_FANS];
+            int fanCount = 0;
+            for (unsigned int fan : fanRotators)
+            {
+                if (fanCount == AIRFLOW_MAX_FANS)
+                    break;
+                airflow[fanCount].Hub = glm::vec3(scene.NodeWorld[animation.RotatorNode[fan]][3]);
+                airflow[fanCount].Radius = fanRadius;
+                airflow[fanCount].Spin = glm::radians(animation.RotatorSpeed[fan] * animation.RotatorActive[fan]);
+                fanCount++;
+            }
+            if (particles != NULL)
+            {
+                particles->SetFans(airflow, fanCount);
+                particles->Update(deltaTime, particleRenderer->Map(), &threadPool);
+            }
+            cloth.SetFans(airflow, fanCount);
+            if (cloth.Update(deltaTime, &threadPool) > 0)
+                clothRenderer.Upload(cloth);
+
+            collideCamera(sceneBVH, previousCameraPosition);
+            if (pickRequested)
+            {
+                pickObject(sceneBVH, scene);
+                pickRequested = false;
+                if (layout.Select(pickedPart))
+                    std::cout << "selected " << layout.SelectedName() << " (node " << layout.Selected << ")" << std::endl;
+            }
 
             // render
             // ------
-            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-
-            // activate shader
-            ourShader.use();
+            if (framebufferWidth != dynamicResolution.OutputWidth || framebufferHeight != dynamicResolution.OutputHeight)
+            {
+                dynamicResolution.Resize(framebufferWidth, framebufferHeight);
+                // the transparency targets share the reallocated depth buffer
+                transparency.Attach(dynamicResolution.DepthRBO);
+            }
+            redraw.BeginFrame(dynamicResolution.Width, dynamicResolution.Height);
 
             // pass projection matrix to shader (note that in this case it could change every frame)
             
-            glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+            float aspect = (float)framebufferWidth / (float)framebufferHeight;
+            glm::ivec4 playerTile(0, 0, dynamicResolution.Width, dynamicResolution.Height);
+            if (multiView != NULL)
+            {
+                // the player camera keeps the first tile, the axis lines are only drawn there
+                multiView->Layout(dynamicResolution.Width, dynamicResolution.Height);
+                aspect = multiView->Aspect(0);
+                playerTile = multiView->Tiles[0];
+            }
+            glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), aspect, 0.1f, 100.0f);
             //glm::mat4 projection = glm::ortho(-2.0f, +2.0f, -1.5f, +1.5f, 0.1f, 100.0f);
-            ourShader.setMat4("projection", projection);
 
             // camera/view transformation
             //glm::mat4 view = camera.GetViewMatrix();
             glm::mat4 view = camera.GetViewMatrix();
-            ourShader.setMat4("view", view);
 
             
             glm::mat4 identityMatrix = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
             glm::mat4 translateMatrix, rotateXMatrix, rotateYMatrix, rotateZMatrix, scaleMatrix, model;
         
-            translateMatrix = glm::translate(identityMatrix, glm::vec3(translate_X + 5.0f, translate_Y + 5.0f, translate_Z + 5.0f));
+            translateMatrix = glm::translate(identityMatrix, glm::vec3(translate_X, translate_Y, translate_Z));
             rotateXMatrix = glm::rotate(identityMatrix, glm::radians(rotateAngle_X), glm::vec3(1.0f, 0.0f, 0.0f));
             rotateYMatrix = glm::rotate(identityMatrix, glm::radians(rotateAngle_Y), glm::vec3(0.0f, 1.0f, 0.0f));
             rotateZMatrix = glm::rotate(identityMatrix, glm::radians(rotateAngle_Z), glm::vec3(0.0f, 0.0f, 1.0f));
             scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X, scale_Y, scale_Z));
             model = translateMatrix * rotateXMatrix * rotateYMatrix * rotateZMatrix * scaleMatrix;
-            ourShader.setMat4("model", model);
-            //ourShader.setVec3("aColor", glm::vec3(0.2f, 0.1f, 0.4f));
-
-            glBindVertexArray(VAO);
-            //glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
 
-
-            // Axis line
+            // per-view parameters, compared with the last drawn frame to find what changed
+            glm::mat4 viewProjections[SCENE_MAX_VIEWS];
+            glm::vec4 viewTiles[SCENE_MAX_VIEWS];
+            glm::vec3 viewEyes[SCENE_MAX_VIEWS];
+            int drawnViews = 1;
+            if (multiView != NULL)
             {
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(translate_X, translate_Y, translate_Z));
-                rotateXMatrix = glm::rotate(identityMatrix, glm::radians(rotateAngle_X), glm::vec3(1.0f, 0.0f, 0.0f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X, scale_Y, scale_Z));
-                model = translateMatrix * rotateXMatrix * rotateYMatrix * rotateZMatrix * scaleMatrix;
-                ourShader.setMat4("model", model);
-
-                glUseProgram(ourShader.ID);
-                glUniform3f(glGetUniformLocation(ourShader.ID, "lineColor"), 1.0f, 0.0f, 0.0f);  // Set line color (red)
-                glBindVertexArray(axisVAO);
-                glDrawArrays(GL_LINES, 0, 2);
-
-                // Draw the y-axis line
-                glUniform3f(glGetUniformLocation(ourShader.ID, "lineColor"), 0.0f, 1.0f, 0.0f);  // Set line color (green)
-                glDrawArrays(GL_LINES, 2, 2);
-
-                // Draw the z-axis line
-                glUniform3f(glGetUniformLocation(ourShader.ID, "lineColor"), 0.0f, 0.0f, 1.0f);  // Set line color (blue)
-                glDrawArrays(GL_LINES, 4, 2);
+                multiView->SetView(0, projection, view);
+                setMonitorViews(*multiView, AABB(sceneBVH.Nodes[0].Min, sceneBVH.Nodes[0].Max));
+                multiView->DrawParameters(viewProjections, viewTiles, viewEyes);
+                drawnViews = multiView->ViewCount;
             }
-        
-
-
-
-            // chair 
+            else
             {
-                float chairX = 1.6f, chairY = 0.8f, chairZ = 0.75f;
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(chairX, chairY, chairZ));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 2.0f, scale_Y * 2.0f, scale_Z * .05f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // leg 1 back
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(chairX - .48f, chairY - .48f, chairZ));//
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * .25f, scale_Y * 0.25f, scale_Z * 3.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // leg 2 back
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(chairX + .48f, chairY - .48f, chairZ));//
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * .25f, scale_Y * 0.25f, scale_Z * 3.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // leg 3 front
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(chairX + .42f, chairY + .42f, chairZ - 0.375f));//
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * .25f, scale_Y * 0.25f, scale_Z * 1.5f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // leg 4 front
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(chairX - .42f, chairY + .42f, chairZ - 0.375f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * .25f, scale_Y * 0.25f, scale_Z * 1.5f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // Back side
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(chairX , chairY - 0.5f, chairZ + 0.625f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 2.0f , scale_Y * .05f, scale_Z * 1.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+                viewProjections[0] = projection * view;
+                viewTiles[0] = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+                viewEyes[0] = camera.Position;
             }
-        
-
-            // table 
+            for (int i = 0; i < drawnViews; i++)
+            {
+                glm::ivec4 tile = multiView != NULL ? multiView->Tiles[i] : playerTile;
+                redraw.CheckView(i, viewProjections[i], tile);
+                redraw.InvalidateMovedParts(scene, viewProjections[i], tile);
+                for (unsigned int c = 0; c < cloth.ClothCount(); c++)
+                    if (cloth.ClothMoving[c])
+                        redraw.InvalidateBounds(cloth.ClothSwept[c], viewProjections[i], tile);
+            }
+            if (model != drawnAxisModel)
             {
-                float tableX = 1.6f, tableY = 2.3f, tableZ = 1.5f;
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX, tableY, tableZ ));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 4.0f, scale_Y * 4.0f, scale_Z * 0.05f));
-                model = translateMatrix * scaleMatrix;
+                redraw.InvalidateRegion(playerTile);
+                drawnAxisModel = model;
+            }
+            // streamed chunks are drawn in the player view only
+            if (streamer != NULL && streamer->Update(camera.Position))
+                redraw.InvalidateRegion(playerTile);
+            // so is the dust, which never stops moving
+            if (particles != NULL)
+                redraw.InvalidateRegion(playerTile);
+            // material detail follows the player view; a landed level sharpens every view
+            if (textureStreamer.Active())
+            {
+                unsigned int* requestedParts = frameArena.Allocate<unsigned int>(scene.PartCount());
+                unsigned int requestedCount = sceneBVH.QueryFrustum(Frustum(viewProjections[0]), requestedParts, scene.PartCount());
+                textureStreamer.RequestParts(scene, materials, requestedParts, requestedCount, camera.Position,
+                                             playerTile.w / (2.0f * tanf(glm::radians(camera.Zoom) * 0.5f)));
+                if (textureStreamer.Update())
+                    redraw.Invalidate();
+            }
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+            // probe faces that saw a change, within the frame's budget; reflections can show anywhere
+            unsigned int probeDrawCalls = 0;
+            if (reflectionProbes.Pending() &&
+                sceneRenderer.CaptureReflections(reflectionProbes, VAO, scene, sceneBVH, materials, REFLECTION_FACES_PER_FRAME) > 0)
+            {
+                probeDrawCalls = sceneRenderer.DrawCalls;
+                redraw.Invalidate();
+            }
 
-                // Leg 1 Back
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX + 0.875f, tableY + 0.875f, tableZ - 0.75f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 3.0f));
-                model = translateMatrix * scaleMatrix;
+            bool drawFrame = redraw.Pending();
+            if (drawFrame)
+            {
+                dynamicResolution.BeginFrame();
+
+                // small changes only re-render their rectangle, the rest of the target is kept
+                bool partial = !redraw.Full();
+                glm::ivec4 region = redraw.Region();
+                if (partial)
+                {
+                    glEnable(GL_SCISSOR_TEST);
+                    glScissor(region.x, region.y, region.z, region.w);
+                }
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+                // the overdraw heat map counts up from black
+                if (overdrawView)
+                    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+                else
+                    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-                // Leg 2 Back
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX - 0.875f, tableY + 0.875f, tableZ - 0.75f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 3.0f));
-                model = translateMatrix * scaleMatrix;
 
+                // activate shader
+                ourShader.use();
+                ourShader.setMat4("projection", projection);
+                ourShader.setMat4("view", view);
                 ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+                //ourShader.setVec3("aColor", glm::vec3(0.2f, 0.1f, 0.4f));
 
-                // Leg 3 Back
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX - 0.875f, tableY - 0.875f, tableZ - 0.75f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 3.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
                 glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // Leg 4 Back
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX + 0.875f, tableY - 0.875f, tableZ - 0.75f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 3.0f));
-                model = translateMatrix * scaleMatrix;
+                //glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
 
-                // table back side
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX , tableY + 1.0f, tableZ + 0.5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 4.0f, scale_Y * 0.05f, scale_Z * 2.0f));
-                model = translateMatrix * scaleMatrix;
+                // Axis line
+                unsigned int axisDrawCalls = 0;
+                if (!overdrawView)
+                {
+                    axisDrawCalls = 3;
+                    glViewport(playerTile.x, playerTile.y, playerTile.z, playerTile.w);
+                    glUseProgram(ourShader.ID);
+                    glUniform3f(glGetUniformLocation(ourShader.ID, "lineColor"), 1.0f, 0.0f, 0.0f);  // Set line color (red)
+                    glBindVertexArray(axisVAO);
+                    glDrawArrays(GL_LINES, 0, 2);
+
+                    // Draw the y-axis line
+                    glUniform3f(glGetUniformLocation(ourShader.ID, "lineColor"), 0.0f, 1.0f, 0.0f);  // Set line color (green)
+                    glDrawArrays(GL_LINES, 2, 2);
+
+                    // Draw the z-axis line
+                    glUniform3f(glGetUniformLocation(ourShader.ID, "lineColor"), 0.0f, 0.0f, 1.0f);  // Set line color (blue)
+                    glDrawArrays(GL_LINES, 4, 2);
+                    glViewport(0, 0, dynamicResolution.Width, dynamicResolution.Height);
+                }
+            
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
 
-                // right side
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX + 0.9875f, tableY + 0.75f, tableZ + 0.5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.05f, scale_Y, scale_Z * 2.0f));
-                model = translateMatrix * scaleMatrix;
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+                // room: only the parts whose bounds touch the view frustum, in one instanced draw
+                unsigned int* visibleParts = frameArena.Allocate<unsigned int>(scene.PartCount());
+                unsigned long long visibleObjects = TELEMETRY_UNKNOWN;
+                sceneRenderer.Begin();
+                if (gpuCulling != NULL)
+                {
+                    // the GPU culls and writes the draw commands; the CPU only passes the frustums
+                    Frustum frustum(partial ? redraw.RegionCrop(playerTile) * viewProjections[0] : viewProjections[0]);
+                    gpuCulling->Cull(multiView != NULL ? multiView->Frustums : &frustum, drawnViews, 36,
+                                     static_cast<unsigned int>(cubeIndexBlock.Offset() / sizeof(unsigned int)));
 
-                // left side
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX - 0.9875f, tableY + 0.75f, tableZ + 0.5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.05f, scale_Y, scale_Z * 2.0f));
-                model = translateMatrix * scaleMatrix;
+                    // the few transparent parts skip the GPU cull and go to every view
+                    for (int view = 0; view < drawnViews; view++)
+                        for (unsigned int part : transparentParts)
+                            sceneRenderer.Add(scene, part, static_cast<unsigned int>(view));
+                }
+                else if (multiView != NULL)
+                {
+                    // every view in one culling walk; parts get one instance per view they are visible in
+                    unsigned int* visibleMasks = frameArena.Allocate<unsigned int>(scene.PartCount());
+                    unsigned int visibleCount = multiView->Cull(sceneBVH, visibleParts, visibleMasks, scene.PartCount());
+                    sceneRenderer.AddVisible(scene, visibleParts, visibleMasks, visibleCount);
+                    visibleObjects = visibleCount;
+                }
+                else
+                {
+                    // a partial redraw culls against the frustum of the redrawn rectangle
+                    Frustum frustum(partial ? redraw.RegionCrop(playerTile) * viewProjections[0] : viewProjections[0]);
+                    unsigned int visibleCount = sceneBVH.QueryFrustum(frustum, visibleParts, scene.PartCount());
+                    sceneRenderer.AddVisible(scene, visibleParts, visibleCount);
+                    visibleObjects = visibleCount;
+                }
+                if (gpuCulling != NULL)
+                    sceneRenderer.DrawIndirect(gpuVAO, materials, drawnViews, viewProjections, viewTiles, viewEyes,
+                                               gpuCulling->CommandBuffer, GPUCULL_COMMAND_OFFSET, gpuCulling->Capacity);
+                else
+                    sceneRenderer.Draw(VAO, materials, drawnViews, viewProjections, viewTiles, viewEyes);
+
+                // curtains in every view, before the glass blends over them
+                if (!overdrawView)
+                    clothRenderer.Draw(cloth, materials, drawnViews, viewProjections, viewTiles, viewEyes, sceneRenderer.LightDirection);
+
+                // streamed building: one instanced run per visible resident chunk
+                if (streamer != NULL)
+                {
+                    glm::uvec2* chunkRuns = frameArena.Allocate<glm::uvec2>(streamer->SlotCount());
+                    Frustum playerFrustum(partial ? redraw.RegionCrop(playerTile) * viewProjections[0] : viewProjections[0]);
+                    unsigned int runCount = streamer->Visible(playerFrustum, chunkRuns);
+                    sceneRenderer.DrawRuns(streamVAO, streamer->InstanceBuffer(), chunkRuns, runCount, materials, drawnViews, viewProjections, viewTiles, viewEyes);
+                }
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+                // glass last, over the depth of everything opaque
+                sceneRenderer.DrawTransparent(VAO, materials, drawnViews, viewProjections, viewTiles, viewEyes);
 
-                // upper side
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX , tableY + 0.75f, tableZ + 0.5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 4.0f, scale_Y, scale_Z * 0.05f));
-                model = translateMatrix * scaleMatrix;
+                // dust adds its light over everything, in the player view like the axis lines
+                if (particles != NULL && !overdrawView)
+                {
+                    glViewport(playerTile.x, playerTile.y, playerTile.z, playerTile.w);
+                    particleRenderer->Draw(particles->Count(), projection, view, sceneRenderer.LightDirection);
+                    glViewport(0, 0, dynamicResolution.Width, dynamicResolution.Height);
+                }
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+                // render boxes
+                //for (unsigned int i = 0; i < 10; i++)
+                //{
+                //    // calculate the model matrix for each object and pass it to shader before drawing
+                //    glm::mat4 model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
+                //    model = glm::translate(model, cubePositions[i]);
+                //    float angle = 20.0f * i;
+                //    model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
+                //    ourShader.setMat4("model", model);
+
+                //    glDrawArrays(GL_TRIANGLES, 0, 36);
+                //}
+
+                if (partial)
+                    glDisable(GL_SCISSOR_TEST);
+
+                if (overdrawView)
+                    overdrawMeter.Measure(dynamicResolution.Width, dynamicResolution.Height);
+
+                // upscale the internal target to the window and adapt its resolution
+                dynamicResolution.EndFrame();
+                redraw.PartsDrawn(scene);
+
+                // the GPU culls for itself, so only it knows what survived
+                telemetry.Set(TELEMETRY_DRAW_CALLS, sceneRenderer.DrawCalls + clothRenderer.DrawCalls + axisDrawCalls + probeDrawCalls);
+                telemetry.Set(TELEMETRY_TRIANGLES, gpuCulling != NULL ? TELEMETRY_UNKNOWN : sceneRenderer.Triangles);
+                telemetry.Set(TELEMETRY_VISIBLE_OBJECTS, visibleObjects);
+                telemetry.Set(TELEMETRY_CULLED_OBJECTS, visibleObjects != TELEMETRY_UNKNOWN ? scene.PartCount() - visibleObjects : TELEMETRY_UNKNOWN);
+                telemetry.Set(TELEMETRY_GPU_TIME_US, static_cast<unsigned long long>(dynamicResolution.GpuFrameMs * 1000.0f));
             }
-        
-            // Bed
+            else if (windowDamaged)
             {
-                float bedX = 3.8f, bedY = 1.3f, bedZ = 0.75f;
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX, bedY, bedZ + 0.125f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 4.0f, scale_Y * 8.0f, scale_Z * 0.5f));
-                model = translateMatrix * scaleMatrix;
+                // nothing changed, but the window needs its image again
+                dynamicResolution.Present();
+            }
+            redraw.EndFrame(drawFrame);
+            if (frameExporter != NULL && drawFrame)
+                frameExporter->Capture();
+            GLCapture::Instance().EndFrame();
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+            // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+            // -------------------------------------------------------------------------------
+            double submitTime = glfwGetTime();
+            if (drawFrame || windowDamaged)
+                glfwSwapBuffers(window);
+            windowDamaged = false;
+            if (drawFrame)
+                framePacer.FramePresented(glfwGetTime(), (submitTime - frameStartTime) * 1000.0 + dynamicResolution.GpuFrameMs);
+            else
+                framePacer.Idle();
+
+            // telemetry of the drawn frame; input that changed nothing has no latency to report
+            if (drawFrame)
+            {
+                double swapTime = glfwGetTime();
+                telemetry.Set(TELEMETRY_FRAMES, ++telemetryFrames);
+                telemetry.Set(TELEMETRY_FRAME_TIME_US, static_cast<unsigned long long>((swapTime - frameStartTime) * 1.0e6));
+                if (inputEventTime != 0.0)
+                    telemetry.Set(TELEMETRY_INPUT_LATENCY_US, static_cast<unsigned long long>((swapTime - inputEventTime) * 1.0e6));
+                if (swapTime - lastGpuMemoryQuery >= TELEMETRY_GPU_MEMORY_INTERVAL)
+                {
+                    telemetry.Set(TELEMETRY_GPU_MEMORY_KB, QueryGpuMemoryKB());
+                    lastGpuMemoryQuery = swapTime;
+                }
+                telemetry.Publish();
+            }
+            inputEventTime = 0.0;
+            if (drawFrame || (streamer != NULL && streamer->Busy()) || textureStreamer.Busy())
+            {
+                // paced: hold the next frame back, handling input meanwhile, until it can just make the vblank
+                for (double delay = framePacer.Delay(glfwGetTime()); delay > 0.0; delay = framePacer.Delay(glfwGetTime()))
+                    glfwWaitEventsTimeout(delay);
+                glfwPollEvents();
+            }
+            else
+            {
+                // idle: sleep until input arrives; the wait must not count as simulated time
+                glfwWaitEventsTimeout(redraw.IdleTimeout);
+                lastFrame = static_cast<float>(glfwGetTime());
+            }
 
+            inputSession.EndFrame();
 
-                // leg 1
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX + 0.875f, bedY + 1.875f, bedZ - .375f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 1.5f));
-                model = translateMatrix * scaleMatrix;
+            // steady-state frames must not touch the heap
+            frameNumber++;
+            if (allocationCheckFrames > 0 && frameNumber > ALLOCATION_WARMUP_FRAMES)
+            {
+                unsigned long long allocations = HeapAllocationCount() - frameAllocationStart;
+                if (allocations > 0)
+                {
+                    std::cout << "frame " << frameNumber << " performed " << allocations << " heap allocations" << std::endl;
+                    allocatingFrames++;
+                }
+                if (frameNumber >= ALLOCATION_WARMUP_FRAMES + allocationCheckFrames)
+                    glfwSetWindowShouldClose(window, true);
+            }
+        }
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    // optional: de-allocate all resources once they've outlived their purpose:
+    // ------------------------------------------------------------------------
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteVertexArrays(1, &axisVAO);
+    axisVertexBlock.Reset();
+    cubeVertexBlock.Reset();
+    cubeIndexBlock.Reset();
+    dynamicResolution.Release();
+    transparency.Release();
+    sceneRenderer.Release();
+    clothRenderer.Release();
+    materials.Release();
+    lightmap.Release();
+    reflectionProbes.Release();
+    textureStreamer.PrintStats();
+    textureStreamer.Release();
+    if (gpuCulling != NULL)
+    {
+        gpuCulling->Release();
+        glDeleteVertexArrays(1, &gpuVAO);
+    }
+    delete gpuCulling;
+    if (streamer != NULL)
+    {
+        streamer->PrintStats();
+        streamer->Release();
+        glDeleteVertexArrays(1, &streamVAO);
+    }
+    delete streamer;
+    if (particles != NULL)
+    {
+        particleRenderer->Release();
+        particles->Release();
+    }
+    delete particleRenderer;
+    delete particles;
+    if (frameExporter != NULL)
+    {
+        frameExporter->Finish();
+        frameExporter->PrintStats();
+    }
+    delete frameExporter;
+    delete multiView;
+    telemetry.Close();
+    gpuMemory.PrintStats();
+    gpuMemory.Release();
 
-                // leg 2
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX - 0.875f, bedY + 1.875f, bedZ - .375f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 1.5f));
-                model = translateMatrix * scaleMatrix;
+    // glfw: terminate, clearing all previously allocated GLFW resources.
+    // ------------------------------------------------------------------
+    glfwTerminate();
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-            
-                // leg 3
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX - 0.875f, bedY - 1.875f, bedZ - .375f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 1.5f));
-                model = translateMatrix * scaleMatrix;
+    inputSession.PrintReplayTimings();
+    redraw.PrintStats();
+    framePacer.PrintStats();
+    overdrawMeter.PrintStats();
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    if (allocationCheckFrames > 0)
+    {
+        std::cout << "allocation check: " << allocatingFrames << " of " << allocationCheckFrames << " steady-state frames allocated" << std::endl;
+        return allocatingFrames == 0 ? 0 : 1;
+    }
+    return 0;
+}
 
-                // leg 4
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX + 0.875f, bedY - 1.875f, bedZ - .375f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 1.5f));
-                model = translateMatrix * scaleMatrix;
+// builds the room's nodes and parts; the fans' rotators are returned in fanRotators
+// ---------------------------------------------------------------------------------
+void buildRoom(Scene& scene, AnimationSystem& animation, std::vector<unsigned int>& fanRotators, LayoutEditor* layout)
+{
+    // the assemblies are baked in prefabs.h; the room only places them
+    glm::mat4 identityMatrix = glm::mat4(1.0f);
+    auto at = [&identityMatrix](float x, float y, float z) { return glm::translate(identityMatrix, glm::vec3(x, y, z)); };
+    // furniture goes through the layout editor, when there is one, so it can be edited later
+    auto furniture = [&scene, layout](Furniture_Kind kind, const glm::mat4& placement) {
+        if (layout != NULL)
+            layout->Build(kind, placement);
+        else
+            AddPrefab(scene, LayoutEditor::Furniture(kind), placement);
+    };
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    furniture(FURNITURE_CHAIR, at(1.6f, 0.8f, 0.0f));
+    furniture(FURNITURE_TABLE, at(1.6f, 2.3f, 0.0f));
+    furniture(FURNITURE_BED, at(3.8f, 1.3f, 0.0f));
+    AddPrefab(scene, FLOOR, identityMatrix);
+    AddPrefab(scene, WALLS, identityMatrix);
+    AddPrefab(scene, WINDOW, at(3.25f, 3.5f, 2.5f));
+    AddPrefab(scene, WINDOW, at(-3.25f, 3.5f, 2.5f));
+
+    // the hub and blades hang off a node that the fan's rotator spins around z
+    unsigned int bladesNode = AddPrefab(scene, FAN_BLADES, at(2.5f, 1.5f, 4.5f));
+    fanRotators.push_back(animation.AddRotator(bladesNode, FAN_SPEED, 0.0f, fan_on));
+    AddPrefab(scene, FAN_ROD, at(2.5f, 1.5f, 4.5f));
+
+    AddPrefab(scene, CEILING, identityMatrix);
+    furniture(FURNITURE_CHAIR, at(-1.6f, 0.8f, 0.0f));
+    furniture(FURNITURE_TABLE, at(-1.6f, 2.3f, 0.0f));
+    furniture(FURNITURE_BED, at(-3.8f, 1.3f, 0.0f));
+
+    bladesNode = AddPrefab(scene, FAN_BLADES, at(-2.5f, 1.5f, 4.5f));
+    fanRotators.push_back(animation.AddRotator(bladesNode, FAN_SPEED, 0.0f, fan_on));
+    AddPrefab(scene, FAN_ROD, at(-2.5f, 1.5f, 4.5f));
+}
 
-                // Head side
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX , bedY + 2.0, bedZ + 0.25f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 4.0f, scale_Y * 0.05f, scale_Z * 0.5f));
-                model = translateMatrix * scaleMatrix;
+// keeps the camera out of walls and furniture: the move of this frame is replayed one
+// axis at a time and any axis that would make the camera sphere overlap a part is dropped
+// ---------------------------------------------------------------------------------------
+void collideCamera(const BVH& bvh, const glm::vec3& previousPosition)
+{
+    if (!camera_collision)
+        return;
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    // already inside something (e.g. a part moved into the camera): let it move out freely
+    queryResults.clear();
+    if (bvh.QuerySphere(previousPosition, CAMERA_RADIUS, queryResults) > 0)
+        return;
 
-                // pillow right
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX + 0.45f, bedY + 1.7f , bedZ + .25f ));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 1.5f , scale_Y * 0.75f, scale_Z * 0.25f));
-                model = translateMatrix * scaleMatrix;
+    glm::vec3 target = camera.Position;
+    glm::vec3 position = previousPosition;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        glm::vec3 candidate = position;
+        candidate[axis] = target[axis];
+        queryResults.clear();
+        if (bvh.QuerySphere(candidate, CAMERA_RADIUS, queryResults) == 0)
+            position = candidate;
+    }
+    camera.Position = position;
+}
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+// picks the part under the crosshair (the cursor is captured, so the ray goes through the view center)
+// ----------------------------------------------------------------------------------------------------
+void pickObject(const BVH& bvh, const Scene& scene)
+{
+    RayHit hit;
+    if (bvh.RayCast(camera.Position, camera.Front, 100.0f, hit))
+    {
+        pickedPart = static_cast<int>(hit.Object);
+        std::cout << "picked part " << hit.Object << " (node " << scene.PartNode[hit.Object] << ") at distance " << hit.Distance << std::endl;
+    }
+    else
+    {
+        pickedPart = -1;
+        std::cout << "picked nothing" << std::endl;
+    }
+}
 
-                // pillow left
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX - 0.45f, bedY + 1.7f, bedZ + .25f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 1.5f, scale_Y * 0.75f, scale_Z * 0.25f));
-                model = translateMatrix * scaleMatrix;
+// edits the furniture layout from the keyboard (see EDIT_MOVE_SPEED); the edits only mark
+// nodes dirty, the frame's transform update carries them to the BVH, GPU buffers and redraw
+// ------------------------------------------------------------------------------------------
+void editLayout(GLFWwindow* window, LayoutEditor& layout, const BVH& bvh)
+{
+    // add and delete once per press
+    bool pressed[FURNITURE_KIND_COUNT + 1];
+    for (int key = 0; key <= FURNITURE_KIND_COUNT; key++)
+    {
+        bool down = inputSession.GetKey(window, key < FURNITURE_KIND_COUNT ? EDIT_ADD_KEYS[key] : GLFW_KEY_DELETE) == GLFW_PRESS;
+        pressed[key] = down && !editKeysHeld[key];
+        editKeysHeld[key] = down;
+    }
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-            }
+    for (int kind = 0; kind < FURNITURE_KIND_COUNT; kind++)
+    {
+        if (!pressed[kind])
+            continue;
+        // on the floor where the view hits something, or as far as EDIT_PLACE_DISTANCE
+        RayHit hit;
+        float distance = bvh.RayCast(camera.Position, camera.Front, EDIT_PLACE_DISTANCE, hit) ? hit.Distance : EDIT_PLACE_DISTANCE;
+        glm::vec3 target = camera.Position + camera.Front * distance;
+        unsigned int node = layout.Add(static_cast<Furniture_Kind>(kind), glm::translate(glm::mat4(1.0f), glm::vec3(target.x, target.y, 0.0f)));
+        std::cout << "added " << layout.SelectedName() << " (node " << node << ")" << std::endl;
+    }
 
+    if (layout.Selected < 0)
+        return;
+    unsigned int node = static_cast<unsigned int>(layout.Selected);
+    if (pressed[FURNITURE_KIND_COUNT])
+    {
+        std::cout << "removed " << layout.SelectedName() << " (node " << node << ")" << std::endl;
+        layout.Remove(node);
+        return;
+    }
 
-            // Floor
-            {
-                float floorX = 0.0f, floorY = 0.0f, floorZ = 0.0f;
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(floorX, floorY, floorZ));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 20.0f, scale_Y * 14.0f, scale_Z * 0.05f));
-                model = translateMatrix * scaleMatrix;
+    // slide along the view's heading, so up always pushes away from the camera
+    glm::vec3 forward = glm::vec3(camera.Front.x, camera.Front.y, 0.0f);
+    forward = glm::length(forward) > 0.0f ? glm::normalize(forward) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 right = glm::vec3(forward.y, -forward.x, 0.0f);
+    glm::vec3 move(0.0f);
+    if (inputSession.GetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+        move += forward;
+    if (inputSession.GetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+        move -= forward;
+    if (inputSession.GetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
+        move += right;
+    if (inputSession.GetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
+        move -= right;
+    if (move != glm::vec3(0.0f))
+        layout.Move(node, move * (EDIT_MOVE_SPEED * deltaTime));
+
+    float turn = 0.0f;
+    if (inputSession.GetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
+        turn += EDIT_TURN_SPEED * deltaTime;
+    if (inputSession.GetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+        turn -= EDIT_TURN_SPEED * deltaTime;
+    if (turn != 0.0f)
+        layout.Rotate(node, turn);
+}
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-            }
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// ---------------------------------------------------------------------------------------------------------
+void processInput(GLFWwindow* window)
+{
+    if (inputSession.GetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
 
-            // Wall
-            {
-                float wallX = 0.0f, wallY = 0.0f, wallZ = 0.0f;
+    if (inputSession.GetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
+        camera.ProcessKeyboard(FORWARD, deltaTime);
+    }
+    if (inputSession.GetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
+        camera.ProcessKeyboard(BACKWARD, deltaTime);
+    }
+    if (inputSession.GetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
+        camera.ProcessKeyboard(LEFT, deltaTime);
+    }
+    if (inputSession.GetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
+        camera.ProcessKeyboard(RIGHT, deltaTime);
+    }
 
-                // right side wall
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(wallX + 5.0f, wallY, wallZ + 2.5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.05f , scale_Y * 14.0f, scale_Z * 10.0f));
-                model = translateMatrix * scaleMatrix;
+    if (inputSession.GetKey(window, GLFW_KEY_F) == GLFW_PRESS)
+    {
+        fan_on = !fan_on;
+    }
 
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // left side wall
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(wallX - 5.0f, wallY, wallZ + 2.5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.05f, scale_Y * 14.0f, scale_Z * 10.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                //// front side wall 
-                //translateMatrix = glm::translate(identityMatrix, glm::vec3(wallX , wallY + 3.5f, wallZ + 2.5f));
-                //scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 20.0f, scale_Y * 0.05f, scale_Z * 10.0f));
-                //model = translateMatrix * scaleMatrix;
-
-                //ourShader.setMat4("model", model);
-                //glBindVertexArray(VAO);
-                //glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // front side wall 1
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(wallX, wallY + 3.5f, wallZ + 4.25f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 20.0f, scale_Y * 0.05f, scale_Z * 3.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // front side wall 2
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(wallX, wallY + 3.5f, wallZ + 0.75f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 20.0f, scale_Y * 0.05f, scale_Z * 3.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // front side wall 3
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(wallX, wallY + 3.5f, wallZ + 2.5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 8.0f, scale_Y * 0.05f, scale_Z * 4.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // front side wall 4
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(wallX + 4.75f, wallY + 3.5f, wallZ + 2.5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X, scale_Y * 0.05f, scale_Z * 4.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // front side wall 5
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(wallX - 4.75f, wallY + 3.5f, wallZ + 2.5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X, scale_Y * 0.05f, scale_Z * 4.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-            }
-        
-            // right Window
-            {
-                float winX = 3.25f, winY = 3.5f, winZ = 2.5f;
-
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(winX , winY , winZ));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 5.0f, scale_Y * 0.05f, scale_Z * 0.1f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(winX, winY, winZ + .5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 5.0f, scale_Y * 0.05f, scale_Z * 0.1f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(winX, winY, winZ + 0.98f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 5.0f, scale_Y * 0.05f, scale_Z * 0.1f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(winX, winY, winZ - .5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 5.0f, scale_Y * 0.05f, scale_Z * 0.1f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(winX, winY, winZ - 0.98f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 5.0f, scale_Y * 0.05f, scale_Z * 0.1f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-            }
-
-            // Left Window
-            {
-                float winX = -3.25f, winY = 3.5f, winZ = 2.5f;
-
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(winX, winY, winZ));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 5.0f, scale_Y * 0.05f, scale_Z * 0.1f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(winX, winY, winZ + .5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 5.0f, scale_Y * 0.05f, scale_Z * 0.1f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(winX, winY, winZ + 0.98f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 5.0f, scale_Y * 0.05f, scale_Z * 0.1f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(winX, winY, winZ - .5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 5.0f, scale_Y * 0.05f, scale_Z * 0.1f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(winX, winY, winZ - 0.98f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 5.0f, scale_Y * 0.05f, scale_Z * 0.1f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-            }
-
-            // Fan
-            {
-                float fanX = 2.5f, fanY = 1.5f, fanZ = 4.5f;
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(fanX , fanY, fanZ ));
-                rotateYMatrix = glm::rotate(identityMatrix, glm::radians(fan_rotateAngle_Y), glm::vec3(0.0f, 0.0f, 1.0f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.5f  , scale_Y * 0.5f, scale_Z * 0.5f));
-                model = translateMatrix * rotateYMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 4.0f, scale_Y * 0.5f, scale_Z * 0.1f));
-                model = translateMatrix * rotateYMatrix * scaleMatrix;
-                ourShader.setMat4("model", model);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);   
-
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.5f, scale_Y * 4.0f, scale_Z * 0.1f));
-                model = translateMatrix * rotateYMatrix * scaleMatrix;
-                ourShader.setMat4("model", model);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                if (fan_on) {
-                    fan_rotateAngle_Y -= 0.1f;
-                }
-
-                glBindVertexArray(VAO);
-
-
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(fanX, fanY , fanZ + .25f));
-                rotateYMatrix = glm::rotate(identityMatrix, glm::radians(rotateAngle_Y), glm::vec3(0.0f, 0.0f, 1.0f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.1f, scale_Y * 0.1f, scale_Z ));
-                model = translateMatrix * rotateYMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-            }
-
-            // Ceil
-            {
-                float floorX = 0.0f, floorY = 0.0f, floorZ = 5.0f;
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(floorX, floorY, floorZ));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 20.0f, scale_Y * 14.0f, scale_Z * 0.05f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-            }
-
-            // chair 2
-            {
-                float chairX = -1.6f, chairY = 0.8f, chairZ = 0.75f;
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(chairX, chairY, chairZ));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 2.0f, scale_Y * 2.0f, scale_Z * .05f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // leg 1 back
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(chairX - .48f, chairY - .48f, chairZ));//
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * .25f, scale_Y * 0.25f, scale_Z * 3.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // leg 2 back
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(chairX + .48f, chairY - .48f, chairZ));//
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * .25f, scale_Y * 0.25f, scale_Z * 3.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // leg 3 front
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(chairX + .42f, chairY + .42f, chairZ - 0.375f));//
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * .25f, scale_Y * 0.25f, scale_Z * 1.5f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // leg 4 front
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(chairX - .42f, chairY + .42f, chairZ - 0.375f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * .25f, scale_Y * 0.25f, scale_Z * 1.5f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // Back side
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(chairX, chairY - 0.5f, chairZ + 0.625f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 2.0f, scale_Y * .05f, scale_Z * 1.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-            }
-
-
-            // table  2
-            {
-                float tableX = -1.6f, tableY = 2.3f, tableZ = 1.5f;
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX, tableY, tableZ));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 4.0f, scale_Y * 4.0f, scale_Z * 0.05f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // Leg 1 Back
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX + 0.875f, tableY + 0.875f, tableZ - 0.75f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 3.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // Leg 2 Back
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX - 0.875f, tableY + 0.875f, tableZ - 0.75f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 3.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // Leg 3 Back
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX - 0.875f, tableY - 0.875f, tableZ - 0.75f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 3.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // Leg 4 Back
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX + 0.875f, tableY - 0.875f, tableZ - 0.75f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 3.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // table back side
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX, tableY + 1.0f, tableZ + 0.5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 4.0f, scale_Y * 0.05f, scale_Z * 2.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // right side
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX + 0.9875f, tableY + 0.75f, tableZ + 0.5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.05f, scale_Y, scale_Z * 2.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // left side
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX - 0.9875f, tableY + 0.75f, tableZ + 0.5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.05f, scale_Y, scale_Z * 2.0f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // upper side
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(tableX, tableY + 0.75f, tableZ + 0.5f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 4.0f, scale_Y, scale_Z * 0.05f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-            }
-
-            // Bed 2
-            {
-                float bedX = -3.8f, bedY = 1.3f, bedZ = 0.75f;
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX, bedY, bedZ + 0.125f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 4.0f, scale_Y * 8.0f, scale_Z * 0.5f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-
-                // leg 1
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX + 0.875f, bedY + 1.875f, bedZ - .375f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 1.5f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // leg 2
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX - 0.875f, bedY + 1.875f, bedZ - .375f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 1.5f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // leg 3
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX - 0.875f, bedY - 1.875f, bedZ - .375f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 1.5f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // leg 4
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX + 0.875f, bedY - 1.875f, bedZ - .375f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.25f, scale_Y * 0.25f, scale_Z * 1.5f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // Head side
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX, bedY + 2.0, bedZ + 0.25f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 4.0f, scale_Y * 0.05f, scale_Z * 0.5f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // pillow right
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX + 0.45f, bedY + 1.7f, bedZ + .25f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 1.5f, scale_Y * 0.75f, scale_Z * 0.25f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                // pillow left
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(bedX - 0.45f, bedY + 1.7f, bedZ + .25f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 1.5f, scale_Y * 0.75f, scale_Z * 0.25f));
-                model = translateMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-            }
-
-
-            // Fan 2
-            {
-                float fanX = -2.5f, fanY = 1.5f, fanZ = 4.5f;
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(fanX, fanY, fanZ));
-                rotateYMatrix = glm::rotate(identityMatrix, glm::radians(fan_rotateAngle_Y), glm::vec3(0.0f, 0.0f, 1.0f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.5f, scale_Y * 0.5f, scale_Z * 0.5f));
-                model = translateMatrix * rotateYMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 4.0f, scale_Y * 0.5f, scale_Z * 0.1f));
-                model = translateMatrix * rotateYMatrix * scaleMatrix;
-                ourShader.setMat4("model", model);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.5f, scale_Y * 4.0f, scale_Z * 0.1f));
-                model = translateMatrix * rotateYMatrix * scaleMatrix;
-                ourShader.setMat4("model", model);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-                if (fan_on) {
-                    fan_rotateAngle_Y -= 0.1f;
-                }
-
-                glBindVertexArray(VAO);
-
-
-                translateMatrix = glm::translate(identityMatrix, glm::vec3(fanX, fanY, fanZ + .25f));
-                rotateYMatrix = glm::rotate(identityMatrix, glm::radians(rotateAngle_Y), glm::vec3(0.0f, 0.0f, 1.0f));
-                scaleMatrix = glm::scale(identityMatrix, glm::vec3(scale_X * 0.1f, scale_Y * 0.1f, scale_Z));
-                model = translateMatrix * rotateYMatrix * scaleMatrix;
-
-                ourShader.setMat4("model", model);
-                glBindVertexArray(VAO);
-                glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-            }
-
-            // render boxes
-            //for (unsigned int i = 0; i < 10; i++)
-            //{
-            //    // calculate the model matrix for each object and pass it to shader before drawing
-            //    glm::mat4 model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
-            //    model = glm::translate(model, cubePositions[i]);
-            //    float angle = 20.0f * i;
-            //    model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-            //    ourShader.setMat4("model", model);
-
-            //    glDrawArrays(GL_TRIANGLES, 0, 36);
-            //}
-
-            // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-            // -------------------------------------------------------------------------------
-            glfwSwapBuffers(window);
-            glfwPollEvents();
-        }
-
-    // optional: de-allocate all resources once they've outlived their purpose:
-    // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    // ------------------------------------------------------------------
-    glfwTerminate();
-    return 0;
-}
-
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-// ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow* window)
-{
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
-
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-        camera.ProcessKeyboard(FORWARD, deltaTime);
-    }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
-    }
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-        camera.ProcessKeyboard(LEFT, deltaTime);
-    }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-        camera.ProcessKeyboard(RIGHT, deltaTime);
-    }
-
-    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS)
-    {
-        fan_on = !fan_on;
-    }
-
-    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS)
+    if (inputSession.GetKey(window, GLFW_KEY_R) == GLFW_PRESS)
     {
         if (rotateAxis_X) rotateAngle_X -= 1;
         else if (rotateAxis_Y) rotateAngle_Y -= 1;
@@ -1237,9 +1500,19 @@ void processInput(GLFWwindow* window)
 // ---------------------------------------------------------------------------------------------
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
+    if (!inputSession.Accept(INPUT_RESIZE, width, height))
+        return;
+
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+
+    // a minimized window reports 0x0; keep the last size so the aspect ratio stays valid
+    if (width > 0 && height > 0)
+    {
+        framebufferWidth = width;
+        framebufferHeight = height;
+    }
 }
 
 
@@ -1247,6 +1520,11 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 // -------------------------------------------------------
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 {
+    if (!inputSession.Accept(INPUT_CURSOR, xposIn, yposIn))
+        return;
+    if (inputEventTime == 0.0)
+        inputEventTime = glfwGetTime();
+
     float xpos = static_cast<float>(xposIn);
     float ypos = static_cast<float>(yposIn);
 
@@ -1266,10 +1544,314 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
     camera.ProcessMouseMovement(xoffset, yoffset);
 }
 
+// glfw: whenever a mouse button is pressed or released, this callback is called
+// -------------------------------------------------------------------------------
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    if (!inputSession.Accept(INPUT_MOUSE_BUTTON, 0.0, 0.0, button, action, mods))
+        return;
+    if (inputEventTime == 0.0)
+        inputEventTime = glfwGetTime();
+
+    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+        pickRequested = true;
+}
+
+// glfw: whenever a key is pressed, repeated or released, this callback is called
+// --------------------------------------------------------------------------------
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    // keys are polled in processInput(); this only times their arrival for the input latency
+    if (inputEventTime == 0.0 && inputSession.Mode != INPUT_REPLAY)
+        inputEventTime = glfwGetTime();
+}
+
+// glfw: whenever the window contents need to be shown again (uncovered, restored), this callback is called
+// --------------------------------------------------------------------------------------------------------
+void window_refresh_callback(GLFWwindow* window)
+{
+    windowDamaged = true;
+}
+
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
+    if (!inputSession.Accept(INPUT_SCROLL, xoffset, yoffset))
+        return;
+    if (inputEventTime == 0.0)
+        inputEventTime = glfwGetTime();
+
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
+// one room of the streamed building; runs on a worker thread, so it only writes to data.
+// The layout varies per chunk but is a pure function of the chunk coordinate.
+// ---------------------------------------------------------------------------------------
+void buildChunk(const glm::ivec2& chunk, const glm::vec2& origin, ChunkData& data)
+{
+    // the hand built room sits in chunk (0, 0)
+    if (chunk.x == 0 && chunk.y == 0)
+        return;
+
+    unsigned int hash = static_cast<unsigned int>(chunk.x) * 73856093u ^ static_cast<unsigned int>(chunk.y) * 19349663u;
+    hash = (hash ^ (hash >> 13)) * 0x5bd1e995u;
+    hash ^= hash >> 15;
+    auto random = [&hash]() {
+        hash = hash * 1664525u + 1013904223u;
+        return static_cast<float>(hash >> 8) / 16777216.0f;
+    };
+
+    glm::mat4 identityMatrix = glm::mat4(1.0f);
+    auto addPart = [&](const glm::vec3& position, const glm::vec3& scale, unsigned int material) {
+        SceneInstance instance;
+        instance.Model = glm::translate(identityMatrix, glm::vec3(origin, 0.0f) + position) * glm::scale(identityMatrix, scale);
+        instance.Material = material;
+        instance.View = 0;
+        instance.Lightmap = LIGHTMAP_NONE;
+        instance.Padding = 0;
+        data.Instances.push_back(instance);
+        data.Bounds.Expand(TransformedCubeBounds(instance.Model));
+    };
+
+    // floor and ceiling
+    addPart(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(20.0f, 14.0f, 0.05f), MATERIAL_FLOOR);
+    addPart(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(20.0f, 14.0f, 0.05f), MATERIAL_CEILING);
+
+    // walls on the -x and -y sides with a doorway; the neighbours close the other sides.
+    // The hand built room already has walls where its neighbours' would go.
+    float door = -2.0f + random() * 4.0f;
+    if (!(chunk.x == 1 && chunk.y == 0))
+    {
+        addPart(glm::vec3(-5.0f, (-3.5f + door - 0.5f) * 0.5f, 2.5f), glm::vec3(0.05f, (door - 0.5f + 3.5f) * 2.0f, 10.0f), MATERIAL_WALL);
+        addPart(glm::vec3(-5.0f, (3.5f + door + 0.5f) * 0.5f, 2.5f), glm::vec3(0.05f, (3.5f - door - 0.5f) * 2.0f, 10.0f), MATERIAL_WALL);
+    }
+    door = -3.0f + random() * 6.0f;
+    if (!(chunk.x == 0 && chunk.y == 1))
+    {
+        addPart(glm::vec3((-5.0f + door - 0.5f) * 0.5f, -3.5f, 2.5f), glm::vec3((door - 0.5f + 5.0f) * 2.0f, 0.05f, 10.0f), MATERIAL_WALL);
+        addPart(glm::vec3((5.0f + door + 0.5f) * 0.5f, -3.5f, 2.5f), glm::vec3((5.0f - door - 0.5f) * 2.0f, 0.05f, 10.0f), MATERIAL_WALL);
+    }
+
+    // bed against the back wall
+    float bedX = -3.0f + random() * 6.0f;
+    addPart(glm::vec3(bedX, 2.0f, 0.5f), glm::vec3(4.0f, 6.0f, 1.0f), MATERIAL_WOOD);
+    addPart(glm::vec3(bedX, 1.9f, 0.85f), glm::vec3(3.8f, 5.6f, 0.4f), MATERIAL_SHEET);
+    addPart(glm::vec3(bedX, 3.1f, 1.05f), glm::vec3(3.0f, 0.75f, 0.25f), MATERIAL_PILLOW);
+
+    // table with four legs and a chair
+    float tableX = -3.0f + random() * 6.0f, tableY = -2.0f + random() * 1.5f;
+    addPart(glm::vec3(tableX, tableY, 1.5f), glm::vec3(4.0f, 2.5f, 0.05f), MATERIAL_DARK_WOOD);
+    for (int leg = 0; leg < 4; leg++)
+        addPart(glm::vec3(tableX + (leg & 1 ? 0.875f : -0.875f), tableY + (leg & 2 ? 0.5f : -0.5f), 0.75f), glm::vec3(0.25f, 0.25f, 3.0f), MATERIAL_DARK_WOOD);
+    addPart(glm::vec3(tableX, tableY + 1.2f, 0.75f), glm::vec3(2.0f, 2.0f, 0.05f), MATERIAL_WOOD);
+    addPart(glm::vec3(tableX, tableY + 1.65f, 1.25f), glm::vec3(2.0f, 0.1f, 2.0f), MATERIAL_WOOD);
+    for (int leg = 0; leg < 4; leg++)
+        addPart(glm::vec3(tableX + (leg & 1 ? 0.4f : -0.4f), tableY + 1.2f + (leg & 2 ? 0.4f : -0.4f), 0.375f), glm::vec3(0.2f, 0.2f, 1.5f), MATERIAL_WOOD);
+
+    // a wardrobe in some rooms
+    if (random() < 0.5f)
+        addPart(glm::vec3(4.4f, -1.0f + random() * 2.0f, 1.75f), glm::vec3(2.0f, 4.0f, 7.0f), MATERIAL_DARK_WOOD);
+}
+
+// a vertex array for the cube's vertex and index buffers (instance attributes are attached separately)
+// ---------------------------------------------------------------------------------------------------
+unsigned int createCubeVertexArray(const GpuBlock& vertices, const GpuBlock& indices)
+{
+    unsigned int cubeVAO;
+    glGenVertexArrays(1, &cubeVAO);
+    glBindVertexArray(cubeVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, vertices.Buffer());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.Buffer());
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)vertices.Offset());
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(vertices.Offset() + 12));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+    return cubeVAO;
+}
+
+// color, roughness, texture layer and opacity of every Room_Material
+// ---------------------------------------------------------
+void createRoomMaterials(MaterialTable& materials)
+{
+    materials.Add(glm::vec3(0.72f, 0.50f, 0.30f), 0.6f, LAYER_WOOD);       // MATERIAL_WOOD
+    materials.Add(glm::vec3(0.42f, 0.26f, 0.15f), 0.5f, LAYER_WOOD);       // MATERIAL_DARK_WOOD
+    materials.Add(glm::vec3(0.80f, 0.85f, 0.95f), 0.9f, LAYER_FABRIC);     // MATERIAL_SHEET
+    materials.Add(glm::vec3(0.95f, 0.93f, 0.85f), 0.9f, LAYER_FABRIC);     // MATERIAL_PILLOW
+    materials.Add(glm::vec3(0.65f, 0.62f, 0.58f), 0.3f, LAYER_TILES);      // MATERIAL_FLOOR
+    materials.Add(glm::vec3(0.85f, 0.82f, 0.74f), 0.95f, LAYER_PLASTER);   // MATERIAL_WALL
+    materials.Add(glm::vec3(0.95f, 0.95f, 0.95f), 0.95f, LAYER_PLASTER);   // MATERIAL_CEILING
+    materials.Add(glm::vec3(0.30f, 0.30f, 0.32f), 0.4f);                   // MATERIAL_WINDOW_FRAME
+    materials.Add(glm::vec3(0.60f, 0.62f, 0.65f), 0.2f);                   // MATERIAL_METAL
+    materials.Add(glm::vec3(0.70f, 0.82f, 0.88f), 0.05f, MATERIAL_NO_TEXTURE, 0.25f);   // MATERIAL_GLASS
+    materials.Add(glm::vec3(0.55f, 0.12f, 0.14f), 0.9f, LAYER_FABRIC);     // MATERIAL_CURTAIN
+}
+
+// fixed monitoring cameras in the upper corners of the room, looking at its center
+// ---------------------------------------------------------------------------------
+void setMonitorViews(MultiView& multiView, const AABB& room)
+{
+    const glm::vec3 corners[3] = {
+        glm::vec3(room.Min.x, room.Min.y, room.Max.z),
+        glm::vec3(room.Max.x, room.Min.y, room.Max.z),
+        glm::vec3(room.Max.x, room.Max.y, room.Max.z)
+    };
+    glm::vec3 center = room.Center();
+    for (int i = 1; i < multiView.ViewCount; i++)
+    {
+        // pulled slightly towards the center so the camera is inside the walls
+        glm::vec3 eye = glm::mix(corners[i - 1], center, 0.1f);
+        glm::mat4 projection = glm::perspective(glm::radians(MONITOR_FOV), multiView.Aspect(i), 0.1f, 100.0f);
+        multiView.SetView(i, projection, glm::lookAt(eye, center, glm::vec3(0.0f, 0.0f, 1.0f)));
+    }
+}
+
+// feeds a recorded event back through the callback that originally received it
+// ------------------------------------------------------------------------------
+void dispatchInputEvent(GLFWwindow* window, const InputEvent& event)
+{
+    switch (event.Type)
+    {
+    case INPUT_CURSOR:
+        mouse_callback(window, event.X, event.Y);
+        break;
+    case INPUT_SCROLL:
+        scroll_callback(window, event.X, event.Y);
+        break;
+    case INPUT_MOUSE_BUTTON:
+        mouse_button_callback(window, event.Button, event.Action, event.Mods);
+        break;
+    case INPUT_RESIZE:
+        framebuffer_size_callback(window, static_cast<int>(event.X), static_cast<int>(event.Y));
+        break;
+    }
+}
+
+// bakes the lighting of every part no animation moves, in passes of LIGHTMAP_PASS_SAMPLES
+// samples per texel; the file is rewritten after each pass so a long bake can be stopped early
+int bakeRoomLightmap(unsigned int samplesPerTexel)
+{
+    MaterialTable materials;
+    createRoomMaterials(materials);
+    Scene scene;
+    AnimationSystem animation;
+    std::vector<unsigned int> fanRotators;
+    buildRoom(scene, animation, fanRotators);
+
+    std::vector<unsigned char> partStatic(scene.PartCount(), 1);
+    std::vector<unsigned int> movingNodes(animation.RotatorNode);
+    movingNodes.insert(movingNodes.end(), animation.TrackNode.begin(), animation.TrackNode.end());
+    for (unsigned int node : movingNodes)
+        for (unsigned int part = scene.NodeFirstPart[node]; part < scene.NodeFirstPart[node] + scene.NodePartCount[node]; part++)
+            partStatic[part] = 0;
+    // light passes through glass; it is lit dynamically
+    for (unsigned int part = 0; part < scene.PartCount(); part++)
+        if (materials.Transparent(scene.PartMaterial[part]))
+            partStatic[part] = 0;
+
+    ThreadPool pool;
+    LightmapBaker baker(scene, partStatic, materials);
+    std::cout << "baking " << baker.TexelCount() << " texels into a " << baker.AtlasWidth << "x" << baker.AtlasHeight
+              << " atlas on " << pool.Size() << " threads" << std::endl;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (baker.SamplesPerTexel < samplesPerTexel)
+    {
+        unsigned int passSamples = std::min(LIGHTMAP_PASS_SAMPLES, samplesPerTexel - baker.SamplesPerTexel);
+        std::chrono::steady_clock::time_point passStart = std::chrono::steady_clock::now();
+        baker.Refine(pool, passSamples);
+        double seconds = benchmarkSeconds(passStart);
+        if (!baker.Save(LIGHTMAP_PATH))
+        {
+            std::cout << "Failed to write " << LIGHTMAP_PATH << std::endl;
+            return -1;
+        }
+        std::cout << "pass " << baker.Passes << ": " << baker.SamplesPerTexel << " samples per texel, "
+                  << static_cast<int>(seconds * 1000.0) << " ms, "
+                  << static_cast<int>(baker.TexelCount() * passSamples / seconds / 1000.0) << "k paths/s" << std::endl;
+    }
+    std::cout << "lightmap written to " << LIGHTMAP_PATH << " in " << benchmarkSeconds(start) << " s" << std::endl;
+    return 0;
+}
+
+// renders a camera file into images without opening the interactive window
+// -------------------------------------------------------------------------
+int renderImageBatch(const char* cameraPath, const char* outputPattern, int width, int height, unsigned int contextCount)
+{
+    std::vector<BatchCamera> cameras;
+    FILE* file = fopen(cameraPath, "r");
+    if (file == NULL)
+    {
+        std::cout << "Failed to open camera list " << cameraPath << std::endl;
+        return -1;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        BatchCamera camera;
+        camera.Layout = 0;
+        camera.Fov = BATCH_DEFAULT_FOV;
+        if (sscanf(line, "%f %f %f %f %f %f %f", &camera.Position.x, &camera.Position.y, &camera.Position.z,
+                   &camera.Target.x, &camera.Target.y, &camera.Target.z, &camera.Fov) >= 6)
+            cameras.push_back(camera);
+    }
+    fclose(file);
+    if (width <= 0 || height <= 0 || cameras.empty())
+    {
+        std::cout << "Nothing to render from " << cameraPath << std::endl;
+        return -1;
+    }
+
+    glfwInit();
+    Scene scene;
+    AnimationSystem animation;
+    std::vector<unsigned int> fanRotators;
+    buildRoom(scene, animation, fanRotators);
+
+    BatchRenderer batch(width, height, contextCount, createRoomMaterials, cube_vertices, sizeof(cube_vertices), cube_indices, sizeof(cube_indices));
+    if (!batch.Ok())
+    {
+        glfwTerminate();
+        return -1;
+    }
+    batch.AddLayout(scene);
+
+    // PPM stores rows top to bottom; each worker encodes and writes its own images
+    std::atomic<unsigned int> failures(0);
+    batch.Render(cameras.data(), static_cast<unsigned int>(cameras.size()), [outputPattern, &failures](const BatchImage& image) {
+        char path[1024];
+        snprintf(path, sizeof(path), outputPattern, static_cast<int>(image.Index));
+        std::vector<unsigned char> encoded(static_cast<size_t>(image.Width) * image.Height * 3);
+        for (int y = 0; y < image.Height; y++)
+        {
+            const unsigned char* in = image.Pixels + static_cast<size_t>(image.Height - 1 - y) * image.Width * 4;
+            unsigned char* out = &encoded[static_cast<size_t>(y) * image.Width * 3];
+            for (int x = 0; x < image.Width; x++)
+            {
+                out[x * 3 + 0] = in[x * 4 + 0];
+                out[x * 3 + 1] = in[x * 4 + 1];
+                out[x * 3 + 2] = in[x * 4 + 2];
+            }
+        }
+        FILE* output = fopen(path, "wb");
+        if (output == NULL)
+        {
+            failures.fetch_add(1);
+            return;
+        }
+        fprintf(output, "P6\n%d %d\n255\n", image.Width, image.Height);
+        fwrite(encoded.data(), 1, encoded.size(), output);
+        fclose(output);
+    });
+    batch.PrintStats();
+    batch.Release();
+    glfwTerminate();
+
+    if (failures.load() > 0)
+    {
+        std::cout << "Failed to write " << failures.load() << " images to " << outputPattern << std::endl;
+        return -1;
+    }
+    return 0;
+}
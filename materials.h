@@ -0,0 +1,162 @@
+//
+//  materials.h
+//  3D Object Drawing
+//
+//  Material table shared by every draw. Each material is two RGBA32F texels in a
+//  texture buffer (color, then roughness and texture layer) that the scene shader
+//  indexes with the per-instance material id, plus a texture array holding the
+//  layers materials can reference. The layers are generated procedurally. The
+//  color's alpha is the material's opacity; SceneRenderer draws the instances of
+//  materials below 1 in its transparent pass.
+//
+
+#ifndef MATERIALS_H
+#define MATERIALS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// texture array layers; MATERIAL_NO_TEXTURE uses the flat color only
+enum Material_Layer {
+    MATERIAL_NO_TEXTURE = -1,
+    LAYER_WOOD,
+    LAYER_FABRIC,
+    LAYER_TILES,
+    LAYER_PLASTER,
+    MATERIAL_LAYER_COUNT
+};
+
+const int MATERIAL_TEXTURE_SIZE = 128;
+
+// grayscale detail pattern of a layer at (u, v) in [0, 1), the same at any resolution;
+// tinted by the material color in the shader
+inline float MaterialLayerValue(int layer, float u, float v)
+{
+    switch (layer)
+    {
+    case LAYER_WOOD:
+        return 0.75f + 0.25f * std::sin((v * 24.0f + 2.0f * std::sin(u * 6.2832f * 2.0f)) * 3.1416f);
+    case LAYER_FABRIC:
+        return ((static_cast<int>(u * 32.0f) + static_cast<int>(v * 32.0f)) % 2) ? 0.85f : 1.0f;
+    case LAYER_TILES:
+        return (u * 4.0f - std::floor(u * 4.0f) < 1.0f / 16.0f || v * 4.0f - std::floor(v * 4.0f) < 1.0f / 16.0f) ? 0.55f : 1.0f;
+    case LAYER_PLASTER:
+        return 0.92f + 0.08f * std::sin(u * 91.0f) * std::sin(v * 77.0f);
+    default:
+        return 1.0f;
+    }
+}
+
+// texture buffer layout, two texels per material
+struct Material
+{
+    glm::vec4 Color;
+    float Roughness;
+    float Layer;
+    float Padding[2];
+};
+
+class MaterialTable
+{
+public:
+    std::vector<Material> Materials;
+    unsigned int Buffer, BufferTexture, TextureArray;
+
+    MaterialTable() : Buffer(0), BufferTexture(0), TextureArray(0) {}
+
+    unsigned int Add(const glm::vec3& color, float roughness, int layer = MATERIAL_NO_TEXTURE, float opacity = 1.0f)
+    {
+        Material material;
+        material.Color = glm::vec4(color, opacity);
+        material.Roughness = roughness;
+        material.Layer = static_cast<float>(layer);
+        material.Padding[0] = material.Padding[1] = 0.0f;
+        Materials.push_back(material);
+        return static_cast<unsigned int>(Materials.size() - 1);
+    }
+
+    bool Transparent(unsigned int material) const
+    {
+        return Materials[material].Color.w < 1.0f;
+    }
+
+    bool HasTransparent() const
+    {
+        for (const Material& material : Materials)
+            if (material.Color.w < 1.0f)
+                return true;
+        return false;
+    }
+
+    // (re)uploads the table; cheap enough to call after editing materials at runtime
+    void Upload()
+    {
+        if (Buffer == 0)
+        {
+            glGenBuffers(1, &Buffer);
+            glGenTextures(1, &BufferTexture);
+            createLayers();
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, Buffer);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(Material) * Materials.size(), Materials.data(), GL_STATIC_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, BufferTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, Buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // binds the table to tableUnit and the layers to layerUnit
+    void Bind(int tableUnit, int layerUnit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + tableUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, BufferTexture);
+        glActiveTexture(GL_TEXTURE0 + layerUnit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, TextureArray);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void Release()
+    {
+        glDeleteTextures(1, &BufferTexture);
+        glDeleteTextures(1, &TextureArray);
+        glDeleteBuffers(1, &Buffer);
+        Buffer = BufferTexture = TextureArray = 0;
+    }
+
+private:
+    // the layers at MATERIAL_TEXTURE_SIZE; TextureStreamer streams finer ones when a texture pack is present
+    void createLayers()
+    {
+        const int size = MATERIAL_TEXTURE_SIZE;
+        std::vector<unsigned char> pixels(static_cast<size_t>(size) * size * 4 * MATERIAL_LAYER_COUNT);
+        for (int layer = 0; layer < MATERIAL_LAYER_COUNT; layer++)
+        {
+            for (int y = 0; y < size; y++)
+            {
+                for (int x = 0; x < size; x++)
+                {
+                    float value = MaterialLayerValue(layer, static_cast<float>(x) / size, static_cast<float>(y) / size);
+                    unsigned char c = static_cast<unsigned char>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f);
+                    unsigned char* p = &pixels[((static_cast<size_t>(layer) * size + y) * size + x) * 4];
+                    p[0] = p[1] = p[2] = c;
+                    p[3] = 255;
+                }
+            }
+        }
+
+        glGenTextures(1, &TextureArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, TextureArray);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size, size, MATERIAL_LAYER_COUNT, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,92 @@
+//
+//  multi_view.h
+//  3D Object Drawing
+//
+//  Renders up to MULTIVIEW_MAX_VIEWS cameras into tiles of one render target in a
+//  single pass. Culling walks the BVH once for all view frustums and yields a view
+//  mask per part; SceneRenderer then emits one instance per part and view, and the
+//  vertex shader places every instance in its view's tile (clip distances keep it there).
+//
+
+#ifndef MULTI_VIEW_H
+#define MULTI_VIEW_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "bvh.h"
+#include "scene_renderer.h"
+
+#include <algorithm>
+
+const int MULTIVIEW_MAX_VIEWS = SCENE_MAX_VIEWS;
+
+class MultiView
+{
+public:
+    int ViewCount;
+    glm::mat4 Projection[MULTIVIEW_MAX_VIEWS];
+    glm::mat4 View[MULTIVIEW_MAX_VIEWS];
+    glm::ivec4 Tiles[MULTIVIEW_MAX_VIEWS];      // x, y, width, height in pixels of the render target
+    Frustum Frustums[MULTIVIEW_MAX_VIEWS];
+
+    explicit MultiView(int viewCount)
+        : ViewCount(std::min(std::max(viewCount, 1), MULTIVIEW_MAX_VIEWS)), targetWidth(1), targetHeight(1)
+    {
+    }
+
+    // splits the render target into a grid: one view fills it, two sit side by side,
+    // three or four share a 2x2 grid
+    void Layout(int width, int height)
+    {
+        targetWidth = std::max(width, 1);
+        targetHeight = std::max(height, 1);
+        int columns = ViewCount > 1 ? 2 : 1;
+        int rows = ViewCount > 2 ? 2 : 1;
+        int tileWidth = targetWidth / columns;
+        int tileHeight = targetHeight / rows;
+        for (int i = 0; i < ViewCount; i++)
+        {
+            int column = i % columns;
+            int row = rows - 1 - i / columns;       // first row at the top
+            Tiles[i] = glm::ivec4(column * tileWidth, row * tileHeight, tileWidth, tileHeight);
+        }
+    }
+
+    float Aspect(int view) const
+    {
+        return static_cast<float>(Tiles[view].z) / static_cast<float>(std::max(Tiles[view].w, 1));
+    }
+
+    void SetView(int view, const glm::mat4& projection, const glm::mat4& viewMatrix)
+    {
+        Projection[view] = projection;
+        View[view] = viewMatrix;
+        Frustums[view] = Frustum(projection * viewMatrix);
+    }
+
+    // one BVH walk for all views; masks[i] has bit v set when parts[i] is visible in view v
+    unsigned int Cull(const BVH& bvh, unsigned int* parts, unsigned int* masks, unsigned int capacity) const
+    {
+        return bvh.QueryFrustums(Frustums, static_cast<unsigned int>(ViewCount), parts, masks, capacity);
+    }
+
+    // per-view parameters for SceneRenderer::Draw
+    void DrawParameters(glm::mat4* viewProjection, glm::vec4* tiles, glm::vec3* eyes) const
+    {
+        for (int i = 0; i < ViewCount; i++)
+        {
+            viewProjection[i] = Projection[i] * View[i];
+            glm::vec2 scale(static_cast<float>(Tiles[i].z) / targetWidth, static_cast<float>(Tiles[i].w) / targetHeight);
+            glm::vec2 center((Tiles[i].x + Tiles[i].z * 0.5f) / targetWidth, (Tiles[i].y + Tiles[i].w * 0.5f) / targetHeight);
+            tiles[i] = glm::vec4(scale.x, scale.y, center.x * 2.0f - 1.0f, center.y * 2.0f - 1.0f);
+            eyes[i] = glm::vec3(glm::inverse(View[i])[3]);
+        }
+    }
+
+private:
+    int targetWidth, targetHeight;
+};
+
+#endif
@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 FragColor;
+
+// added (blended GL_ONE, GL_ONE) for every fragment that gets shaded: red saturates after 4
+// layers, green after 12 and blue after 42, so the image runs black - red - yellow - white.
+// Blue steps are exact in an 8 bit target; must match OVERDRAW_BLUE_STEP in overdraw_meter.h
+const vec3 LAYER = vec3(64.0, 21.0, 6.0) / 255.0;
+
+void main()
+{
+    FragColor = vec4(LAYER, 1.0);
+}
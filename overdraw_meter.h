@@ -0,0 +1,74 @@
+//
+//  overdraw_meter.h
+//  3D Object Drawing
+//
+//  Reads back a frame drawn with SceneRenderer::Overdraw and turns the heat map
+//  into numbers: every shaded fragment added OVERDRAW_BLUE_STEP to the blue
+//  channel, so blue / step is the number of fragments shaded for that pixel. The
+//  average over the covered pixels is the overdraw the ordering and the depth
+//  pre-pass are meant to bring down. The readback stalls the pipeline; it is a
+//  debugging aid, not something to leave on while profiling frame times.
+//
+
+#ifndef OVERDRAW_METER_H
+#define OVERDRAW_METER_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <vector>
+
+// must match LAYER.b in overdrawShader.fs
+const int OVERDRAW_BLUE_STEP = 6;
+
+class OverdrawMeter
+{
+public:
+    // last measured frame
+    unsigned long long ShadedFragments, CoveredPixels, Pixels;
+
+    // running totals over all measured frames
+    unsigned long long Frames;
+    double AverageSum;
+
+    OverdrawMeter() : ShadedFragments(0), CoveredPixels(0), Pixels(0), Frames(0), AverageSum(0.0) {}
+
+    // counts the shaded fragments of the bound read framebuffer's width x height pixels
+    void Measure(int width, int height)
+    {
+        pixels.resize(static_cast<size_t>(width) * height * 4);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+        ShadedFragments = CoveredPixels = 0;
+        Pixels = static_cast<unsigned long long>(width) * height;
+        for (size_t i = 2; i < pixels.size(); i += 4)
+        {
+            // a saturated channel means 42 layers or more
+            unsigned int layers = (pixels[i] + OVERDRAW_BLUE_STEP / 2) / OVERDRAW_BLUE_STEP;
+            ShadedFragments += layers;
+            CoveredPixels += layers > 0;
+        }
+        Frames++;
+        AverageSum += Average();
+    }
+
+    // shaded fragments per covered pixel in the last measured frame; 1.0 is no overdraw
+    double Average() const
+    {
+        return CoveredPixels > 0 ? static_cast<double>(ShadedFragments) / CoveredPixels : 0.0;
+    }
+
+    void PrintStats() const
+    {
+        if (Frames == 0)
+            return;
+        std::cout << "overdraw: " << Frames << " frames, average " << AverageSum / Frames << " shaded fragments per covered pixel"
+                  << " (last frame " << Average() << ", " << CoveredPixels * 100 / (Pixels > 0 ? Pixels : 1) << "% covered)" << std::endl;
+    }
+
+private:
+    std::vector<unsigned char> pixels;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#version 330 core
+in vec2 corner;
+in float brightness;
+
+uniform vec3 dustColor;
+
+out vec4 FragColor;
+
+void main()
+{
+    // a soft round speck, added to whatever is behind it
+    float r2 = dot(corner, corner);
+    if (r2 > 1.0 || brightness <= 0.0)
+        discard;
+    FragColor = vec4(dustColor * (brightness * (1.0 - r2)), 1.0);
+}
@@ -0,0 +1,35 @@
+#version 330 core
+layout (location = 0) in vec4 particle;         // position, fade
+
+// must match PARTICLE_MAX_WINDOWS in particles.h
+const int MAX_WINDOWS = 4;
+
+uniform mat4 viewProjection;
+uniform vec3 cameraRight;
+uniform vec3 cameraUp;
+uniform float particleSize;
+uniform vec3 lightDirection;
+uniform vec4 windows[MAX_WINDOWS];              // openings in the wall y = windowWallY: center x, z, half width, height
+uniform int windowCount;
+uniform float windowWallY;
+uniform float ambient;
+
+out vec2 corner;
+out float brightness;
+
+void main()
+{
+    // a quad facing the camera; the strip's four corners come from gl_VertexID
+    corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    vec3 position = particle.xyz + (cameraRight * corner.x + cameraUp * corner.y) * particleSize;
+
+    // sunlit when the way back to the light leaves the room through a window
+    float lit = 0.0;
+    float t = (windowWallY - particle.y) / -lightDirection.y;
+    vec3 wall = particle.xyz - lightDirection * t;
+    for (int i = 0; i < windowCount; i++)
+        lit = max(lit, step(abs(wall.x - windows[i].x), windows[i].z) * step(abs(wall.z - windows[i].y), windows[i].w));
+    brightness = particle.w * max(ambient, lit * step(0.0, t));
+
+    gl_Position = viewProjection * vec4(position, 1.0);
+}
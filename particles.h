@@ -0,0 +1,390 @@
+//
+//  particles.h
+//  3D Object Drawing
+//
+//  Dust carried by the air the ceiling fans move. ParticleSystem keeps the
+//  particles as flat per-field arrays and advects them as massless tracers
+//  through the fans' airflow (see airflow.h). Each particle also wanders with a small drift of its own, so still air is not
+//  frozen. The update walks the arrays in blocks of PARTICLE_LANES into local
+//  lane arrays, a shape compilers turn into SIMD code without intrinsics, and the
+//  blocks are split across the thread pool. Particles that reach the end of their
+//  life are respawned somewhere else in the room.
+//
+//  The same pass writes every particle packed as (position, fade) straight into
+//  the buffer ParticleRenderer draws from: with GL 4.4 that is one of three
+//  regions of a persistently mapped buffer, fenced so the CPU never writes a
+//  region the GPU still reads, otherwise a CPU copy uploaded with
+//  glBufferSubData (also what GL captures see). The renderer draws one camera
+//  facing quad per particle, instanced, brightening the ones inside the
+//  sunlight coming through the window openings.
+//
+
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "airflow.h"
+#include "shader.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// particles per block of the update; counts are rounded up to a multiple of it
+const unsigned int PARTICLE_LANES = 8;
+// blocks per chunk below which splitting across threads costs more than it saves
+const size_t PARTICLE_PARALLEL_BLOCKS = 1024;
+
+const int PARTICLE_MAX_FANS = AIRFLOW_MAX_FANS;
+
+// lifetime and drift of a particle
+const float PARTICLE_MIN_LIFE = 4.0f;       // seconds
+const float PARTICLE_MAX_LIFE = 12.0f;
+const float PARTICLE_FADE_TIME = 1.0f;      // fade in after spawning and out before respawning
+const float PARTICLE_DRIFT = 0.04f;         // wander speed in still air
+const float PARTICLE_SETTLE = 0.01f;        // sinking speed
+
+// drawing: must match MAX_WINDOWS in particle.vs
+const int PARTICLE_MAX_WINDOWS = 4;
+const unsigned int PARTICLE_BUFFER_REGIONS = 3;
+
+// 32-bit integer hash (Chris Wellons' lowbias32)
+inline uint32_t particleHash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// uniform in [0, 1) from a seed
+inline float particleRandom(uint32_t seed)
+{
+    return static_cast<float>(particleHash(seed) >> 8) * (1.0f / 16777216.0f);
+}
+
+class ParticleSystem
+{
+public:
+    // per-particle fields
+    std::vector<float> PositionX, PositionY, PositionZ;
+    std::vector<float> DriftX, DriftY, DriftZ;      // own velocity on top of the air's
+    std::vector<float> Age, Life;                   // seconds
+
+    glm::vec3 BoundsMin, BoundsMax;                 // the room's inside; particles stay in it
+    Airflow Fans[PARTICLE_MAX_FANS];
+    int FanCount;
+
+    ParticleSystem()
+        : BoundsMin(0.0f), BoundsMax(0.0f), FanCount(0), frame(0)
+    {
+    }
+
+    unsigned int Count() const { return static_cast<unsigned int>(PositionX.size()); }
+
+    // fills the bounds with count particles (rounded up to whole blocks) at random ages
+    void Spawn(unsigned int count, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        BoundsMin = boundsMin;
+        BoundsMax = boundsMax;
+        count = (count + PARTICLE_LANES - 1) / PARTICLE_LANES * PARTICLE_LANES;
+        for (std::vector<float>* field : { &PositionX, &PositionY, &PositionZ, &DriftX, &DriftY, &DriftZ, &Age, &Life })
+            field->assign(count, 0.0f);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            respawn(i);
+            Age[i] = particleRandom(i * 8u + 7u) * Life[i];
+        }
+    }
+
+    // replaces the fans; extra ones beyond PARTICLE_MAX_FANS are ignored
+    void SetFans(const Airflow* fans, int count)
+    {
+        FanCount = std::min(count, PARTICLE_MAX_FANS);
+        std::copy(fans, fans + FanCount, Fans);
+    }
+
+    // advances every particle by deltaTime and, when packed is not null, writes Count()
+    // (position, fade) entries into it
+    void Update(float deltaTime, glm::vec4* packed, ThreadPool* pool = nullptr)
+    {
+        frame++;
+        size_t blockCount = Count() / PARTICLE_LANES;
+        if (pool != nullptr)
+            pool->ParallelFor(blockCount, PARTICLE_PARALLEL_BLOCKS, [this, deltaTime, packed](size_t begin, size_t end) { update(begin, end, deltaTime, packed); });
+        else
+            update(0, blockCount, deltaTime, packed);
+    }
+
+    void Release()
+    {
+        for (std::vector<float>* field : { &PositionX, &PositionY, &PositionZ, &DriftX, &DriftY, &DriftZ, &Age, &Life })
+            std::vector<float>().swap(*field);
+    }
+
+private:
+    uint32_t frame;
+
+    void update(size_t firstBlock, size_t endBlock, float deltaTime, glm::vec4* packed)
+    {
+        float* px = PositionX.data();
+        float* py = PositionY.data();
+        float* pz = PositionZ.data();
+        const float* driftX = DriftX.data();
+        const float* driftY = DriftY.data();
+        const float* driftZ = DriftZ.data();
+        float* age = Age.data();
+        const float* life = Life.data();
+        // locals, so the stores through the arrays cannot change them
+        const glm::vec3 lower = BoundsMin, upper = BoundsMax;
+
+        for (size_t block = firstBlock; block < endBlock; block++)
+        {
+            size_t first = block * PARTICLE_LANES;
+            float* x = px + first;
+            float* y = py + first;
+            float* z = pz + first;
+            float vx[PARTICLE_LANES], vy[PARTICLE_LANES], vz[PARTICLE_LANES];
+            for (unsigned int l = 0; l < PARTICLE_LANES; l++)
+            {
+                vx[l] = driftX[first + l];
+                vy[l] = driftY[first + l];
+                vz[l] = driftZ[first + l];
+            }
+
+            // AirflowVelocity() spelled out per lane, without branches
+            for (int f = 0; f < FanCount; f++)
+            {
+                const Airflow& fan = Fans[f];
+                float r2 = fan.Radius * fan.Radius;
+                float push = AirflowPush(fan);
+                float swirlScale = std::copysign(AIRFLOW_SWIRL * push / fan.Radius, fan.Spin);
+                float outflowScale = push / fan.Radius;
+                for (unsigned int l = 0; l < PARTICLE_LANES; l++)
+                {
+                    float dx = x[l] - fan.Hub.x, dy = y[l] - fan.Hub.y;
+                    float spread = r2 / (r2 + dx * dx + dy * dy);
+                    float core = spread * spread;
+                    float under = std::min(std::max((fan.Hub.z - z[l]) * 4.0f, 0.0f), 1.0f);
+                    float floorLayer = std::max(1.0f - (z[l] - lower.z) * (1.0f / AIRFLOW_FLOOR_LAYER), 0.0f);
+                    float swirl = swirlScale * core;
+                    float outflow = outflowScale * floorLayer * spread;
+                    vx[l] += -dy * swirl + dx * outflow;
+                    vy[l] += dx * swirl + dy * outflow;
+                    vz[l] -= push * core * under;
+                }
+            }
+
+            float fade[PARTICLE_LANES];
+            for (unsigned int l = 0; l < PARTICLE_LANES; l++)
+            {
+                x[l] = std::min(std::max(x[l] + vx[l] * deltaTime, lower.x), upper.x);
+                y[l] = std::min(std::max(y[l] + vy[l] * deltaTime, lower.y), upper.y);
+                z[l] = std::min(std::max(z[l] + vz[l] * deltaTime, lower.z), upper.z);
+                float a = age[first + l] + deltaTime;
+                age[first + l] = a;
+                fade[l] = std::min(std::max(std::min(a, life[first + l] - a) * (1.0f / PARTICLE_FADE_TIME), 0.0f), 1.0f);
+            }
+
+            // rare, so out of the lanes
+            for (unsigned int l = 0; l < PARTICLE_LANES; l++)
+            {
+                if (age[first + l] >= life[first + l])
+                {
+                    respawn(first + l);
+                    fade[l] = 0.0f;
+                }
+            }
+
+            if (packed != nullptr)
+            {
+                for (unsigned int l = 0; l < PARTICLE_LANES; l++)
+                    packed[first + l] = glm::vec4(x[l], y[l], z[l], fade[l]);
+            }
+        }
+    }
+
+    // a fresh particle somewhere in the bounds; only touches particle i
+    void respawn(size_t i)
+    {
+        uint32_t seed = particleHash(static_cast<uint32_t>(i) * 0x9e3779b9u + frame) * 8u;
+        glm::vec3 extent = BoundsMax - BoundsMin;
+        PositionX[i] = BoundsMin.x + particleRandom(seed) * extent.x;
+        PositionY[i] = BoundsMin.y + particleRandom(seed + 1u) * extent.y;
+        PositionZ[i] = BoundsMin.z + particleRandom(seed + 2u) * extent.z;
+        DriftX[i] = (particleRandom(seed + 3u) * 2.0f - 1.0f) * PARTICLE_DRIFT;
+        DriftY[i] = (particleRandom(seed + 4u) * 2.0f - 1.0f) * PARTICLE_DRIFT;
+        DriftZ[i] = (particleRandom(seed + 5u) * 2.0f - 1.0f) * PARTICLE_DRIFT - PARTICLE_SETTLE;
+        Age[i] = 0.0f;
+        Life[i] = PARTICLE_MIN_LIFE + particleRandom(seed + 6u) * (PARTICLE_MAX_LIFE - PARTICLE_MIN_LIFE);
+    }
+};
+
+class ParticleRenderer
+{
+public:
+    float Size;                 // half extent of a particle's quad
+    glm::vec3 Color;            // added per fully lit particle
+    float Ambient;              // brightness outside the sunlight
+    bool Persistent;            // drawing from a persistently mapped buffer
+
+    ParticleRenderer()
+        : Size(0.006f), Color(1.0f, 0.92f, 0.75f), Ambient(0.08f), Persistent(false), capacity(0), buffer(0), region(0),
+          mapped(NULL), windowCount(0), shader("particle.vs", "particle.fs")
+    {
+        for (unsigned int i = 0; i < PARTICLE_BUFFER_REGIONS; i++)
+        {
+            vertexArrays[i] = 0;
+            fences[i] = 0;
+        }
+    }
+
+    // room for capacity particles; persistent asks for a mapped buffer, which needs GL 4.4
+    void Create(unsigned int particleCapacity, bool persistent)
+    {
+        capacity = particleCapacity;
+        Persistent = persistent && (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage);
+        GLsizeiptr regionBytes = static_cast<GLsizeiptr>(capacity) * sizeof(glm::vec4);
+        unsigned int regions = Persistent ? PARTICLE_BUFFER_REGIONS : 1;
+
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        if (Persistent)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, regionBytes * regions, NULL, flags);
+            mapped = static_cast<glm::vec4*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, regionBytes * regions, flags));
+            if (mapped == NULL)
+                std::cout << "ERROR::PARTICLES::MAP_FAILED" << std::endl;
+        }
+        else
+        {
+            glBufferData(GL_ARRAY_BUFFER, regionBytes, NULL, GL_STREAM_DRAW);
+            staging.resize(capacity);
+        }
+
+        // one vertex array per region, its attribute pointing at the region
+        glGenVertexArrays(regions, vertexArrays);
+        for (unsigned int i = 0; i < regions; i++)
+        {
+            glBindVertexArray(vertexArrays[i]);
+            glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)(regionBytes * i));
+            glEnableVertexAttribArray(0);
+            glVertexAttribDivisor(0, 1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // window openings the sun shines through, each (center x, center z, half width, half height)
+    // in the wall plane y = wallY
+    void SetWindows(const glm::vec4* windows, int count, float wallY)
+    {
+        windowCount = std::min(count, PARTICLE_MAX_WINDOWS);
+        shader.use();
+        if (windowCount > 0)
+            glUniform4fv(glGetUniformLocation(shader.ID, "windows"), windowCount, glm::value_ptr(windows[0]));
+        shader.setInt("windowCount", windowCount);
+        shader.setFloat("windowWallY", wallY);
+    }
+
+    // memory for this frame's Count() packed particles; waits while the GPU still reads it
+    glm::vec4* Map()
+    {
+        if (!Persistent)
+            return staging.data();
+        if (mapped == NULL)
+            return NULL;
+        region = (region + 1) % PARTICLE_BUFFER_REGIONS;
+        if (fences[region] != 0)
+        {
+            // the region was drawn from two frames ago, so this rarely blocks
+            while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+                ;
+            glDeleteSync(fences[region]);
+            fences[region] = 0;
+        }
+        return mapped + static_cast<size_t>(capacity) * region;
+    }
+
+    // draws the first count particles written since Map() into the bound framebuffer, blended
+    // additively over its colors and tested against (not written to) its depth
+    void Draw(unsigned int count, const glm::mat4& projection, const glm::mat4& view, const glm::vec3& lightDirection)
+    {
+        count = std::min(count, capacity);
+        if (count == 0 || (Persistent && mapped == NULL))
+            return;
+        if (!Persistent)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(capacity) * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(count) * sizeof(glm::vec4), staging.data());
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        shader.use();
+        shader.setMat4("viewProjection", projection * view);
+        shader.setVec3("cameraRight", glm::vec3(view[0][0], view[1][0], view[2][0]));
+        shader.setVec3("cameraUp", glm::vec3(view[0][1], view[1][1], view[2][1]));
+        shader.setFloat("particleSize", Size);
+        shader.setVec3("lightDirection", lightDirection);
+        shader.setVec3("dustColor", Color);
+        shader.setFloat("ambient", Ambient);
+
+        glDepthMask(GL_FALSE);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glBindVertexArray(vertexArrays[Persistent ? region : 0]);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count));
+        glBindVertexArray(0);
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+
+        if (Persistent)
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    void Release()
+    {
+        for (unsigned int i = 0; i < PARTICLE_BUFFER_REGIONS; i++)
+        {
+            if (fences[i] != 0)
+                glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+        if (mapped != NULL)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            mapped = NULL;
+        }
+        glDeleteVertexArrays(PARTICLE_BUFFER_REGIONS, vertexArrays);
+        glDeleteBuffers(1, &buffer);
+        for (unsigned int i = 0; i < PARTICLE_BUFFER_REGIONS; i++)
+            vertexArrays[i] = 0;
+        buffer = 0;
+        std::vector<glm::vec4>().swap(staging);
+    }
+
+private:
+    unsigned int capacity;
+    unsigned int buffer;
+    unsigned int vertexArrays[PARTICLE_BUFFER_REGIONS];
+    GLsync fences[PARTICLE_BUFFER_REGIONS];
+    unsigned int region;                // the one Map() handed out last
+    glm::vec4* mapped;
+    std::vector<glm::vec4> staging;     // without a persistent mapping
+    int windowCount;
+    Shader shader;
+};
+
+#endif
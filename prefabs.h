@@ -0,0 +1,260 @@
+//
+//  prefabs.h
+//  3D Object Drawing
+//
+//  The room's built-in furniture as compile-time data. A prefab is a fixed
+//  assembly of scaled unit cubes (half extent 0.25) given as offset/scale tables;
+//  the compiler turns each table into the parts' local matrices and the prefab's
+//  bounds, and the static_asserts below check the assemblies whenever they are
+//  edited. Placing a prefab adds one node at the placement and its baked parts
+//  under it, so each part costs the one node * local multiply in Scene::AddPart.
+//
+
+#ifndef PREFABS_H
+#define PREFABS_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "scene.h"
+
+#include <cstddef>
+
+// materials of the room, in the order createRoomMaterials() adds them
+enum Room_Material {
+    MATERIAL_WOOD,
+    MATERIAL_DARK_WOOD,
+    MATERIAL_SHEET,
+    MATERIAL_PILLOW,
+    MATERIAL_FLOOR,
+    MATERIAL_WALL,
+    MATERIAL_CEILING,
+    MATERIAL_WINDOW_FRAME,
+    MATERIAL_METAL,
+    MATERIAL_GLASS,
+    MATERIAL_CURTAIN,
+    ROOM_MATERIAL_COUNT
+};
+
+// one cube of an assembly, relative to the prefab's origin
+struct PrefabPart
+{
+    float Offset[3];
+    float Scale[3];
+    Room_Material Material;
+};
+
+// column-major like glm::mat4
+struct PrefabMatrix
+{
+    float M[16];
+};
+
+struct PrefabBounds
+{
+    float Min[3];
+    float Max[3];
+};
+
+template <size_t N>
+struct Prefab
+{
+    PrefabMatrix Local[N];
+    Room_Material Material[N];
+    PrefabBounds Bounds;
+
+    static constexpr unsigned int PartCount = static_cast<unsigned int>(N);
+};
+
+// translate(offset) * scale(scale)
+constexpr PrefabMatrix PrefabPartMatrix(const PrefabPart& part)
+{
+    return PrefabMatrix{ { part.Scale[0], 0.0f, 0.0f, 0.0f,
+                           0.0f, part.Scale[1], 0.0f, 0.0f,
+                           0.0f, 0.0f, part.Scale[2], 0.0f,
+                           part.Offset[0], part.Offset[1], part.Offset[2], 1.0f } };
+}
+
+template <size_t N>
+constexpr Prefab<N> MakePrefab(const PrefabPart (&parts)[N])
+{
+    Prefab<N> prefab{};
+    for (int axis = 0; axis < 3; axis++)
+    {
+        prefab.Bounds.Min[axis] = parts[0].Offset[axis] - 0.25f * parts[0].Scale[axis];
+        prefab.Bounds.Max[axis] = parts[0].Offset[axis] + 0.25f * parts[0].Scale[axis];
+    }
+    for (size_t i = 0; i < N; i++)
+    {
+        prefab.Local[i] = PrefabPartMatrix(parts[i]);
+        prefab.Material[i] = parts[i].Material;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float low = parts[i].Offset[axis] - 0.25f * parts[i].Scale[axis];
+            float high = parts[i].Offset[axis] + 0.25f * parts[i].Scale[axis];
+            prefab.Bounds.Min[axis] = low < prefab.Bounds.Min[axis] ? low : prefab.Bounds.Min[axis];
+            prefab.Bounds.Max[axis] = high > prefab.Bounds.Max[axis] ? high : prefab.Bounds.Max[axis];
+        }
+    }
+    return prefab;
+}
+
+// every cube has a positive size and a room material
+template <size_t N>
+constexpr bool PrefabPartsValid(const PrefabPart (&parts)[N])
+{
+    for (size_t i = 0; i < N; i++)
+    {
+        if (parts[i].Scale[0] <= 0.0f || parts[i].Scale[1] <= 0.0f || parts[i].Scale[2] <= 0.0f ||
+            parts[i].Material >= ROOM_MATERIAL_COUNT)
+            return false;
+    }
+    return true;
+}
+
+constexpr bool PrefabNear(float a, float b)
+{
+    return a - b < 1.0e-4f && b - a < 1.0e-4f;
+}
+
+// Furniture stands on its origin: z = 0 is the floor under it.
+// -----------------------------------------------------------
+
+constexpr PrefabPart CHAIR_PARTS[] = {
+    { { 0.0f, 0.0f, 0.75f }, { 2.0f, 2.0f, 0.05f }, MATERIAL_WOOD },             // seat
+    { { -0.48f, -0.48f, 0.75f }, { 0.25f, 0.25f, 3.0f }, MATERIAL_WOOD },        // leg 1 back
+    { { 0.48f, -0.48f, 0.75f }, { 0.25f, 0.25f, 3.0f }, MATERIAL_WOOD },         // leg 2 back
+    { { 0.42f, 0.42f, 0.75f - 0.375f }, { 0.25f, 0.25f, 1.5f }, MATERIAL_WOOD }, // leg 3 front
+    { { -0.42f, 0.42f, 0.75f - 0.375f }, { 0.25f, 0.25f, 1.5f }, MATERIAL_WOOD },// leg 4 front
+    { { 0.0f, -0.5f, 0.75f + 0.625f }, { 2.0f, 0.05f, 1.0f }, MATERIAL_WOOD }    // back side
+};
+
+constexpr PrefabPart TABLE_PARTS[] = {
+    { { 0.0f, 0.0f, 1.5f }, { 4.0f, 4.0f, 0.05f }, MATERIAL_DARK_WOOD },                 // top
+    { { 0.875f, 0.875f, 1.5f - 0.75f }, { 0.25f, 0.25f, 3.0f }, MATERIAL_DARK_WOOD },    // leg 1 back
+    { { -0.875f, 0.875f, 1.5f - 0.75f }, { 0.25f, 0.25f, 3.0f }, MATERIAL_DARK_WOOD },   // leg 2 back
+    { { -0.875f, -0.875f, 1.5f - 0.75f }, { 0.25f, 0.25f, 3.0f }, MATERIAL_DARK_WOOD },  // leg 3 front
+    { { 0.875f, -0.875f, 1.5f - 0.75f }, { 0.25f, 0.25f, 3.0f }, MATERIAL_DARK_WOOD },   // leg 4 front
+    { { 0.0f, 1.0f, 1.5f + 0.5f }, { 4.0f, 0.05f, 2.0f }, MATERIAL_DARK_WOOD },          // shelf back side
+    { { 0.9875f, 0.75f, 1.5f + 0.5f }, { 0.05f, 1.0f, 2.0f }, MATERIAL_DARK_WOOD },      // shelf right side
+    { { -0.9875f, 0.75f, 1.5f + 0.5f }, { 0.05f, 1.0f, 2.0f }, MATERIAL_DARK_WOOD },     // shelf left side
+    { { 0.0f, 0.75f, 1.5f + 0.5f }, { 4.0f, 1.0f, 0.05f }, MATERIAL_DARK_WOOD }          // shelf
+};
+
+constexpr PrefabPart BED_PARTS[] = {
+    { { 0.0f, 0.0f, 0.75f + 0.125f }, { 4.0f, 8.0f, 0.5f }, MATERIAL_SHEET },                // mattress
+    { { 0.875f, 1.875f, 0.75f - 0.375f }, { 0.25f, 0.25f, 1.5f }, MATERIAL_DARK_WOOD },      // leg 1
+    { { -0.875f, 1.875f, 0.75f - 0.375f }, { 0.25f, 0.25f, 1.5f }, MATERIAL_DARK_WOOD },     // leg 2
+    { { -0.875f, -1.875f, 0.75f - 0.375f }, { 0.25f, 0.25f, 1.5f }, MATERIAL_DARK_WOOD },    // leg 3
+    { { 0.875f, -1.875f, 0.75f - 0.375f }, { 0.25f, 0.25f, 1.5f }, MATERIAL_DARK_WOOD },     // leg 4
+    { { 0.0f, 2.0f, 0.75f + 0.25f }, { 4.0f, 0.05f, 0.5f }, MATERIAL_DARK_WOOD },            // head side
+    { { 0.45f, 1.7f, 0.75f + 0.25f }, { 1.5f, 0.75f, 0.25f }, MATERIAL_PILLOW },             // pillow right
+    { { -0.45f, 1.7f, 0.75f + 0.25f }, { 1.5f, 0.75f, 0.25f }, MATERIAL_PILLOW }             // pillow left
+};
+
+// Fixtures are placed by their center.
+// ------------------------------------
+
+// horizontal bars across a window opening, and the pane filling it
+constexpr PrefabPart WINDOW_PARTS[] = {
+    { { 0.0f, 0.0f, 0.0f }, { 5.0f, 0.05f, 0.1f }, MATERIAL_WINDOW_FRAME },
+    { { 0.0f, 0.0f, 0.5f }, { 5.0f, 0.05f, 0.1f }, MATERIAL_WINDOW_FRAME },
+    { { 0.0f, 0.0f, 0.98f }, { 5.0f, 0.05f, 0.1f }, MATERIAL_WINDOW_FRAME },
+    { { 0.0f, 0.0f, -0.5f }, { 5.0f, 0.05f, 0.1f }, MATERIAL_WINDOW_FRAME },
+    { { 0.0f, 0.0f, -0.98f }, { 5.0f, 0.05f, 0.1f }, MATERIAL_WINDOW_FRAME },
+    { { 0.0f, 0.0f, 0.0f }, { 7.0f, 0.02f, 4.0f }, MATERIAL_GLASS }
+};
+
+// hub and blades; placed on the node the fan's rotator spins
+constexpr PrefabPart FAN_BLADE_PARTS[] = {
+    { { 0.0f, 0.0f, 0.0f }, { 0.5f, 0.5f, 0.5f }, MATERIAL_METAL },
+    { { 0.0f, 0.0f, 0.0f }, { 4.0f, 0.5f, 0.1f }, MATERIAL_METAL },
+    { { 0.0f, 0.0f, 0.0f }, { 0.5f, 4.0f, 0.1f }, MATERIAL_METAL }
+};
+
+// the rod holding the hub, placed at the hub's center
+constexpr PrefabPart FAN_ROD_PARTS[] = {
+    { { 0.0f, 0.0f, 0.25f }, { 0.1f, 0.1f, 1.0f }, MATERIAL_METAL }
+};
+
+// The shell is placed at the room's origin.
+// -----------------------------------------
+
+constexpr PrefabPart FLOOR_PARTS[] = {
+    { { 0.0f, 0.0f, 0.0f }, { 20.0f, 14.0f, 0.05f }, MATERIAL_FLOOR }
+};
+
+constexpr PrefabPart CEILING_PARTS[] = {
+    { { 0.0f, 0.0f, 5.0f }, { 20.0f, 14.0f, 0.05f }, MATERIAL_CEILING }
+};
+
+// side walls, and the front wall around two window openings at x in [1, 4.5] and [-4.5, -1], z in [1.5, 3.5]
+constexpr PrefabPart WALL_PARTS[] = {
+    { { 5.0f, 0.0f, 2.5f }, { 0.05f, 14.0f, 10.0f }, MATERIAL_WALL },      // right side wall
+    { { -5.0f, 0.0f, 2.5f }, { 0.05f, 14.0f, 10.0f }, MATERIAL_WALL },     // left side wall
+    { { 0.0f, 3.5f, 4.25f }, { 20.0f, 0.05f, 3.0f }, MATERIAL_WALL },      // above the windows
+    { { 0.0f, 3.5f, 0.75f }, { 20.0f, 0.05f, 3.0f }, MATERIAL_WALL },      // below the windows
+    { { 0.0f, 3.5f, 2.5f }, { 8.0f, 0.05f, 4.0f }, MATERIAL_WALL },        // between the windows
+    { { 4.75f, 3.5f, 2.5f }, { 1.0f, 0.05f, 4.0f }, MATERIAL_WALL },       // right of the right window
+    { { -4.75f, 3.5f, 2.5f }, { 1.0f, 0.05f, 4.0f }, MATERIAL_WALL }       // left of the left window
+};
+
+constexpr auto CHAIR = MakePrefab(CHAIR_PARTS);
+constexpr auto TABLE = MakePrefab(TABLE_PARTS);
+constexpr auto BED = MakePrefab(BED_PARTS);
+constexpr auto WINDOW = MakePrefab(WINDOW_PARTS);
+constexpr auto FAN_BLADES = MakePrefab(FAN_BLADE_PARTS);
+constexpr auto FAN_ROD = MakePrefab(FAN_ROD_PARTS);
+constexpr auto FLOOR = MakePrefab(FLOOR_PARTS);
+constexpr auto CEILING = MakePrefab(CEILING_PARTS);
+constexpr auto WALLS = MakePrefab(WALL_PARTS);
+
+// consistency of the assemblies
+static_assert(PrefabPartsValid(CHAIR_PARTS) && PrefabPartsValid(TABLE_PARTS) && PrefabPartsValid(BED_PARTS) &&
+              PrefabPartsValid(WINDOW_PARTS) && PrefabPartsValid(FAN_BLADE_PARTS) && PrefabPartsValid(FAN_ROD_PARTS) &&
+              PrefabPartsValid(FLOOR_PARTS) && PrefabPartsValid(CEILING_PARTS) && PrefabPartsValid(WALL_PARTS),
+              "prefab parts need a positive size and a room material");
+static_assert(PrefabNear(CHAIR.Bounds.Min[2], 0.0f), "the chair's legs must end on the floor");
+static_assert(PrefabNear(TABLE.Bounds.Min[2], 0.0f), "the table's legs must end on the floor");
+static_assert(PrefabNear(BED.Bounds.Min[2], 0.0f), "the bed's legs must end on the floor");
+static_assert(WINDOW.Bounds.Max[0] - WINDOW.Bounds.Min[0] <= 3.5f && WINDOW.Bounds.Max[2] - WINDOW.Bounds.Min[2] <= 2.0f + 0.025f,
+              "the window bars and pane must fit their 3.5 x 2 wall opening, reaching at most the wall's thickness into it");
+static_assert(FAN_ROD.Bounds.Min[2] <= FAN_BLADES.Bounds.Max[2], "the fan rod must reach the hub");
+static_assert(PrefabNear(WALLS.Bounds.Min[2], FLOOR_PARTS[0].Offset[2]) && PrefabNear(WALLS.Bounds.Max[2], CEILING_PARTS[0].Offset[2]),
+              "the walls must reach from the floor to the ceiling");
+
+// any prefab behind one type, for code that picks prefabs at run time (see layout_editor.h)
+struct PrefabView
+{
+    const PrefabMatrix* Local;
+    const Room_Material* Material;
+    unsigned int PartCount;
+    PrefabBounds Bounds;
+};
+
+template <size_t N>
+constexpr PrefabView ViewPrefab(const Prefab<N>& prefab)
+{
+    return PrefabView{ prefab.Local, prefab.Material, Prefab<N>::PartCount, prefab.Bounds };
+}
+
+inline unsigned int AddPrefab(Scene& scene, const PrefabView& prefab, const glm::mat4& placement)
+{
+    unsigned int node = scene.AddNode(placement);
+    for (unsigned int i = 0; i < prefab.PartCount; i++)
+        scene.AddPart(glm::make_mat4(prefab.Local[i].M), prefab.Material[i]);
+    return node;
+}
+
+// adds a node at placement holding the prefab's parts; returns the node
+template <size_t N>
+unsigned int AddPrefab(Scene& scene, const Prefab<N>& prefab, const glm::mat4& placement,
+                       const glm::vec3& axis = glm::vec3(0.0f, 0.0f, 1.0f))
+{
+    unsigned int node = scene.AddNode(placement, axis);
+    for (size_t i = 0; i < N; i++)
+        scene.AddPart(glm::make_mat4(prefab.Local[i].M), prefab.Material[i]);
+    return node;
+}
+
+#endif
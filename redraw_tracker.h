@@ -0,0 +1,233 @@
+//
+//  redraw_tracker.h
+//  3D Object Drawing
+//
+//  Decides how much of the offscreen target has to be rendered again. Views whose
+//  camera moved, a resized target and parts that moved since they were last drawn
+//  mark pixel rectangles as damaged; a frame with no damage is not rendered at all
+//  (the loop then sleeps until input arrives), and a frame with little damage only
+//  re-renders the scissored union of the damaged rectangles. The rest of the target
+//  keeps the pixels of earlier frames.
+//
+
+#ifndef REDRAW_TRACKER_H
+#define REDRAW_TRACKER_H
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+const int REDRAW_MAX_VIEWS = 4;
+
+// pixels added around projected bounds to cover rounding and the upscale filter
+const int REDRAW_REGION_PADDING = 2;
+
+// a region covering more than this share of the target is drawn as a full frame
+const float REDRAW_FULL_FRACTION = 0.6f;
+
+class RedrawTracker
+{
+public:
+    bool Enabled;
+    float IdleTimeout;      // longest glfwWaitEventsTimeout between two frames without damage
+
+    // statistics
+    unsigned long long FullFrames, PartialFrames, SkippedFrames;
+
+    RedrawTracker()
+        : Enabled(true), IdleTimeout(0.5f), FullFrames(0), PartialFrames(0), SkippedFrames(0),
+          targetWidth(0), targetHeight(0), full(true), region(0), regionEmpty(true)
+    {
+        for (int i = 0; i < REDRAW_MAX_VIEWS; i++)
+            viewValid[i] = false;
+    }
+
+    // remembers where every part was drawn; call once after the scene is built
+    void TrackParts(const Scene& scene)
+    {
+        drawnBounds = scene.PartBounds;
+    }
+
+    // starts collecting damage for a frame rendered at targetWidth x targetHeight
+    void BeginFrame(int targetWidth_, int targetHeight_)
+    {
+        if (targetWidth_ != targetWidth || targetHeight_ != targetHeight)
+        {
+            targetWidth = targetWidth_;
+            targetHeight = targetHeight_;
+            Invalidate();
+        }
+        if (!Enabled)
+            Invalidate();
+    }
+
+    // everything is redrawn, and every view's camera is compared afresh next frame
+    void Invalidate()
+    {
+        full = true;
+        for (int i = 0; i < REDRAW_MAX_VIEWS; i++)
+            viewValid[i] = false;
+    }
+
+    void InvalidateRegion(const glm::ivec4& rectangle)
+    {
+        glm::ivec4 r = clip(rectangle, glm::ivec4(0, 0, targetWidth, targetHeight));
+        if (r.z <= 0 || r.w <= 0)
+            return;
+        if (regionEmpty)
+        {
+            region = r;
+            regionEmpty = false;
+            return;
+        }
+        int x1 = std::max(region.x + region.z, r.x + r.z);
+        int y1 = std::max(region.y + region.w, r.y + r.w);
+        region.x = std::min(region.x, r.x);
+        region.y = std::min(region.y, r.y);
+        region.z = x1 - region.x;
+        region.w = y1 - region.y;
+    }
+
+    // damages the whole tile when the view's camera differs from the last drawn one
+    void CheckView(int view, const glm::mat4& viewProjection, const glm::ivec4& tile)
+    {
+        if (viewValid[view] && viewTiles[view] == tile && viewProjections[view] == viewProjection)
+            return;
+        viewProjections[view] = viewProjection;
+        viewTiles[view] = tile;
+        viewValid[view] = true;
+        InvalidateRegion(tile);
+    }
+
+    // damages the screen rectangle of a world space box in one view
+    void InvalidateBounds(const AABB& bounds, const glm::mat4& viewProjection, const glm::ivec4& tile)
+    {
+        if (full || bounds.Empty())
+            return;
+        glm::vec2 ndcMin(1.0f), ndcMax(-1.0f);
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec4 p = viewProjection * glm::vec4(corner & 1 ? bounds.Max.x : bounds.Min.x,
+                                                     corner & 2 ? bounds.Max.y : bounds.Min.y,
+                                                     corner & 4 ? bounds.Max.z : bounds.Min.z, 1.0f);
+            // a corner behind the eye can project anywhere in the tile
+            if (p.w <= 1.0e-4f)
+            {
+                InvalidateRegion(tile);
+                return;
+            }
+            glm::vec2 ndc = glm::vec2(p) / p.w;
+            ndcMin = glm::min(ndcMin, ndc);
+            ndcMax = glm::max(ndcMax, ndc);
+        }
+        ndcMin = glm::max(ndcMin, glm::vec2(-1.0f));
+        ndcMax = glm::min(ndcMax, glm::vec2(1.0f));
+        if (ndcMin.x >= ndcMax.x || ndcMin.y >= ndcMax.y)
+            return;
+
+        int x0 = tile.x + static_cast<int>(std::floor((ndcMin.x * 0.5f + 0.5f) * tile.z)) - REDRAW_REGION_PADDING;
+        int y0 = tile.y + static_cast<int>(std::floor((ndcMin.y * 0.5f + 0.5f) * tile.w)) - REDRAW_REGION_PADDING;
+        int x1 = tile.x + static_cast<int>(std::ceil((ndcMax.x * 0.5f + 0.5f) * tile.z)) + REDRAW_REGION_PADDING;
+        int y1 = tile.y + static_cast<int>(std::ceil((ndcMax.y * 0.5f + 0.5f) * tile.w)) + REDRAW_REGION_PADDING;
+        InvalidateRegion(clip(glm::ivec4(x0, y0, x1 - x0, y1 - y0), tile));
+    }
+
+    // damage from the parts UpdateTransforms() moved: where they were drawn and where they are now.
+    // Call once per view and then PartsDrawn() once the frame has been rendered.
+    void InvalidateMovedParts(const Scene& scene, const glm::mat4& viewProjection, const glm::ivec4& tile)
+    {
+        // parts added since TrackParts() were not drawn before
+        if (drawnBounds.size() < scene.PartCount())
+            drawnBounds.resize(scene.PartCount());
+        for (unsigned int part : scene.DirtyParts)
+        {
+            InvalidateBounds(drawnBounds[part], viewProjection, tile);
+            InvalidateBounds(scene.PartBounds[part], viewProjection, tile);
+        }
+    }
+
+    void PartsDrawn(const Scene& scene)
+    {
+        for (unsigned int part : scene.DirtyParts)
+            drawnBounds[part] = scene.PartBounds[part];
+    }
+
+    // true when this frame must render anything at all
+    bool Pending() const { return full || !regionEmpty; }
+
+    // true when the whole target is rendered; otherwise only Region() is
+    bool Full() const
+    {
+        if (full)
+            return true;
+        float area = static_cast<float>(region.z) * static_cast<float>(region.w);
+        return area > REDRAW_FULL_FRACTION * static_cast<float>(targetWidth) * static_cast<float>(targetHeight);
+    }
+
+    // x, y, width, height in pixels of the target
+    glm::ivec4 Region() const { return Full() ? glm::ivec4(0, 0, targetWidth, targetHeight) : region; }
+
+    // projection that maps the part of a tile covered by Region() to the whole clip space,
+    // for culling a partial redraw with Frustum(crop * viewProjection)
+    glm::mat4 RegionCrop(const glm::ivec4& tile) const
+    {
+        glm::ivec4 r = clip(Region(), tile);
+        if (r.z <= 0 || r.w <= 0)
+            return glm::mat4(1.0f);
+        glm::vec2 scale(static_cast<float>(tile.z) / r.z, static_cast<float>(tile.w) / r.w);
+        glm::vec2 center((r.x - tile.x + r.z * 0.5f) / tile.z * 2.0f - 1.0f, (r.y - tile.y + r.w * 0.5f) / tile.w * 2.0f - 1.0f);
+        glm::mat4 crop(1.0f);
+        crop[0][0] = scale.x;
+        crop[1][1] = scale.y;
+        crop[3][0] = -center.x * scale.x;
+        crop[3][1] = -center.y * scale.y;
+        return crop;
+    }
+
+    // closes the frame; drawn is false when the frame was skipped
+    void EndFrame(bool drawn)
+    {
+        if (!drawn)
+            SkippedFrames++;
+        else if (Full())
+            FullFrames++;
+        else
+            PartialFrames++;
+        full = false;
+        regionEmpty = true;
+    }
+
+    void PrintStats() const
+    {
+        unsigned long long total = FullFrames + PartialFrames + SkippedFrames;
+        if (!Enabled || total == 0)
+            return;
+        std::cout << "redraw: " << total << " frames, " << FullFrames << " full, " << PartialFrames << " partial, "
+                  << SkippedFrames << " skipped" << std::endl;
+    }
+
+private:
+    int targetWidth, targetHeight;
+    bool full;
+    glm::ivec4 region;
+    bool regionEmpty;
+    glm::mat4 viewProjections[REDRAW_MAX_VIEWS];
+    glm::ivec4 viewTiles[REDRAW_MAX_VIEWS];
+    bool viewValid[REDRAW_MAX_VIEWS];
+    std::vector<AABB> drawnBounds;
+
+    static glm::ivec4 clip(const glm::ivec4& r, const glm::ivec4& bounds)
+    {
+        int x0 = std::max(r.x, bounds.x), y0 = std::max(r.y, bounds.y);
+        int x1 = std::min(r.x + r.z, bounds.x + bounds.z), y1 = std::min(r.y + r.w, bounds.y + bounds.w);
+        return glm::ivec4(x0, y0, x1 - x0, y1 - y0);
+    }
+};
+
+#endif
@@ -0,0 +1,234 @@
+//
+//  reflection_probes.h
+//  3D Object Drawing
+//
+//  Reflections for the glossy floor and the window glass. Every room gets a probe:
+//  a capture point and the box of the room's volume. A probe's six faces are
+//  rendered once at load and afterwards only when something that changed lies
+//  inside the probe's volume and in view of the face (a spinning fan, edited
+//  furniture). Dirty faces are picked round robin, so a frame re-renders only as
+//  many as its budget allows (see SceneRenderer::CaptureReflections).
+//
+//  GL 3.3 has no cube map arrays, so the faces of all probes share one 2D array
+//  texture, six layers per probe, with mipmaps that stand in for the blur of the
+//  rougher materials. The scene shader takes the probe whose volume holds the
+//  fragment and corrects the reflected ray for parallax by following it to the
+//  volume's walls before looking it up.
+//
+
+#ifndef REFLECTION_PROBES_H
+#define REFLECTION_PROBES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bounds.h"
+#include "bvh.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// must match MAX_PROBES in sceneShader.fs
+const int REFLECTION_MAX_PROBES = 8;
+const int REFLECTION_FACE_SIZE = 128;
+const float REFLECTION_NEAR = 0.05f;
+const float REFLECTION_FAR = 50.0f;
+
+// face f looks along axis f / 2, towards + for odd f; must match FACE_FORWARD and FACE_UP in sceneShader.fs
+const glm::vec3 REFLECTION_FACE_FORWARD[6] = {
+    glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f),
+    glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+    glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 0.0f, 1.0f)
+};
+const glm::vec3 REFLECTION_FACE_UP[6] = {
+    glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+    glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+    glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)
+};
+
+class ReflectionProbes
+{
+public:
+    glm::vec3 Positions[REFLECTION_MAX_PROBES];     // capture points
+    glm::vec3 VolumeMin[REFLECTION_MAX_PROBES];
+    glm::vec3 VolumeMax[REFLECTION_MAX_PROBES];
+    unsigned int FaceTexture;                       // 2D array, layer probe * 6 + face
+    int FaceSize;
+    unsigned long long FacesRendered;               // since Create(), the initial capture included
+    glm::vec4 Background;                           // seen through the windows
+
+    ReflectionProbes()
+        : FaceTexture(0), FaceSize(REFLECTION_FACE_SIZE), FacesRendered(0), Background(0.0f, 0.0f, 0.0f, 1.0f), probeCount(0), cursor(0), framebuffer(0), depthBuffer(0)
+    {
+        for (unsigned char& dirty : faceDirty)
+            dirty = 0;
+    }
+
+    int ProbeCount() const { return probeCount; }
+    unsigned int FaceCount() const { return static_cast<unsigned int>(probeCount) * 6u; }
+
+    // adds the probe of a room; add them all before Create(). False when the probes are full
+    bool Add(const glm::vec3& position, const AABB& volume)
+    {
+        if (probeCount == REFLECTION_MAX_PROBES || FaceTexture != 0)
+            return false;
+        Positions[probeCount] = position;
+        VolumeMin[probeCount] = volume.Min;
+        VolumeMax[probeCount] = volume.Max;
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, REFLECTION_NEAR, REFLECTION_FAR);
+        for (int face = 0; face < 6; face++)
+        {
+            unsigned int i = static_cast<unsigned int>(probeCount) * 6u + face;
+            faceViewProjection[i] = projection * glm::lookAt(position, position + REFLECTION_FACE_FORWARD[face], REFLECTION_FACE_UP[face]);
+            faceFrustums[i] = Frustum(faceViewProjection[i]);
+            faceDirty[i] = 1;
+        }
+        probeCount++;
+        return true;
+    }
+
+    // allocates the faces of the added probes, all dirty, and remembers the parts' bounds
+    // to compare later moves against
+    void Create(const Scene& scene, int faceSize = REFLECTION_FACE_SIZE)
+    {
+        FaceSize = faceSize;
+
+        glGenTextures(1, &FaceTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, FaceTexture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, faceSize, faceSize, std::max(probeCount, 1) * 6, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, faceSize, faceSize);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, FaceTexture, 0, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::REFLECTION_PROBES::FRAMEBUFFER_INCOMPLETE" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        knownBounds = scene.PartBounds;
+        visible.resize(scene.PartCount());
+    }
+
+    // dirties the faces that see the parts UpdateTransforms() just moved, where they were and where they are
+    void Invalidate(const Scene& scene)
+    {
+        if (knownBounds.size() < scene.PartCount())
+        {
+            knownBounds.resize(scene.PartCount());
+            visible.resize(scene.PartCount());
+        }
+        for (unsigned int part : scene.DirtyParts)
+        {
+            Invalidate(knownBounds[part]);
+            Invalidate(scene.PartBounds[part]);
+            knownBounds[part] = scene.PartBounds[part];
+        }
+    }
+
+    // dirties the faces that see something inside bounds; changes outside a probe's volume
+    // are behind its room's walls
+    void Invalidate(const AABB& bounds)
+    {
+        if (bounds.Empty())
+            return;
+        for (int probe = 0; probe < probeCount; probe++)
+        {
+            if (!bounds.Overlaps(AABB(VolumeMin[probe], VolumeMax[probe])))
+                continue;
+            for (unsigned int i = probe * 6u; i < probe * 6u + 6u; i++)
+                if (!faceDirty[i] && faceFrustums[i].Intersects(bounds))
+                    faceDirty[i] = 1;
+        }
+    }
+
+    bool Pending() const
+    {
+        for (unsigned int i = 0; i < FaceCount(); i++)
+            if (faceDirty[i])
+                return true;
+        return false;
+    }
+
+    // next dirty face after the last one rendered, so a steadily dirty face cannot starve the others
+    bool NextDirtyFace(unsigned int& face)
+    {
+        for (unsigned int step = 0; step < FaceCount(); step++)
+        {
+            unsigned int i = (cursor + step) % FaceCount();
+            if (faceDirty[i])
+            {
+                face = i;
+                cursor = i + 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // targets the face and culls the room for it; returns the number of Visible() parts
+    unsigned int BeginFace(unsigned int face, const BVH& bvh)
+    {
+        faceDirty[face] = 0;
+        FacesRendered++;
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, FaceTexture, 0, static_cast<GLint>(face));
+        glViewport(0, 0, FaceSize, FaceSize);
+        glClearColor(Background.x, Background.y, Background.z, Background.w);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        return bvh.QueryFrustum(faceFrustums[face], visible.data(), static_cast<unsigned int>(visible.size()));
+    }
+
+    const unsigned int* Visible() const { return visible.data(); }
+    const glm::mat4& FaceViewProjection(unsigned int face) const { return faceViewProjection[face]; }
+    const glm::vec3& FacePosition(unsigned int face) const { return Positions[face / 6u]; }
+
+    // after the faces of a frame: refreshes the blurred levels and lets go of the target
+    void EndFaces()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, FaceTexture);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    void Bind(int unit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, FaceTexture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void Release()
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        glDeleteTextures(1, &FaceTexture);
+        framebuffer = depthBuffer = FaceTexture = 0;
+    }
+
+private:
+    int probeCount;
+    unsigned int cursor;
+    unsigned int framebuffer, depthBuffer;
+    glm::mat4 faceViewProjection[REFLECTION_MAX_PROBES * 6];
+    Frustum faceFrustums[REFLECTION_MAX_PROBES * 6];
+    unsigned char faceDirty[REFLECTION_MAX_PROBES * 6];
+    std::vector<AABB> knownBounds;          // per part: bounds when the probes last looked
+    std::vector<unsigned int> visible;
+};
+
+#endif
@@ -0,0 +1,105 @@
+//
+//  replay.cpp
+//  3D Object Drawing
+//
+//  Offline replay of a capture written with `--capture <first> <last> <file>`.
+//  Rebuilds the captured objects once, then re-executes the captured frames in a
+//  hidden window and reports CPU submission and GPU execution time per pass.
+//
+//  usage: replay <capture file> [passes]
+//
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "gl_capture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "usage: " << argv[0] << " <capture file> [passes]" << std::endl;
+        return 1;
+    }
+    int passes = argc > 2 ? std::max(1, atoi(argv[2])) : 100;
+
+    GLReplay replay;
+    if (!replay.Load(argv[1]))
+    {
+        std::cout << "Failed to load capture " << argv[1] << std::endl;
+        return 1;
+    }
+
+    // glfw: hidden window with the context version the capture was recorded on
+    // -------------------------------------------------------------------------
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, static_cast<int>(replay.Header.ContextMajor));
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, static_cast<int>(replay.Header.ContextMinor));
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    GLFWwindow* window = glfwCreateWindow(static_cast<int>(replay.Header.Width), static_cast<int>(replay.Header.Height), "replay", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+
+    replay.RunSetup();
+    glFinish();
+
+    // the captured frames already use GL_TIME_ELAPSED queries, so passes are timed with timestamps
+    GLuint timestamps[2];
+    glGenQueries(2, timestamps);
+
+    std::vector<double> cpuMs, gpuMs;
+    int frames = 0;
+    for (int pass = 0; pass < passes; pass++)
+    {
+        glQueryCounter(timestamps[0], GL_TIMESTAMP);
+        auto start = std::chrono::high_resolution_clock::now();
+        frames = replay.RunFrames();
+        auto submitted = std::chrono::high_resolution_clock::now();
+        glQueryCounter(timestamps[1], GL_TIMESTAMP);
+        glFinish();
+
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(timestamps[0], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(timestamps[1], GL_QUERY_RESULT, &end);
+        cpuMs.push_back(std::chrono::duration<double, std::milli>(submitted - start).count());
+        gpuMs.push_back((end - begin) / 1.0e6);
+    }
+
+    // per frame statistics over all passes
+    std::sort(cpuMs.begin(), cpuMs.end());
+    std::sort(gpuMs.begin(), gpuMs.end());
+    double perFrame = frames > 0 ? 1.0 / frames : 1.0;
+    std::cout << "replayed frames " << replay.Header.FirstFrame << "-" << replay.Header.LastFrame
+              << " (" << frames << " frames) x " << passes << " passes" << std::endl;
+    std::cout << "cpu ms/frame  min " << cpuMs.front() * perFrame << "  median " << cpuMs[cpuMs.size() / 2] * perFrame
+              << "  max " << cpuMs.back() * perFrame << std::endl;
+    std::cout << "gpu ms/frame  min " << gpuMs.front() * perFrame << "  median " << gpuMs[gpuMs.size() / 2] * perFrame
+              << "  max " << gpuMs.back() * perFrame << std::endl;
+
+    glDeleteQueries(2, timestamps);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,157 @@
+//
+//  scene.h
+//  3D Object Drawing
+//
+//  Retained description of the room. Every drawable is a part (one scaled unit
+//  cube) hanging off a node; nodes carry the transform that animations and edits
+//  change. Parts of a node are stored contiguously so a dirty node only touches
+//  its own range. Everything is kept in flat per-field arrays. Nodes are never
+//  erased: a removed node keeps its parts with empty bounds, so part indices stay
+//  valid for everything that caches them, and can be placed again later.
+//
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "bounds.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+
+// node transform channels that animations can drive
+enum Node_Channel {
+    CHANNEL_ANGLE,
+    CHANNEL_OFFSET_X,
+    CHANNEL_OFFSET_Y,
+    CHANNEL_OFFSET_Z
+};
+
+// PartLightmap of parts without baked lighting
+const unsigned int LIGHTMAP_NONE = 0xFFFFFFFFu;
+
+class Scene
+{
+public:
+    // nodes
+    std::vector<glm::mat4> NodeBase;        // placement of the node in the room
+    std::vector<glm::vec3> NodeAxis;        // axis NodeAngle rotates around
+    std::vector<float> NodeAngle;           // degrees
+    std::vector<glm::vec3> NodeOffset;      // translation applied after NodeBase
+    std::vector<glm::mat4> NodeWorld;
+    std::vector<unsigned int> NodeFirstPart;
+    std::vector<unsigned int> NodePartCount;
+    std::vector<unsigned char> NodeDirty;
+    std::vector<unsigned char> NodeRemoved;  // parts are neither drawn nor hit
+
+    // parts
+    std::vector<unsigned int> PartNode;
+    std::vector<glm::mat4> PartLocal;       // part transform relative to its node
+    std::vector<glm::mat4> PartModel;       // model matrix sent to the shader
+    std::vector<AABB> PartBounds;           // world bounds of the part's cube
+    std::vector<unsigned int> PartMaterial; // index into the MaterialTable
+    std::vector<unsigned int> PartLightmap; // lightmap slot (see lightmap.h) or LIGHTMAP_NONE
+
+    // work lists; DirtyParts holds the parts whose PartModel changed in the last UpdateTransforms()
+    std::vector<unsigned int> DirtyNodes;
+    std::vector<unsigned int> DirtyParts;
+
+    unsigned int NodeCount() const { return static_cast<unsigned int>(NodeBase.size()); }
+    unsigned int PartCount() const { return static_cast<unsigned int>(PartNode.size()); }
+
+    // starts a new node; parts added afterwards belong to it
+    unsigned int AddNode(const glm::mat4& base, const glm::vec3& axis = glm::vec3(0.0f, 0.0f, 1.0f))
+    {
+        unsigned int node = NodeCount();
+        NodeBase.push_back(base);
+        NodeAxis.push_back(axis);
+        NodeAngle.push_back(0.0f);
+        NodeOffset.push_back(glm::vec3(0.0f));
+        NodeWorld.push_back(base);
+        NodeFirstPart.push_back(PartCount());
+        NodePartCount.push_back(0);
+        NodeDirty.push_back(0);
+        NodeRemoved.push_back(0);
+        return node;
+    }
+
+    // adds a part to the most recently added node
+    unsigned int AddPart(const glm::mat4& local, unsigned int material = 0)
+    {
+        unsigned int node = NodeCount() - 1;
+        unsigned int part = PartCount();
+        PartNode.push_back(node);
+        PartLocal.push_back(local);
+        PartModel.push_back(NodeWorld[node] * local);
+        PartBounds.push_back(TransformedCubeBounds(PartModel.back()));
+        PartMaterial.push_back(material);
+        PartLightmap.push_back(LIGHTMAP_NONE);
+        NodePartCount[node]++;
+        return part;
+    }
+
+    void SetChannel(unsigned int node, int channel, float value)
+    {
+        if (channel == CHANNEL_ANGLE)
+            NodeAngle[node] = value;
+        else
+            NodeOffset[node][channel - CHANNEL_OFFSET_X] = value;
+        MarkNodeDirty(node);
+    }
+
+    // moves a node to a new placement, bringing it back if it was removed
+    void PlaceNode(unsigned int node, const glm::mat4& base)
+    {
+        NodeBase[node] = base;
+        NodeRemoved[node] = 0;
+        MarkNodeDirty(node);
+    }
+
+    // takes a node's parts out of the room; UpdateTransforms() empties their bounds
+    void RemoveNode(unsigned int node)
+    {
+        NodeRemoved[node] = 1;
+        MarkNodeDirty(node);
+    }
+
+    // world matrix of a node from its placement and channels
+    glm::mat4 NodeTransform(unsigned int node) const
+    {
+        glm::mat4 identityMatrix = glm::mat4(1.0f);
+        glm::mat4 translateMatrix = glm::translate(identityMatrix, NodeOffset[node]);
+        glm::mat4 rotateMatrix = glm::rotate(identityMatrix, glm::radians(NodeAngle[node]), NodeAxis[node]);
+        return translateMatrix * NodeBase[node] * rotateMatrix;
+    }
+
+    void MarkNodeDirty(unsigned int node)
+    {
+        if (NodeDirty[node])
+            return;
+        NodeDirty[node] = 1;
+        DirtyNodes.push_back(node);
+    }
+
+    // recomputes the world matrix of every dirty node and the model matrices and bounds of its parts
+    void UpdateTransforms()
+    {
+        DirtyParts.clear();
+        for (unsigned int node : DirtyNodes)
+        {
+            NodeWorld[node] = NodeTransform(node);
+
+            unsigned int end = NodeFirstPart[node] + NodePartCount[node];
+            for (unsigned int part = NodeFirstPart[node]; part < end; part++)
+            {
+                // removed parts collapse to a point no query or draw can reach
+                PartModel[part] = NodeRemoved[node] ? glm::mat4(0.0f) : NodeWorld[node] * PartLocal[part];
+                PartBounds[part] = NodeRemoved[node] ? AABB() : TransformedCubeBounds(PartModel[part]);
+                DirtyParts.push_back(part);
+            }
+            NodeDirty[node] = 0;
+        }
+        DirtyNodes.clear();
+    }
+};
+
+#endif
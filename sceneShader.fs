@@ -0,0 +1,161 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out float Revealage;     // weighted blended pass only, see transparency.h
+
+in vec3 worldPosition;
+in vec3 localPosition;
+flat in uint materialId;
+flat in uint lightmapSlot;
+flat in int viewIndex;
+
+const int MAX_VIEWS = 4;
+const float TEXTURE_SCALE = 0.5;                // texture repeats per world unit
+const uint LIGHTMAP_NONE = 0xFFFFFFFFu;         // must match scene.h
+const int MAX_PROBES = 8;                       // must match REFLECTION_MAX_PROBES in reflection_probes.h
+const float PROBE_MARGIN = 0.1;                 // walls just outside a probe's volume still reflect it
+const int MAX_STREAMED_LAYERS = 16;             // must match TEXSTREAM_MAX_TEXTURES in texture_streaming.h
+
+// forward and up of the probe faces, face = axis * 2 + (positive ? 1 : 0); must match reflection_probes.h
+const vec3 FACE_FORWARD[6] = vec3[6](vec3(-1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0), vec3(0.0, -1.0, 0.0),
+                                     vec3(0.0, 1.0, 0.0), vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0));
+const vec3 FACE_UP[6] = vec3[6](vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, 1.0),
+                                vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 0.0), vec3(0.0, 1.0, 0.0));
+
+uniform samplerBuffer materials;                // two texels per material: color, (roughness, layer)
+uniform sampler2DArray materialLayers;         // the streamed layers' resident tails while streaming
+uniform int streamedLayerCount;                 // 0 without texture streaming
+uniform int streamedPool[MAX_STREAMED_LAYERS];  // pool holding a layer's finest levels, -1 for the tail only
+uniform int streamedSlot[MAX_STREAMED_LAYERS];
+uniform sampler2DArray streamedLevel0;          // one pool per streamed level, see texture_streaming.h
+uniform sampler2DArray streamedLevel1;
+uniform sampler2DArray streamedLevel2;
+uniform vec3 viewPosition[MAX_VIEWS];
+uniform vec3 lightDirection;
+uniform sampler2D lightmapAtlas;                // baked irradiance / pi
+uniform samplerBuffer lightmapRects;            // six texel rectangles per slot, see LightmapRect
+uniform bool weightedBlend;                     // write the transparency targets instead of the color
+uniform sampler2DArray reflectionFaces;         // six layers per probe
+uniform int reflectionProbeCount;               // 0 reflects nothing
+uniform vec3 probePosition[MAX_PROBES];
+uniform vec3 probeMin[MAX_PROBES];
+uniform vec3 probeMax[MAX_PROBES];
+
+// baked light of this point of the unit cube: the face is the dominant local axis
+vec3 bakedLight()
+{
+    vec3 p = abs(localPosition);
+    int axis = p.x >= p.y && p.x >= p.z ? 0 : (p.y >= p.z ? 1 : 2);
+    int face = axis * 2 + (localPosition[axis] > 0.0 ? 1 : 0);
+    vec4 rect = texelFetch(lightmapRects, int(lightmapSlot) * 6 + face);
+    vec2 uv = vec2(localPosition[(axis + 1) % 3], localPosition[(axis + 2) % 3]) * 2.0 + 0.5;
+    // stay between the rectangle's outer texel centers so filtering never reads a neighbour
+    vec2 texel = rect.xy + clamp(uv * rect.zw, vec2(0.5), rect.zw - 0.5);
+    return texture(lightmapAtlas, texel / vec2(textureSize(lightmapAtlas, 0))).rgb;
+}
+
+// detail pattern of a layer: from the pool holding its finest resident levels when streamed
+vec3 layerTexel(vec2 uv, float layer)
+{
+    // gradients taken outside the branches stay valid inside them
+    vec2 dx = dFdx(uv);
+    vec2 dy = dFdy(uv);
+    int index = int(layer);
+    int pool = index < streamedLayerCount ? streamedPool[index] : -1;
+    if (pool == 0)
+        return textureGrad(streamedLevel0, vec3(uv, float(streamedSlot[index])), dx, dy).rgb;
+    if (pool == 1)
+        return textureGrad(streamedLevel1, vec3(uv, float(streamedSlot[index])), dx, dy).rgb;
+    if (pool == 2)
+        return textureGrad(streamedLevel2, vec3(uv, float(streamedSlot[index])), dx, dy).rgb;
+    return textureGrad(materialLayers, vec3(uv, layer), dx, dy).rgb;
+}
+
+// what the probe around this point sees along the reflected view ray; w is 0 outside every probe
+vec4 probeReflection(vec3 normal, vec3 viewDirection, float roughness)
+{
+    int probe = -1;
+    for (int i = 0; i < reflectionProbeCount && probe < 0; i++)
+        if (all(greaterThanEqual(worldPosition, probeMin[i] - PROBE_MARGIN)) && all(lessThanEqual(worldPosition, probeMax[i] + PROBE_MARGIN)))
+            probe = i;
+    if (probe < 0)
+        return vec4(0.0);
+
+    // parallax correction: the ray ends on the volume's walls, which the probe sees from its own position
+    vec3 ray = reflect(-viewDirection, normal);
+    ray = mix(ray, vec3(1.0e-5), lessThan(abs(ray), vec3(1.0e-5)));
+    vec3 origin = clamp(worldPosition, probeMin[probe], probeMax[probe]);
+    vec3 exits = max((probeMax[probe] - origin) / ray, (probeMin[probe] - origin) / ray);
+    vec3 direction = origin + ray * min(min(exits.x, exits.y), exits.z) - probePosition[probe];
+
+    vec3 d = abs(direction);
+    int axis = d.x >= d.y && d.x >= d.z ? 0 : (d.y >= d.z ? 1 : 2);
+    int face = axis * 2 + (direction[axis] > 0.0 ? 1 : 0);
+    vec3 forward = FACE_FORWARD[face];
+    vec3 right = normalize(cross(forward, FACE_UP[face]));
+    vec3 up = cross(right, forward);
+    vec2 uv = vec2(dot(direction, right), dot(direction, up)) / dot(direction, forward) * 0.5 + 0.5;
+    // rougher surfaces read blurrier levels
+    float lod = roughness * log2(float(textureSize(reflectionFaces, 0).x));
+    return vec4(textureLod(reflectionFaces, vec3(uv, float(probe * 6 + face)), lod).rgb, 1.0);
+}
+
+void emit(vec3 rgb, float alpha)
+{
+    if (!weightedBlend)
+    {
+        FragColor = vec4(rgb, alpha);
+        return;
+    }
+    // depth weight of McGuire and Bavoil: near layers dominate the average, without sorting
+    float weight = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+    FragColor = vec4(rgb * alpha, alpha) * weight;
+    Revealage = -log2(1.0 - min(alpha, 0.999));
+}
+
+void main()
+{
+    vec4 color = texelFetch(materials, int(materialId) * 2);
+    vec4 params = texelFetch(materials, int(materialId) * 2 + 1);
+    float roughness = params.x;
+    float layer = params.y;
+
+    // cubes carry no normals; use the face normal from screen space derivatives
+    vec3 normal = normalize(cross(dFdx(worldPosition), dFdy(worldPosition)));
+    vec3 viewDirection = normalize(viewPosition[viewIndex] - worldPosition);
+    if (dot(normal, viewDirection) < 0.0)
+        normal = -normal;
+
+    if (layer >= 0.0)
+    {
+        // box projection onto the face's dominant plane
+        vec3 n = abs(normal);
+        vec2 uv = n.x > n.y && n.x > n.z ? worldPosition.yz : (n.y > n.z ? worldPosition.xz : worldPosition.xy);
+        color.rgb *= layerTexel(uv * TEXTURE_SCALE, layer);
+    }
+
+    vec3 shaded;
+    if (lightmapSlot != LIGHTMAP_NONE)
+    {
+        shaded = color.rgb * bakedLight();
+    }
+    else
+    {
+        vec3 toLight = -lightDirection;
+        float diffuse = max(dot(normal, toLight), 0.0);
+        float shininess = mix(96.0, 4.0, roughness);
+        float specular = pow(max(dot(normal, normalize(toLight + viewDirection)), 0.0), shininess) * (1.0 - roughness) * 0.5;
+        shaded = color.rgb * (0.35 + 0.65 * diffuse) + vec3(specular);
+    }
+
+    vec4 reflection = reflectionProbeCount > 0 ? probeReflection(normal, viewDirection, roughness) : vec4(0.0);
+    if (reflection.w == 0.0)
+    {
+        emit(shaded, color.a);
+        return;
+    }
+    // Schlick's Fresnel; the reflection covers glass too, so it raises the coverage
+    float fresnel = 0.04 + 0.96 * pow(1.0 - max(dot(normal, viewDirection), 0.0), 5.0);
+    float amount = fresnel * (1.0 - roughness);
+    float alpha = color.a + (1.0 - color.a) * amount;
+    emit((shaded * color.a * (1.0 - amount) + reflection.rgb * amount) / alpha, alpha);
+}
@@ -0,0 +1,41 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aColor;
+layout (location = 2) in mat4 instanceModel;
+layout (location = 6) in uvec3 instanceIds;     // material, view, lightmap slot
+
+// must match SCENE_MAX_VIEWS in scene_renderer.h
+const int MAX_VIEWS = 4;
+
+uniform mat4 viewProjection[MAX_VIEWS];
+uniform vec4 viewTile[MAX_VIEWS];               // xy: scale, zw: offset of the view's tile in NDC
+
+out vec3 worldPosition;
+out vec3 localPosition;
+flat out uint materialId;
+flat out uint lightmapSlot;
+flat out int viewIndex;
+out float gl_ClipDistance[4];
+
+// the depth pre-pass runs this shader with another fragment shader; positions must match exactly
+invariant gl_Position;
+
+void main()
+{
+    int view = int(instanceIds.y);
+    vec4 world = instanceModel * vec4(aPos, 1.0);
+    worldPosition = world.xyz;
+    localPosition = aPos;
+    materialId = instanceIds.x;
+    lightmapSlot = instanceIds.z;
+    viewIndex = view;
+
+    // squeeze the view into its tile and clip it against the tile edges
+    vec4 clip = viewProjection[view] * world;
+    gl_ClipDistance[0] = clip.w + clip.x;
+    gl_ClipDistance[1] = clip.w - clip.x;
+    gl_ClipDistance[2] = clip.w + clip.y;
+    gl_ClipDistance[3] = clip.w - clip.y;
+    clip.xy = clip.xy * viewTile[view].xy + viewTile[view].zw * clip.w;
+    gl_Position = clip;
+}
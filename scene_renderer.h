@@ -0,0 +1,582 @@
+//
+//  scene_renderer.h
+//  3D Object Drawing
+//
+//  Draws the room's visible parts in one instanced call. Every instance carries its
+//  model matrix, material id and view index; the shader looks the material up in
+//  the MaterialTable and places the instance in its view's tile (see MultiView), so
+//  parts with different materials, and all views, share a single draw.
+//
+//  To keep overdraw down the instances are sorted front to back before the upload,
+//  and with DepthPrepass the large occluders (walls, floor, ceiling, big furniture)
+//  are laid into the depth buffer first so hidden fragments fail the early depth
+//  test. Overdraw swaps the lighting for an additive count of shaded fragments.
+//
+//  Instances of transparent materials are kept out of the opaque draw and go to
+//  DrawTransparent(), which the caller issues after everything opaque: unsorted,
+//  into a TransparencyTarget's weighted blended targets when one is in use, or
+//  plainly alpha blended otherwise.
+//
+//  The instances are streamed into a range of the GpuMemory instance arena, and
+//  the cube's indices may sit anywhere in the bound element buffer (IndexOffset).
+//
+//  With reflection probes in use, glossy materials reflect the probe around them;
+//  CaptureReflections() renders the probes' dirty faces with this same renderer.
+//
+//  With a TextureStreamer in use, the material layers are sampled from its pools
+//  and resident tails instead of the MaterialTable's layers.
+//
+
+#ifndef SCENE_RENDERER_H
+#define SCENE_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "shader.h"
+#include "scene.h"
+#include "materials.h"
+#include "gpu_memory.h"
+#include "lightmap.h"
+#include "reflection_probes.h"
+#include "texture_streaming.h"
+#include "transparency.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// must match MAX_VIEWS in sceneShader.vs
+const int SCENE_MAX_VIEWS = 4;
+
+// vertex attribute locations of the instance data (0 and 1 are the cube's position and color)
+const int INSTANCE_MODEL_ATTRIBUTE = 2;        // four vec4 columns: 2..5
+const int INSTANCE_IDS_ATTRIBUTE = 6;          // material, view, lightmap slot
+
+// texture units used by the scene shader
+const int MATERIAL_TABLE_UNIT = 0;
+const int MATERIAL_LAYER_UNIT = 1;
+const int LIGHTMAP_ATLAS_UNIT = 2;
+const int LIGHTMAP_RECT_UNIT = 3;
+const int REFLECTION_FACES_UNIT = 4;
+const int STREAMED_LEVEL_UNIT = 5;              // the streamer's pools: 5..5 + TEXSTREAM_POOLS - 1
+
+// instances with a face at least this large (in square units) count as occluders
+const float SCENE_OCCLUDER_MIN_AREA = 2.0f;
+
+enum Scene_Pass {
+    SCENE_PASS_SHADE,       // lit materials
+    SCENE_PASS_DEPTH,       // depth only, for the pre-pass
+    SCENE_PASS_OVERDRAW,    // additive fragment count, see overdraw_meter.h
+    SCENE_PASS_TRANSPARENT, // lit materials into the weighted blended targets
+    SCENE_PASS_COUNT
+};
+
+struct SceneInstance
+{
+    glm::mat4 Model;
+    unsigned int Material;
+    unsigned int View;
+    unsigned int Lightmap;      // LIGHTMAP_NONE for dynamically lit instances
+    unsigned int Padding;
+};
+
+class SceneRenderer
+{
+public:
+    unsigned int InstanceVBO;       // the instance arena's buffer
+    unsigned int InstanceCapacity;
+    size_t IndexOffset;             // byte offset of the cube's 36 indices in the element buffer
+    glm::vec3 LightDirection;
+    bool FrontToBack;           // sort Draw()'s instances by distance to their view's eye
+    bool DepthPrepass;          // lay the occluders (or all indirect draws) into depth first
+    bool Overdraw;              // count shaded fragments instead of lighting them
+
+    // submitted since Begin(); an indirect draw counts as one call and its triangles are
+    // only known to the GPU
+    unsigned int DrawCalls;
+    unsigned long long Triangles;
+
+    explicit SceneRenderer(GpuArena& instanceArena)
+        : InstanceVBO(instanceArena.Buffer), InstanceCapacity(0), IndexOffset(0), LightDirection(glm::normalize(glm::vec3(0.3f, -0.5f, -1.0f))),
+          FrontToBack(true), DepthPrepass(false), Overdraw(false), DrawCalls(0), Triangles(0), occluderCount(0), transparentCount(0),
+          uploaded(false), instanceArena(&instanceArena), lightmap(NULL), reflections(NULL), streamer(NULL), transparency(NULL),
+          shader("sceneShader.vs", "sceneShader.fs"), depthShader("sceneShader.vs", "depthShader.fs"),
+          overdrawShader("sceneShader.vs", "overdrawShader.fs"), transparentShader("sceneShader.vs", "sceneShader.fs")
+    {
+        programs[SCENE_PASS_SHADE] = &shader;
+        programs[SCENE_PASS_DEPTH] = &depthShader;
+        programs[SCENE_PASS_OVERDRAW] = &overdrawShader;
+        programs[SCENE_PASS_TRANSPARENT] = &transparentShader;
+        for (int pass = 0; pass < SCENE_PASS_COUNT; pass++)
+        {
+            unsigned int id = programs[pass]->ID;
+            viewProjectionLocations[pass] = glGetUniformLocation(id, "viewProjection");
+            tileLocations[pass] = glGetUniformLocation(id, "viewTile");
+            eyeLocations[pass] = glGetUniformLocation(id, "viewPosition");
+            lightLocations[pass] = glGetUniformLocation(id, "lightDirection");
+            probeCountLocations[pass] = glGetUniformLocation(id, "reflectionProbeCount");
+            probePositionLocations[pass] = glGetUniformLocation(id, "probePosition");
+            probeMinLocations[pass] = glGetUniformLocation(id, "probeMin");
+            probeMaxLocations[pass] = glGetUniformLocation(id, "probeMax");
+            streamedCountLocations[pass] = glGetUniformLocation(id, "streamedLayerCount");
+            streamedPoolLocations[pass] = glGetUniformLocation(id, "streamedPool");
+            streamedSlotLocations[pass] = glGetUniformLocation(id, "streamedSlot");
+        }
+        Shader* lit[2] = { &shader, &transparentShader };
+        for (Shader* program : lit)
+        {
+            program->use();
+            program->setInt("materials", MATERIAL_TABLE_UNIT);
+            program->setInt("materialLayers", MATERIAL_LAYER_UNIT);
+            program->setInt("lightmapAtlas", LIGHTMAP_ATLAS_UNIT);
+            program->setInt("lightmapRects", LIGHTMAP_RECT_UNIT);
+            program->setInt("reflectionFaces", REFLECTION_FACES_UNIT);
+            program->setInt("streamedLevel0", STREAMED_LEVEL_UNIT);
+            program->setInt("streamedLevel1", STREAMED_LEVEL_UNIT + 1);
+            program->setInt("streamedLevel2", STREAMED_LEVEL_UNIT + 2);
+            program->setBool("weightedBlend", program == &transparentShader);
+        }
+        instances.reserve(256);
+        sorted.reserve(256);
+        order.reserve(256);
+    }
+
+    // adds the per-instance attributes to the cube's vertex array
+    void AttachInstances(unsigned int cubeVAO)
+    {
+        AttachInstances(cubeVAO, InstanceVBO);
+    }
+
+    // same, sourcing the instances from a buffer filled elsewhere (GpuCulling)
+    void AttachInstances(unsigned int cubeVAO, unsigned int instanceBuffer)
+    {
+        glBindVertexArray(cubeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        pointInstances(0);
+        for (int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(INSTANCE_MODEL_ATTRIBUTE + column);
+            glVertexAttribDivisor(INSTANCE_MODEL_ATTRIBUTE + column, 1);
+        }
+        glEnableVertexAttribArray(INSTANCE_IDS_ATTRIBUTE);
+        glVertexAttribDivisor(INSTANCE_IDS_ATTRIBUTE, 1);
+        glBindVertexArray(0);
+    }
+
+    void Begin()
+    {
+        instances.clear();
+        uploaded = false;
+        DrawCalls = 0;
+        Triangles = 0;
+    }
+
+    void Add(const Scene& scene, unsigned int part, unsigned int view)
+    {
+        SceneInstance instance;
+        instance.Model = scene.PartModel[part];
+        instance.Material = scene.PartMaterial[part];
+        instance.View = view;
+        instance.Lightmap = scene.PartLightmap[part];
+        instance.Padding = 0;
+        instances.push_back(instance);
+    }
+
+    // visible set of a single view
+    void AddVisible(const Scene& scene, const unsigned int* parts, unsigned int count)
+    {
+        for (unsigned int i = 0; i < count; i++)
+            Add(scene, parts[i], 0);
+    }
+
+    // visible set of several views; one instance per view a part was visible in
+    void AddVisible(const Scene& scene, const unsigned int* parts, const unsigned int* viewMasks, unsigned int count)
+    {
+        for (unsigned int i = 0; i < count; i++)
+        {
+            for (unsigned int view = 0; view < static_cast<unsigned int>(SCENE_MAX_VIEWS); view++)
+            {
+                if (viewMasks[i] & (1u << view))
+                    Add(scene, parts[i], view);
+            }
+        }
+    }
+
+    unsigned int InstanceCount() const { return static_cast<unsigned int>(instances.size()); }
+
+    // baked lighting for instances with a lightmap slot; NULL lights everything dynamically
+    void UseLightmap(const Lightmap* bakedLighting)
+    {
+        lightmap = bakedLighting;
+    }
+
+    // probes glossy materials reflect; NULL reflects nothing
+    void UseReflections(const ReflectionProbes* probes)
+    {
+        reflections = probes;
+    }
+
+    // streamed material layers; NULL samples the MaterialTable's own
+    void UseTextureStreaming(const TextureStreamer* textures)
+    {
+        streamer = textures != NULL && textures->Active() ? textures : NULL;
+    }
+
+    // weighted blended targets for DrawTransparent(); NULL alpha blends the transparent instances unsorted
+    void UseTransparency(TransparencyTarget* target)
+    {
+        transparency = target;
+    }
+
+    // tiles are xy scale / zw offset in NDC; pass a full-screen tile (1, 1, 0, 0) for a single view
+    void Draw(unsigned int cubeVAO, const MaterialTable& materials, int viewCount,
+              const glm::mat4* viewProjection, const glm::vec4* tiles, const glm::vec3* eyes)
+    {
+        upload(materials, eyes);
+        unsigned int opaqueCount = static_cast<unsigned int>(instances.size()) - transparentCount;
+        if (opaqueCount == 0)
+            return;
+
+        glBindVertexArray(cubeVAO);
+        if (DepthPrepass && occluderCount > 0)
+        {
+            // the occluders close the sorted opaque instances: shaded last, where nothing nearer covers them
+            beginDraw(SCENE_PASS_DEPTH, materials, viewCount, viewProjection, tiles, eyes);
+            drawRange(opaqueCount - occluderCount, occluderCount);
+            endDraw(SCENE_PASS_DEPTH);
+        }
+        Scene_Pass pass = Overdraw ? SCENE_PASS_OVERDRAW : SCENE_PASS_SHADE;
+        beginDraw(pass, materials, viewCount, viewProjection, tiles, eyes);
+        drawRange(0, opaqueCount);
+        endDraw(pass);
+    }
+
+    // the transparent instances since Begin(), in any order, over the depth of everything drawn
+    // so far; call it after the last opaque draw of the frame. cubeVAO must have InstanceVBO attached.
+    void DrawTransparent(unsigned int cubeVAO, const MaterialTable& materials, int viewCount,
+                         const glm::mat4* viewProjection, const glm::vec4* tiles, const glm::vec3* eyes)
+    {
+        upload(materials, eyes);
+        if (transparentCount == 0)
+            return;
+
+        // the heat map counts the transparent layers like any other fragments
+        Scene_Pass pass = Overdraw ? SCENE_PASS_OVERDRAW : (transparency != NULL ? SCENE_PASS_TRANSPARENT : SCENE_PASS_SHADE);
+        if (pass == SCENE_PASS_TRANSPARENT)
+            transparency->Begin();
+        glBindVertexArray(cubeVAO);
+        beginDraw(pass, materials, viewCount, viewProjection, tiles, eyes);
+        glDepthMask(GL_FALSE);
+        glEnable(GL_BLEND);
+        if (pass == SCENE_PASS_SHADE)
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        else
+            glBlendFunc(GL_ONE, GL_ONE);
+        drawRange(static_cast<unsigned int>(instances.size()) - transparentCount, transparentCount);
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+        endDraw(pass);
+        if (pass == SCENE_PASS_TRANSPARENT)
+            transparency->Composite();
+    }
+
+    // occluders among the instances of the last Draw() with DepthPrepass
+    unsigned int OccluderCount() const { return occluderCount; }
+
+    // instances of transparent materials since Begin()
+    unsigned int TransparentCount() const { return transparentCount; }
+
+    // draws the commands GpuCulling wrote into commandBuffer; cubeVAO must have its
+    // instances attached from the matching instance buffer
+    void DrawIndirect(unsigned int cubeVAO, const MaterialTable& materials, int viewCount,
+                      const glm::mat4* viewProjection, const glm::vec4* tiles, const glm::vec3* eyes,
+                      unsigned int commandBuffer, size_t commandOffset, unsigned int commandCount)
+    {
+        glBindVertexArray(cubeVAO);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        if (DepthPrepass)
+        {
+            // the CPU does not know which parts survived culling, so every one goes into depth first
+            beginDraw(SCENE_PASS_DEPTH, materials, viewCount, viewProjection, tiles, eyes);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)commandOffset, static_cast<GLsizei>(commandCount), 0);
+            DrawCalls++;
+            endDraw(SCENE_PASS_DEPTH);
+        }
+        Scene_Pass pass = Overdraw ? SCENE_PASS_OVERDRAW : SCENE_PASS_SHADE;
+        beginDraw(pass, materials, viewCount, viewProjection, tiles, eyes);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)commandOffset, static_cast<GLsizei>(commandCount), 0);
+        DrawCalls++;
+        endDraw(pass);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    // draws runs (first instance, count) of an instance buffer attached to cubeVAO with one
+    // shared setup; GL 3.3 has no base instance, so the attributes are re-pointed per run
+    void DrawRuns(unsigned int cubeVAO, unsigned int instanceBuffer, const glm::uvec2* runs, unsigned int runCount,
+                  const MaterialTable& materials, int viewCount,
+                  const glm::mat4* viewProjection, const glm::vec4* tiles, const glm::vec3* eyes)
+    {
+        if (runCount == 0)
+            return;
+        Scene_Pass pass = Overdraw ? SCENE_PASS_OVERDRAW : SCENE_PASS_SHADE;
+        beginDraw(pass, materials, viewCount, viewProjection, tiles, eyes);
+        glBindVertexArray(cubeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        for (unsigned int i = 0; i < runCount; i++)
+        {
+            pointInstances(sizeof(SceneInstance) * runs[i].x);
+            glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, (void*)IndexOffset, static_cast<GLsizei>(runs[i].y));
+            count(runs[i].y);
+        }
+        pointInstances(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        endDraw(pass);
+    }
+
+    // renders up to faceBudget dirty probe faces with what bvh finds in their view and returns
+    // how many it rendered; DrawCalls and Triangles then count all of them. The faces see no
+    // reflections, which would read the texture being drawn, and their glass is blended
+    // plainly since the transparency targets are screen sized. Leaves the default framebuffer
+    // bound; cubeVAO must have InstanceVBO attached.
+    unsigned int CaptureReflections(ReflectionProbes& probes, unsigned int cubeVAO, const Scene& scene, const BVH& bvh,
+                                    const MaterialTable& materials, unsigned int faceBudget)
+    {
+        const ReflectionProbes* reflected = reflections;
+        TransparencyTarget* blended = transparency;
+        reflections = NULL;
+        transparency = NULL;
+
+        unsigned int faces = 0, face = 0, drawCalls = 0;
+        unsigned long long triangles = 0;
+        while (faces < faceBudget && probes.NextDirtyFace(face))
+        {
+            unsigned int visibleCount = probes.BeginFace(face, bvh);
+            glm::mat4 viewProjection = probes.FaceViewProjection(face);
+            glm::vec4 tile(1.0f, 1.0f, 0.0f, 0.0f);
+            glm::vec3 eye = probes.FacePosition(face);
+            Begin();
+            AddVisible(scene, probes.Visible(), visibleCount);
+            Draw(cubeVAO, materials, 1, &viewProjection, &tile, &eye);
+            DrawTransparent(cubeVAO, materials, 1, &viewProjection, &tile, &eye);
+            drawCalls += DrawCalls;
+            triangles += Triangles;
+            faces++;
+        }
+        if (faces > 0)
+            probes.EndFaces();
+        DrawCalls = drawCalls;
+        Triangles = triangles;
+
+        reflections = reflected;
+        transparency = blended;
+        return faces;
+    }
+
+    // gives the instance range back; the buffer belongs to the arena
+    void Release()
+    {
+        instanceBlock.Reset();
+        InstanceVBO = 0;
+        InstanceCapacity = 0;
+    }
+
+private:
+    // sort key of an instance: occluders last when pre-passing, transparent ones after them, then by distance
+    struct DrawOrder
+    {
+        unsigned int Group;
+        float Distance;
+        unsigned int Index;
+
+        bool operator<(const DrawOrder& other) const
+        {
+            return Group != other.Group ? Group < other.Group : Distance < other.Distance;
+        }
+    };
+
+    unsigned int occluderCount, transparentCount;
+    bool uploaded;              // the instances since Begin() are sorted and in instanceBlock
+    GpuArena* instanceArena;
+    GpuBlock instanceBlock;
+    const Lightmap* lightmap;
+    const ReflectionProbes* reflections;
+    const TextureStreamer* streamer;
+    TransparencyTarget* transparency;
+    Shader shader, depthShader, overdrawShader, transparentShader;
+    Shader* programs[SCENE_PASS_COUNT];
+    GLint viewProjectionLocations[SCENE_PASS_COUNT], tileLocations[SCENE_PASS_COUNT];
+    GLint eyeLocations[SCENE_PASS_COUNT], lightLocations[SCENE_PASS_COUNT];
+    GLint probeCountLocations[SCENE_PASS_COUNT], probePositionLocations[SCENE_PASS_COUNT];
+    GLint probeMinLocations[SCENE_PASS_COUNT], probeMaxLocations[SCENE_PASS_COUNT];
+    GLint streamedCountLocations[SCENE_PASS_COUNT], streamedPoolLocations[SCENE_PASS_COUNT], streamedSlotLocations[SCENE_PASS_COUNT];
+    std::vector<SceneInstance> instances, sorted;
+    std::vector<DrawOrder> order;
+
+    // sorts the instances once per Begin() and uploads them for Draw() and DrawTransparent()
+    void upload(const MaterialTable& materials, const glm::vec3* eyes)
+    {
+        if (uploaded)
+            return;
+        uploaded = true;
+        occluderCount = 0;
+        transparentCount = 0;
+        if (instances.empty())
+            return;
+
+        bool transparent = materials.HasTransparent();
+        if (FrontToBack || DepthPrepass || transparent)
+            sort(materials, transparent, eyes);
+
+        if (instances.size() > InstanceCapacity)
+        {
+            // the old range goes back first, so the new one can take its place
+            instanceBlock.Reset();
+            instanceBlock = instanceArena->Allocate(sizeof(SceneInstance) * instances.capacity(), "scene instances");
+            InstanceCapacity = instanceBlock.Valid() ? static_cast<unsigned int>(instanceBlock.Size() / sizeof(SceneInstance)) : 0;
+            if (!instanceBlock.Valid())
+            {
+                // the arena reported it; draw nothing rather than a partial frame
+                instances.clear();
+                occluderCount = transparentCount = 0;
+                return;
+            }
+        }
+        instanceBlock.Upload(instances.data(), sizeof(SceneInstance) * instances.size());
+    }
+
+    // orders the instances front to back per view, with the occluders behind the rest when pre-passing
+    // and the transparent instances at the very end
+    void sort(const MaterialTable& materials, bool transparent, const glm::vec3* eyes)
+    {
+        order.resize(instances.size());
+        for (unsigned int i = 0; i < instances.size(); i++)
+        {
+            const glm::mat4& model = instances[i].Model;
+            // world box of the unit cube (half extent 0.25) under the model matrix
+            glm::vec3 center(model[3]);
+            glm::vec3 halfExtent = 0.25f * (glm::abs(glm::vec3(model[0])) + glm::abs(glm::vec3(model[1])) + glm::abs(glm::vec3(model[2])));
+            glm::vec3 d = glm::max(glm::abs(eyes[instances[i].View] - center) - halfExtent, glm::vec3(0.0f));
+
+            if (transparent && materials.Transparent(instances[i].Material))
+                order[i].Group = 2u;
+            else
+                order[i].Group = DepthPrepass && occluder(model) ? 1u : 0u;
+            order[i].Distance = d.x * d.x + d.y * d.y + d.z * d.z;
+            order[i].Index = i;
+        }
+        std::sort(order.begin(), order.end());
+
+        sorted.resize(instances.size());
+        for (unsigned int i = 0; i < order.size(); i++)
+        {
+            sorted[i] = instances[order[i].Index];
+            occluderCount += order[i].Group == 1u;
+            transparentCount += order[i].Group == 2u;
+        }
+        instances.swap(sorted);
+    }
+
+    // instanced draw of count uploaded instances from first on; the range is looked up
+    // every time since defragmentation may have moved it
+    void drawRange(unsigned int first, unsigned int instanceCount)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, InstanceVBO);
+        pointInstances(instanceBlock.Offset() + sizeof(SceneInstance) * first);
+        glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, (void*)IndexOffset, static_cast<GLsizei>(instanceCount));
+        count(instanceCount);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // statistics of one instanced draw of the 12-triangle cube
+    void count(unsigned int instanceCount)
+    {
+        DrawCalls++;
+        Triangles += 12ull * instanceCount;
+    }
+
+    // an instance with a large face hides much of what lies behind it
+    static bool occluder(const glm::mat4& model)
+    {
+        // edge lengths of the cube (0.5) after the model transform
+        float a = 0.5f * glm::length(glm::vec3(model[0]));
+        float b = 0.5f * glm::length(glm::vec3(model[1]));
+        float c = 0.5f * glm::length(glm::vec3(model[2]));
+        return std::max(a * b, std::max(b * c, a * c)) >= SCENE_OCCLUDER_MIN_AREA;
+    }
+
+    void beginDraw(Scene_Pass pass, const MaterialTable& materials, int viewCount,
+                   const glm::mat4* viewProjection, const glm::vec4* tiles, const glm::vec3* eyes)
+    {
+        viewCount = std::min(viewCount, SCENE_MAX_VIEWS);
+        programs[pass]->use();
+        glUniformMatrix4fv(viewProjectionLocations[pass], viewCount, GL_FALSE, glm::value_ptr(viewProjection[0]));
+        glUniform4fv(tileLocations[pass], viewCount, glm::value_ptr(tiles[0]));
+        if (pass == SCENE_PASS_SHADE || pass == SCENE_PASS_TRANSPARENT)
+        {
+            glUniform3fv(eyeLocations[pass], viewCount, glm::value_ptr(eyes[0]));
+            glUniform3fv(lightLocations[pass], 1, glm::value_ptr(LightDirection));
+            materials.Bind(MATERIAL_TABLE_UNIT, MATERIAL_LAYER_UNIT);
+            if (lightmap != NULL)
+                lightmap->Bind(LIGHTMAP_ATLAS_UNIT, LIGHTMAP_RECT_UNIT);
+            int probeCount = reflections != NULL ? reflections->ProbeCount() : 0;
+            glUniform1i(probeCountLocations[pass], probeCount);
+            if (probeCount > 0)
+            {
+                glUniform3fv(probePositionLocations[pass], probeCount, glm::value_ptr(reflections->Positions[0]));
+                glUniform3fv(probeMinLocations[pass], probeCount, glm::value_ptr(reflections->VolumeMin[0]));
+                glUniform3fv(probeMaxLocations[pass], probeCount, glm::value_ptr(reflections->VolumeMax[0]));
+                reflections->Bind(REFLECTION_FACES_UNIT);
+            }
+            int streamedCount = streamer != NULL ? static_cast<int>(streamer->TextureCount()) : 0;
+            glUniform1i(streamedCountLocations[pass], streamedCount);
+            if (streamedCount > 0)
+            {
+                glUniform1iv(streamedPoolLocations[pass], streamedCount, streamer->TexturePool);
+                glUniform1iv(streamedSlotLocations[pass], streamedCount, streamer->TextureSlot);
+                streamer->Bind(MATERIAL_LAYER_UNIT, STREAMED_LEVEL_UNIT);
+            }
+        }
+        if (pass == SCENE_PASS_DEPTH)
+        {
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        }
+        else if (DepthPrepass)
+        {
+            // the pre-passed occluders must pass against their own depth
+            glDepthFunc(GL_LEQUAL);
+        }
+        if (pass == SCENE_PASS_OVERDRAW)
+        {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+        }
+
+        // tiles are kept apart by clip distances; a single full-screen view never clips
+        for (int i = 0; i < 4; i++)
+            glEnable(GL_CLIP_DISTANCE0 + i);
+    }
+
+    // instance attribute pointers into the bound GL_ARRAY_BUFFER, starting at byteOffset
+    void pointInstances(size_t byteOffset)
+    {
+        for (int column = 0; column < 4; column++)
+            glVertexAttribPointer(INSTANCE_MODEL_ATTRIBUTE + column, 4, GL_FLOAT, GL_FALSE, sizeof(SceneInstance), (void*)(byteOffset + sizeof(glm::vec4) * column));
+        glVertexAttribIPointer(INSTANCE_IDS_ATTRIBUTE, 3, GL_UNSIGNED_INT, sizeof(SceneInstance), (void*)(byteOffset + offsetof(SceneInstance, Material)));
+    }
+
+    void endDraw(Scene_Pass pass)
+    {
+        for (int i = 0; i < 4; i++)
+            glDisable(GL_CLIP_DISTANCE0 + i);
+        if (pass == SCENE_PASS_DEPTH)
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        else
+            glDepthFunc(GL_LESS);
+        if (pass == SCENE_PASS_OVERDRAW)
+            glDisable(GL_BLEND);
+    }
+};
+
+#endif
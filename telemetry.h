@@ -0,0 +1,395 @@
+//
+//  telemetry.h
+//  3D Object Drawing
+//
+//  Publishes the renderer's live counters (frame time, draw calls, triangles,
+//  culled objects, GPU memory, input latency) for monitoring without a profiler.
+//  The counters live in a POSIX shared-memory block that other processes can map
+//  read-only. The render loop writes it under a sequence lock, so it never waits:
+//  the sequence is odd while a frame is being written, and readers retry until
+//  they see the same even sequence before and after their copy. Optionally a small
+//  HTTP server on 127.0.0.1 serves the same snapshot as Prometheus text at
+//  /metrics. It runs on its own thread and only ever reads the block.
+//
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+enum Telemetry_Metric {
+    TELEMETRY_FRAMES,               // frames drawn since start
+    TELEMETRY_FRAME_TIME_US,        // CPU time of the last drawn frame, input to swap
+    TELEMETRY_GPU_TIME_US,          // GPU time of the scene, from DynamicResolution's timer
+    TELEMETRY_DRAW_CALLS,
+    TELEMETRY_TRIANGLES,
+    TELEMETRY_VISIBLE_OBJECTS,
+    TELEMETRY_CULLED_OBJECTS,
+    TELEMETRY_GPU_MEMORY_KB,        // video memory in use by every process on the device
+    TELEMETRY_INPUT_LATENCY_US,     // first input event of a frame to the end of its swap
+    TELEMETRY_METRIC_COUNT
+};
+
+// a value the renderer cannot provide (no driver extension, GPU-side culling); not exported
+const unsigned long long TELEMETRY_UNKNOWN = ~0ull;
+
+const char TELEMETRY_MAGIC[8] = { 'R', 'O', 'O', 'M', 'T', 'E', 'L', 'E' };
+const unsigned int TELEMETRY_VERSION = 1;
+const char* const TELEMETRY_SHARED_NAME = "/room_telemetry";
+
+struct TelemetryMetricInfo
+{
+    const char* Name;
+    const char* Type;
+    const char* Help;
+    double Scale;               // raw value to the exported unit
+};
+
+const TelemetryMetricInfo TELEMETRY_METRICS[TELEMETRY_METRIC_COUNT] = {
+    { "room_frames_total", "counter", "Frames drawn since start.", 1.0 },
+    { "room_frame_time_seconds", "gauge", "CPU time of the last drawn frame.", 1.0e-6 },
+    { "room_gpu_frame_time_seconds", "gauge", "GPU time of the last timed frame.", 1.0e-6 },
+    { "room_draw_calls", "gauge", "Draw calls issued by the last drawn frame.", 1.0 },
+    { "room_triangles", "gauge", "Triangles submitted by the last drawn frame.", 1.0 },
+    { "room_visible_objects", "gauge", "Objects that passed culling in the last drawn frame.", 1.0 },
+    { "room_culled_objects", "gauge", "Objects rejected by culling in the last drawn frame.", 1.0 },
+    { "room_gpu_memory_used_bytes", "gauge", "Video memory in use on the device.", 1024.0 },
+    { "room_input_latency_seconds", "gauge", "Time from the last input event to the swap that showed it.", 1.0e-6 },
+};
+
+// layout of the shared block; readers check Magic, Version and MetricCount before trusting it
+struct TelemetryBlock
+{
+    char Magic[8];
+    unsigned int Version;
+    unsigned int MetricCount;
+    std::atomic<unsigned int> Sequence;
+    std::atomic<unsigned long long> Values[TELEMETRY_METRIC_COUNT];
+};
+
+// GL_NVX_gpu_memory_info; core GL cannot tell how much video memory is in use
+const GLenum TELEMETRY_GPU_MEMORY_TOTAL_NVX = 0x9048;
+const GLenum TELEMETRY_GPU_MEMORY_AVAILABLE_NVX = 0x9049;
+
+// video memory in use on the current context's device, in KiB, or TELEMETRY_UNKNOWN
+// when the driver does not report it
+inline unsigned long long QueryGpuMemoryKB()
+{
+    static int supported = -1;
+    if (supported < 0)
+    {
+        supported = 0;
+        GLint extensionCount = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for (GLint i = 0; i < extensionCount; i++)
+        {
+            const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+            if (extension != NULL && std::strcmp(extension, "GL_NVX_gpu_memory_info") == 0)
+                supported = 1;
+        }
+    }
+    if (!supported)
+        return TELEMETRY_UNKNOWN;
+    GLint total = 0, available = 0;
+    glGetIntegerv(TELEMETRY_GPU_MEMORY_TOTAL_NVX, &total);
+    glGetIntegerv(TELEMETRY_GPU_MEMORY_AVAILABLE_NVX, &available);
+    return total > available ? static_cast<unsigned long long>(total - available) : 0ull;
+}
+
+class Telemetry
+{
+public:
+    Telemetry() : block(NULL), shared(false), listener(-1), serving(false)
+    {
+        for (int i = 0; i < TELEMETRY_METRIC_COUNT; i++)
+            values[i] = TELEMETRY_UNKNOWN;
+    }
+
+    ~Telemetry()
+    {
+        Close();
+    }
+
+    Telemetry(const Telemetry&) = delete;
+    Telemetry& operator=(const Telemetry&) = delete;
+
+    // creates (or takes over) the named shared block; when that fails the counters are
+    // kept in private memory so the HTTP endpoint still works
+    void Open(const char* name)
+    {
+        sharedName = name;
+#ifndef _WIN32
+        int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+        if (fd >= 0 && ftruncate(fd, sizeof(TelemetryBlock)) == 0)
+        {
+            void* memory = mmap(NULL, sizeof(TelemetryBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (memory != MAP_FAILED)
+            {
+                block = static_cast<TelemetryBlock*>(memory);
+                shared = true;
+            }
+        }
+        if (fd >= 0)
+            close(fd);
+#endif
+        if (block == NULL)
+        {
+            std::cout << "ERROR::TELEMETRY::SHARED_MEMORY_FAILED " << name << std::endl;
+            block = new TelemetryBlock;
+        }
+
+        // the magic goes in last, a reader that sees it sees an initialized block
+        std::memset(block->Magic, 0, sizeof(block->Magic));
+        block->Version = TELEMETRY_VERSION;
+        block->MetricCount = TELEMETRY_METRIC_COUNT;
+        block->Sequence.store(0, std::memory_order_relaxed);
+        for (int i = 0; i < TELEMETRY_METRIC_COUNT; i++)
+            block->Values[i].store(TELEMETRY_UNKNOWN, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(block->Magic, TELEMETRY_MAGIC, sizeof(TELEMETRY_MAGIC));
+    }
+
+    // starts the /metrics endpoint on 127.0.0.1:port
+    bool Serve(int port)
+    {
+#ifndef _WIN32
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        if (listener < 0)
+            return false;
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<unsigned short>(port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 8) != 0)
+        {
+            std::cout << "ERROR::TELEMETRY::BIND_FAILED port " << port << std::endl;
+            close(listener);
+            listener = -1;
+            return false;
+        }
+        serving.store(true);
+        server = std::thread([this]() { serve(); });
+        std::cout << "telemetry: serving http://127.0.0.1:" << port << "/metrics" << std::endl;
+        return true;
+#else
+        std::cout << "ERROR::TELEMETRY::BIND_FAILED port " << port << std::endl;
+        return false;
+#endif
+    }
+
+    // stages a value for the next Publish()
+    void Set(Telemetry_Metric metric, unsigned long long value)
+    {
+        values[metric] = value;
+    }
+
+    // writes the staged values; never waits, whatever the readers are doing
+    void Publish()
+    {
+        if (block == NULL)
+            return;
+        unsigned int sequence = block->Sequence.load(std::memory_order_relaxed);
+        block->Sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (int i = 0; i < TELEMETRY_METRIC_COUNT; i++)
+            block->Values[i].store(values[i], std::memory_order_relaxed);
+        block->Sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // consistent copy of a block's values; false if the writer kept it busy
+    static bool Snapshot(const TelemetryBlock& source, unsigned long long* out)
+    {
+        for (int attempt = 0; attempt < 1000; attempt++)
+        {
+            unsigned int before = source.Sequence.load(std::memory_order_acquire);
+            if (before & 1u)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            for (int i = 0; i < TELEMETRY_METRIC_COUNT; i++)
+                out[i] = source.Values[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (source.Sequence.load(std::memory_order_relaxed) == before)
+                return true;
+        }
+        return false;
+    }
+
+    // Prometheus text exposition format, version 0.0.4
+    static std::string Format(const unsigned long long* snapshot)
+    {
+        std::string text;
+        char line[160];
+        for (int i = 0; i < TELEMETRY_METRIC_COUNT; i++)
+        {
+            if (snapshot[i] == TELEMETRY_UNKNOWN)
+                continue;
+            const TelemetryMetricInfo& metric = TELEMETRY_METRICS[i];
+            snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", metric.Name, metric.Help, metric.Name, metric.Type);
+            text += line;
+            if (metric.Scale == 1.0)
+                snprintf(line, sizeof(line), "%s %llu\n", metric.Name, snapshot[i]);
+            else
+                snprintf(line, sizeof(line), "%s %.9g\n", metric.Name, static_cast<double>(snapshot[i]) * metric.Scale);
+            text += line;
+        }
+        return text;
+    }
+
+    // prints the metrics of a running instance's shared block; used by --read-telemetry
+    static int Dump(const char* name)
+    {
+#ifndef _WIN32
+        int fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0)
+        {
+            std::cout << "ERROR::TELEMETRY::NOT_PUBLISHED " << name << std::endl;
+            return 1;
+        }
+        void* memory = mmap(NULL, sizeof(TelemetryBlock), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED)
+        {
+            std::cout << "ERROR::TELEMETRY::NOT_PUBLISHED " << name << std::endl;
+            return 1;
+        }
+        const TelemetryBlock* source = static_cast<const TelemetryBlock*>(memory);
+        unsigned long long snapshot[TELEMETRY_METRIC_COUNT];
+        bool valid = std::memcmp(source->Magic, TELEMETRY_MAGIC, sizeof(TELEMETRY_MAGIC)) == 0 &&
+                     source->Version == TELEMETRY_VERSION && source->MetricCount == TELEMETRY_METRIC_COUNT;
+        bool consistent = valid && Snapshot(*source, snapshot);
+        munmap(memory, sizeof(TelemetryBlock));
+        if (!consistent)
+        {
+            std::cout << "ERROR::TELEMETRY::INVALID_BLOCK " << name << std::endl;
+            return 1;
+        }
+        std::cout << Format(snapshot);
+        return 0;
+#else
+        std::cout << "ERROR::TELEMETRY::NOT_PUBLISHED " << name << std::endl;
+        return 1;
+#endif
+    }
+
+    // stops the endpoint and removes the shared block
+    void Close()
+    {
+#ifndef _WIN32
+        if (serving.exchange(false))
+            server.join();
+        if (listener >= 0)
+        {
+            close(listener);
+            listener = -1;
+        }
+        if (shared)
+        {
+            munmap(block, sizeof(TelemetryBlock));
+            shm_unlink(sharedName.c_str());
+            shared = false;
+            block = NULL;
+        }
+#endif
+        delete block;
+        block = NULL;
+    }
+
+private:
+    TelemetryBlock* block;
+    bool shared;
+    std::string sharedName;
+    unsigned long long values[TELEMETRY_METRIC_COUNT];
+    int listener;
+    std::atomic<bool> serving;
+    std::thread server;
+
+#ifndef _WIN32
+    // one request per connection; polls with a timeout so Close() is noticed
+    void serve()
+    {
+        pollfd waiting = { listener, POLLIN, 0 };
+        while (serving.load(std::memory_order_relaxed))
+        {
+            if (poll(&waiting, 1, 100) <= 0)
+                continue;
+            int client = accept(listener, NULL, NULL);
+            if (client < 0)
+                continue;
+            respond(client);
+            close(client);
+        }
+    }
+
+    void respond(int client)
+    {
+        // read the request line; a client that sends nothing within a second is dropped
+        char request[1024];
+        size_t received = 0;
+        pollfd reading = { client, POLLIN, 0 };
+        while (received < sizeof(request) - 1 && std::memchr(request, '\n', received) == NULL)
+        {
+            if (poll(&reading, 1, 1000) <= 0)
+                return;
+            ssize_t count = recv(client, request + received, sizeof(request) - 1 - received, 0);
+            if (count <= 0)
+                return;
+            received += static_cast<size_t>(count);
+        }
+        request[received] = '\0';
+
+        std::string status = "200 OK", body;
+        unsigned long long snapshot[TELEMETRY_METRIC_COUNT];
+        if (std::strncmp(request, "GET /metrics ", 13) != 0 && std::strncmp(request, "GET / ", 6) != 0)
+        {
+            status = "404 Not Found";
+            body = "not found\n";
+        }
+        else if (!Snapshot(*block, snapshot))
+        {
+            status = "503 Service Unavailable";
+            body = "busy\n";
+        }
+        else
+        {
+            body = Format(snapshot);
+        }
+
+        std::string response = "HTTP/1.1 " + status + "\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                               std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        const char* data = response.data();
+        size_t remaining = response.size();
+        while (remaining > 0)
+        {
+            ssize_t count = send(client, data, remaining, MSG_NOSIGNAL);
+            if (count <= 0)
+                return;
+            data += count;
+            remaining -= static_cast<size_t>(count);
+        }
+    }
+#endif
+};
+
+#endif
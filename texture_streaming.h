@@ -0,0 +1,569 @@
+//
+//  texture_streaming.h
+//  3D Object Drawing
+//
+//  Streams the material layers at resolutions that would not fit in memory for a
+//  whole building. A texture pack holds every layer's full mip chain, compressed
+//  as BC4 (RGTC1, one channel at half a byte per texel) exactly as the GPU takes
+//  it, so a level goes from the file to the texture unchanged. The coarse levels
+//  from TEXSTREAM_TAIL_LEVEL down are loaded for every layer at start and never
+//  leave; the finer ones are streamed.
+//
+//  Every frame the caller requests each visible textured surface with its size on
+//  screen, and a layer's needed level is the one that puts about a texel on a pixel
+//  of its largest request. Loads run on the thread pool into staging buffers and
+//  are uploaded a bounded number of bytes per frame; until one lands, the layer
+//  samples the levels it has, down to its resident tail.
+//
+//  GL 3.3 cannot commit memory per mip level, so MemoryBudget is carved up front
+//  into one texture array per streamed level, coarsest first: a slot in the pool of
+//  level L holds one layer's levels L and below. A layer owns at most one slot.
+//  When the pool it needs is full, the slot of a layer that now wants less detail
+//  than it holds is taken (that layer falls back to its tail), or the next coarser
+//  pool is tried.
+//
+
+#ifndef TEXTURE_STREAMING_H
+#define TEXTURE_STREAMING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "materials.h"
+#include "scene.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// must match MAX_STREAMED_LAYERS in sceneShader.fs
+const int TEXSTREAM_MAX_TEXTURES = 16;
+// streamed levels, one pool each; must match the streamedLevel samplers in sceneShader.fs
+const int TEXSTREAM_POOLS = 3;
+// levels from here down are always resident; the tail's top is MATERIAL_TEXTURE_SIZE
+const int TEXSTREAM_TAIL_LEVEL = TEXSTREAM_POOLS;
+const int TEXSTREAM_TOP_SIZE = MATERIAL_TEXTURE_SIZE << TEXSTREAM_POOLS;
+// texture repeats per world unit, TEXTURE_SCALE in sceneShader.fs
+const float TEXSTREAM_REPEATS_PER_UNIT = 0.5f;
+const unsigned int TEXSTREAM_LOADS_IN_FLIGHT = 2;
+// surfaces closer than this to the eye request as if they were this far
+const float TEXSTREAM_NEAREST = 0.1f;
+
+const char TEXSTREAM_FILE_MAGIC[4] = { 'T', 'X', 'S', 'T' };
+const unsigned int TEXSTREAM_FILE_VERSION = 1;
+
+// TexturePool of a layer that only has its tail
+const int TEXSTREAM_TAIL = -1;
+
+enum Texture_Load_State {
+    TEXTURE_LOAD_EMPTY,     // staging buffer is free
+    TEXTURE_LOAD_READING,   // a worker is reading it from the pack
+    TEXTURE_LOAD_READY,     // read, waiting for its upload
+    TEXTURE_LOAD_FAILED     // the pack could not be read
+};
+
+class TextureStreamer
+{
+public:
+    size_t MemoryBudget;            // GPU bytes for the tails and the pools
+    size_t UploadBudget;            // bytes uploaded per frame at most
+    // per layer: pool its finest levels are sampled from (TEXSTREAM_TAIL for the tail) and the slot in it
+    int TexturePool[TEXSTREAM_MAX_TEXTURES];
+    int TextureSlot[TEXSTREAM_MAX_TEXTURES];
+
+    // statistics
+    unsigned long long Loads, Evictions, UploadedBytes;
+
+    TextureStreamer(ThreadPool& pool, size_t memoryBudget)
+        : MemoryBudget(memoryBudget), UploadBudget(1 << 20), Loads(0), Evictions(0), UploadedBytes(0), pool(pool),
+          textureCount(0), levelCount(0), topSize(0), textureBytes(0), tailArray(0)
+    {
+        for (int i = 0; i < TEXSTREAM_MAX_TEXTURES; i++)
+        {
+            TexturePool[i] = TEXSTREAM_TAIL;
+            TextureSlot[i] = 0;
+            needed[i] = TEXSTREAM_TAIL_LEVEL;
+            loading[i] = false;
+        }
+        for (int p = 0; p < TEXSTREAM_POOLS; p++)
+            poolArrays[p] = 0;
+    }
+
+    ~TextureStreamer()
+    {
+        Release();
+    }
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // opens a pack written by Write(), loads its tails and carves the budget into the pools;
+    // false if there is no usable pack
+    bool Open(const char* path)
+    {
+        FILE* file = std::fopen(path, "rb");
+        if (file == NULL)
+            return false;
+        char magic[4];
+        unsigned int header[4];
+        bool ok = std::fread(magic, 1, 4, file) == 4 && std::fread(header, sizeof(unsigned int), 4, file) == 4 &&
+                  std::memcmp(magic, TEXSTREAM_FILE_MAGIC, 4) == 0 && header[0] == TEXSTREAM_FILE_VERSION &&
+                  header[1] <= static_cast<unsigned int>(TEXSTREAM_MAX_TEXTURES) && header[2] == static_cast<unsigned int>(TEXSTREAM_TOP_SIZE) &&
+                  header[3] == chainLevels();
+        if (!ok)
+        {
+            std::cout << "ERROR::TEXTURE_STREAMING::BAD_PACK " << path << std::endl;
+            std::fclose(file);
+            return false;
+        }
+        packPath = path;
+        textureCount = header[1];
+        topSize = static_cast<int>(header[2]);
+        levelCount = header[3];
+        textureBytes = levelOffset(levelCount);
+
+        // the tails, read straight into their array
+        size_t tailBytes = textureBytes - levelOffset(TEXSTREAM_TAIL_LEVEL);
+        std::vector<unsigned char> tails(tailBytes * textureCount);
+        for (unsigned int texture = 0; texture < textureCount && ok; texture++)
+        {
+            std::fseek(file, static_cast<long>(headerBytes() + texture * textureBytes + levelOffset(TEXSTREAM_TAIL_LEVEL)), SEEK_SET);
+            ok = std::fread(&tails[texture * tailBytes], 1, tailBytes, file) == tailBytes;
+        }
+        std::fclose(file);
+        if (!ok)
+        {
+            std::cout << "ERROR::TEXTURE_STREAMING::TRUNCATED_PACK " << path << std::endl;
+            return false;
+        }
+        tailArray = createArray(TEXSTREAM_TAIL_LEVEL, textureCount);
+        for (unsigned int texture = 0; texture < textureCount; texture++)
+            uploadLevels(tailArray, TEXSTREAM_TAIL_LEVEL, texture, &tails[texture * tailBytes]);
+
+        // coarsest pools first, so every layer can get some detail before any gets the finest
+        size_t remaining = MemoryBudget > tailBytes * textureCount ? MemoryBudget - tailBytes * textureCount : 0;
+        size_t stagingBytes = 0;
+        for (int p = TEXSTREAM_POOLS - 1; p >= 0; p--)
+        {
+            size_t slotBytes = textureBytes - levelOffset(p);
+            unsigned int capacity = static_cast<unsigned int>(std::min<size_t>(remaining / slotBytes, textureCount));
+            remaining -= slotBytes * capacity;
+            poolOwners[p].assign(capacity, -1);
+            poolArrays[p] = capacity > 0 ? createArray(p, capacity) : 0;
+            if (capacity > 0)
+                stagingBytes = slotBytes;
+        }
+        for (Load& load : loads)
+            load.Data.resize(stagingBytes);
+        return true;
+    }
+
+    bool Active() const { return tailArray != 0; }
+    unsigned int TextureCount() const { return textureCount; }
+
+    int ResidentLevel(unsigned int texture) const
+    {
+        return TexturePool[texture] == TEXSTREAM_TAIL ? TEXSTREAM_TAIL_LEVEL : TexturePool[texture];
+    }
+
+    // a surface with this texture covers pixelsPerUnit screen pixels per world unit
+    void Request(unsigned int texture, float pixelsPerUnit)
+    {
+        if (texture >= textureCount || pixelsPerUnit <= 0.0f)
+            return;
+        float texelsPerPixel = TEXSTREAM_TOP_SIZE * TEXSTREAM_REPEATS_PER_UNIT / pixelsPerUnit;
+        int level = static_cast<int>(std::floor(std::log2(std::max(texelsPerPixel, 1.0f))));
+        needed[texture] = std::min(needed[texture], std::min(level, TEXSTREAM_TAIL_LEVEL));
+    }
+
+    // requests the layers of the given parts as seen from eye, where a world unit at distance 1
+    // covers pixelsAtUnitDistance pixels (height / (2 tan(fov / 2)) for a perspective view)
+    void RequestParts(const Scene& scene, const MaterialTable& materials, const unsigned int* parts, unsigned int count,
+                      const glm::vec3& eye, float pixelsAtUnitDistance)
+    {
+        for (unsigned int i = 0; i < count; i++)
+        {
+            float layer = materials.Materials[scene.PartMaterial[parts[i]]].Layer;
+            if (layer < 0.0f)
+                continue;
+            // the nearest point of the part is where it needs the most detail
+            float distance = std::max(std::sqrt(scene.PartBounds[parts[i]].DistanceSquared(eye)), TEXSTREAM_NEAREST);
+            Request(static_cast<unsigned int>(layer), pixelsAtUnitDistance / distance);
+        }
+    }
+
+    // loads are on the way; the caller keeps its frames coming until they land
+    bool Busy() const
+    {
+        for (const Load& load : loads)
+            if (load.State.load(std::memory_order_acquire) != TEXTURE_LOAD_EMPTY)
+                return true;
+        return false;
+    }
+
+    // uploads finished loads, starts the ones this frame's requests call for and returns true
+    // when any layer's sampled levels changed
+    bool Update()
+    {
+        if (!Active())
+            return false;
+        bool changed = upload();
+
+        // the layers that want the most detail go first
+        for (int level = 0; level < TEXSTREAM_TAIL_LEVEL; level++)
+        {
+            for (unsigned int texture = 0; texture < textureCount; texture++)
+            {
+                if (needed[texture] != level || loading[texture] || level >= ResidentLevel(texture))
+                    continue;
+                Load* load = freeLoad();
+                if (load == NULL)
+                    break;
+                // the finest pool with room that still improves on what the layer has
+                for (int p = level; p < ResidentLevel(texture); p++)
+                {
+                    int slot = acquire(p, changed);
+                    if (slot < 0)
+                        continue;
+                    start(*load, texture, p, slot);
+                    break;
+                }
+            }
+        }
+        for (unsigned int texture = 0; texture < textureCount; texture++)
+            needed[texture] = TEXSTREAM_TAIL_LEVEL;
+        return changed;
+    }
+
+    // the tails replace the MaterialTable's layers on tailUnit; pool p goes to firstPoolUnit + p
+    void Bind(int tailUnit, int firstPoolUnit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + tailUnit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, tailArray);
+        for (int p = 0; p < TEXSTREAM_POOLS; p++)
+        {
+            glActiveTexture(GL_TEXTURE0 + firstPoolUnit + p);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, poolArrays[p]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void PrintStats() const
+    {
+        if (!Active())
+            return;
+        size_t bytes = (textureBytes - levelOffset(TEXSTREAM_TAIL_LEVEL)) * textureCount;
+        std::cout << "texture streaming: " << textureCount << " layers, pools of";
+        for (int p = 0; p < TEXSTREAM_POOLS; p++)
+        {
+            std::cout << " " << poolOwners[p].size() << "x" << (topSize >> p);
+            bytes += (textureBytes - levelOffset(p)) * poolOwners[p].size();
+        }
+        std::cout << " (" << bytes / 1024 << " KiB of " << MemoryBudget / 1024 << "), " << Loads << " loads, " << Evictions
+                  << " evictions, " << UploadedBytes / 1024 << " KiB uploaded" << std::endl;
+    }
+
+    // waits for the workers, then frees the arrays
+    void Release()
+    {
+        if (!Active())
+            return;
+        pool.Wait();
+        glDeleteTextures(1, &tailArray);
+        glDeleteTextures(TEXSTREAM_POOLS, poolArrays);
+        tailArray = 0;
+        for (int p = 0; p < TEXSTREAM_POOLS; p++)
+        {
+            poolArrays[p] = 0;
+            poolOwners[p].clear();
+        }
+    }
+
+    // writes the full mip chains of the first layerCount material layers at TEXSTREAM_TOP_SIZE
+    static bool Write(const char* path, unsigned int layerCount)
+    {
+        FILE* file = std::fopen(path, "wb");
+        if (file == NULL)
+        {
+            std::cout << "ERROR::TEXTURE_STREAMING::CANNOT_WRITE " << path << std::endl;
+            return false;
+        }
+        unsigned int levels = chainLevels();
+        unsigned int header[4] = { TEXSTREAM_FILE_VERSION, layerCount, static_cast<unsigned int>(TEXSTREAM_TOP_SIZE), levels };
+        bool ok = std::fwrite(TEXSTREAM_FILE_MAGIC, 1, 4, file) == 4 && std::fwrite(header, sizeof(unsigned int), 4, file) == 4;
+
+        std::vector<float> level, next;
+        std::vector<unsigned char> blocks;
+        for (unsigned int layer = 0; layer < layerCount && ok; layer++)
+        {
+            int size = TEXSTREAM_TOP_SIZE;
+            level.resize(static_cast<size_t>(size) * size);
+            for (int y = 0; y < size; y++)
+                for (int x = 0; x < size; x++)
+                    level[static_cast<size_t>(y) * size + x] = MaterialLayerValue(static_cast<int>(layer), static_cast<float>(x) / size, static_cast<float>(y) / size);
+            for (unsigned int l = 0; l < levels && ok; l++)
+            {
+                encodeLevel(level, size, blocks);
+                ok = std::fwrite(blocks.data(), 1, blocks.size(), file) == blocks.size();
+                // box filter down to the next level
+                int half = std::max(size / 2, 1);
+                next.resize(static_cast<size_t>(half) * half);
+                for (int y = 0; y < half; y++)
+                    for (int x = 0; x < half; x++)
+                    {
+                        int x0 = std::min(x * 2, size - 1), x1 = std::min(x * 2 + 1, size - 1);
+                        int y0 = std::min(y * 2, size - 1), y1 = std::min(y * 2 + 1, size - 1);
+                        next[static_cast<size_t>(y) * half + x] = 0.25f * (level[y0 * size + x0] + level[y0 * size + x1] + level[y1 * size + x0] + level[y1 * size + x1]);
+                    }
+                level.swap(next);
+                size = half;
+            }
+        }
+        ok = std::fclose(file) == 0 && ok;
+        if (!ok)
+            std::cout << "ERROR::TEXTURE_STREAMING::CANNOT_WRITE " << path << std::endl;
+        return ok;
+    }
+
+private:
+    struct Load
+    {
+        std::atomic<int> State;
+        unsigned int Texture;
+        int Pool, Slot;
+        std::vector<unsigned char> Data;
+
+        Load() : State(TEXTURE_LOAD_EMPTY), Texture(0), Pool(0), Slot(0) {}
+    };
+
+    ThreadPool& pool;
+    std::string packPath;
+    unsigned int textureCount, levelCount;
+    int topSize;
+    size_t textureBytes;            // one layer's full chain in the pack
+    unsigned int tailArray;
+    unsigned int poolArrays[TEXSTREAM_POOLS];
+    std::vector<int> poolOwners[TEXSTREAM_POOLS];   // per slot: layer holding or loading into it, -1 if free
+    int needed[TEXSTREAM_MAX_TEXTURES];             // finest level requested since the last Update()
+    bool loading[TEXSTREAM_MAX_TEXTURES];
+    Load loads[TEXSTREAM_LOADS_IN_FLIGHT];
+
+    static size_t headerBytes() { return 4 + 4 * sizeof(unsigned int); }
+
+    static size_t levelBytes(int size)
+    {
+        size_t blocks = static_cast<size_t>(std::max((size + 3) / 4, 1));
+        return blocks * blocks * 8;
+    }
+
+    // levels of a full mip chain at TEXSTREAM_TOP_SIZE, down to 1x1
+    static unsigned int chainLevels()
+    {
+        unsigned int levels = 1;
+        while ((TEXSTREAM_TOP_SIZE >> levels) > 0)
+            levels++;
+        return levels;
+    }
+
+    // bytes of levels 0..level-1 of a layer
+    size_t levelOffset(unsigned int level) const
+    {
+        size_t offset = 0;
+        for (unsigned int l = 0; l < level; l++)
+            offset += levelBytes(std::max(topSize >> l, 1));
+        return offset;
+    }
+
+    // an array of layers holding levels firstLevel and below, single channel read back as gray
+    unsigned int createArray(int firstLevel, unsigned int layers)
+    {
+        unsigned int array;
+        glGenTextures(1, &array);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        for (unsigned int l = firstLevel; l < levelCount; l++)
+        {
+            int size = std::max(topSize >> l, 1);
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, l - firstLevel, GL_COMPRESSED_RED_RGTC1, size, size, layers, 0,
+                                   static_cast<GLsizei>(levelBytes(size) * layers), NULL);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levelCount - firstLevel - 1));
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_G, GL_RED);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_B, GL_RED);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_A, GL_ONE);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return array;
+    }
+
+    // levels firstLevel and below of one layer, as stored in the pack, into layer of array
+    size_t uploadLevels(unsigned int array, int firstLevel, unsigned int layer, const unsigned char* data)
+    {
+        size_t bytes = 0;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        for (unsigned int l = firstLevel; l < levelCount; l++)
+        {
+            int size = std::max(topSize >> l, 1);
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, l - firstLevel, 0, 0, layer, size, size, 1, GL_COMPRESSED_RED_RGTC1,
+                                      static_cast<GLsizei>(levelBytes(size)), data + bytes);
+            bytes += levelBytes(size);
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return bytes;
+    }
+
+    Load* freeLoad()
+    {
+        for (Load& load : loads)
+            if (load.State.load(std::memory_order_acquire) == TEXTURE_LOAD_EMPTY)
+                return &load;
+        return NULL;
+    }
+
+    // a free slot of pool p, or the slot of a settled layer that now wants less than level p;
+    // -1 when neither exists
+    int acquire(int p, bool& changed)
+    {
+        int victim = -1;
+        for (unsigned int slot = 0; slot < poolOwners[p].size(); slot++)
+        {
+            int owner = poolOwners[p][slot];
+            if (owner < 0)
+                return static_cast<int>(slot);
+            if (loading[owner] || needed[owner] <= p)
+                continue;
+            if (victim < 0 || needed[owner] > needed[poolOwners[p][victim]])
+                victim = static_cast<int>(slot);
+        }
+        if (victim >= 0)
+        {
+            // the layer samples its tail from now on
+            TexturePool[poolOwners[p][victim]] = TEXSTREAM_TAIL;
+            poolOwners[p][victim] = -1;
+            Evictions++;
+            changed = true;
+        }
+        return victim;
+    }
+
+    void start(Load& load, unsigned int texture, int p, int slot)
+    {
+        poolOwners[p][slot] = static_cast<int>(texture);
+        loading[texture] = true;
+        load.Texture = texture;
+        load.Pool = p;
+        load.Slot = slot;
+        load.State.store(TEXTURE_LOAD_READING, std::memory_order_relaxed);
+
+        Load* target = &load;
+        const char* path = packPath.c_str();
+        long offset = static_cast<long>(headerBytes() + texture * textureBytes + levelOffset(p));
+        size_t bytes = textureBytes - levelOffset(p);
+        pool.Submit([target, path, offset, bytes]() {
+            bool ok = false;
+            if (FILE* file = std::fopen(path, "rb"))
+            {
+                ok = std::fseek(file, offset, SEEK_SET) == 0 && std::fread(target->Data.data(), 1, bytes, file) == bytes;
+                std::fclose(file);
+            }
+            target->State.store(ok ? TEXTURE_LOAD_READY : TEXTURE_LOAD_FAILED, std::memory_order_release);
+        });
+    }
+
+    // uploads finished loads until the frame's byte budget is spent; each replaces the slot
+    // its layer sampled until now
+    bool upload()
+    {
+        bool changed = false;
+        size_t budget = UploadBudget;
+        for (Load& load : loads)
+        {
+            int state = load.State.load(std::memory_order_acquire);
+            if (state == TEXTURE_LOAD_FAILED)
+            {
+                std::cout << "ERROR::TEXTURE_STREAMING::READ_FAILED layer " << load.Texture << std::endl;
+                poolOwners[load.Pool][load.Slot] = -1;
+                loading[load.Texture] = false;
+                load.State.store(TEXTURE_LOAD_EMPTY, std::memory_order_relaxed);
+                continue;
+            }
+            if (state != TEXTURE_LOAD_READY)
+                continue;
+            size_t bytes = textureBytes - levelOffset(load.Pool);
+            if (bytes > budget && budget != UploadBudget)
+                break;
+            uploadLevels(poolArrays[load.Pool], load.Pool, static_cast<unsigned int>(load.Slot), load.Data.data());
+            budget -= std::min(budget, bytes);
+            UploadedBytes += bytes;
+
+            unsigned int texture = load.Texture;
+            if (TexturePool[texture] != TEXSTREAM_TAIL)
+                poolOwners[TexturePool[texture]][TextureSlot[texture]] = -1;
+            TexturePool[texture] = load.Pool;
+            TextureSlot[texture] = load.Slot;
+            loading[texture] = false;
+            load.State.store(TEXTURE_LOAD_EMPTY, std::memory_order_relaxed);
+            Loads++;
+            changed = true;
+        }
+        return changed;
+    }
+
+    // BC4 blocks of a level of values in [0, 1]; levels under 4 texels repeat their edge
+    static void encodeLevel(const std::vector<float>& level, int size, std::vector<unsigned char>& blocks)
+    {
+        int blocksPerRow = std::max((size + 3) / 4, 1);
+        blocks.resize(static_cast<size_t>(blocksPerRow) * blocksPerRow * 8);
+        unsigned char texels[16];
+        for (int by = 0; by < blocksPerRow; by++)
+        {
+            for (int bx = 0; bx < blocksPerRow; bx++)
+            {
+                for (int i = 0; i < 16; i++)
+                {
+                    int x = std::min(bx * 4 + i % 4, size - 1), y = std::min(by * 4 + i / 4, size - 1);
+                    float value = std::min(std::max(level[static_cast<size_t>(y) * size + x], 0.0f), 1.0f);
+                    texels[i] = static_cast<unsigned char>(value * 255.0f + 0.5f);
+                }
+                encodeBlock(texels, &blocks[(static_cast<size_t>(by) * blocksPerRow + bx) * 8]);
+            }
+        }
+    }
+
+    // one 4x4 block in BC4's eight value mode: the endpoints are the block's extremes and
+    // every texel takes the nearest of the six values between them
+    static void encodeBlock(const unsigned char* texels, unsigned char* block)
+    {
+        unsigned char low = 255, high = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            low = std::min(low, texels[i]);
+            high = std::max(high, texels[i]);
+        }
+        block[0] = high;
+        block[1] = low;
+        unsigned long long indices = 0;
+        if (high > low)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                // steps up from low: 0 is low (index 1), 7 is high (index 0), step s between is index 8 - s
+                int step = (static_cast<int>(texels[i] - low) * 14 + (high - low)) / ((high - low) * 2);
+                unsigned long long index = step == 7 ? 0 : (step == 0 ? 1 : 8 - step);
+                indices |= index << (3 * i);
+            }
+        }
+        for (int i = 0; i < 6; i++)
+            block[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+    }
+};
+
+#endif
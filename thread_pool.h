@@ -0,0 +1,186 @@
+//
+//  thread_pool.h
+//  3D Object Drawing
+//
+//  Fixed set of worker threads shared by the CPU-side subsystems. ParallelFor
+//  splits a range across the workers and the calling thread and does not allocate;
+//  Submit queues independent background jobs.
+//
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    // workerCount 0 uses one worker per hardware thread besides the caller
+    explicit ThreadPool(unsigned int workerCount = 0)
+        : stopping(false), parallelTask(nullptr), generation(0), runningJobs(0)
+    {
+        if (workerCount == 0)
+        {
+            unsigned int hardware = std::thread::hardware_concurrency();
+            workerCount = hardware > 1 ? hardware - 1 : 0;
+        }
+        for (unsigned int i = 0; i < workerCount; i++)
+            workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeCondition.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // threads that take part in ParallelFor, including the caller
+    unsigned int Size() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+    // calls func(begin, end) over [0, count) in chunks of at least minChunk elements and
+    // returns once every chunk is done; must not be called from inside a pool job
+    template<typename Func>
+    void ParallelFor(size_t count, size_t minChunk, Func&& func)
+    {
+        if (count == 0)
+            return;
+        size_t chunk = std::max<size_t>(std::max<size_t>(minChunk, 1), (count + Size() * 4 - 1) / (Size() * 4));
+        if (workers.empty() || chunk >= count)
+        {
+            func(size_t(0), count);
+            return;
+        }
+
+        typedef typename std::remove_reference<Func>::type FuncType;
+        ParallelTask task;
+        task.invoke = [](void* context, size_t begin, size_t end) { (*static_cast<FuncType*>(context))(begin, end); };
+        task.context = const_cast<void*>(static_cast<const void*>(&func));
+        task.count = count;
+        task.chunk = chunk;
+        task.next = 0;
+        task.users = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            parallelTask = &task;
+            generation++;
+        }
+        wakeCondition.notify_all();
+
+        runChunks(task);
+
+        // every chunk has been claimed; wait for workers still finishing theirs
+        std::unique_lock<std::mutex> lock(mutex);
+        parallelTask = nullptr;
+        doneCondition.wait(lock, [&task] { return task.users == 0; });
+    }
+
+    // queues a job to run on some worker; use Wait() to join all queued jobs
+    void Submit(std::function<void()> job)
+    {
+        if (workers.empty())
+        {
+            job();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        wakeCondition.notify_one();
+    }
+
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [this] { return jobs.empty() && runningJobs == 0; });
+    }
+
+private:
+    struct ParallelTask
+    {
+        void (*invoke)(void* context, size_t begin, size_t end);
+        void* context;
+        size_t count;
+        size_t chunk;
+        std::atomic<size_t> next;
+        int users;
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    bool stopping;
+    ParallelTask* parallelTask;
+    unsigned long long generation;
+    std::deque<std::function<void()>> jobs;
+    int runningJobs;
+
+    static void runChunks(ParallelTask& task)
+    {
+        for (;;)
+        {
+            size_t begin = task.next.fetch_add(task.chunk);
+            if (begin >= task.count)
+                return;
+            task.invoke(task.context, begin, std::min(begin + task.chunk, task.count));
+        }
+    }
+
+    void workerLoop()
+    {
+        unsigned long long seenGeneration = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            wakeCondition.wait(lock, [this, &seenGeneration] {
+                return stopping || !jobs.empty() || (parallelTask != nullptr && generation != seenGeneration);
+            });
+            if (stopping)
+                return;
+
+            if (parallelTask != nullptr && generation != seenGeneration)
+            {
+                seenGeneration = generation;
+                ParallelTask* task = parallelTask;
+                task->users++;
+                lock.unlock();
+                runChunks(*task);
+                lock.lock();
+                if (--task->users == 0)
+                    doneCondition.notify_all();
+                continue;
+            }
+
+            std::function<void()> job = std::move(jobs.front());
+            jobs.pop_front();
+            runningJobs++;
+            lock.unlock();
+            job();
+            lock.lock();
+            runningJobs--;
+            if (jobs.empty() && runningJobs == 0)
+                doneCondition.notify_all();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,149 @@
+//
+//  transparency.h
+//  3D Object Drawing
+//
+//  Weighted blended order-independent transparency (McGuire and Bavoil, 2013).
+//  Transparent instances are drawn unsorted, after everything opaque, into two
+//  additive targets that share the opaque pass's depth buffer (tested, not
+//  written): the accumulation target sums the weighted premultiplied color in
+//  rgb and the weights in alpha, the revealage target sums -log2(1 - alpha), so
+//  the product of (1 - alpha) over all layers, the part of the background that
+//  still shows, is exp2(-sum). Both only need glBlendFunc(GL_ONE, GL_ONE), which
+//  GL 3.3 applies to every draw buffer alike. A full-screen composite then blends
+//  the weighted average color over the opaque image in one pass.
+//
+
+#ifndef TRANSPARENCY_H
+#define TRANSPARENCY_H
+
+#include <glad/glad.h>
+
+#include "shader.h"
+
+#include <iostream>
+
+// texture units the composite reads from
+const int TRANSPARENCY_ACCUM_UNIT = 0;
+const int TRANSPARENCY_REVEALAGE_UNIT = 1;
+
+class TransparencyTarget
+{
+public:
+    unsigned int FBO, AccumTexture, RevealageTexture;
+    int Width, Height;              // those of the shared depth buffer
+
+    TransparencyTarget()
+        : FBO(0), AccumTexture(0), RevealageTexture(0), Width(0), Height(0), depthBuffer(0), target(0), emptyVAO(0),
+          composite("transparencyComposite.vs", "transparencyComposite.fs")
+    {
+        composite.use();
+        composite.setInt("accumulation", TRANSPARENCY_ACCUM_UNIT);
+        composite.setInt("revealage", TRANSPARENCY_REVEALAGE_UNIT);
+        // the composite's full-screen triangle comes from gl_VertexID alone
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    // shares depthRenderbuffer with the opaque target; call again whenever that is reallocated.
+    // The targets take its size, so the opaque pass's viewport addresses the same pixels here.
+    void Attach(unsigned int depthRenderbuffer)
+    {
+        GLint width = 0, height = 0, format = 0;
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+        glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_WIDTH, &width);
+        glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_HEIGHT, &height);
+        glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_INTERNAL_FORMAT, &format);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        if (depthRenderbuffer == depthBuffer && width == Width && height == Height)
+            return;
+
+        release();
+        depthBuffer = depthRenderbuffer;
+        Width = width;
+        Height = height;
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        AccumTexture = createTexture(GL_RGBA16F, GL_RGBA);
+        RevealageTexture = createTexture(GL_R16F, GL_RED);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, AccumTexture, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, RevealageTexture, 0);
+        bool stencil = format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+        const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, drawBuffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::TRANSPARENCY::FRAMEBUFFER_INCOMPLETE" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // redirects drawing from the bound (opaque) framebuffer to the cleared targets;
+    // an active scissor limits the clear like it limits the opaque pass
+    void Begin()
+    {
+        GLint bound = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &bound);
+        target = static_cast<unsigned int>(bound);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        const GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glClearBufferfv(GL_COLOR, 0, zero);
+        glClearBufferfv(GL_COLOR, 1, zero);
+    }
+
+    // blends the weighted average of the transparent layers over the framebuffer Begin() found bound
+    void Composite()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, target);
+        glActiveTexture(GL_TEXTURE0 + TRANSPARENCY_ACCUM_UNIT);
+        glBindTexture(GL_TEXTURE_2D, AccumTexture);
+        glActiveTexture(GL_TEXTURE0 + TRANSPARENCY_REVEALAGE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, RevealageTexture);
+        glActiveTexture(GL_TEXTURE0);
+
+        composite.use();
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    void Release()
+    {
+        release();
+        glDeleteVertexArrays(1, &emptyVAO);
+        emptyVAO = 0;
+    }
+
+private:
+    unsigned int depthBuffer;       // shared, owned by the opaque target
+    unsigned int target;            // framebuffer to composite into
+    unsigned int emptyVAO;
+    Shader composite;
+
+    unsigned int createTexture(GLenum internalFormat, GLenum format)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, Width, Height, 0, format, GL_HALF_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    }
+
+    void release()
+    {
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteTextures(1, &AccumTexture);
+        glDeleteTextures(1, &RevealageTexture);
+        FBO = AccumTexture = RevealageTexture = 0;
+        depthBuffer = 0;
+        Width = Height = 0;
+    }
+};
+
+#endif
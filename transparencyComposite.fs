@@ -0,0 +1,18 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D accumulation;     // rgb: sum of weighted premultiplied color, a: sum of weights
+uniform sampler2D revealage;        // sum of -log2(1 - alpha) over the layers
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float reveal = exp2(-texelFetch(revealage, texel, 0).r);
+    // nothing transparent covers this pixel
+    if (reveal >= 0.999)
+        discard;
+
+    vec4 accum = texelFetch(accumulation, texel, 0);
+    // blended (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA): the average color covers 1 - reveal of the background
+    FragColor = vec4(accum.rgb / max(accum.a, 1e-5), 1.0 - reveal);
+}
@@ -0,0 +1,308 @@
+//
+//  world_streaming.h
+//  3D Object Drawing
+//
+//  Streams a building far too large to create up front. The world is a grid of
+//  chunks on the floor plane; chunks within LoadRadius of the camera are generated
+//  on the thread pool into a fixed set of slots and uploaded into one instance
+//  buffer, a bounded number of bytes per frame. Everything is allocated once from
+//  MemoryBudget, so memory stays flat however far the camera travels. When no slot
+//  is free, the least recently visible resident chunk farther away than the wanted
+//  one is evicted, preferring chunks outside the load radius.
+//
+
+#ifndef WORLD_STREAMING_H
+#define WORLD_STREAMING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "scene_renderer.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+enum Chunk_State {
+    CHUNK_EMPTY,            // slot is free
+    CHUNK_BUILDING,         // a worker is generating it
+    CHUNK_READY,            // generated, waiting for its upload
+    CHUNK_RESIDENT          // uploaded and drawable
+};
+
+// upper bound of the parts a generator may emit for one chunk
+const unsigned int STREAM_MAX_CHUNK_INSTANCES = 64;
+
+// generated content of one chunk; the generator runs on a worker thread and may only
+// append to Instances (capacity STREAM_MAX_CHUNK_INSTANCES) and touch nothing shared
+struct ChunkData
+{
+    std::vector<SceneInstance> Instances;
+    AABB Bounds;
+};
+
+typedef void (*ChunkGenerator)(const glm::ivec2& chunk, const glm::vec2& origin, ChunkData& data);
+
+class WorldStreamer
+{
+public:
+    glm::vec2 ChunkSize;            // chunk extent on the floor plane
+    float LoadRadius;               // chunks closer than this to the camera are wanted
+    size_t UploadBudget;            // bytes uploaded per frame at most
+    unsigned int MaxBuildsInFlight;
+
+    // statistics
+    unsigned long long Loads, Evictions;
+
+    WorldStreamer(ThreadPool& pool, ChunkGenerator generator, const glm::vec2& chunkSize, size_t memoryBudget, float loadRadius)
+        : ChunkSize(chunkSize), LoadRadius(loadRadius), UploadBudget(256 * 1024), MaxBuildsInFlight(4),
+          Loads(0), Evictions(0), pool(pool), generator(generator), slots(NULL), slotCount(0), instanceBuffer(0), frame(0),
+          buildsInFlight(0)
+    {
+        size_t slotBytes = sizeof(SceneInstance) * STREAM_MAX_CHUNK_INSTANCES;
+        // the CPU copy of a chunk costs as much as its GPU copy
+        slotCount = static_cast<unsigned int>(std::max<size_t>(memoryBudget / (slotBytes * 2), 1));
+        slots = new Slot[slotCount];
+        for (unsigned int i = 0; i < slotCount; i++)
+            slots[i].Data.Instances.reserve(STREAM_MAX_CHUNK_INSTANCES);
+
+        glGenBuffers(1, &instanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, slotBytes * slotCount, NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ~WorldStreamer()
+    {
+        Release();
+    }
+
+    WorldStreamer(const WorldStreamer&) = delete;
+    WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+    unsigned int InstanceBuffer() const { return instanceBuffer; }
+    unsigned int SlotCount() const { return slotCount; }
+
+    // true while chunks are being generated or wait for their upload
+    bool Busy() const
+    {
+        for (unsigned int i = 0; i < slotCount; i++)
+        {
+            int state = slots[i].State.load(std::memory_order_acquire);
+            if (state == CHUNK_BUILDING || state == CHUNK_READY)
+                return true;
+        }
+        return false;
+    }
+
+    // requests the chunks around the camera, uploads finished ones and returns true when
+    // the set of drawable chunks changed
+    bool Update(const glm::vec3& cameraPosition)
+    {
+        frame++;
+        bool changed = upload();
+
+        glm::vec2 camera(cameraPosition.x, cameraPosition.y);
+        glm::ivec2 center = ChunkAt(camera);
+        int reach = static_cast<int>(std::ceil(LoadRadius / std::min(ChunkSize.x, ChunkSize.y)));
+
+        // nearest chunks first, ring by ring, so a small budget keeps the closest ones
+        for (int ring = 0; ring <= reach && buildsInFlight < MaxBuildsInFlight; ring++)
+        {
+            for (int dy = -ring; dy <= ring && buildsInFlight < MaxBuildsInFlight; dy++)
+            {
+                for (int dx = -ring; dx <= ring; dx++)
+                {
+                    if (std::max(std::abs(dx), std::abs(dy)) != ring)
+                        continue;
+                    glm::ivec2 chunk = center + glm::ivec2(dx, dy);
+                    if (distance(camera, chunk) > LoadRadius || find(chunk) >= 0)
+                        continue;
+                    int slot = acquire(camera, distance(camera, chunk));
+                    if (slot < 0)
+                        return changed;
+                    changed = evict(slot) || changed;
+                    build(slot, chunk);
+                    if (buildsInFlight >= MaxBuildsInFlight)
+                        break;
+                }
+            }
+        }
+        return changed;
+    }
+
+    // resident chunks whose bounds touch the frustum, as (first instance, count) runs into
+    // InstanceBuffer(); runs needs room for SlotCount() entries
+    unsigned int Visible(const Frustum& frustum, glm::uvec2* runs)
+    {
+        unsigned int count = 0;
+        for (unsigned int i = 0; i < slotCount; i++)
+        {
+            Slot& slot = slots[i];
+            if (slot.State.load(std::memory_order_acquire) != CHUNK_RESIDENT || slot.Data.Instances.empty() ||
+                !frustum.Intersects(slot.Data.Bounds))
+                continue;
+            slot.LastVisibleFrame = frame;
+            runs[count++] = glm::uvec2(i * STREAM_MAX_CHUNK_INSTANCES, static_cast<unsigned int>(slot.Data.Instances.size()));
+        }
+        return count;
+    }
+
+    glm::ivec2 ChunkAt(const glm::vec2& position) const
+    {
+        return glm::ivec2(static_cast<int>(std::floor(position.x / ChunkSize.x + 0.5f)),
+                          static_cast<int>(std::floor(position.y / ChunkSize.y + 0.5f)));
+    }
+
+    // center of a chunk on the floor plane
+    glm::vec2 ChunkOrigin(const glm::ivec2& chunk) const
+    {
+        return glm::vec2(chunk.x * ChunkSize.x, chunk.y * ChunkSize.y);
+    }
+
+    void PrintStats() const
+    {
+        size_t bytes = sizeof(SceneInstance) * STREAM_MAX_CHUNK_INSTANCES * slotCount;
+        std::cout << "streaming: " << slotCount << " chunk slots (" << bytes / 1024 << " KiB GPU + " << bytes / 1024 << " KiB CPU), "
+                  << Loads << " loads, " << Evictions << " evictions" << std::endl;
+    }
+
+    // waits for the workers, then frees the slots and the buffer
+    void Release()
+    {
+        if (slots == NULL)
+            return;
+        pool.Wait();
+        delete[] slots;
+        slots = NULL;
+        slotCount = 0;
+        glDeleteBuffers(1, &instanceBuffer);
+        instanceBuffer = 0;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<int> State;
+        glm::ivec2 Chunk;
+        unsigned long long LastVisibleFrame;
+        ChunkData Data;
+
+        Slot() : State(CHUNK_EMPTY), Chunk(INT_MIN), LastVisibleFrame(0) {}
+    };
+
+    ThreadPool& pool;
+    ChunkGenerator generator;
+    Slot* slots;
+    unsigned int slotCount;
+    unsigned int instanceBuffer;
+    unsigned long long frame;
+    unsigned int buildsInFlight;
+
+    // distance on the floor plane from the camera to the nearest point of a chunk
+    float distance(const glm::vec2& camera, const glm::ivec2& chunk) const
+    {
+        glm::vec2 d = glm::max(glm::abs(camera - ChunkOrigin(chunk)) - ChunkSize * 0.5f, glm::vec2(0.0f));
+        return std::sqrt(d.x * d.x + d.y * d.y);
+    }
+
+    int find(const glm::ivec2& chunk) const
+    {
+        for (unsigned int i = 0; i < slotCount; i++)
+        {
+            if (slots[i].State.load(std::memory_order_relaxed) != CHUNK_EMPTY && slots[i].Chunk == chunk)
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    // a free slot, or the least recently visible resident chunk that is farther away than
+    // the one being requested; chunks outside the load radius go first
+    int acquire(const glm::vec2& camera, float wantedDistance)
+    {
+        int victim = -1;
+        bool victimOutside = false;
+        for (unsigned int i = 0; i < slotCount; i++)
+        {
+            int state = slots[i].State.load(std::memory_order_acquire);
+            if (state == CHUNK_EMPTY)
+                return static_cast<int>(i);
+            if (state != CHUNK_RESIDENT || slots[i].LastVisibleFrame == frame)
+                continue;
+            float d = distance(camera, slots[i].Chunk);
+            if (d <= wantedDistance)
+                continue;
+            bool outside = d > LoadRadius;
+            if (victim < 0 || (outside && !victimOutside) ||
+                (outside == victimOutside && slots[i].LastVisibleFrame < slots[victim].LastVisibleFrame))
+            {
+                victim = static_cast<int>(i);
+                victimOutside = outside;
+            }
+        }
+        return victim;
+    }
+
+    bool evict(int index)
+    {
+        Slot& slot = slots[index];
+        if (slot.State.load(std::memory_order_relaxed) != CHUNK_RESIDENT)
+            return false;
+        slot.State.store(CHUNK_EMPTY, std::memory_order_relaxed);
+        Evictions++;
+        return true;
+    }
+
+    void build(int index, const glm::ivec2& chunk)
+    {
+        Slot* slot = &slots[index];
+        slot->Chunk = chunk;
+        slot->LastVisibleFrame = 0;
+        slot->State.store(CHUNK_BUILDING, std::memory_order_relaxed);
+        buildsInFlight++;
+
+        glm::vec2 origin = ChunkOrigin(chunk);
+        ChunkGenerator generate = generator;
+        pool.Submit([slot, chunk, origin, generate]() {
+            slot->Data.Instances.clear();
+            slot->Data.Bounds = AABB();
+            generate(chunk, origin, slot->Data);
+            if (slot->Data.Instances.size() > STREAM_MAX_CHUNK_INSTANCES)
+                slot->Data.Instances.resize(STREAM_MAX_CHUNK_INSTANCES);
+            slot->State.store(CHUNK_READY, std::memory_order_release);
+        });
+    }
+
+    // uploads finished chunks until the frame's byte budget is spent
+    bool upload()
+    {
+        bool changed = false;
+        size_t budget = UploadBudget;
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        for (unsigned int i = 0; i < slotCount; i++)
+        {
+            Slot& slot = slots[i];
+            if (slot.State.load(std::memory_order_acquire) != CHUNK_READY)
+                continue;
+            size_t bytes = sizeof(SceneInstance) * slot.Data.Instances.size();
+            if (bytes > budget && budget != UploadBudget)
+                break;
+            if (bytes > 0)
+                glBufferSubData(GL_ARRAY_BUFFER, sizeof(SceneInstance) * STREAM_MAX_CHUNK_INSTANCES * i, bytes, slot.Data.Instances.data());
+            budget -= std::min(budget, bytes);
+            slot.State.store(CHUNK_RESIDENT, std::memory_order_relaxed);
+            buildsInFlight--;
+            Loads++;
+            changed = true;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return changed;
+    }
+};
+
+#endif